@@ -0,0 +1,446 @@
+#include "assetregistry.hpp"
+#include "../util/hash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+#include <sstream>
+#include <tinygltf/tiny_gltf.h>
+
+namespace denoise::assets {
+
+    std::string AssetDedupStats::PrintPretty() const
+    {
+        return fmt::format("Dedup of {} models: images {} -> {} ({:.1f} -> {:.1f} MB), accessors {} -> {} ({:.1f} -> {:.1f} MB), materials {} -> {}, meshes {} -> {} "
+                           "({} instances of shared meshes)",
+                           Models, Images, UniqueImages, ImageBytes * 1e-6, UniqueImageBytes * 1e-6, Accessors, UniqueAccessors, AccessorBytes * 1e-6,
+                           UniqueAccessorBytes * 1e-6, Materials, UniqueMaterials, Meshes, UniqueMeshes, SharedMeshInstances);
+    }
+
+    std::string AssetDedupStats::Serialize() const
+    {
+        return fmt::format("{} {} {} {} {} {} {} {} {} {} {} {} {} {}", Models, Images, Accessors, Materials, Meshes, UniqueImages, UniqueAccessors, UniqueMaterials,
+                           UniqueMeshes, ImageBytes, AccessorBytes, UniqueImageBytes, UniqueAccessorBytes, SharedMeshInstances);
+    }
+
+    bool AssetDedupStats::Parse(const std::string& text)
+    {
+        std::istringstream stream(text);
+        stream >> Models >> Images >> Accessors >> Materials >> Meshes >> UniqueImages >> UniqueAccessors >> UniqueMaterials >> UniqueMeshes >> ImageBytes >> AccessorBytes
+            >> UniqueImageBytes >> UniqueAccessorBytes >> SharedMeshInstances;
+        return !stream.fail();
+    }
+
+    namespace {
+        /// @brief Returns the index of an item in items equal to item (ignoring names, sources name shared assets differently), appends item otherwise
+        template <typename T>
+        int lIntern(std::vector<T>& items, std::unordered_multimap<uint64_t, int>& lookup, uint64_t hash, T&& item)
+        {
+            auto range = lookup.equal_range(hash);
+            for(auto iter = range.first; iter != range.second; iter++)
+            {
+                T& existing = items[iter->second];
+                std::swap(item.name, existing.name);
+                bool equal = existing == item;
+                std::swap(item.name, existing.name);
+                if(equal)
+                {
+                    return iter->second;
+                }
+            }
+            int index = static_cast<int>(items.size());
+            items.push_back(std::move(item));
+            lookup.emplace(hash, index);
+            return index;
+        }
+
+        int lRemap(int index, const std::vector<int>& map) { return index >= 0 && index < static_cast<int>(map.size()) ? map[index] : -1; }
+
+        int lOffset(int index, int offset) { return index >= 0 ? index + offset : index; }
+
+        void lHashDoubles(uint64_t& hash, const std::vector<double>& values)
+        {
+            util::HashBytes(hash, values.data(), values.size() * sizeof(double));
+        }
+
+        /// @brief Remaps the "index" of texture references ("...Texture" objects) in material extensions
+        void lRemapTextureReferences(tinygltf::Value& value, const std::vector<int>& textureMap)
+        {
+            if(!value.IsObject())
+            {
+                return;
+            }
+            tinygltf::Value::Object object = value.Get<tinygltf::Value::Object>();
+            for(auto& [key, member] : object)
+            {
+                if(key.ends_with("Texture") && member.IsObject() && member.Has("index"))
+                {
+                    tinygltf::Value::Object reference = member.Get<tinygltf::Value::Object>();
+                    reference["index"]                = tinygltf::Value(lRemap(member.Get("index").GetNumberAsInt(), textureMap));
+                    member                            = tinygltf::Value(std::move(reference));
+                }
+                else
+                {
+                    lRemapTextureReferences(member, textureMap);
+                }
+            }
+            value = tinygltf::Value(std::move(object));
+        }
+    }  // namespace
+
+    AssetRegistry::AssetRegistry(util::ThreadPool* threadPool) : mThreadPool(threadPool), mMerged(new tinygltf::Model())
+    {
+        mMerged->buffers.emplace_back();
+    }
+
+    AssetRegistry::~AssetRegistry()
+    {
+        delete mMerged;
+    }
+
+    void AssetRegistry::Add(tinygltf::Model& model)
+    {
+        mStats.Models++;
+
+        // Hashing the texels dominates, images are hashed in parallel up front
+        std::vector<uint64_t> imageHashes(model.images.size(), util::FNV1A_SEED);
+        mThreadPool->ParallelFor(
+            static_cast<uint32_t>(model.images.size()),
+            [&](uint32_t index) {
+                const tinygltf::Image& image    = model.images[index];
+                int32_t                header[] = {image.width, image.height, image.component, image.bits, image.pixel_type};
+                util::HashBytes(imageHashes[index], header, sizeof(header));
+                util::HashBytes(imageHashes[index], image.image.data(), image.image.size());
+            },
+            1);
+
+        std::vector<int> imageMap(model.images.size());
+        for(size_t i = 0; i < model.images.size(); i++)
+        {
+            imageMap[i] = AddImage(model, static_cast<int>(i), imageHashes[i]);
+        }
+        std::vector<int> textureMap(model.textures.size());
+        for(size_t i = 0; i < model.textures.size(); i++)
+        {
+            textureMap[i] = AddTexture(model, static_cast<int>(i), imageMap);
+        }
+        std::vector<int> materialMap(model.materials.size());
+        for(size_t i = 0; i < model.materials.size(); i++)
+        {
+            materialMap[i] = AddMaterial(model, static_cast<int>(i), textureMap);
+        }
+        std::vector<int> meshMap(model.meshes.size());
+        for(size_t i = 0; i < model.meshes.size(); i++)
+        {
+            meshMap[i] = AddMesh(model, static_cast<int>(i), materialMap);
+        }
+
+        // Scene graph, cameras, skins, lights and animations belong to the model and are appended
+        const int nodeOffset   = static_cast<int>(mMerged->nodes.size());
+        const int cameraOffset = static_cast<int>(mMerged->cameras.size());
+        const int skinOffset   = static_cast<int>(mMerged->skins.size());
+        const int lightOffset  = static_cast<int>(mMerged->lights.size());
+        for(tinygltf::Node node : model.nodes)
+        {
+            node.mesh = lRemap(node.mesh, meshMap);
+            if(node.mesh >= 0)
+            {
+                mMeshInstanceCounts.resize(mMerged->meshes.size(), 0);
+                mStats.SharedMeshInstances += mMeshInstanceCounts[node.mesh]++ > 0 ? 1 : 0;
+            }
+            node.camera = lOffset(node.camera, cameraOffset);
+            node.skin   = lOffset(node.skin, skinOffset);
+            for(int& child : node.children)
+            {
+                child += nodeOffset;
+            }
+            auto light = node.extensions.find("KHR_lights_punctual");
+            if(light != node.extensions.end() && light->second.Has("light"))
+            {
+                tinygltf::Value::Object object = light->second.Get<tinygltf::Value::Object>();
+                object["light"]                = tinygltf::Value(light->second.Get("light").GetNumberAsInt() + lightOffset);
+                light->second                  = tinygltf::Value(std::move(object));
+            }
+            mMerged->nodes.push_back(std::move(node));
+        }
+        mMerged->cameras.insert(mMerged->cameras.end(), model.cameras.begin(), model.cameras.end());
+        mMerged->lights.insert(mMerged->lights.end(), model.lights.begin(), model.lights.end());
+        for(tinygltf::Skin skin : model.skins)
+        {
+            skin.inverseBindMatrices = skin.inverseBindMatrices >= 0 ? AddAccessor(model, skin.inverseBindMatrices) : -1;
+            skin.skeleton            = lOffset(skin.skeleton, nodeOffset);
+            for(int& joint : skin.joints)
+            {
+                joint += nodeOffset;
+            }
+            mMerged->skins.push_back(std::move(skin));
+        }
+        for(tinygltf::Animation animation : model.animations)
+        {
+            for(tinygltf::AnimationSampler& sampler : animation.samplers)
+            {
+                sampler.input  = AddAccessor(model, sampler.input);
+                sampler.output = AddAccessor(model, sampler.output);
+            }
+            for(tinygltf::AnimationChannel& channel : animation.channels)
+            {
+                channel.target_node = lOffset(channel.target_node, nodeOffset);
+            }
+            mMerged->animations.push_back(std::move(animation));
+        }
+
+        if(!model.scenes.empty())
+        {
+            const tinygltf::Scene& scene = model.scenes[std::clamp(model.defaultScene, 0, static_cast<int>(model.scenes.size()) - 1)];
+            for(int node : scene.nodes)
+            {
+                mRootNodes.push_back(node + nodeOffset);
+            }
+        }
+        else
+        {
+            std::vector<bool> isChild(model.nodes.size(), false);
+            for(const tinygltf::Node& node : model.nodes)
+            {
+                for(int child : node.children)
+                {
+                    isChild[child] = true;
+                }
+            }
+            for(size_t i = 0; i < model.nodes.size(); i++)
+            {
+                if(!isChild[i])
+                {
+                    mRootNodes.push_back(static_cast<int>(i) + nodeOffset);
+                }
+            }
+        }
+
+        for(const std::string& extension : model.extensionsUsed)
+        {
+            if(std::find(mMerged->extensionsUsed.begin(), mMerged->extensionsUsed.end(), extension) == mMerged->extensionsUsed.end())
+            {
+                mMerged->extensionsUsed.push_back(extension);
+            }
+        }
+    }
+
+    void AssetRegistry::Finish(tinygltf::Model& out)
+    {
+        tinygltf::Scene scene;
+        scene.nodes = std::move(mRootNodes);
+        mMerged->scenes.push_back(std::move(scene));
+        mMerged->defaultScene  = 0;
+        mMerged->asset.version = "2.0";
+        // Draco compressed primitives were decoded into plain accessors on import
+        std::erase(mMerged->extensionsUsed, "KHR_draco_mesh_compression");
+        mMerged->buffers[0].data.resize((mMerged->buffers[0].data.size() + 3) / 4 * 4);
+        out = std::move(*mMerged);
+        *mMerged = tinygltf::Model();
+        mMerged->buffers.emplace_back();
+        mRootNodes.clear();
+        mMeshInstanceCounts.clear();
+    }
+
+    int AssetRegistry::AddImage(tinygltf::Model& model, int index, uint64_t hash)
+    {
+        tinygltf::Image& image = model.images[index];
+        mStats.Images++;
+        mStats.ImageBytes += image.image.size();
+
+        auto range = mImageLookup.equal_range(hash);
+        for(auto iter = range.first; iter != range.second; iter++)
+        {
+            const tinygltf::Image& existing = mMerged->images[iter->second];
+            if(!image.image.empty() && existing.width == image.width && existing.height == image.height && existing.component == image.component
+               && existing.bits == image.bits && existing.pixel_type == image.pixel_type && existing.image == image.image)
+            {
+                image.image = {};
+                return iter->second;
+            }
+        }
+
+        tinygltf::Image merged;
+        merged.name       = image.name.empty() ? image.uri : image.name;
+        merged.width      = image.width;
+        merged.height     = image.height;
+        merged.component  = image.component;
+        merged.bits       = image.bits;
+        merged.pixel_type = image.pixel_type;
+        merged.image      = std::move(image.image);
+        mStats.UniqueImages++;
+        mStats.UniqueImageBytes += merged.image.size();
+        int mergedIndex = static_cast<int>(mMerged->images.size());
+        mMerged->images.push_back(std::move(merged));
+        mImageLookup.emplace(hash, mergedIndex);
+        return mergedIndex;
+    }
+
+    int AssetRegistry::AddAccessor(const tinygltf::Model& model, int index)
+    {
+        if(index < 0 || index >= static_cast<int>(model.accessors.size()))
+        {
+            return -1;
+        }
+        const tinygltf::Accessor& accessor    = model.accessors[index];
+        const size_t              elementSize = (size_t)tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+
+        // Gather the elements tightly packed, accessors without buffer view are zero and sparse ones get their substitutions applied
+        mElements.assign(elementSize * accessor.count, 0);
+        if(accessor.bufferView >= 0)
+        {
+            const tinygltf::BufferView& view   = model.bufferViews[accessor.bufferView];
+            const uint8_t*              source = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+            const size_t                stride = view.byteStride > 0 ? view.byteStride : elementSize;
+            for(size_t i = 0; i < accessor.count; i++)
+            {
+                std::memcpy(mElements.data() + i * elementSize, source + i * stride, elementSize);
+            }
+        }
+        if(accessor.sparse.isSparse)
+        {
+            const tinygltf::BufferView& indexView = model.bufferViews[accessor.sparse.indices.bufferView];
+            const tinygltf::BufferView& valueView = model.bufferViews[accessor.sparse.values.bufferView];
+            const uint8_t*              indices   = model.buffers[indexView.buffer].data.data() + indexView.byteOffset + accessor.sparse.indices.byteOffset;
+            const uint8_t*              values    = model.buffers[valueView.buffer].data.data() + valueView.byteOffset + accessor.sparse.values.byteOffset;
+            const int                   indexSize = tinygltf::GetComponentSizeInBytes(accessor.sparse.indices.component_type);
+            for(int i = 0; i < accessor.sparse.count; i++)
+            {
+                uint32_t element = 0;
+                std::memcpy(&element, indices + (size_t)i * indexSize, indexSize);  // Little endian
+                if(element < accessor.count)
+                {
+                    std::memcpy(mElements.data() + element * elementSize, values + i * elementSize, elementSize);
+                }
+            }
+        }
+
+        uint64_t hash     = util::FNV1A_SEED;
+        int32_t  header[] = {accessor.componentType, accessor.type, accessor.normalized ? 1 : 0};
+        uint64_t count    = accessor.count;
+        util::HashBytes(hash, header, sizeof(header));
+        util::HashBytes(hash, &count, sizeof(count));
+        util::HashBytes(hash, mElements.data(), mElements.size());
+        mStats.Accessors++;
+        mStats.AccessorBytes += mElements.size();
+
+        std::vector<uint8_t>& buffer = mMerged->buffers[0].data;
+        auto                  range  = mAccessorLookup.equal_range(hash);
+        for(auto iter = range.first; iter != range.second; iter++)
+        {
+            const tinygltf::Accessor&   existing = mMerged->accessors[iter->second];
+            const tinygltf::BufferView& view     = mMerged->bufferViews[existing.bufferView];
+            if(existing.componentType == accessor.componentType && existing.type == accessor.type && existing.normalized == accessor.normalized
+               && existing.count == accessor.count && view.byteLength == mElements.size()
+               && std::memcmp(buffer.data() + view.byteOffset, mElements.data(), mElements.size()) == 0)
+            {
+                return iter->second;
+            }
+        }
+
+        // Unique: append the elements with a buffer view of their own
+        tinygltf::BufferView view;
+        view.buffer     = 0;
+        view.byteOffset = (buffer.size() + 15) / 16 * 16;
+        view.byteLength = mElements.size();
+        view.target     = accessor.bufferView >= 0 ? model.bufferViews[accessor.bufferView].target : 0;
+        buffer.resize(view.byteOffset);
+        buffer.insert(buffer.end(), mElements.begin(), mElements.end());
+
+        tinygltf::Accessor merged = accessor;
+        merged.bufferView         = static_cast<int>(mMerged->bufferViews.size());
+        merged.byteOffset         = 0;
+        merged.sparse             = {};
+        mMerged->bufferViews.push_back(view);
+        mStats.UniqueAccessors++;
+        mStats.UniqueAccessorBytes += mElements.size();
+        int mergedIndex = static_cast<int>(mMerged->accessors.size());
+        mMerged->accessors.push_back(std::move(merged));
+        mAccessorLookup.emplace(hash, mergedIndex);
+        return mergedIndex;
+    }
+
+    int AssetRegistry::AddSampler(const tinygltf::Model& model, int index)
+    {
+        if(index < 0 || index >= static_cast<int>(model.samplers.size()))
+        {
+            return -1;
+        }
+        tinygltf::Sampler sampler  = model.samplers[index];
+        uint64_t          hash     = util::FNV1A_SEED;
+        int32_t           fields[] = {sampler.minFilter, sampler.magFilter, sampler.wrapS, sampler.wrapT};
+        util::HashBytes(hash, fields, sizeof(fields));
+        return lIntern(mMerged->samplers, mSamplerLookup, hash, std::move(sampler));
+    }
+
+    int AssetRegistry::AddTexture(const tinygltf::Model& model, int index, const std::vector<int>& imageMap)
+    {
+        tinygltf::Texture texture = model.textures[index];
+        texture.sampler           = AddSampler(model, texture.sampler);
+        texture.source            = lRemap(texture.source, imageMap);
+        uint64_t hash             = util::FNV1A_SEED;
+        int32_t  fields[]         = {texture.sampler, texture.source};
+        util::HashBytes(hash, fields, sizeof(fields));
+        return lIntern(mMerged->textures, mTextureLookup, hash, std::move(texture));
+    }
+
+    int AssetRegistry::AddMaterial(const tinygltf::Model& model, int index, const std::vector<int>& textureMap)
+    {
+        tinygltf::Material material                                  = model.materials[index];
+        material.pbrMetallicRoughness.baseColorTexture.index         = lRemap(material.pbrMetallicRoughness.baseColorTexture.index, textureMap);
+        material.pbrMetallicRoughness.metallicRoughnessTexture.index = lRemap(material.pbrMetallicRoughness.metallicRoughnessTexture.index, textureMap);
+        material.normalTexture.index                                 = lRemap(material.normalTexture.index, textureMap);
+        material.occlusionTexture.index                              = lRemap(material.occlusionTexture.index, textureMap);
+        material.emissiveTexture.index                               = lRemap(material.emissiveTexture.index, textureMap);
+        for(auto& [name, extension] : material.extensions)
+        {
+            lRemapTextureReferences(extension, textureMap);
+        }
+        mStats.Materials++;
+
+        uint64_t hash     = util::FNV1A_SEED;
+        int32_t  fields[] = {material.pbrMetallicRoughness.baseColorTexture.index, material.pbrMetallicRoughness.metallicRoughnessTexture.index,
+                             material.normalTexture.index, material.emissiveTexture.index, material.doubleSided ? 1 : 0};
+        util::HashBytes(hash, fields, sizeof(fields));
+        lHashDoubles(hash, material.pbrMetallicRoughness.baseColorFactor);
+        lHashDoubles(hash, material.emissiveFactor);
+        util::HashString(hash, material.alphaMode);
+        size_t count  = mMerged->materials.size();
+        int    result = lIntern(mMerged->materials, mMaterialLookup, hash, std::move(material));
+        mStats.UniqueMaterials += mMerged->materials.size() > count ? 1 : 0;
+        return result;
+    }
+
+    int AssetRegistry::AddMesh(const tinygltf::Model& model, int index, const std::vector<int>& materialMap)
+    {
+        tinygltf::Mesh mesh = model.meshes[index];
+        uint64_t       hash = util::FNV1A_SEED;
+        for(tinygltf::Primitive& primitive : mesh.primitives)
+        {
+            primitive.material = lRemap(primitive.material, materialMap);
+            primitive.indices  = AddAccessor(model, primitive.indices);
+            primitive.extensions.erase("KHR_draco_mesh_compression");
+            int32_t fields[] = {primitive.mode, primitive.material, primitive.indices};
+            util::HashBytes(hash, fields, sizeof(fields));
+            for(auto& [semantic, accessor] : primitive.attributes)
+            {
+                accessor = AddAccessor(model, accessor);
+                util::HashString(hash, semantic);
+                util::HashBytes(hash, &accessor, sizeof(accessor));
+            }
+            for(std::map<std::string, int>& target : primitive.targets)
+            {
+                for(auto& [semantic, accessor] : target)
+                {
+                    accessor = AddAccessor(model, accessor);
+                    util::HashBytes(hash, &accessor, sizeof(accessor));
+                }
+            }
+        }
+        mStats.Meshes++;
+        size_t count  = mMerged->meshes.size();
+        int    result = lIntern(mMerged->meshes, mMeshLookup, hash, std::move(mesh));
+        mStats.UniqueMeshes += mMerged->meshes.size() > count ? 1 : 0;
+        return result;
+    }
+
+}  // namespace denoise::assets
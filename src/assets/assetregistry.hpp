@@ -0,0 +1,88 @@
+#pragma once
+
+#include "../util/threadpool.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tinygltf {
+    class Model;
+}
+
+namespace denoise::assets {
+
+    /// @brief Assets of the merged models before and after deduplication
+    struct AssetDedupStats
+    {
+        uint32_t Models          = 0;
+        uint32_t Images          = 0;
+        uint32_t Accessors       = 0;
+        uint32_t Materials       = 0;
+        uint32_t Meshes          = 0;
+        uint32_t UniqueImages    = 0;
+        uint32_t UniqueAccessors = 0;
+        uint32_t UniqueMaterials = 0;
+        uint32_t UniqueMeshes    = 0;
+        /// @brief Decoded texels and accessor data
+        uint64_t ImageBytes          = 0;
+        uint64_t AccessorBytes       = 0;
+        uint64_t UniqueImageBytes    = 0;
+        uint64_t UniqueAccessorBytes = 0;
+        /// @brief Mesh instances (nodes referencing a mesh) sharing the mesh of another instance
+        uint32_t SharedMeshInstances = 0;
+
+        std::string PrintPretty() const;
+        /// @brief Space separated values, read back by Parse()
+        std::string Serialize() const;
+        bool        Parse(const std::string& text);
+    };
+
+    /// @brief Content addressed merge of glTF models
+    /// @details Images are keyed by their decoded texels, accessors by their (densified) element data, samplers, textures, materials and meshes by
+    /// their fields after remapping the indices they hold. Every key is a 64 bit hash confirmed by comparing the content, so distinct assets are
+    /// never merged. Identical assets are stored once: images are decoded and uploaded once, and a mesh shared by several nodes becomes instances
+    /// of a single mesh (one BLAS) instead of copies. Nodes, cameras, skins, lights and animations are appended per model.
+    class AssetRegistry
+    {
+      public:
+        explicit AssetRegistry(util::ThreadPool* threadPool = &util::ThreadPool::Shared());
+        ~AssetRegistry();
+
+        /// @brief Appends the default scene of model (all root nodes if it has none). Decoded images are moved out of model
+        void Add(tinygltf::Model& model);
+
+        /// @brief Moves the merged model into out: one scene holding the roots of all added models, one buffer holding all unique accessor data.
+        /// Images stay decoded (image.image), without bufferView or uri
+        void Finish(tinygltf::Model& out);
+
+        inline const AssetDedupStats& GetStats() const { return mStats; }
+
+      protected:
+        int AddImage(tinygltf::Model& model, int index, uint64_t hash);
+        int AddAccessor(const tinygltf::Model& model, int index);
+        int AddSampler(const tinygltf::Model& model, int index);
+        int AddTexture(const tinygltf::Model& model, int index, const std::vector<int>& imageMap);
+        int AddMaterial(const tinygltf::Model& model, int index, const std::vector<int>& textureMap);
+        int AddMesh(const tinygltf::Model& model, int index, const std::vector<int>& materialMap);
+
+        util::ThreadPool* mThreadPool = nullptr;
+        /// @brief Heap allocated, tinygltf is only included by the implementation
+        tinygltf::Model* mMerged = nullptr;
+        std::vector<int> mRootNodes;
+        AssetDedupStats  mStats;
+        /// @brief Nodes referencing each merged mesh
+        std::vector<uint32_t> mMeshInstanceCounts;
+
+        /// @brief Content hash to index into the merged model, several indices per hash if contents collide
+        std::unordered_multimap<uint64_t, int> mImageLookup;
+        std::unordered_multimap<uint64_t, int> mAccessorLookup;
+        std::unordered_multimap<uint64_t, int> mSamplerLookup;
+        std::unordered_multimap<uint64_t, int> mTextureLookup;
+        std::unordered_multimap<uint64_t, int> mMaterialLookup;
+        std::unordered_multimap<uint64_t, int> mMeshLookup;
+        /// @brief Scratch for densified accessor data
+        std::vector<uint8_t> mElements;
+    };
+
+}  // namespace denoise::assets
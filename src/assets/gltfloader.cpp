@@ -0,0 +1,103 @@
+#include "gltfloader.hpp"
+#include <chrono>
+#include <filesystem>
+#include <tinygltf/tiny_gltf.h>
+#include <vector>
+
+namespace denoise::assets {
+
+    /// @brief tinygltf image loader storing the encoded bytes (userData is the std::vector<std::vector<uint8_t>> indexed by image)
+    bool lCollectEncodedImage(tinygltf::Image*     image,
+                              const int            imageIndex,
+                              std::string*         error,
+                              std::string*         warning,
+                              int                  requestedWidth,
+                              int                  requestedHeight,
+                              const unsigned char* bytes,
+                              int                  size,
+                              void*                userData)
+    {
+        std::vector<std::vector<uint8_t>>& encoded = *reinterpret_cast<std::vector<std::vector<uint8_t>>*>(userData);
+        if(imageIndex < 0 || size <= 0)
+        {
+            return true;
+        }
+        if(encoded.size() <= static_cast<size_t>(imageIndex))
+        {
+            encoded.resize(static_cast<size_t>(imageIndex) + 1);
+        }
+        encoded[imageIndex].assign(bytes, bytes + size);
+        return true;
+    }
+
+    bool LoadGltf(tinygltf::Model&                   model,
+                  const std::string&                 utf8path,
+                  std::string&                       error,
+                  std::string&                       warning,
+                  util::ThreadPool*                  threadPool,
+                  GltfLoadTimings*                   timings,
+                  std::vector<std::vector<uint8_t>>* encodedImages)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::vector<uint8_t>> encoded;
+        tinygltf::TinyGLTF                loader;
+        loader.SetImageLoader(lCollectEncodedImage, &encoded);
+        bool binary = std::filesystem::u8path(utf8path).extension() == ".glb";
+        bool loaded = binary ? loader.LoadBinaryFromFile(&model, &error, &warning, utf8path) : loader.LoadASCIIFromFile(&model, &error, &warning, utf8path);
+        if(!loaded)
+        {
+            return false;
+        }
+        auto parsed = std::chrono::steady_clock::now();
+
+        // Decoders only touch their own image, one image per task balances best for the typical mix of few large and many small textures
+        encoded.resize(model.images.size());
+        std::vector<std::string> decodeErrors(model.images.size());
+        threadPool->ParallelFor(
+            static_cast<uint32_t>(model.images.size()),
+            [&](uint32_t index) {
+                tinygltf::Image& image = model.images[index];
+                if(encoded[index].empty())
+                {
+                    return;
+                }
+                std::string imageWarning;
+                if(!tinygltf::LoadImageData(&image, static_cast<int>(index), &decodeErrors[index], &imageWarning, 0, 0, encoded[index].data(),
+                                            static_cast<int>(encoded[index].size()), nullptr))
+                {
+                    image.image.clear();
+                    decodeErrors[index] = "Decoding image \"" + (image.name.empty() ? image.uri : image.name) + "\" failed: " + decodeErrors[index];
+                }
+                else
+                {
+                    decodeErrors[index].clear();
+                }
+                if(!encodedImages)
+                {
+                    encoded[index] = {};
+                }
+            },
+            1);
+        for(const std::string& decodeError : decodeErrors)
+        {
+            if(!decodeError.empty())
+            {
+                warning += decodeError + "\n";
+            }
+        }
+
+        if(!!encodedImages)
+        {
+            *encodedImages = std::move(encoded);
+        }
+        if(!!timings)
+        {
+            timings->ParseSeconds  = std::chrono::duration<double>(parsed - start).count();
+            timings->DecodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parsed).count();
+            timings->ImageCount    = static_cast<uint32_t>(model.images.size());
+        }
+        return true;
+    }
+
+}  // namespace denoise::assets
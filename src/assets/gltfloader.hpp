@@ -0,0 +1,36 @@
+#pragma once
+
+#include "../util/threadpool.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tinygltf {
+    class Model;
+}
+
+namespace denoise::assets {
+
+    /// @brief Time spent in the phases of LoadGltf()
+    struct GltfLoadTimings
+    {
+        /// @brief Reading and parsing the file and its buffers, collecting the encoded images
+        double ParseSeconds = 0.0;
+        /// @brief Decoding all images
+        double   DecodeSeconds = 0.0;
+        uint32_t ImageCount    = 0;
+    };
+
+    /// @brief Loads a .gltf or .glb file, decoding its images in parallel
+    /// @details tinygltf decodes every image while parsing, one after another. Here the parse only collects the encoded bytes, then all images are
+    /// decoded by a ParallelFor on threadPool. Images failing to decode are left empty and reported in warning instead of failing the load.
+    /// @param encodedImages Receives the encoded bytes of every image if not null
+    bool LoadGltf(tinygltf::Model&                   model,
+                  const std::string&                 utf8path,
+                  std::string&                       error,
+                  std::string&                       warning,
+                  util::ThreadPool*                  threadPool    = &util::ThreadPool::Shared(),
+                  GltfLoadTimings*                   timings       = nullptr,
+                  std::vector<std::vector<uint8_t>>* encodedImages = nullptr);
+
+}  // namespace denoise::assets
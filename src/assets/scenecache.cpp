@@ -0,0 +1,453 @@
+#include "scenecache.hpp"
+#include "../util/hash.hpp"
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <foray_logger.hpp>
+#include <fstream>
+#include <sstream>
+#include <tinygltf/tiny_gltf.h>
+
+namespace denoise::assets {
+
+    /// @brief Bump to invalidate all entries (e.g. when the cooked layout changes)
+    const uint32_t SCENE_CACHE_VERSION = 2;
+
+#pragma region Stored PNG
+
+    const std::array<uint32_t, 256>& lCrcTable()
+    {
+        static const std::array<uint32_t, 256> sTable = []() {
+            std::array<uint32_t, 256> table{};
+            for(uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for(uint32_t k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            return table;
+        }();
+        return sTable;
+    }
+
+    void lPutU32BE(std::vector<uint8_t>& out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    size_t lBeginChunk(std::vector<uint8_t>& out, const char* type)
+    {
+        size_t begin = out.size();
+        lPutU32BE(out, 0);  // Length, patched by lEndChunk()
+        out.insert(out.end(), type, type + 4);
+        return begin;
+    }
+
+    void lEndChunk(std::vector<uint8_t>& out, size_t chunkBegin)
+    {
+        uint32_t length     = static_cast<uint32_t>(out.size() - chunkBegin - 8);
+        out[chunkBegin + 0] = static_cast<uint8_t>(length >> 24);
+        out[chunkBegin + 1] = static_cast<uint8_t>(length >> 16);
+        out[chunkBegin + 2] = static_cast<uint8_t>(length >> 8);
+        out[chunkBegin + 3] = static_cast<uint8_t>(length);
+        const auto& crcTable = lCrcTable();
+        uint32_t    crc      = 0xffffffffu;
+        for(size_t i = chunkBegin + 4; i < out.size(); i++)
+        {
+            crc = crcTable[(crc ^ out[i]) & 0xff] ^ (crc >> 8);
+        }
+        lPutU32BE(out, crc ^ 0xffffffffu);
+    }
+
+    void EncodeStoredPng(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t components, uint32_t bits, std::vector<uint8_t>& out)
+    {
+        static const uint8_t sColorTypes[] = {0, 0, 4, 2, 6};  // Gray, gray + alpha, RGB, RGBA
+        const size_t         pixelRowSize  = (size_t)width * components * (bits / 8);
+        const size_t         rawSize       = (1 + pixelRowSize) * height;  // Every row starts with its filter type (none)
+
+        out.clear();
+        out.reserve(rawSize + (rawSize / 65535 + 1) * 5 + 128);
+        const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        out.insert(out.end(), signature, signature + sizeof(signature));
+
+        size_t chunk = lBeginChunk(out, "IHDR");
+        lPutU32BE(out, width);
+        lPutU32BE(out, height);
+        out.insert(out.end(), {static_cast<uint8_t>(bits), sColorTypes[components], 0, 0, 0});
+        lEndChunk(out, chunk);
+
+        chunk = lBeginChunk(out, "IDAT");
+        out.insert(out.end(), {0x78, 0x01});  // zlib header: deflate, 32K window, no dictionary
+
+        // Stored deflate blocks hold up to 65535 bytes each, rows are split across blocks as needed
+        size_t remaining  = rawSize;
+        size_t blockSpace = 0;
+        auto   emit       = [&](const uint8_t* data, size_t size) {
+            while(size > 0)
+            {
+                if(blockSpace == 0)
+                {
+                    uint16_t blockSize = static_cast<uint16_t>(std::min<size_t>(remaining, 65535));
+                    uint8_t  final     = remaining == blockSize ? 1 : 0;
+                    out.insert(out.end(), {final, static_cast<uint8_t>(blockSize), static_cast<uint8_t>(blockSize >> 8), static_cast<uint8_t>(~blockSize & 0xff),
+                                           static_cast<uint8_t>(~blockSize >> 8)});
+                    blockSpace = blockSize;
+                }
+                size_t count = std::min(size, blockSpace);
+                out.insert(out.end(), data, data + count);
+                data += count;
+                size -= count;
+                blockSpace -= count;
+                remaining -= count;
+            }
+        };
+
+        std::vector<uint8_t> row(1 + pixelRowSize, 0);
+        for(uint32_t y = 0; y < height; y++)
+        {
+            const uint8_t* source = pixels + y * pixelRowSize;
+            if(bits == 16)
+            {
+                for(size_t i = 0; i < pixelRowSize; i += 2)
+                {
+                    row[1 + i]     = source[i + 1];  // PNG stores 16 bit samples big endian
+                    row[1 + i + 1] = source[i];
+                }
+            }
+            else
+            {
+                std::copy(source, source + pixelRowSize, row.begin() + 1);
+            }
+            emit(row.data(), row.size());
+        }
+
+        // Adler-32 of the uncompressed data, the modulo is deferred as long as the sums can not overflow
+        uint32_t     adlerA   = 1;
+        uint32_t     adlerB   = 0;
+        size_t       pending  = 0;
+        const size_t idatData = chunk + 8 + 2;
+        for(size_t i = idatData; i < out.size();)
+        {
+            // Skip the 5 byte block headers, every block but the last one is 65535 bytes long
+            size_t blockSize = std::min<size_t>(out.size() - i - 5, 65535);
+            for(size_t j = i + 5; j < i + 5 + blockSize; j++)
+            {
+                adlerA += out[j];
+                adlerB += adlerA;
+                if(++pending == 5552)
+                {
+                    adlerA %= 65521;
+                    adlerB %= 65521;
+                    pending = 0;
+                }
+            }
+            i += 5 + blockSize;
+        }
+        adlerA %= 65521;
+        adlerB %= 65521;
+        lPutU32BE(out, (adlerB << 16) | adlerA);
+        lEndChunk(out, chunk);
+
+        chunk = lBeginChunk(out, "IEND");
+        lEndChunk(out, chunk);
+    }
+
+#pragma endregion
+#pragma region Key
+
+    void lHashFileStamp(uint64_t& hash, const std::filesystem::path& path)
+    {
+        std::error_code error;
+        util::HashString(hash, path.string());
+        uint64_t size = std::filesystem::file_size(path, error);
+        util::HashBytes(hash, &size, sizeof(size));
+        int64_t modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+        util::HashBytes(hash, &modified, sizeof(modified));
+    }
+
+    std::string lDecodeUri(std::string_view uri)
+    {
+        std::string result;
+        for(size_t i = 0; i < uri.size(); i++)
+        {
+            uint8_t value = 0;
+            if(uri[i] == '%' && i + 2 < uri.size() && std::from_chars(uri.data() + i + 1, uri.data() + i + 3, value, 16).ptr == uri.data() + i + 3)
+            {
+                result.push_back(static_cast<char>(value));
+                i += 2;
+            }
+            else
+            {
+                result.push_back(uri[i]);
+            }
+        }
+        return result;
+    }
+
+    bool SceneCache::ComputeKey(const std::string& sourcePath, uint64_t& key)
+    {
+        std::filesystem::path path = std::filesystem::absolute(std::filesystem::u8path(sourcePath));
+        if(!std::filesystem::is_regular_file(path))
+        {
+            return false;
+        }
+        uint64_t hash = util::FNV1A_SEED;
+        util::HashBytes(hash, &SCENE_CACHE_VERSION, sizeof(SCENE_CACHE_VERSION));
+        lHashFileStamp(hash, path);
+        if(path.extension() == ".glb")
+        {
+            key = hash;  // Self contained, hashing gigabytes of content would cost more than it saves
+            return true;
+        }
+
+        std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        std::string json = stream.str();
+        util::HashString(hash, json);
+
+        // Referenced buffers and images. Embedded data URIs are covered by the JSON hash
+        for(size_t pos = json.find("\"uri\""); pos != std::string::npos; pos = json.find("\"uri\"", pos + 5))
+        {
+            size_t begin = json.find('"', json.find(':', pos + 5));
+            size_t end   = begin == std::string::npos ? begin : json.find('"', begin + 1);
+            if(end == std::string::npos)
+            {
+                break;
+            }
+            std::string_view uri(json.data() + begin + 1, end - begin - 1);
+            if(uri.substr(0, 5) != "data:")
+            {
+                lHashFileStamp(hash, path.parent_path() / std::filesystem::u8path(lDecodeUri(uri)));
+            }
+        }
+        key = hash;
+        return true;
+    }
+
+#pragma endregion
+#pragma region Cook
+
+    bool SceneCache::Init(const std::string& utf8dir, util::ThreadPool* threadPool)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::u8path(utf8dir), error);
+        if(error)
+        {
+            foray::logger()->warn("SceneCache: Unable to create \"{}\": {}", utf8dir, error.message());
+            return false;
+        }
+        mDirectory  = utf8dir;
+        mThreadPool = threadPool;
+        return true;
+    }
+
+    std::string SceneCache::Resolve(const std::string& sourcePath, AssetDedupStats* stats)
+    {
+        std::string entry = ResolveMerged({sourcePath}, stats);
+        return entry.empty() ? sourcePath : entry;
+    }
+
+    std::string SceneCache::ResolveMerged(const std::vector<std::string>& sourcePaths, AssetDedupStats* stats)
+    {
+        if(!Exists() || sourcePaths.empty())
+        {
+            return "";
+        }
+        // A single scene keeps its own key, merged entries combine the keys of their scenes in order
+        std::string name;
+        std::string label;
+        uint64_t    key = util::FNV1A_SEED;
+        for(const std::string& sourcePath : sourcePaths)
+        {
+            uint64_t sourceKey = 0;
+            if(!ComputeKey(sourcePath, sourceKey))
+            {
+                return "";
+            }
+            name += (name.empty() ? "" : "+") + std::filesystem::u8path(sourcePath).stem().string();
+            label += (label.empty() ? "\"" : ", \"") + sourcePath + "\"";
+            if(sourcePaths.size() == 1)
+            {
+                key = sourceKey;
+            }
+            else
+            {
+                util::HashBytes(key, &sourceKey, sizeof(sourceKey));
+            }
+        }
+        std::filesystem::path entry     = std::filesystem::u8path(mDirectory) / fmt::format("{}-{:016x}.glb", name, key);
+        std::filesystem::path statsPath = entry;
+        statsPath += ".dedup";
+        if(std::filesystem::exists(entry))
+        {
+            if(!!stats)
+            {
+                std::ifstream file(statsPath);
+                std::string   text;
+                std::getline(file, text);
+                if(!stats->Parse(text))
+                {
+                    *stats = AssetDedupStats{};
+                }
+            }
+            return entry.string();
+        }
+
+        // Remove entries (and their statistics) of older versions of the scene
+        std::error_code error;
+        for(const std::filesystem::directory_entry& existing : std::filesystem::directory_iterator(std::filesystem::u8path(mDirectory), error))
+        {
+            std::filesystem::path existingEntry = existing.path();
+            if(existingEntry.extension() == ".dedup")
+            {
+                existingEntry.replace_extension();
+            }
+            std::string existingName = existingEntry.filename().string();
+            if(existingEntry.extension() == ".glb" && existingName.size() == name.size() + 21 && existingName.compare(0, name.size() + 1, name + "-") == 0)
+            {
+                std::filesystem::remove(existing.path(), error);
+            }
+        }
+
+        auto                  start = std::chrono::steady_clock::now();
+        std::filesystem::path temp  = entry;
+        temp += fmt::format(".{}.tmp", start.time_since_epoch().count());
+        GltfLoadTimings timings;
+        AssetDedupStats dedupStats;
+        bool            cooked = Cook(sourcePaths, temp.string(), timings, dedupStats);
+        if(cooked)
+        {
+            std::ofstream(statsPath) << dedupStats.Serialize() << "\n";
+            std::filesystem::rename(temp, entry, error);
+        }
+        std::filesystem::remove(temp, error);
+        if(!cooked || !std::filesystem::exists(entry))
+        {
+            foray::logger()->warn("SceneCache: Cooking {} failed, loading the source", label);
+            return "";
+        }
+        foray::logger()->info("SceneCache: Cooked {} into \"{}\" in {:.1f} s (parsing {:.1f} s, decoding {} images {:.1f} s)", label, entry.string(),
+                              std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), timings.ParseSeconds, timings.ImageCount,
+                              timings.DecodeSeconds);
+        if(!!stats)
+        {
+            *stats = dedupStats;
+        }
+        return entry.string();
+    }
+
+    bool SceneCache::Cook(const std::vector<std::string>& sourcePaths, const std::string& outPath, GltfLoadTimings& timings, AssetDedupStats& stats)
+    {
+        // Scenes are loaded in parallel (each decoding its images on the pool), then added in order so merged indices do not depend on timing
+        std::vector<tinygltf::Model> models(sourcePaths.size());
+        std::vector<GltfLoadTimings> modelTimings(sourcePaths.size());
+        std::vector<uint8_t>         loaded(sourcePaths.size(), 0);
+        mThreadPool->ParallelFor(
+            static_cast<uint32_t>(sourcePaths.size()),
+            [&](uint32_t index) {
+                std::string error;
+                std::string warning;
+                if(!LoadGltf(models[index], sourcePaths[index], error, warning, mThreadPool, &modelTimings[index]))
+                {
+                    foray::logger()->warn("SceneCache: Failed to load \"{}\": {}", sourcePaths[index], error);
+                    return;
+                }
+                loaded[index] = 1;
+            },
+            1);
+        for(size_t i = 0; i < sourcePaths.size(); i++)
+        {
+            timings.ParseSeconds += modelTimings[i].ParseSeconds;
+            timings.DecodeSeconds += modelTimings[i].DecodeSeconds;
+            timings.ImageCount += modelTimings[i].ImageCount;
+            if(!loaded[i])
+            {
+                return false;
+            }
+            for(const tinygltf::Image& image : models[i].images)
+            {
+                if(image.image.empty() || image.component < 1 || image.component > 4 || (image.bits != 8 && image.bits != 16))
+                {
+                    foray::logger()->warn("SceneCache: Image \"{}\" of \"{}\" was not decoded", image.name.empty() ? image.uri : image.name, sourcePaths[i]);
+                    return false;
+                }
+            }
+        }
+
+        tinygltf::Model model;
+        {
+            AssetRegistry registry(mThreadPool);
+            for(tinygltf::Model& source : models)
+            {
+                registry.Add(source);
+                source = {};
+            }
+            registry.Finish(model);
+            stats = registry.GetStats();
+        }
+
+        std::vector<std::vector<uint8_t>> encoded(model.images.size());
+        mThreadPool->ParallelFor(
+            static_cast<uint32_t>(model.images.size()),
+            [&](uint32_t index) {
+                const tinygltf::Image& image = model.images[index];
+                EncodeStoredPng(image.image.data(), static_cast<uint32_t>(image.width), static_cast<uint32_t>(image.height), static_cast<uint32_t>(image.component),
+                                static_cast<uint32_t>(image.bits), encoded[index]);
+            },
+            1);
+
+        // Merge all buffers and the encoded images into one buffer (the GLB binary chunk)
+        tinygltf::Buffer     merged;
+        std::vector<size_t>  bufferOffsets;
+        auto                 align = [&merged](size_t alignment) { merged.data.resize((merged.data.size() + alignment - 1) / alignment * alignment); };
+        for(const tinygltf::Buffer& buffer : model.buffers)
+        {
+            align(16);
+            bufferOffsets.push_back(merged.data.size());
+            merged.data.insert(merged.data.end(), buffer.data.begin(), buffer.data.end());
+        }
+        for(tinygltf::BufferView& view : model.bufferViews)
+        {
+            view.byteOffset += bufferOffsets[view.buffer];
+            view.buffer = 0;
+        }
+        for(size_t i = 0; i < model.images.size(); i++)
+        {
+            align(16);
+            tinygltf::BufferView view;
+            view.buffer     = 0;
+            view.byteOffset = merged.data.size();
+            view.byteLength = encoded[i].size();
+            merged.data.insert(merged.data.end(), encoded[i].begin(), encoded[i].end());
+            encoded[i] = {};
+
+            tinygltf::Image& image = model.images[i];
+            image.bufferView       = static_cast<int>(model.bufferViews.size());
+            image.mimeType         = "image/png";
+            image.uri.clear();
+            image.image.clear();
+            model.bufferViews.push_back(view);
+        }
+        align(4);
+        model.buffers = {std::move(merged)};
+
+        tinygltf::TinyGLTF writer;
+        if(!writer.WriteGltfSceneToFile(&model, outPath, true, true, false, true))
+        {
+            foray::logger()->warn("SceneCache: Writing \"{}\" failed", outPath);
+            return false;
+        }
+        return true;
+    }
+
+#pragma endregion
+
+}  // namespace denoise::assets
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../util/threadpool.hpp"
+#include "assetregistry.hpp"
+#include "gltfloader.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace denoise::assets {
+
+    /// @brief Encodes 8 or 16 bit pixels (1 to 4 components, 16 bit values in native byte order) as PNG with uncompressed (stored) deflate blocks
+    /// @details Decoding such a PNG is a copy per row, which is what makes cooked scenes fast to load
+    void EncodeStoredPng(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t components, uint32_t bits, std::vector<uint8_t>& out);
+
+    /// @brief Cache of cooked glTF scenes
+    /// @details Cooking loads a scene once (decoding all textures in parallel), deduplicates its assets by content (AssetRegistry), merges all buffers into
+    /// one and re-encodes every texture as uncompressed PNG, then writes the result as self-contained .glb. Loading a cooked scene therefore reads a single
+    /// file and skips all JPEG decoding and PNG inflating. Several scenes can be cooked into one entry, sharing identical assets across scenes.
+    /// Entries are named <directory>/<scene>-<key:016x>.glb (scene names joined by '+' for merged entries), where the key hashes the glTF JSON and path,
+    /// size and modification time of every file it references (.glb sources by their own size and modification time). The dedup statistics are kept
+    /// next to the entry (<entry>.dedup). Stale entries of a scene are removed when it is cooked again.
+    class SceneCache
+    {
+      public:
+        /// @param utf8dir Cache directory, created if missing
+        bool Init(const std::string& utf8dir, util::ThreadPool* threadPool = &util::ThreadPool::Shared());
+
+        /// @brief Returns the cooked scene, cooking it on a miss. Returns sourcePath if the scene can not be cooked
+        /// @param stats Receives the dedup statistics of the entry if not null
+        std::string Resolve(const std::string& sourcePath, AssetDedupStats* stats = nullptr);
+
+        /// @brief Returns one cooked entry holding all scenes (in order), cooking it on a miss. Returns an empty string if any scene can not be cooked
+        /// @param stats Receives the dedup statistics of the entry if not null
+        std::string ResolveMerged(const std::vector<std::string>& sourcePaths, AssetDedupStats* stats = nullptr);
+
+        /// @brief Hashes the scene file and the files it references. Returns false if the scene can not be read
+        static bool ComputeKey(const std::string& sourcePath, uint64_t& key);
+
+        inline bool Exists() const { return !mDirectory.empty(); }
+
+      protected:
+        bool Cook(const std::vector<std::string>& sourcePaths, const std::string& outPath, GltfLoadTimings& timings, AssetDedupStats& stats);
+
+        std::string       mDirectory;
+        util::ThreadPool* mThreadPool = nullptr;
+    };
+
+}  // namespace denoise::assets
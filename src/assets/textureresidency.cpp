@@ -0,0 +1,160 @@
+#include "textureresidency.hpp"
+#include <algorithm>
+
+namespace denoise::assets {
+
+    void TextureResidency::Init(uint64_t budgetBytes, uint64_t streamBytesPerUpdate)
+    {
+        mTextures.clear();
+        mRequests.clear();
+        mBudget               = budgetBytes;
+        mStreamBytesPerUpdate = streamBytesPerUpdate;
+        mResidentBytes        = 0;
+        mTotalBytes           = 0;
+        mStreamedBytes        = 0;
+        mEvictedBytes         = 0;
+        mFrame                = 0;
+    }
+
+    uint32_t TextureResidency::AddTexture(const std::vector<uint64_t>& mipBytes, uint32_t tailMip)
+    {
+        Texture& texture    = mTextures.emplace_back();
+        texture.MipBytes    = mipBytes;
+        texture.TailMip     = std::min<uint32_t>(tailMip, static_cast<uint32_t>(std::max<size_t>(mipBytes.size(), 1) - 1));
+        texture.ResidentMip = texture.TailMip;
+        texture.WantedMip   = texture.TailMip;
+        for(size_t mip = 0; mip < mipBytes.size(); mip++)
+        {
+            mTotalBytes += mipBytes[mip];
+            if(mip >= texture.TailMip)
+            {
+                mResidentBytes += mipBytes[mip];
+            }
+        }
+        mRequests.emplace_back(NO_REQUEST);
+        return static_cast<uint32_t>(mTextures.size() - 1);
+    }
+
+    bool TextureResidency::MakeRoom(uint64_t bytes)
+    {
+        if(!mVictimsCollected)
+        {
+            mVictims.clear();
+            mEvictableBytes = 0;
+            for(uint32_t i = 0; i < mTextures.size(); i++)
+            {
+                const Texture& texture = mTextures[i];
+                uint32_t       keepMip = texture.LastUsed == mFrame ? texture.WantedMip : texture.TailMip;
+                for(uint32_t mip = texture.ResidentMip; mip < keepMip; mip++)
+                {
+                    mEvictableBytes += texture.MipBytes[mip];
+                }
+                if(texture.ResidentMip < keepMip)
+                {
+                    mVictims.push_back(i);
+                }
+            }
+            std::sort(mVictims.begin(), mVictims.end(), [this](uint32_t a, uint32_t b) {
+                return mTextures[a].LastUsed != mTextures[b].LastUsed ? mTextures[a].LastUsed < mTextures[b].LastUsed : a < b;
+            });
+            mVictimCursor     = 0;
+            mVictimsCollected = true;
+        }
+
+        // Evicting is pointless if the mips still would not fit afterwards
+        if(mResidentBytes + bytes > mBudget + mEvictableBytes)
+        {
+            return false;
+        }
+        while(mResidentBytes + bytes > mBudget)
+        {
+            Texture& texture = mTextures[mVictims[mVictimCursor]];
+            // Textures of the current frame only give up detail finer than requested
+            uint32_t keepMip = texture.LastUsed == mFrame ? texture.WantedMip : texture.TailMip;
+            if(texture.ResidentMip >= keepMip)
+            {
+                mVictimCursor++;
+                continue;
+            }
+            mResidentBytes -= texture.MipBytes[texture.ResidentMip];
+            mEvictableBytes -= texture.MipBytes[texture.ResidentMip];
+            mEvictedBytes += texture.MipBytes[texture.ResidentMip];
+            texture.ResidentMip++;
+        }
+        return true;
+    }
+
+    void TextureResidency::Update(std::vector<ResidencyChange>& changes)
+    {
+        mFrame++;
+        mVictimsCollected = false;
+
+        std::vector<uint32_t> startMips(mTextures.size());
+        std::vector<uint32_t> streaming;
+        for(uint32_t i = 0; i < mTextures.size(); i++)
+        {
+            Texture& texture = mTextures[i];
+            startMips[i]     = texture.ResidentMip;
+            uint32_t request = mRequests[i].exchange(NO_REQUEST, std::memory_order_relaxed);
+            if(request == NO_REQUEST)
+            {
+                continue;
+            }
+            texture.LastUsed  = mFrame;
+            texture.WantedMip = std::min(request, texture.TailMip);
+            if(texture.WantedMip < texture.ResidentMip)
+            {
+                streaming.push_back(i);
+            }
+        }
+
+        // A lowered budget is enforced before streaming anything in
+        MakeRoom(0);
+
+        // One mip per texture and round streams the coarse mips of all textures before the fine ones. Textures are all used in this frame, so
+        // their order only decides who gets the last bytes of the streaming rate: the coarsest go first, so textures left behind when the rate
+        // ran out in the last update catch up before others get finer
+        std::stable_sort(streaming.begin(), streaming.end(), [this](uint32_t a, uint32_t b) { return mTextures[a].ResidentMip > mTextures[b].ResidentMip; });
+        uint64_t streamed = 0;
+        bool     progress = true;
+        while(progress)
+        {
+            progress = false;
+            for(uint32_t index : streaming)
+            {
+                Texture& texture = mTextures[index];
+                if(texture.ResidentMip <= texture.WantedMip)
+                {
+                    continue;
+                }
+                uint64_t bytes = texture.MipBytes[texture.ResidentMip - 1];
+                // The first mip of an update may exceed the rate, so mips larger than it still stream in
+                if(streamed > 0 && streamed + bytes > mStreamBytesPerUpdate)
+                {
+                    progress = false;
+                    break;
+                }
+                if(!MakeRoom(bytes))
+                {
+                    // Finer mips of this texture do not fit either, smaller mips of others may
+                    texture.WantedMip = texture.ResidentMip;
+                    continue;
+                }
+                texture.ResidentMip--;
+                mResidentBytes += bytes;
+                mStreamedBytes += bytes;
+                streamed += bytes;
+                progress = true;
+            }
+        }
+
+        for(uint32_t i = 0; i < mTextures.size(); i++)
+        {
+            if(mTextures[i].ResidentMip != startMips[i])
+            {
+                changes.push_back(ResidencyChange{.Texture = i, .FromMip = startMips[i], .ToMip = mTextures[i].ResidentMip});
+            }
+        }
+    }
+
+}  // namespace denoise::assets
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace denoise::assets {
+
+    /// @brief Change of the finest resident mip of a texture, decided by TextureResidency::Update()
+    struct ResidencyChange
+    {
+        uint32_t Texture = 0;
+        /// @brief Finest resident mip before the update
+        uint32_t FromMip = 0;
+        /// @brief Finest resident mip after the update. Mips [ToMip, FromMip) are streamed in if ToMip < FromMip, [FromMip, ToMip) are evicted otherwise
+        uint32_t ToMip = 0;
+    };
+
+    /// @brief Budget policy for mip mapped textures, independent of where the mips live (host only, no device required)
+    /// @details Every texture keeps its coarsest mips (the tail) resident at all times, so there always is something to sample. Renderers report the
+    /// finest mip every texture lookup wanted with RequestMip(), Update() then streams in missing mips, coarse before fine and most recently used
+    /// textures first, limited per update to a streaming rate. Making room evicts the finest mips of the least recently used textures, or detail
+    /// finer than requested of textures in use. Mips wanted in the current frame are never evicted to make room for others.
+    class TextureResidency
+    {
+      public:
+        /// @param budgetBytes Upper limit for the resident mips of all textures (tails are resident even if they exceed it)
+        /// @param streamBytesPerUpdate Upper limit for the bytes streamed in per Update() call
+        void Init(uint64_t budgetBytes, uint64_t streamBytesPerUpdate);
+
+        /// @brief Registers a texture with the byte sizes of its mips (finest first). Mips [tailMip, mip count) are resident from the start
+        /// @return Index of the texture for RequestMip() and the residency changes
+        uint32_t AddTexture(const std::vector<uint64_t>& mipBytes, uint32_t tailMip);
+
+        /// @brief Reports a lookup wanting the texture at mip. Thread safe, may be called concurrently with itself
+        inline void RequestMip(uint32_t texture, uint32_t mip)
+        {
+            std::atomic<uint32_t>& request = mRequests[texture];
+            uint32_t               current = request.load(std::memory_order_relaxed);
+            while(mip < current && !request.compare_exchange_weak(current, mip, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        /// @brief Ends a frame: collects the requests since the last update and appends the resulting residency changes (at most one per texture)
+        void Update(std::vector<ResidencyChange>& changes);
+
+        inline uint32_t GetResidentMip(uint32_t texture) const { return mTextures[texture].ResidentMip; }
+        inline uint32_t GetTextureCount() const { return static_cast<uint32_t>(mTextures.size()); }
+        inline uint64_t GetBudget() const { return mBudget; }
+        inline uint64_t GetResidentBytes() const { return mResidentBytes; }
+        /// @brief Bytes of the resident mips a full residency of all textures would hold
+        inline uint64_t GetTotalBytes() const { return mTotalBytes; }
+        /// @brief Bytes streamed in and evicted since Init()
+        inline uint64_t GetStreamedBytes() const { return mStreamedBytes; }
+        inline uint64_t GetEvictedBytes() const { return mEvictedBytes; }
+
+      protected:
+        static constexpr uint32_t NO_REQUEST = UINT32_MAX;
+
+        struct Texture
+        {
+            std::vector<uint64_t> MipBytes;
+            uint32_t              TailMip     = 0;
+            uint32_t              ResidentMip = 0;
+            /// @brief Finest mip requested in the last frame the texture was used in
+            uint32_t WantedMip = 0;
+            /// @brief Update() counter of the last frame the texture was used in, 0 if never
+            uint64_t LastUsed = 0;
+        };
+
+        /// @brief Evicts mips until bytes more fit into the budget. Returns false if not enough mips may be evicted
+        bool MakeRoom(uint64_t bytes);
+
+        std::vector<Texture> mTextures;
+        /// @brief Finest mip requested per texture since the last update (a deque, as atomics can not be moved)
+        std::deque<std::atomic<uint32_t>> mRequests;
+        /// @brief Textures with evictable mips in least recently used order, collected by the first MakeRoom() of an update
+        std::vector<uint32_t> mVictims;
+        size_t                mVictimCursor         = 0;
+        bool                  mVictimsCollected     = false;
+        uint64_t              mEvictableBytes       = 0;
+        uint64_t              mBudget               = 0;
+        uint64_t              mStreamBytesPerUpdate = 0;
+        uint64_t              mResidentBytes        = 0;
+        uint64_t              mTotalBytes           = 0;
+        uint64_t              mStreamedBytes        = 0;
+        uint64_t              mEvictedBytes         = 0;
+        uint64_t              mFrame                = 0;
+    };
+
+}  // namespace denoise::assets
@@ -0,0 +1,322 @@
+#include "benchlogpipeline.hpp"
+#include "csvcells.hpp"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <foray_logger.hpp>
+#include <imgui/imgui.h>
+#include <limits>
+
+namespace denoise::bench {
+
+    bool BenchLogPipeline::Init(const std::string& utf8path, uint32_t capacity, uint32_t window)
+    {
+        Destroy();
+
+        mRing.clear();
+        mRing.resize(std::bit_ceil(std::max(capacity, 2u)));
+        mRingMask = mRing.size() - 1;
+        mWriteIndex.store(0);
+        mReadIndex.store(0);
+        mFramesDropped.store(0);
+        mFramesWritten.store(0);
+        mWindowSize = std::max(window, 1u);
+        mLogHeader.clear();
+        mWithMetrics = false;
+        mColumns.clear();
+
+        if(!utf8path.empty())
+        {
+            std::filesystem::path path = std::filesystem::absolute(std::filesystem::u8path(utf8path));
+            mFormat                    = path.extension() == ".bin" ? EFormat::Binary : EFormat::Csv;
+            mFile.open(path, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+            if(!mFile.is_open() || mFile.bad())
+            {
+                foray::logger()->error("Unable to open benchmark log \"{}\"", path.string());
+                return false;
+            }
+            foray::logger()->info("Benchmark log: Streaming {} rows to \"{}\"", mFormat == EFormat::Binary ? "binary" : "CSV", path.string());
+        }
+
+        mStopWriter.store(false);
+        mWriterThread = std::thread([this]() { this->WriterMain(); });
+        return true;
+    }
+
+    void BenchLogPipeline::Push(uint64_t frameIndex, foray::bench::BenchmarkLog& log, const metrics::ImageMetrics* metrics)
+    {
+        if(!Exists())
+        {
+            return;
+        }
+        uint64_t write = mWriteIndex.load(std::memory_order_relaxed);
+        uint64_t read  = mReadIndex.load(std::memory_order_acquire);
+        if(write - read > mRingMask)
+        {
+            mFramesDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Record& record    = mRing[write & mRingMask];
+        record.FrameIndex = frameIndex;
+        std::swap(record.Log, log);
+        record.HasMetrics = !!metrics;
+        if(!!metrics)
+        {
+            record.Metrics = *metrics;
+        }
+        mWriteIndex.store(write + 1, std::memory_order_release);
+    }
+
+#pragma region Writer thread
+
+    void BenchLogPipeline::WriterMain()
+    {
+        while(true)
+        {
+            uint64_t read  = mReadIndex.load(std::memory_order_relaxed);
+            uint64_t write = mWriteIndex.load(std::memory_order_acquire);
+            if(read == write)
+            {
+                if(mStopWriter.load())
+                {
+                    return;  // Stop requested and all pending records written
+                }
+                // The render thread does not signal new records (no locking in the frame loop), the writer polls instead
+                std::unique_lock<std::mutex> lock(mWakeMutex);
+                mWakeCondition.wait_for(lock, std::chrono::milliseconds(50), [this]() { return mStopWriter.load(); });
+                continue;
+            }
+
+            for(uint32_t batch = 0; read != write; read++, batch++)
+            {
+                const Record& record = mRing[read & mRingMask];
+                ParseRecord(record);
+                WriteRow(record.FrameIndex);
+                UpdateWindow();
+                mReadIndex.store(read + 1, std::memory_order_release);
+                mFramesWritten.fetch_add(1, std::memory_order_relaxed);
+                if(batch % 64 == 63)
+                {
+                    PublishStats();
+                }
+            }
+            if(mFile.is_open())
+            {
+                mFile.flush();
+            }
+            PublishStats();
+        }
+    }
+
+    void BenchLogPipeline::ParseRecord(const Record& record)
+    {
+        mLineScratch            = record.Log.PrintCsvHeader();
+        std::string_view header = TrimCsvLine(mLineScratch);
+        // Metrics columns stay once the first scored frame arrived, unscored frames leave them empty
+        bool withMetrics = record.HasMetrics || mWithMetrics;
+        if(mColumns.empty() || withMetrics != mWithMetrics || header != mLogHeader)
+        {
+            // Columns changed (first record, denoiser switched or metrics started)
+            mLogHeader   = header;
+            mWithMetrics = withMetrics;
+            mColumns.clear();
+            ForEachCsvCell(header, [this](size_t, std::string_view cell) { mColumns.emplace_back(cell); });
+            if(withMetrics)
+            {
+                ForEachCsvCell(std::string_view(metrics::ImageMetrics::PrintCsvHeader()).substr(1), [this](size_t, std::string_view cell) { mColumns.emplace_back(cell); });
+            }
+            mValues.assign(mColumns.size(), 0.f);
+            mWindow.assign((size_t)mColumns.size() * mWindowSize, std::numeric_limits<float>::quiet_NaN());
+            mWindowCount.assign(mColumns.size(), 0);
+            mWindowPos = 0;
+            WriteHeader();
+        }
+
+        mLineScratch = TrimCsvLine(record.Log.PrintCsvLine());
+        if(withMetrics)
+        {
+            mLineScratch += (record.HasMetrics ? record.Metrics : metrics::ImageMetrics::Unavailable()).PrintCsvLine();
+        }
+        std::fill(mValues.begin(), mValues.end(), std::numeric_limits<float>::quiet_NaN());
+        ForEachCsvCell(mLineScratch, [this](size_t index, std::string_view cell) {
+            float value  = 0.f;
+            auto  result = std::from_chars(cell.data(), cell.data() + cell.size(), value);
+            if(index < mValues.size() && result.ec == std::errc())
+            {
+                mValues[index] = value;
+            }
+        });
+    }
+
+    void BenchLogPipeline::WriteHeader()
+    {
+        if(!mFile.is_open())
+        {
+            return;
+        }
+        if(mFormat == EFormat::Csv)
+        {
+            mFile << "frame";
+            for(const std::string& column : mColumns)
+            {
+                mFile << ',' << column;
+            }
+            mFile << '\n';
+            return;
+        }
+        uint32_t count = static_cast<uint32_t>(mColumns.size());
+        mFile.put('H');
+        mFile.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for(const std::string& column : mColumns)
+        {
+            mFile.write(column.c_str(), column.size() + 1);
+        }
+    }
+
+    void BenchLogPipeline::WriteRow(uint64_t frameIndex)
+    {
+        if(!mFile.is_open())
+        {
+            return;
+        }
+        if(mFormat == EFormat::Csv)
+        {
+            mFile << frameIndex;
+            for(float value : mValues)
+            {
+                mFile << ',';
+                if(std::isfinite(value))
+                {
+                    mFile << value;
+                }
+            }
+            mFile << '\n';
+            return;
+        }
+        uint32_t count = static_cast<uint32_t>(mValues.size());
+        mFile.put('R');
+        mFile.write(reinterpret_cast<const char*>(&frameIndex), sizeof(frameIndex));
+        mFile.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        mFile.write(reinterpret_cast<const char*>(mValues.data()), mValues.size() * sizeof(float));
+    }
+
+    void BenchLogPipeline::UpdateWindow()
+    {
+        for(size_t column = 0; column < mValues.size(); column++)
+        {
+            mWindow[column * mWindowSize + mWindowPos] = mValues[column];
+            mWindowCount[column]                        = std::min(mWindowCount[column] + 1, mWindowSize);
+        }
+        mWindowPos = (mWindowPos + 1) % mWindowSize;
+    }
+
+    void BenchLogPipeline::PublishStats()
+    {
+        mBackStats.resize(0);
+        for(size_t column = 0; column < mColumns.size(); column++)
+        {
+            mSortScratch.resize(0);
+            double sum = 0.0;
+            for(uint32_t i = 0; i < mWindowCount[column]; i++)
+            {
+                float value = mWindow[column * mWindowSize + i];
+                if(std::isfinite(value))
+                {
+                    mSortScratch.push_back(value);
+                    sum += value;
+                }
+            }
+            if(mSortScratch.empty())
+            {
+                continue;  // Non-numeric column (title) or no values in the window
+            }
+            auto percentile = [this](double p) {
+                auto nth = mSortScratch.begin() + static_cast<ptrdiff_t>(p * (mSortScratch.size() - 1));
+                std::nth_element(mSortScratch.begin(), nth, mSortScratch.end());
+                return static_cast<double>(*nth);
+            };
+            ColumnStats stats{.Name = mColumns[column], .Mean = sum / mSortScratch.size()};
+            stats.P50 = percentile(0.50);
+            stats.P95 = percentile(0.95);
+            stats.P99 = percentile(0.99);
+            stats.Max = *std::max_element(mSortScratch.begin(), mSortScratch.end());
+            mBackStats.push_back(std::move(stats));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mStatsMutex);
+            std::swap(mFrontStats, mBackStats);
+        }
+        mStatsVersion.fetch_add(1, std::memory_order_release);
+    }
+
+#pragma endregion
+#pragma region Render thread
+
+    bool BenchLogPipeline::FetchStats(std::vector<ColumnStats>& out)
+    {
+        uint64_t version = mStatsVersion.load(std::memory_order_acquire);
+        if(version == mFetchedVersion)
+        {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        out             = mFrontStats;
+        mFetchedVersion = version;
+        return true;
+    }
+
+    void BenchLogPipeline::PrintImGui()
+    {
+        FetchStats(mUiStats);
+        ImGui::Text("Last %u frames, %llu logged, %llu dropped", mWindowSize, static_cast<unsigned long long>(GetFramesWritten()),
+                    static_cast<unsigned long long>(GetFramesDropped()));
+        if(ImGui::BeginTable("BenchStats", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            const char* headers[] = {"", "Mean", "P50", "P95", "P99", "Max"};
+            for(const char* header : headers)
+            {
+                ImGui::TableSetupColumn(header);
+            }
+            ImGui::TableHeadersRow();
+            for(const ColumnStats& stats : mUiStats)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(stats.Name.c_str());
+                for(double value : {stats.Mean, stats.P50, stats.P95, stats.P99, stats.Max})
+                {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.4f", value);
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+
+#pragma endregion
+
+    void BenchLogPipeline::Destroy()
+    {
+        if(mWriterThread.joinable())
+        {
+            mStopWriter.store(true);
+            {
+                std::lock_guard<std::mutex> lock(mWakeMutex);
+            }
+            mWakeCondition.notify_all();
+            mWriterThread.join();
+            if(mFramesDropped.load() > 0)
+            {
+                foray::logger()->warn("Benchmark log: {} frames dropped (writer behind by {} frames)", mFramesDropped.load(), mRing.size());
+            }
+        }
+        if(mFile.is_open())
+        {
+            mFile.flush();
+            mFile.close();
+        }
+    }
+
+}  // namespace denoise::bench
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../metrics/imagemetrics.hpp"
+#include <atomic>
+#include <bench/foray_devicebenchmark.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace denoise::bench {
+
+    /// @brief Rolling statistics of one benchmark column
+    struct ColumnStats
+    {
+        std::string Name;
+        double      Mean = 0.0;
+        double      P50  = 0.0;
+        double      P95  = 0.0;
+        double      P99  = 0.0;
+        double      Max  = 0.0;
+    };
+
+    /// @brief Moves per frame benchmark logs off the render thread
+    /// @details The render thread swaps each frame's BenchmarkLog into a fixed capacity single producer / single consumer ring (no locks, no growing
+    /// containers; the ring slots keep their string and vector capacity across frames). A writer thread drains the ring, parses the logs, streams them
+    /// to an optional soak log (CSV or binary, flushed per batch so a crash only loses the last batch) and maintains rolling statistics over a fixed
+    /// window of frames. Statistics are published double buffered, the UI picks up the latest copy without waiting for the writer.
+    /// If the writer falls behind by the ring capacity, frames are dropped and counted instead of stalling the renderer.
+    class BenchLogPipeline
+    {
+      public:
+        enum class EFormat
+        {
+            Csv,
+            /// @brief Blocks of 'H' (u32 column count, zero terminated names) and 'R' (u64 frame, u32 count, f32 values) records, little endian
+            Binary
+        };
+
+        ~BenchLogPipeline() { Destroy(); }
+
+        /// @param utf8path Soak log output, empty to only compute statistics. Binary if the extension is .bin, CSV otherwise
+        /// @param capacity Ring slots (rounded up to a power of two)
+        /// @param window Frames the rolling statistics cover
+        bool Init(const std::string& utf8path, uint32_t capacity = 256, uint32_t window = 1024);
+        void Destroy();
+
+        /// @brief Hands the log of a finished frame to the writer. log is swapped with a processed log (contents unspecified afterwards)
+        /// @param metrics Image quality of the frame, appended as columns. Null if the frame was not scored
+        void Push(uint64_t frameIndex, foray::bench::BenchmarkLog& log, const metrics::ImageMetrics* metrics = nullptr);
+
+        /// @brief Copies the most recently published statistics into out. Returns false (out untouched) if nothing changed since the last call
+        bool FetchStats(std::vector<ColumnStats>& out);
+        /// @brief Draws the rolling statistics as ImGui table (render thread)
+        void PrintImGui();
+
+        inline bool     Exists() const { return mWriterThread.joinable(); }
+        inline uint64_t GetFramesDropped() const { return mFramesDropped.load(); }
+        inline uint64_t GetFramesWritten() const { return mFramesWritten.load(); }
+
+      protected:
+        struct Record
+        {
+            uint64_t                   FrameIndex = 0;
+            foray::bench::BenchmarkLog Log;
+            bool                       HasMetrics = false;
+            metrics::ImageMetrics      Metrics;
+        };
+
+        void WriterMain();
+        /// @brief Parses the record into mValues, updates the columns (and writes a header) if they changed
+        void ParseRecord(const Record& record);
+        void WriteHeader();
+        void WriteRow(uint64_t frameIndex);
+        void UpdateWindow();
+        void PublishStats();
+
+        std::vector<Record>   mRing;
+        uint64_t              mRingMask = 0;
+        std::atomic<uint64_t> mWriteIndex{0};
+        std::atomic<uint64_t> mReadIndex{0};
+        std::atomic<uint64_t> mFramesDropped{0};
+        std::atomic<uint64_t> mFramesWritten{0};
+
+        std::thread             mWriterThread;
+        std::mutex              mWakeMutex;
+        std::condition_variable mWakeCondition;
+        std::atomic<bool>       mStopWriter{false};
+
+        // Writer thread state
+        EFormat                  mFormat = EFormat::Csv;
+        std::ofstream            mFile;
+        /// @brief CSV header of the BenchmarkLog the current columns were built from
+        std::string              mLogHeader;
+        bool                     mWithMetrics = false;
+        std::string              mLineScratch;
+        std::vector<std::string> mColumns;
+        std::vector<float>       mValues;
+        uint32_t                 mWindowSize = 0;
+        /// @brief Per column ring of the last mWindowSize values (column major)
+        std::vector<float>       mWindow;
+        std::vector<uint32_t>    mWindowCount;
+        uint32_t                 mWindowPos = 0;
+        std::vector<float>       mSortScratch;
+        std::vector<ColumnStats> mBackStats;
+
+        // Published statistics
+        std::mutex               mStatsMutex;
+        std::vector<ColumnStats> mFrontStats;
+        std::atomic<uint64_t>    mStatsVersion{0};
+        uint64_t                 mFetchedVersion = 0;
+        std::vector<ColumnStats> mUiStats;
+    };
+
+}  // namespace denoise::bench
@@ -0,0 +1,133 @@
+#include "benchrunner.hpp"
+#include "../launchoptions.hpp"
+#include "csvcells.hpp"
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <foray_logger.hpp>
+#include <string_view>
+
+namespace denoise::bench {
+
+    bool BenchRunner::Init(const BenchConfig& config)
+    {
+        mConfig = config;
+        mCases.clear();
+        for(const std::string& scene : mConfig.Scenes)
+        {
+            for(const VkExtent2D& resolution : mConfig.Resolutions)
+            {
+                for(const std::string& denoiser : mConfig.Denoisers)
+                {
+                    mCases.push_back(BenchCase{.SceneName = scene, .ScenePath = ResolveScenePath(scene), .Denoiser = denoiser, .Resolution = resolution});
+                }
+            }
+        }
+        mCaseIndex = 0;
+
+        std::filesystem::path path = std::filesystem::absolute(mConfig.ReportPath);
+        mReport.open(path, std::ios_base::out | std::ios_base::trunc);
+        if(!mReport.is_open() || mReport.bad())
+        {
+            foray::logger()->error("Unable to open benchmark report \"{}\"", path.string());
+            return false;
+        }
+        mReport << "scene,denoiser,width,height,frame,metric,value\n";
+        foray::logger()->info("Benchmark: {} cases x {} frames, report \"{}\"", mCases.size(), mConfig.FramesPerCase, path.string());
+        return true;
+    }
+
+    void BenchRunner::BeginCase(uint64_t firstFrame)
+    {
+        const BenchCase& benchCase = GetCurrentCase();
+        foray::logger()->info("Benchmark case {}/{}: {} {} {}x{}", mCaseIndex + 1, mCases.size(), benchCase.SceneName, benchCase.Denoiser, benchCase.Resolution.width,
+                              benchCase.Resolution.height);
+        mCaseFirstFrame   = firstFrame;
+        mCaseFramesLogged = 0;
+        mCaseRunning      = true;
+        mColumns.clear();
+        mColumnSums.clear();
+        mColumnCounts.clear();
+    }
+
+    void BenchRunner::LogFrame(uint64_t frameIndex, const foray::bench::BenchmarkLog& log, const metrics::ImageMetrics* metrics)
+    {
+        if(!mCaseRunning || frameIndex < mCaseFirstFrame || IsCaseComplete())
+        {
+            return;
+        }
+
+        if(mColumns.empty())
+        {
+            std::string header = std::string(TrimCsvLine(log.PrintCsvHeader()));
+            if(mConfig.RecordMetrics)
+            {
+                header += metrics::ImageMetrics::PrintCsvHeader();
+            }
+            ForEachCsvCell(header, [this](size_t, std::string_view cell) { mColumns.emplace_back(cell); });
+            mColumnSums.resize(mColumns.size(), 0.0);
+            mColumnCounts.resize(mColumns.size(), 0);
+        }
+
+        const BenchCase& benchCase = GetCurrentCase();
+        std::string      line      = std::string(TrimCsvLine(log.PrintCsvLine()));
+        if(mConfig.RecordMetrics)
+        {
+            line += (metrics ? *metrics : metrics::ImageMetrics::Unavailable()).PrintCsvLine();
+        }
+        uint64_t         frame     = frameIndex - mCaseFirstFrame;
+        ForEachCsvCell(line, [&](size_t index, std::string_view cell) {
+            double value  = 0.0;
+            auto   result = std::from_chars(cell.data(), cell.data() + cell.size(), value);
+            if(index >= mColumns.size() || result.ec != std::errc() || !std::isfinite(value))
+            {
+                return;  // Non-numeric cells (titles) and unavailable metrics are not reported
+            }
+            mColumnSums[index] += value;
+            mColumnCounts[index]++;
+            mReport << benchCase.SceneName << ',' << benchCase.Denoiser << ',' << benchCase.Resolution.width << ',' << benchCase.Resolution.height << ',' << frame << ','
+                    << mColumns[index] << ',' << cell << '\n';
+        });
+        mCaseFramesLogged++;
+    }
+
+    void BenchRunner::NextCase()
+    {
+        if(mCaseRunning)
+        {
+            LogCaseSummary();
+            mReport.flush();
+        }
+        mCaseRunning = false;
+        mCaseIndex++;
+    }
+
+    void BenchRunner::LogCaseSummary()
+    {
+        if(mCaseFramesLogged == 0)
+        {
+            return;
+        }
+        std::string summary;
+        for(size_t i = 0; i < mColumns.size(); i++)
+        {
+            if(mColumnCounts[i] > 0)
+            {
+                summary += fmt::format("\n  {}: {:.4f} avg", mColumns[i], mColumnSums[i] / mColumnCounts[i]);
+            }
+        }
+        foray::logger()->info("Benchmark case {}/{} finished ({} frames):{}", mCaseIndex + 1, mCases.size(), mCaseFramesLogged, summary);
+    }
+
+    void BenchRunner::Destroy()
+    {
+        if(mReport.is_open())
+        {
+            mReport.flush();
+            mReport.close();
+        }
+        mCases.clear();
+        mCaseIndex = 0;
+    }
+
+}  // namespace denoise::bench
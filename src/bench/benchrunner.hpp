@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../metrics/imagemetrics.hpp"
+#include <bench/foray_devicebenchmark.hpp>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace denoise::bench {
+
+    /// @brief A single combination of the benchmark matrix
+    struct BenchCase
+    {
+        std::string SceneName;
+        std::string ScenePath;
+        std::string Denoiser;
+        VkExtent2D  Resolution{};
+    };
+
+    struct BenchConfig
+    {
+        std::vector<std::string> Scenes;
+        std::vector<std::string> Denoisers;
+        std::vector<VkExtent2D>  Resolutions;
+        uint32_t                 FramesPerCase = 2000;
+        std::string              ReportPath;
+        /// @brief If set, image quality metrics are appended to every frame's columns
+        bool                     RecordMetrics = false;
+    };
+
+    /// @brief Walks a scenes x resolutions x denoisers matrix and streams all frame logs into one report
+    /// @details Cases are ordered scene-major, so a scene is loaded once for all of its cases. The report is a CSV
+    /// in long format (scene,denoiser,width,height,frame,metric,value), which merges logs with differing columns.
+    class BenchRunner
+    {
+      public:
+        /// @brief Expands the matrix and opens the report. Returns false if the report can not be written.
+        bool Init(const BenchConfig& config);
+
+        inline const BenchCase& GetCurrentCase() const { return mCases[mCaseIndex]; }
+        inline bool             IsFinished() const { return mCaseIndex >= mCases.size(); }
+        inline bool             IsCaseComplete() const { return mCaseFramesLogged >= mConfig.FramesPerCase; }
+        inline size_t           GetCaseIndex() const { return mCaseIndex; }
+        inline size_t           GetCaseCount() const { return mCases.size(); }
+        inline uint64_t         GetCaseFirstFrame() const { return mCaseFirstFrame; }
+
+        /// @brief Starts recording the current case. Frames with index below firstFrame are still in flight from the previous case and are dropped.
+        void BeginCase(uint64_t firstFrame);
+        /// @brief Writes all numeric columns of log (and the image quality metrics, if recorded) as report rows
+        /// @param metrics Metrics of the frame. Null if the frame was not scored, the metric rows are omitted then
+        void LogFrame(uint64_t frameIndex, const foray::bench::BenchmarkLog& log, const metrics::ImageMetrics* metrics = nullptr);
+        /// @brief Finishes the current case and moves to the next one
+        void NextCase();
+
+        void Destroy();
+
+      protected:
+        void LogCaseSummary();
+
+        BenchConfig            mConfig;
+        std::vector<BenchCase> mCases;
+        size_t                 mCaseIndex        = 0;
+        uint64_t               mCaseFirstFrame   = 0;
+        uint32_t               mCaseFramesLogged = 0;
+        bool                   mCaseRunning      = false;
+
+        std::ofstream mReport;
+
+        /// @brief Column names, running sums and number of finite values of the current case, for the summary logged at case end
+        std::vector<std::string> mColumns;
+        std::vector<double>      mColumnSums;
+        std::vector<uint32_t>    mColumnCounts;
+    };
+
+}  // namespace denoise::bench
@@ -0,0 +1,169 @@
+#include "benchstatistics.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace denoise::bench {
+
+    uint64_t lSplitMix64(uint64_t& state)
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z          = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    void SampleReservoir::Add(double value)
+    {
+        mCount++;
+        if(mSamples.size() < mCapacity)
+        {
+            mSamples.push_back(value);
+            return;
+        }
+        // Replacing a random slot with probability capacity / count keeps every value seen equally likely in the sample
+        uint64_t slot = NextRandom() % mCount;
+        if(slot < mCapacity)
+        {
+            mSamples[slot] = value;
+        }
+    }
+
+    uint64_t SampleReservoir::NextRandom()
+    {
+        return lSplitMix64(mState);
+    }
+
+    double Median(std::vector<double>& values)
+    {
+        if(values.empty())
+        {
+            return 0.0;
+        }
+        size_t half = values.size() / 2;
+        std::nth_element(values.begin(), values.begin() + half, values.end());
+        double upper = values[half];
+        if(values.size() % 2 == 1)
+        {
+            return upper;
+        }
+        return (*std::max_element(values.begin(), values.begin() + half) + upper) * 0.5;
+    }
+
+    uint32_t RemoveOutliers(std::vector<double>& values, double mads)
+    {
+        std::vector<double> deviations(values);
+        double              median = Median(deviations);
+        for(double& deviation : deviations)
+        {
+            deviation = std::abs(deviation - median);
+        }
+        // 1.4826 scales the MAD to the standard deviation of normally distributed values
+        double limit = mads * 1.4826 * Median(deviations);
+        if(!(limit > 0.0))
+        {
+            return 0;  // More than half of the values are equal
+        }
+        size_t count = values.size();
+        std::erase_if(values, [&](double value) { return std::abs(value - median) > limit; });
+        return static_cast<uint32_t>(count - values.size());
+    }
+
+    double MannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b)
+    {
+        if(a.empty() || b.empty())
+        {
+            return 1.0;
+        }
+        // (value, belongs to a) sorted, tied values share their average rank
+        std::vector<std::pair<double, bool>> merged;
+        merged.reserve(a.size() + b.size());
+        for(double value : a)
+        {
+            merged.emplace_back(value, true);
+        }
+        for(double value : b)
+        {
+            merged.emplace_back(value, false);
+        }
+        std::sort(merged.begin(), merged.end());
+
+        double rankSumA = 0.0;
+        double tieTerm  = 0.0;
+        for(size_t first = 0; first < merged.size();)
+        {
+            size_t last = first;
+            while(last + 1 < merged.size() && merged[last + 1].first == merged[first].first)
+            {
+                last++;
+            }
+            double rank = (first + last) * 0.5 + 1.0;
+            double ties = static_cast<double>(last - first + 1);
+            tieTerm += ties * ties * ties - ties;
+            for(size_t i = first; i <= last; i++)
+            {
+                rankSumA += merged[i].second ? rank : 0.0;
+            }
+            first = last + 1;
+        }
+
+        double n1       = static_cast<double>(a.size());
+        double n2       = static_cast<double>(b.size());
+        double n        = n1 + n2;
+        double u        = rankSumA - n1 * (n1 + 1.0) * 0.5;
+        double mean     = n1 * n2 * 0.5;
+        double variance = n1 * n2 / 12.0 * ((n + 1.0) - tieTerm / (n * (n - 1.0)));
+        if(!(variance > 0.0))
+        {
+            return 1.0;
+        }
+        // Normal approximation with continuity correction, accurate for the sample sizes of benchmark runs
+        double z = std::max(std::abs(u - mean) - 0.5, 0.0) / std::sqrt(variance);
+        return std::erfc(z / std::sqrt(2.0));
+    }
+
+    void BootstrapMedianDelta(const std::vector<double>& baseline,
+                              const std::vector<double>& candidate,
+                              uint32_t                   rounds,
+                              double                     confidence,
+                              uint64_t                   seed,
+                              double&                    low,
+                              double&                    high)
+    {
+        low  = 0.0;
+        high = 0.0;
+        if(baseline.empty() || candidate.empty() || rounds == 0)
+        {
+            return;
+        }
+        uint64_t            random = seed;
+        std::vector<double> resampled;
+        std::vector<double> deltas;
+        deltas.reserve(rounds);
+        auto resampleMedian = [&](const std::vector<double>& values) {
+            resampled.resize(values.size());
+            for(double& value : resampled)
+            {
+                value = values[lSplitMix64(random) % values.size()];
+            }
+            return Median(resampled);
+        };
+        for(uint32_t round = 0; round < rounds; round++)
+        {
+            double baselineMedian  = resampleMedian(baseline);
+            double candidateMedian = resampleMedian(candidate);
+            if(baselineMedian != 0.0)
+            {
+                deltas.push_back(candidateMedian / baselineMedian - 1.0);
+            }
+        }
+        if(deltas.empty())
+        {
+            return;
+        }
+        std::sort(deltas.begin(), deltas.end());
+        double tail = (1.0 - confidence) * 0.5;
+        low         = deltas[static_cast<size_t>(tail * (deltas.size() - 1))];
+        high        = deltas[static_cast<size_t>(std::ceil((1.0 - tail) * (deltas.size() - 1)))];
+    }
+
+}  // namespace denoise::bench
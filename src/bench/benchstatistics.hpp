@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace denoise::bench {
+
+    /// @brief Uniform random sample of bounded size over a stream of values (reservoir sampling), deterministic for a given seed
+    class SampleReservoir
+    {
+      public:
+        explicit SampleReservoir(uint32_t capacity = 4096, uint64_t seed = 1) : mCapacity(capacity), mState(seed) {}
+
+        void Add(double value);
+
+        /// @brief Values seen, the sample holds min(count, capacity) of them
+        inline uint64_t                   GetCount() const { return mCount; }
+        inline const std::vector<double>& GetSamples() const { return mSamples; }
+
+      protected:
+        uint64_t NextRandom();
+
+        std::vector<double> mSamples;
+        uint32_t            mCapacity = 0;
+        uint64_t            mCount    = 0;
+        uint64_t            mState    = 0;
+    };
+
+    /// @brief Median, reorders values
+    double Median(std::vector<double>& values);
+    /// @brief Removes values further than mads scaled median absolute deviations from the median
+    /// @return Number of removed values
+    uint32_t RemoveOutliers(std::vector<double>& values, double mads);
+    /// @brief Two-sided p-value of the Mann-Whitney U test (normal approximation with tie correction)
+    double MannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b);
+    /// @brief Percentile bootstrap confidence interval of the relative median change from baseline to candidate
+    void BootstrapMedianDelta(const std::vector<double>& baseline,
+                              const std::vector<double>& candidate,
+                              uint32_t                   rounds,
+                              double                     confidence,
+                              uint64_t                   seed,
+                              double&                    low,
+                              double&                    high);
+
+}  // namespace denoise::bench
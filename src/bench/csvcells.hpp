@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string_view>
+
+namespace denoise::bench {
+
+    /// @brief Removes trailing line breaks and spaces
+    inline std::string_view TrimCsvLine(std::string_view text)
+    {
+        while(text.size() > 0 && (text.back() == '\n' || text.back() == '\r' || text.back() == ' '))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    /// @brief Splits one CSV line into its cells and calls func(index, cell) for each (the benchmark logs do not quote cells)
+    template <typename TFunc>
+    void ForEachCsvCell(std::string_view line, TFunc&& func)
+    {
+        size_t index = 0;
+        while(true)
+        {
+            size_t split = line.find(',');
+            func(index++, line.substr(0, split));
+            if(split == std::string_view::npos)
+            {
+                break;
+            }
+            line = line.substr(split + 1);
+        }
+    }
+
+}  // namespace denoise::bench
@@ -0,0 +1,144 @@
+#include "frameprofiler.hpp"
+#include <algorithm>
+
+namespace denoise::bench {
+
+    void FrameProfiler::Init(foray::core::Context* context, uint32_t maxScopesPerFrame)
+    {
+        Destroy();
+        mContext           = context;
+        mMaxScopesPerFrame = maxScopesPerFrame;
+
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(mContext->VkPhysicalDevice(), &properties);
+        mTimestampPeriod = static_cast<double>(properties.limits.timestampPeriod);
+        foray::Assert(properties.limits.timestampComputeAndGraphics == VK_TRUE, "FrameProfiler: Device does not support timestamps on all queues");
+
+        VkQueryPoolCreateInfo poolCi{.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, .queryType = VK_QUERY_TYPE_TIMESTAMP, .queryCount = maxScopesPerFrame * 2};
+        mSlots.resize(foray::INFLIGHT_FRAME_COUNT);
+        for(Slot& slot : mSlots)
+        {
+            foray::AssertVkResult(mContext->DispatchTable().createQueryPool(&poolCi, nullptr, &slot.Pool));
+            slot.Names.reserve(maxScopesPerFrame);
+        }
+        mResults.resize((size_t)maxScopesPerFrame * 2 * 2);
+        mTrack         = util::Timeline::Shared().AddTrack("Graphics Queue");
+        mClockOffsetNs = INT64_MIN;
+    }
+
+    void FrameProfiler::Destroy()
+    {
+        for(Slot& slot : mSlots)
+        {
+            mContext->DispatchTable().destroyQueryPool(slot.Pool, nullptr);
+        }
+        mSlots.clear();
+        mCurrent = nullptr;
+    }
+
+    void FrameProfiler::BeginFrame(VkCommandBuffer cmdBuffer, uint64_t frameNumber)
+    {
+        if(!Exists())
+        {
+            return;
+        }
+        // The slot's previous frame finished executing (in flight fence), its results were read or are dropped
+        mCurrent              = &mSlots[frameNumber % mSlots.size()];
+        mCurrent->FrameNumber = frameNumber;
+        mCurrent->SubmitNs    = -1;
+        mCurrent->Recorded    = true;
+        mCurrent->Names.clear();
+        vkCmdResetQueryPool(cmdBuffer, mCurrent->Pool, 0, mMaxScopesPerFrame * 2);
+    }
+
+    uint32_t FrameProfiler::BeginScope(VkCommandBuffer cmdBuffer, const char* name)
+    {
+        if(!mCurrent || mCurrent->Names.size() >= mMaxScopesPerFrame)
+        {
+            return UINT32_MAX;
+        }
+        uint32_t scope = static_cast<uint32_t>(mCurrent->Names.size());
+        mCurrent->Names.push_back(name);
+        vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, mCurrent->Pool, scope * 2);
+        return scope;
+    }
+
+    void FrameProfiler::EndScope(VkCommandBuffer cmdBuffer, uint32_t scope)
+    {
+        vkCmdWriteTimestamp2(cmdBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, mCurrent->Pool, scope * 2 + 1);
+    }
+
+    void FrameProfiler::OnSubmit()
+    {
+        if(!!mCurrent && mCurrent->SubmitNs < 0)
+        {
+            mCurrent->SubmitNs = util::Timeline::Shared().Now();
+        }
+    }
+
+    bool FrameProfiler::OnFrameFinished(uint64_t frameIndex)
+    {
+        if(!Exists())
+        {
+            return false;
+        }
+        Slot& slot = mSlots[frameIndex % mSlots.size()];
+        if(!slot.Recorded || slot.FrameNumber != frameIndex || slot.Names.empty())
+        {
+            return false;
+        }
+        slot.Recorded = false;
+
+        // Scopes recorded into command buffers that have not finished (e.g. a pipelined handoff) report unavailable and are skipped
+        uint32_t queryCount = static_cast<uint32_t>(slot.Names.size()) * 2;
+        VkResult result     = mContext->DispatchTable().getQueryPoolResults(slot.Pool, 0, queryCount, mResults.size() * sizeof(uint64_t), mResults.data(),
+                                                                            2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if(result != VK_SUCCESS && result != VK_NOT_READY)
+        {
+            return false;
+        }
+
+        uint64_t firstTicks = UINT64_MAX;
+        uint64_t lastTicks  = 0;
+        for(uint32_t query = 0; query < queryCount; query++)
+        {
+            if(mResults[query * 2 + 1] != 0)
+            {
+                firstTicks = std::min(firstTicks, mResults[query * 2]);
+                lastTicks  = std::max(lastTicks, mResults[query * 2]);
+            }
+        }
+        if(firstTicks == UINT64_MAX)
+        {
+            return false;
+        }
+        mLastFrameDeviceMs = static_cast<float>((lastTicks - firstTicks) * mTimestampPeriod * 1e-6);
+        if(!util::Timeline::Shared().IsEnabled())
+        {
+            return true;
+        }
+
+        auto toNs = [this](uint64_t ticks) { return static_cast<int64_t>(static_cast<double>(ticks) * mTimestampPeriod); };
+        if(slot.SubmitNs >= 0)
+        {
+            mClockOffsetNs = std::max(mClockOffsetNs, slot.SubmitNs - toNs(firstTicks));
+        }
+        if(mClockOffsetNs == INT64_MIN)
+        {
+            return true;
+        }
+
+        util::Timeline& timeline = util::Timeline::Shared();
+        for(uint32_t scope = 0; scope < slot.Names.size(); scope++)
+        {
+            const uint64_t* begin = &mResults[scope * 4];
+            const uint64_t* end   = &mResults[scope * 4 + 2];
+            if(begin[1] != 0 && end[1] != 0)
+            {
+                timeline.AddEvent(slot.Names[scope], toNs(begin[0]) + mClockOffsetNs, toNs(end[0]) + mClockOffsetNs, mTrack);
+            }
+        }
+        return true;
+    }
+
+}  // namespace denoise::bench
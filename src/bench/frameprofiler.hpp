@@ -0,0 +1,93 @@
+#pragma once
+
+#include "../util/timeline.hpp"
+#include <foray_api.hpp>
+#include <vector>
+
+namespace denoise::bench {
+
+    /// @brief Times render stages on the device with timestamp queries and adds them to the util::Timeline
+    /// @details Every in flight frame owns a query pool holding a begin and end timestamp per scope. Once the frame finished executing, the
+    /// timestamps are converted to host time and added to the "Graphics Queue" track of the timeline (the device frame time is available without
+    /// timeline as well). Device and host clocks are correlated without extensions: the device can not start a frame before its first submit, so
+    /// the offset is the largest observed difference of submit time and first timestamp. This is exact once any frame found the device idle (e.g.
+    /// the first one), clock drift is not corrected.
+    class FrameProfiler
+    {
+      public:
+        /// @param maxScopesPerFrame Scopes beyond this count are not timed on the device
+        void Init(foray::core::Context* context, uint32_t maxScopesPerFrame = 32);
+        void Destroy();
+
+        inline bool Exists() const { return !mSlots.empty(); }
+
+        /// @brief Resets the queries of the frame. Record into the first command buffer of the frame, before any scope
+        void BeginFrame(VkCommandBuffer cmdBuffer, uint64_t frameNumber);
+        /// @brief Writes the begin timestamp of a scope
+        /// @param name Static or interned (util::Timeline::InternName()) string
+        /// @return Scope index for EndScope(), UINT32_MAX if not timed
+        uint32_t BeginScope(VkCommandBuffer cmdBuffer, const char* name);
+        void     EndScope(VkCommandBuffer cmdBuffer, uint32_t scope);
+        /// @brief Call right before submitting a command buffer of the frame, the first call per frame anchors the clock correlation
+        void OnSubmit();
+        /// @brief Reads the timestamps of a finished frame and adds them to the timeline if it is enabled
+        /// @return True if the frame was timed (GetLastFrameDeviceMs() updated)
+        bool OnFrameFinished(uint64_t frameIndex);
+
+        /// @brief Device time from the first to the last timestamp of the last timed frame
+        inline float GetLastFrameDeviceMs() const { return mLastFrameDeviceMs; }
+
+      protected:
+        struct Slot
+        {
+            VkQueryPool              Pool = VK_NULL_HANDLE;
+            std::vector<const char*> Names;
+            uint64_t                 FrameNumber = 0;
+            int64_t                  SubmitNs    = -1;
+            bool                     Recorded    = false;
+        };
+
+        std::vector<Slot>     mSlots;
+        foray::core::Context* mContext           = nullptr;
+        Slot*                 mCurrent           = nullptr;
+        uint32_t              mMaxScopesPerFrame = 0;
+        /// @brief Nanoseconds per timestamp tick
+        double mTimestampPeriod = 1.0;
+        /// @brief Host time minus device time, lower bound estimated from submits
+        int64_t  mClockOffsetNs     = INT64_MIN;
+        uint32_t mTrack             = 0;
+        float    mLastFrameDeviceMs = 0.f;
+        /// @brief Query results of a frame: value and availability per query
+        std::vector<uint64_t> mResults;
+    };
+
+    /// @brief Times the lifetime of the scope on the host (recording) and the commands recorded meanwhile on the device
+    class StageScope
+    {
+      public:
+        StageScope(FrameProfiler& profiler, VkCommandBuffer cmdBuffer, const char* name) : mHost(name), mProfiler(profiler), mCmdBuffer(cmdBuffer)
+        {
+            if(mProfiler.Exists())
+            {
+                mScope = mProfiler.BeginScope(cmdBuffer, name);
+            }
+        }
+        ~StageScope()
+        {
+            if(mScope != UINT32_MAX)
+            {
+                mProfiler.EndScope(mCmdBuffer, mScope);
+            }
+        }
+
+        StageScope(const StageScope&)            = delete;
+        StageScope& operator=(const StageScope&) = delete;
+
+      protected:
+        util::TimelineScope mHost;
+        FrameProfiler&      mProfiler;
+        VkCommandBuffer     mCmdBuffer = VK_NULL_HANDLE;
+        uint32_t            mScope     = UINT32_MAX;
+    };
+
+}  // namespace denoise::bench
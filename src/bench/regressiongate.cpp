@@ -0,0 +1,332 @@
+#include "regressiongate.hpp"
+#include "csvcells.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <foray_logger.hpp>
+#include <fstream>
+
+namespace denoise::bench {
+
+#pragma region Parsing
+
+    bool lParseDouble(std::string_view cell, double& out)
+    {
+        auto result = std::from_chars(cell.data(), cell.data() + cell.size(), out);
+        return result.ec == std::errc() && result.ptr == cell.data() + cell.size();
+    }
+
+    void lAddValue(BenchSeries& series, double value, const RegressionGateConfig& config)
+    {
+        if(!std::isfinite(value))
+        {
+            return;  // Unavailable metrics
+        }
+        if(series.WarmupDropped < config.WarmupFrames)
+        {
+            series.WarmupDropped++;
+            return;
+        }
+        series.Samples.Add(value);
+    }
+
+    BenchSeries& lFindSeries(std::map<SeriesKey, BenchSeries>& out, SeriesKey&& key, const RegressionGateConfig& config)
+    {
+        return out.try_emplace(std::move(key), BenchSeries{.Samples = SampleReservoir(config.SampleSize)}).first->second;
+    }
+
+    /// @brief Long format report: one value per row. Consecutive rows mostly continue the same series, so the last lookup is reused
+    void lReadReport(std::istream& stream, std::string& line, const RegressionGateConfig& config, std::map<SeriesKey, BenchSeries>& out)
+    {
+        SeriesKey    key;
+        BenchSeries* series = nullptr;
+        std::string  resolution;
+        while(std::getline(stream, line))
+        {
+            std::string_view cells[7];
+            size_t           cellCount = 0;
+            ForEachCsvCell(TrimCsvLine(line), [&](size_t index, std::string_view cell) {
+                if(index < 7)
+                {
+                    cells[index] = cell;
+                }
+                cellCount = index + 1;
+            });
+            double value = 0.0;
+            if(cellCount != 7 || !lParseDouble(cells[6], value))
+            {
+                continue;
+            }
+            resolution.assign(cells[2]).append("x").append(cells[3]);
+            if(!series || key.Scene != cells[0] || key.Denoiser != cells[1] || key.Resolution != resolution || key.Metric != cells[5])
+            {
+                key    = SeriesKey{.Scene = std::string(cells[0]), .Denoiser = std::string(cells[1]), .Resolution = resolution, .Metric = std::string(cells[5])};
+                series = &lFindSeries(out, SeriesKey(key), config);
+            }
+            lAddValue(*series, value, config);
+        }
+    }
+
+    /// @brief Wide format soak log: a header row ("frame,...") whenever the columns change, then one row per frame
+    void lReadSoakLog(std::istream& stream, std::string& line, const RegressionGateConfig& config, std::map<SeriesKey, BenchSeries>& out)
+    {
+        std::vector<std::string>  columns;
+        std::vector<BenchSeries*> columnSeries;
+        std::string               label;
+        do
+        {
+            std::string_view row = TrimCsvLine(line);
+            if(row.starts_with("frame,"))
+            {
+                columns.clear();
+                ForEachCsvCell(row, [&](size_t, std::string_view cell) { columns.emplace_back(cell); });
+                columnSeries.clear();
+                continue;
+            }
+
+            // The first non-numeric cell names the denoiser (BenchmarkLog title), series are looked up again when it changes
+            std::string_view rowLabel;
+            ForEachCsvCell(row, [&](size_t index, std::string_view cell) {
+                double value = 0.0;
+                if(index > 0 && rowLabel.empty() && !cell.empty() && !lParseDouble(cell, value))
+                {
+                    rowLabel = cell;
+                }
+            });
+            if(columnSeries.empty() || rowLabel != label)
+            {
+                label = rowLabel;
+                columnSeries.assign(columns.size(), nullptr);
+            }
+
+            ForEachCsvCell(row, [&](size_t index, std::string_view cell) {
+                double value = 0.0;
+                if(index == 0 || index >= columns.size() || !lParseDouble(cell, value))
+                {
+                    return;  // Frame number, titles and cells beyond the header
+                }
+                if(!columnSeries[index])
+                {
+                    columnSeries[index] = &lFindSeries(out, SeriesKey{.Denoiser = label, .Metric = columns[index]}, config);
+                }
+                lAddValue(*columnSeries[index], value, config);
+            });
+        } while(std::getline(stream, line));
+    }
+
+    bool ReadBenchSeries(const std::string& utf8path, const RegressionGateConfig& config, std::map<SeriesKey, BenchSeries>& out)
+    {
+        std::ifstream stream(std::filesystem::u8path(utf8path), std::ios_base::in);
+        if(!stream.is_open())
+        {
+            foray::logger()->error("Unable to open benchmark CSV \"{}\"", utf8path);
+            return false;
+        }
+        std::string line;
+        if(!std::getline(stream, line))
+        {
+            foray::logger()->error("Benchmark CSV \"{}\" is empty", utf8path);
+            return false;
+        }
+        std::string_view header = TrimCsvLine(line);
+        if(header == "scene,denoiser,width,height,frame,metric,value")
+        {
+            lReadReport(stream, line, config, out);
+        }
+        else if(header.starts_with("frame,"))
+        {
+            lReadSoakLog(stream, line, config, out);
+        }
+        else
+        {
+            foray::logger()->error("Benchmark CSV \"{}\" has an unknown layout (expected a --report or CSV --bench-log file)", utf8path);
+            return false;
+        }
+        if(stream.bad())
+        {
+            foray::logger()->error("Failed reading benchmark CSV \"{}\"", utf8path);
+            return false;
+        }
+        return true;
+    }
+
+#pragma endregion
+#pragma region Statistics
+
+    const char* PrintVerdict(EVerdict verdict)
+    {
+        switch(verdict)
+        {
+            case EVerdict::Unchanged:
+                return "unchanged";
+            case EVerdict::Improved:
+                return "improved";
+            case EVerdict::Regressed:
+                return "regressed";
+            case EVerdict::Missing:
+                return "missing";
+            default:
+                return "unknown";
+        }
+    }
+
+    bool IsHigherBetter(std::string_view metric)
+    {
+        return metric == "PSNR" || metric == "SSIM";
+    }
+
+    void CompareBenchSeries(const std::map<SeriesKey, BenchSeries>& baseline,
+                            const std::map<SeriesKey, BenchSeries>& candidate,
+                            const RegressionGateConfig&             config,
+                            std::vector<SeriesComparison>&          out)
+    {
+        out.clear();
+        std::vector<SeriesKey> keys;
+        for(const auto& [key, series] : baseline)
+        {
+            keys.push_back(key);
+        }
+        for(const auto& [key, series] : candidate)
+        {
+            if(!baseline.contains(key))
+            {
+                keys.push_back(key);
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<double> baselineValues;
+        std::vector<double> candidateValues;
+        for(const SeriesKey& key : keys)
+        {
+            SeriesComparison& comparison = out.emplace_back(SeriesComparison{.Key = key});
+            auto              baseIter   = baseline.find(key);
+            auto              candIter   = candidate.find(key);
+            if(baseIter != baseline.end())
+            {
+                comparison.BaselineCount = baseIter->second.Samples.GetCount();
+            }
+            if(candIter != candidate.end())
+            {
+                comparison.CandidateCount = candIter->second.Samples.GetCount();
+            }
+            if(comparison.BaselineCount == 0 || comparison.CandidateCount == 0)
+            {
+                comparison.Verdict = EVerdict::Missing;
+                continue;
+            }
+
+            baselineValues               = baseIter->second.Samples.GetSamples();
+            candidateValues              = candIter->second.Samples.GetSamples();
+            comparison.BaselineOutliers  = RemoveOutliers(baselineValues, config.OutlierMads);
+            comparison.CandidateOutliers = RemoveOutliers(candidateValues, config.OutlierMads);
+            comparison.PValue            = MannWhitneyPValue(baselineValues, candidateValues);
+            BootstrapMedianDelta(baselineValues, candidateValues, config.BootstrapRounds, config.Confidence, out.size(), comparison.DeltaLow, comparison.DeltaHigh);
+            comparison.BaselineMedian  = Median(baselineValues);
+            comparison.CandidateMedian = Median(candidateValues);
+            if(comparison.BaselineMedian != 0.0)
+            {
+                comparison.Delta = comparison.CandidateMedian / comparison.BaselineMedian - 1.0;
+            }
+
+            bool significant = comparison.PValue < config.Alpha && (comparison.DeltaLow > 0.0 || comparison.DeltaHigh < 0.0);
+            if(significant && std::abs(comparison.Delta) >= config.Threshold)
+            {
+                bool worse         = IsHigherBetter(key.Metric) ? comparison.Delta < 0.0 : comparison.Delta > 0.0;
+                comparison.Verdict = worse ? EVerdict::Regressed : EVerdict::Improved;
+            }
+        }
+    }
+
+    bool WriteComparisonCsv(const std::string& utf8path, const std::vector<SeriesComparison>& comparisons)
+    {
+        std::ofstream stream(std::filesystem::u8path(utf8path), std::ios_base::out | std::ios_base::trunc);
+        if(!stream.is_open())
+        {
+            foray::logger()->error("Unable to open regression summary \"{}\"", utf8path);
+            return false;
+        }
+        stream << "scene,denoiser,resolution,metric,verdict,baseline_median,candidate_median,delta,delta_low,delta_high,p_value,baseline_count,candidate_count,"
+                  "baseline_outliers,candidate_outliers\n";
+        for(const SeriesComparison& comparison : comparisons)
+        {
+            const SeriesKey& key = comparison.Key;
+            stream << fmt::format("{},{},{},{},{},{},{},{},{},{},{},{},{},{},{}\n", key.Scene, key.Denoiser, key.Resolution, key.Metric, PrintVerdict(comparison.Verdict),
+                                  comparison.BaselineMedian, comparison.CandidateMedian, comparison.Delta, comparison.DeltaLow, comparison.DeltaHigh, comparison.PValue,
+                                  comparison.BaselineCount, comparison.CandidateCount, comparison.BaselineOutliers, comparison.CandidateOutliers);
+        }
+        return !stream.bad();
+    }
+
+#pragma endregion
+#pragma region Runner
+
+    int RunRegressionGate(const LaunchOptions& options)
+    {
+        RegressionGateConfig config;
+        config.WarmupFrames = options.GateWarmupFrames;
+        config.Threshold    = options.GateThreshold * 0.01;
+
+        std::map<SeriesKey, BenchSeries> baseline;
+        std::map<SeriesKey, BenchSeries> candidate;
+        if(!ReadBenchSeries(options.GateBaseline, config, baseline) || !ReadBenchSeries(options.GateCandidate, config, candidate))
+        {
+            return 2;
+        }
+        std::vector<SeriesComparison> comparisons;
+        CompareBenchSeries(baseline, candidate, config, comparisons);
+
+        uint32_t regressed = 0;
+        uint32_t improved  = 0;
+        uint32_t missing   = 0;
+        for(const SeriesComparison& comparison : comparisons)
+        {
+            const SeriesKey& key  = comparison.Key;
+            std::string      name =
+                key.Scene.empty() ? fmt::format("{} {}", key.Denoiser, key.Metric) : fmt::format("{} {} {} {}", key.Scene, key.Denoiser, key.Resolution, key.Metric);
+            switch(comparison.Verdict)
+            {
+                case EVerdict::Missing:
+                    missing++;
+                    foray::logger()->warn("{}: only in the {} run", name, comparison.BaselineCount > 0 ? "baseline" : "candidate");
+                    continue;
+                case EVerdict::Regressed:
+                    regressed++;
+                    break;
+                case EVerdict::Improved:
+                    improved++;
+                    break;
+                default:
+                    break;
+            }
+            std::string message = fmt::format("{}: {:.4f} -> {:.4f} ({:+.2f}% [{:+.2f}%, {:+.2f}%], p = {:.2g}) {}", name, comparison.BaselineMedian, comparison.CandidateMedian,
+                                              comparison.Delta * 100.0, comparison.DeltaLow * 100.0, comparison.DeltaHigh * 100.0, comparison.PValue,
+                                              PrintVerdict(comparison.Verdict));
+            if(comparison.Verdict == EVerdict::Regressed)
+            {
+                foray::logger()->error("{}", message);
+            }
+            else
+            {
+                foray::logger()->info("{}", message);
+            }
+        }
+
+        if(!options.GateSummaryPath.empty() && !WriteComparisonCsv(options.GateSummaryPath, comparisons))
+        {
+            return 2;
+        }
+        if(comparisons.size() == missing)
+        {
+            foray::logger()->error("Regression gate: baseline and candidate share no series");
+            return 2;
+        }
+        foray::logger()->info("Regression gate {}: {} series compared, {} regressed, {} improved, {} missing (threshold {:.1f}%, alpha {})", regressed > 0 ? "FAILED" : "passed",
+                              comparisons.size() - missing, regressed, improved, missing, config.Threshold * 100.0, config.Alpha);
+        return regressed > 0 ? 1 : 0;
+    }
+
+#pragma endregion
+
+}  // namespace denoise::bench
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../launchoptions.hpp"
+#include "benchstatistics.hpp"
+#include <compare>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace denoise::bench {
+
+    /// @brief Identifies one compared series of benchmark values
+    struct SeriesKey
+    {
+        /// @brief Empty for soak logs (--bench-log), which do not record the case
+        std::string Scene;
+        /// @brief Denoiser of the bench case, or the label cell of a soak log row
+        std::string Denoiser;
+        std::string Resolution;
+        std::string Metric;
+
+        auto operator<=>(const SeriesKey&) const = default;
+    };
+
+    struct RegressionGateConfig
+    {
+        /// @brief Leading values dropped per series (per bench case in reports, per column layout in soak logs)
+        uint32_t WarmupFrames = 100;
+        /// @brief Values kept per series, bounds memory independent of the log length
+        uint32_t SampleSize = 4096;
+        /// @brief Values further than this many scaled median absolute deviations from the median are outliers
+        double OutlierMads = 5.0;
+        /// @brief Resamples of the bootstrap confidence interval of the median delta
+        uint32_t BootstrapRounds = 1000;
+        double   Confidence      = 0.95;
+        /// @brief Significance level of the Mann-Whitney U test
+        double Alpha = 0.01;
+        /// @brief Relative median change below which a significant difference still counts as unchanged
+        double Threshold = 0.02;
+    };
+
+    /// @brief Series of one benchmark CSV, values after warm-up
+    struct BenchSeries
+    {
+        SampleReservoir Samples;
+        uint64_t        WarmupDropped = 0;
+    };
+
+    /// @brief Streams a benchmark CSV into per series samples with bounded memory
+    /// @details Accepts the bench report (long format scene,denoiser,width,height,frame,metric,value) and CSV soak logs (frame and the
+    /// BenchmarkLog columns, the header repeats when the columns change). Non-numeric cells are skipped, a soak log row's first non-numeric cell
+    /// names its denoiser.
+    /// @return False if the file can not be read or has an unknown layout
+    bool ReadBenchSeries(const std::string& utf8path, const RegressionGateConfig& config, std::map<SeriesKey, BenchSeries>& out);
+
+    enum class EVerdict
+    {
+        Unchanged,
+        Improved,
+        Regressed,
+        /// @brief The series exists in one run only
+        Missing,
+    };
+
+    const char* PrintVerdict(EVerdict verdict);
+
+    struct SeriesComparison
+    {
+        SeriesKey Key;
+        uint64_t  BaselineCount     = 0;
+        uint64_t  CandidateCount    = 0;
+        uint32_t  BaselineOutliers  = 0;
+        uint32_t  CandidateOutliers = 0;
+        double    BaselineMedian    = 0.0;
+        double    CandidateMedian   = 0.0;
+        /// @brief Relative change of the median (candidate / baseline - 1) and its bootstrap confidence interval
+        double Delta     = 0.0;
+        double DeltaLow  = 0.0;
+        double DeltaHigh = 0.0;
+        /// @brief Two-sided Mann-Whitney U test
+        double   PValue  = 1.0;
+        EVerdict Verdict = EVerdict::Unchanged;
+    };
+
+    /// @brief PSNR and SSIM improve when growing, all other columns (timings, error metrics) when shrinking
+    bool IsHigherBetter(std::string_view metric);
+
+    /// @brief Compares all series of both runs
+    /// @details Outliers are removed per series, then a series regressed (or improved) if the Mann-Whitney test is significant, the confidence
+    /// interval of the median delta excludes 0 and the median moved by at least the threshold in the worse (better) direction.
+    void CompareBenchSeries(const std::map<SeriesKey, BenchSeries>& baseline,
+                            const std::map<SeriesKey, BenchSeries>& candidate,
+                            const RegressionGateConfig&             config,
+                            std::vector<SeriesComparison>&          out);
+
+    /// @brief Writes the comparisons as CSV (one row per series)
+    bool WriteComparisonCsv(const std::string& utf8path, const std::vector<SeriesComparison>& comparisons);
+
+    /// @brief Compares the benchmark CSVs of a baseline and a candidate run, logs the per series deltas and optionally writes the summary CSV
+    /// @return Process exit code: 0 if no series regressed, 1 if any did, 2 if the inputs could not be read
+    int RunRegressionGate(const LaunchOptions& options);
+
+}  // namespace denoise::bench
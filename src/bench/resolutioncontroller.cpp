@@ -0,0 +1,128 @@
+#include "resolutioncontroller.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace denoise::bench {
+
+    /// @brief Fraction of the target frame time the level above has to be predicted to need before a backoff block is lifted early
+    constexpr float UNBLOCK_HEADROOM = 0.85f;
+
+    void ResolutionController::Init(const ResolutionControllerConfig& config, uint32_t initialLevel)
+    {
+        mConfig = config;
+        mScales.resize(std::max(config.LevelCount, 1u));
+        for(size_t i = 0; i < mScales.size(); i++)
+        {
+            float t    = mScales.size() > 1 ? static_cast<float>(i) / (mScales.size() - 1) : 1.f;
+            mScales[i] = config.MinScale + (config.MaxScale - config.MinScale) * t;
+        }
+        mLevel         = std::min(initialLevel, GetLevelCount() - 1);
+        mLogPixels     = 2.0 * std::log2(mScales[mLevel] / mConfig.MaxScale);
+        mLastError     = 0.0;
+        mSmoothedMs    = 0.f;
+        mSettleFrames  = mConfig.SettleFrames;
+        mLevelChanges  = 0;
+        mFramesAtLevel = 0;
+        mSteppedUp     = false;
+        mUpBlocked     = 0;
+        mBackoff       = mConfig.UpBackoffFrames;
+    }
+
+    void ResolutionController::Settle()
+    {
+        mSettleFrames = mConfig.SettleFrames;
+        mSmoothedMs   = 0.f;
+    }
+
+    bool ResolutionController::Update(float frameMs)
+    {
+        if(!Exists() || !(frameMs > 0.f))
+        {
+            return false;
+        }
+        mFramesAtLevel++;
+        mUpBlocked = mUpBlocked > 0 ? mUpBlocked - 1 : 0;
+        if(mSettleFrames > 0)
+        {
+            mSettleFrames--;
+            return false;
+        }
+        bool settled = mSmoothedMs > 0.f;
+        if(settled)
+        {
+            frameMs     = std::clamp(frameMs, mSmoothedMs / mConfig.OutlierRatio, mSmoothedMs * mConfig.OutlierRatio);
+            mSmoothedMs = mSmoothedMs + (frameMs - mSmoothedMs) * mConfig.Smoothing;
+        }
+        else
+        {
+            mSmoothedMs = frameMs;
+        }
+
+        if(mUpBlocked > 0 && mLevel + 1 < GetLevelCount())
+        {
+            // The load dropped far enough that the blocked level fits now (with headroom against noise), stop waiting for the backoff
+            float pixelRatio = (mScales[mLevel + 1] * mScales[mLevel + 1]) / (mScales[mLevel] * mScales[mLevel]);
+            if(mSmoothedMs * pixelRatio < mConfig.TargetFrameMs * UNBLOCK_HEADROOM)
+            {
+                mUpBlocked = 0;
+                mBackoff   = mConfig.UpBackoffFrames;
+            }
+        }
+
+        // Velocity form: clamping the output is all the anti windup needed. The error jump of a level change is caused by the controller itself,
+        // the first error after settling is the new baseline of the proportional term
+        double error = std::log2(mConfig.TargetFrameMs / mSmoothedMs);
+        mLastError   = settled ? mLastError : error;
+        mLogPixels += mConfig.Kp * (error - mLastError) + mConfig.Ki * error;
+        mLastError       = error;
+        double minPixels = 2.0 * std::log2(mConfig.MinScale / mConfig.MaxScale);
+        double maxPixels = mUpBlocked > 0 ? 2.0 * std::log2(mScales[mLevel] / mConfig.MaxScale) : 0.0;
+        mLogPixels       = std::clamp(mLogPixels, minPixels, maxPixels);
+
+        // Quantize with hysteresis: the output has to pass the midpoint to a neighbouring level by a margin
+        float    scale    = mConfig.MaxScale * static_cast<float>(std::exp2(mLogPixels * 0.5));
+        float    margin   = 0.5f + 0.5f * mConfig.Hysteresis;
+        uint32_t previous = mLevel;
+        while(mLevel + 1 < GetLevelCount() && scale >= mScales[mLevel] + (mScales[mLevel + 1] - mScales[mLevel]) * margin)
+        {
+            mLevel++;
+        }
+        while(mLevel > 0 && scale <= mScales[mLevel] - (mScales[mLevel] - mScales[mLevel - 1]) * margin)
+        {
+            mLevel--;
+        }
+        if(mLevel == previous)
+        {
+            return false;
+        }
+
+        bool steppedUp = mLevel > previous;
+        if(!steppedUp)
+        {
+            // Stepping down right after stepping up: the upper level misses the target, block it for longer every time
+            if(mSteppedUp && mFramesAtLevel < mBackoff)
+            {
+                mUpBlocked = mBackoff;
+                mBackoff   = std::min(mBackoff * 2, mConfig.UpBackoffFrames * 16);
+            }
+            else
+            {
+                mBackoff = mConfig.UpBackoffFrames;
+            }
+        }
+        mSteppedUp     = steppedUp;
+        mFramesAtLevel = 0;
+        mLevelChanges++;
+        Settle();
+        return true;
+    }
+
+    void ResolutionController::GetExtent(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const
+    {
+        auto scaleAxis = [](uint32_t size, float scale) { return std::max(8u, static_cast<uint32_t>(std::lround(size * scale / 8.f)) * 8u); };
+        float scale    = Exists() ? GetScale() : 1.f;
+        width          = std::min(scaleAxis(outputWidth, scale), std::max(outputWidth, 8u));
+        height         = std::min(scaleAxis(outputHeight, scale), std::max(outputHeight, 8u));
+    }
+
+}  // namespace denoise::bench
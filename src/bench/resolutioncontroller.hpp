@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace denoise::bench {
+
+    struct ResolutionControllerConfig
+    {
+        /// @brief Frame time the controller holds
+        float TargetFrameMs = 16.667f;
+        /// @brief Render scale range, relative to the output size per axis
+        float MinScale = 0.5f;
+        float MaxScale = 1.f;
+        /// @brief Discrete scales between MinScale and MaxScale (equally spaced per axis)
+        uint32_t LevelCount = 6;
+        /// @brief PI gains on the log of the frame time error, acting on the log of the pixel count
+        float Kp = 0.4f;
+        float Ki = 0.15f;
+        /// @brief Weight of a new frame time in the exponential average the controller sees
+        float Smoothing = 0.25f;
+        /// @brief Frame times are clamped to this multiple of the average before entering it, so single frame hitches do not change the level
+        float OutlierRatio = 1.5f;
+        /// @brief Frames ignored after a level change, as frames in flight were measured at the previous level
+        uint32_t SettleFrames = 6;
+        /// @brief Fraction of the distance to the next level the controller output has to pass beyond the midpoint before switching
+        float Hysteresis = 0.25f;
+        /// @brief Frames a level is blocked after stepping up to it missed the target. Doubles with every further miss, up to 16 times
+        uint32_t UpBackoffFrames = 120;
+    };
+
+    /// @brief Picks a render resolution level holding a frame time budget
+    /// @details Frame time is modelled as roughly proportional to the rendered pixel count. A velocity form PI controller drives the log pixel
+    /// fraction by the log ratio of target and measured frame time, clamped to the level range (no integrator windup). The continuous output is
+    /// quantized to LevelCount discrete scales with hysteresis, so the traced resolution only follows sustained changes in load. If the target lies
+    /// between two levels, stepping up to the level that misses it is blocked with exponential backoff instead of oscillating, unless the load drops
+    /// enough that the upper level clearly fits. Host only and deterministic, so recorded frame time traces can be replayed through Update()
+    /// (tests/resolutioncontrollertest).
+    class ResolutionController
+    {
+      public:
+        /// @param initialLevel Starting level, clamped. LevelCount - 1 is MaxScale
+        void Init(const ResolutionControllerConfig& config, uint32_t initialLevel = UINT32_MAX);
+
+        /// @brief Feeds the frame time of a frame rendered at the current level
+        /// @return True if the level changed
+        bool Update(float frameMs);
+
+        /// @brief Restarts the settle period (e.g. after a resize not caused by the controller)
+        void Settle();
+
+        inline uint32_t GetLevel() const { return mLevel; }
+        inline uint32_t GetLevelCount() const { return static_cast<uint32_t>(mScales.size()); }
+        inline float    GetScale() const { return mScales[mLevel]; }
+        inline float    GetSmoothedFrameMs() const { return mSmoothedMs; }
+        inline uint64_t GetLevelChanges() const { return mLevelChanges; }
+        inline bool     Exists() const { return !mScales.empty(); }
+
+        /// @brief Output extent scaled by the current level, rounded to multiples of 8 (at least 8)
+        void GetExtent(uint32_t outputWidth, uint32_t outputHeight, uint32_t& width, uint32_t& height) const;
+
+      protected:
+        ResolutionControllerConfig mConfig;
+        std::vector<float>         mScales;
+        uint32_t                   mLevel         = 0;
+        uint32_t                   mSettleFrames  = 0;
+        uint64_t                   mLevelChanges  = 0;
+        uint32_t                   mFramesAtLevel = 0;
+        /// @brief The last level change stepped up
+        bool mSteppedUp = false;
+        /// @brief Frames stepping up stays blocked, and the block length of the next miss
+        uint32_t mUpBlocked = 0;
+        uint32_t mBackoff   = 0;
+        /// @brief Controller output: log2 of the pixel fraction relative to MaxScale
+        double mLogPixels  = 0.0;
+        double mLastError  = 0.0;
+        float  mSmoothedMs = 0.f;
+    };
+
+}  // namespace denoise::bench
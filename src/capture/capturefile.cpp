@@ -0,0 +1,275 @@
+#include "capturefile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <foray_logger.hpp>
+
+namespace denoise::capture {
+
+    namespace {
+        /// @brief True if [offset, offset + size) lies within a file of fileSize bytes, without overflowing
+        bool lFits(uint64_t offset, uint64_t size, uint64_t fileSize) { return offset <= fileSize && size <= fileSize - offset; }
+
+        /// @brief a * b, false if it does not fit 64 bits
+        bool lMultiply(uint64_t a, uint64_t b, uint64_t& product)
+        {
+            if(a != 0 && b > UINT64_MAX / a)
+            {
+                return false;
+            }
+            product = a * b;
+            return true;
+        }
+    }  // namespace
+
+#pragma region CaptureWriter
+
+    bool CaptureWriter::Open(const std::string& utf8path, uint32_t width, uint32_t height, const std::vector<ChannelInfo>& channels)
+    {
+        mFile.open(std::filesystem::u8path(utf8path), std::ios_base::out | std::ios_base::in | std::ios_base::binary | std::ios_base::trunc);
+        if(!mFile.is_open() || mFile.bad())
+        {
+            foray::logger()->error("Capture: Unable to open \"{}\" for writing", utf8path);
+            return false;
+        }
+
+        mHeader = format::FileHeader{};
+        std::memcpy(mHeader.Magic, format::MAGIC, sizeof(format::MAGIC));
+        mHeader.Version      = format::VERSION;
+        mHeader.ChannelCount = static_cast<uint32_t>(channels.size());
+        mHeader.Width        = width;
+        mHeader.Height       = height;
+
+        // Channel data is laid out at fixed offsets relative to the chunk start
+        uint64_t chunkOffset = format::Align(sizeof(format::FrameHeader));
+        mChannels.resize(channels.size());
+        for(size_t i = 0; i < channels.size(); i++)
+        {
+            format::ChannelDesc& desc = mChannels[i];
+            desc                      = format::ChannelDesc{};
+            std::strncpy(desc.Name, channels[i].Name.c_str(), sizeof(desc.Name) - 1);
+            desc.Format      = channels[i].Format;
+            desc.TexelSize   = channels[i].TexelSize;
+            desc.ChunkOffset = chunkOffset;
+            chunkOffset      = format::Align(chunkOffset + (uint64_t)width * height * desc.TexelSize);
+        }
+        mChunkSize = chunkOffset;
+
+        mHeader.FirstChunkOffset = format::Align(sizeof(format::FileHeader) + sizeof(format::ChannelDesc) * mChannels.size());
+        mNextOffset              = mHeader.FirstChunkOffset;
+        mIndex.clear();
+
+        mFile.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+        mFile.write(reinterpret_cast<const char*>(mChannels.data()), sizeof(format::ChannelDesc) * mChannels.size());
+        return mFile.good();
+    }
+
+    bool CaptureWriter::WriteFrame(const FrameMeta& meta, const std::vector<const void*>& channelData)
+    {
+        if(!mFile.is_open() || channelData.size() != mChannels.size())
+        {
+            return false;
+        }
+
+        format::FrameHeader header{};
+        header.Magic       = format::FRAME_MAGIC;
+        header.RngSeed     = meta.RngSeed;
+        header.FrameNumber = meta.FrameNumber;
+        header.ChunkSize   = mChunkSize;
+        std::memcpy(header.ViewMatrix, meta.ViewMatrix, sizeof(header.ViewMatrix));
+        std::memcpy(header.ProjectionMatrix, meta.ProjectionMatrix, sizeof(header.ProjectionMatrix));
+        std::memcpy(header.PreviousViewMatrix, meta.PreviousViewMatrix, sizeof(header.PreviousViewMatrix));
+        std::memcpy(header.PreviousProjectionMatrix, meta.PreviousProjectionMatrix, sizeof(header.PreviousProjectionMatrix));
+
+        mFile.seekp(static_cast<std::streamoff>(mNextOffset));
+        mFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for(size_t i = 0; i < mChannels.size(); i++)
+        {
+            const format::ChannelDesc& desc = mChannels[i];
+            mFile.seekp(static_cast<std::streamoff>(mNextOffset + desc.ChunkOffset));
+            mFile.write(reinterpret_cast<const char*>(channelData[i]), static_cast<std::streamsize>((uint64_t)mHeader.Width * mHeader.Height * desc.TexelSize));
+        }
+        if(!mFile.good())
+        {
+            foray::logger()->error("Capture: Writing frame {} failed", meta.FrameNumber);
+            return false;
+        }
+
+        mIndex.push_back(format::IndexEntry{.FrameNumber = meta.FrameNumber, .ChunkOffset = mNextOffset});
+        mNextOffset += mChunkSize;
+        return true;
+    }
+
+    void CaptureWriter::Close()
+    {
+        if(!mFile.is_open())
+        {
+            return;
+        }
+        mHeader.FrameCount  = mIndex.size();
+        mHeader.IndexOffset = mNextOffset;
+        mFile.seekp(static_cast<std::streamoff>(mNextOffset));
+        mFile.write(reinterpret_cast<const char*>(mIndex.data()), sizeof(format::IndexEntry) * mIndex.size());
+        mFile.seekp(0);
+        mFile.write(reinterpret_cast<const char*>(&mHeader), sizeof(mHeader));
+        mFile.flush();
+        mFile.close();
+        mIndex.clear();
+        mChannels.clear();
+    }
+
+#pragma endregion
+#pragma region CaptureReader
+
+    bool CaptureReader::Open(const std::string& utf8path)
+    {
+        Close();
+        if(!mFile.Open(utf8path))
+        {
+            return false;
+        }
+        if(mFile.GetSize() < sizeof(format::FileHeader))
+        {
+            foray::logger()->warn("Capture: \"{}\" is truncated", utf8path);
+            Close();
+            return false;
+        }
+        mHeader = reinterpret_cast<const format::FileHeader*>(mFile.GetData());
+        if(std::memcmp(mHeader->Magic, format::MAGIC, sizeof(format::MAGIC)) != 0 || mHeader->Version != format::VERSION
+           || !lFits(sizeof(format::FileHeader), sizeof(format::ChannelDesc) * mHeader->ChannelCount, mFile.GetSize()))
+        {
+            foray::logger()->warn("Capture: \"{}\" is not a capture file of version {}", utf8path, format::VERSION);
+            Close();
+            return false;
+        }
+
+        // Every chunk has to hold the frame header and the data of all channels
+        mMinChunkSize                    = sizeof(format::FrameHeader);
+        const format::ChannelDesc* descs = reinterpret_cast<const format::ChannelDesc*>(mFile.GetData() + sizeof(format::FileHeader));
+        for(uint32_t i = 0; i < mHeader->ChannelCount; i++)
+        {
+            uint64_t pixels     = 0;
+            uint64_t channelEnd = 0;
+            if(!lMultiply(mHeader->Width, mHeader->Height, pixels) || !lMultiply(pixels, descs[i].TexelSize, channelEnd) || descs[i].ChunkOffset < sizeof(format::FrameHeader)
+               || channelEnd > UINT64_MAX - descs[i].ChunkOffset)
+            {
+                foray::logger()->warn("Capture: \"{}\" channel #{} has an invalid layout", utf8path, i);
+                Close();
+                return false;
+            }
+            mMinChunkSize = std::max(mMinChunkSize, descs[i].ChunkOffset + channelEnd);
+            mChannels.push_back(ChannelInfo{.Name = std::string(descs[i].Name, strnlen(descs[i].Name, sizeof(descs[i].Name))), .Format = descs[i].Format, .TexelSize = descs[i].TexelSize});
+            mChannelOffsets.push_back(descs[i].ChunkOffset);
+        }
+
+        uint64_t indexBytes = 0;
+        bool     indexValid = mHeader->IndexOffset > 0 && lMultiply(sizeof(format::IndexEntry), mHeader->FrameCount, indexBytes)
+                          && lFits(mHeader->IndexOffset, indexBytes, mFile.GetSize());
+        if(indexValid)
+        {
+            const format::IndexEntry* entries = reinterpret_cast<const format::IndexEntry*>(mFile.GetData() + mHeader->IndexOffset);
+            mIndex.assign(entries, entries + mHeader->FrameCount);
+            for(const format::IndexEntry& entry : mIndex)
+            {
+                if(!lFits(entry.ChunkOffset, mMinChunkSize, mFile.GetSize()))
+                {
+                    foray::logger()->warn("Capture: \"{}\" frame {} at offset {} lies beyond the end of the file ({} bytes)", utf8path, entry.FrameNumber, entry.ChunkOffset,
+                                          mFile.GetSize());
+                    Close();
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            foray::logger()->warn("Capture: \"{}\" has no index (interrupted capture?), rebuilding", utf8path);
+            if(!RebuildIndex(utf8path))
+            {
+                Close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool CaptureReader::RebuildIndex(const std::string& utf8path)
+    {
+        mIndex.clear();
+        const uint64_t fileSize = mFile.GetSize();
+        uint64_t       offset   = mHeader->FirstChunkOffset;
+        while(lFits(offset, sizeof(format::FrameHeader), fileSize))
+        {
+            const format::FrameHeader* header = reinterpret_cast<const format::FrameHeader*>(mFile.GetData() + offset);
+            if(header->Magic != format::FRAME_MAGIC || header->ChunkSize < mMinChunkSize)
+            {
+                foray::logger()->warn("Capture: \"{}\" has no valid frame chunk at offset {}, {} trailing bytes ignored", utf8path, offset, fileSize - offset);
+                break;
+            }
+            if(!lFits(offset, header->ChunkSize, fileSize))
+            {
+                foray::logger()->warn("Capture: \"{}\" ends in a partially written chunk (frame {}, {} of {} bytes), dropped", utf8path, header->FrameNumber,
+                                      fileSize - offset, header->ChunkSize);
+                break;
+            }
+            mIndex.push_back(format::IndexEntry{.FrameNumber = header->FrameNumber, .ChunkOffset = offset});
+            offset += header->ChunkSize;
+        }
+        if(mIndex.empty())
+        {
+            foray::logger()->warn("Capture: \"{}\" holds no complete frame", utf8path);
+            return false;
+        }
+        return true;
+    }
+
+    void CaptureReader::Close()
+    {
+        mFile.Close();
+        mHeader = nullptr;
+        mChannels.clear();
+        mChannelOffsets.clear();
+        mIndex.clear();
+    }
+
+    int32_t CaptureReader::FindChannel(std::string_view name) const
+    {
+        for(size_t i = 0; i < mChannels.size(); i++)
+        {
+            if(mChannels[i].Name == name)
+            {
+                return static_cast<int32_t>(i);
+            }
+        }
+        return -1;
+    }
+
+    FrameView CaptureReader::GetFrame(uint64_t index) const
+    {
+        FrameView view;
+        if(index >= mIndex.size())
+        {
+            return view;
+        }
+        const uint8_t* chunk = mFile.GetData() + mIndex[index].ChunkOffset;
+        view.Header          = reinterpret_cast<const format::FrameHeader*>(chunk);
+        for(uint64_t offset : mChannelOffsets)
+        {
+            view.Channels.push_back(chunk + offset);
+        }
+        return view;
+    }
+
+    FrameView CaptureReader::FindFrame(uint64_t frameNumber) const
+    {
+        // Frames are appended in ascending frame number order
+        auto iter = std::lower_bound(mIndex.begin(), mIndex.end(), frameNumber, [](const format::IndexEntry& entry, uint64_t number) { return entry.FrameNumber < number; });
+        if(iter == mIndex.end() || iter->FrameNumber != frameNumber)
+        {
+            return FrameView{};
+        }
+        return GetFrame(static_cast<uint64_t>(iter - mIndex.begin()));
+    }
+
+#pragma endregion
+
+}  // namespace denoise::capture
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "../util/mappedfile.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string_view>
+#include <string>
+#include <vector>
+
+namespace denoise::capture {
+
+    /// @brief Capture sequence file layout (all values little endian)
+    /// @details
+    /// FileHeader
+    /// ChannelDesc[ChannelCount]
+    /// Frame chunks, each starting at a CHUNK_ALIGNMENT aligned offset:
+    ///     FrameHeader, followed by the tightly packed texels of every channel (each channel CHUNK_ALIGNMENT aligned)
+    /// IndexEntry[FrameCount] at FileHeader::IndexOffset
+    ///
+    /// The index is written last. Files of an interrupted capture have IndexOffset == 0, readers then rebuild the index by walking the chunk headers.
+    namespace format {
+        inline constexpr char     MAGIC[8]        = {'F', 'R', 'Y', 'C', 'A', 'P', 'T', '\0'};
+        inline constexpr uint32_t VERSION         = 1;
+        inline constexpr uint32_t FRAME_MAGIC     = 0x454D5246;  // "FRME"
+        inline constexpr uint64_t CHUNK_ALIGNMENT = 256;
+
+        struct FileHeader
+        {
+            char     Magic[8];
+            uint32_t Version;
+            uint32_t ChannelCount;
+            uint32_t Width;
+            uint32_t Height;
+            uint64_t FrameCount;
+            uint64_t IndexOffset;
+            uint64_t FirstChunkOffset;
+        };
+        static_assert(sizeof(FileHeader) == 48);
+
+        struct ChannelDesc
+        {
+            char     Name[48];
+            /// @brief VkFormat of the source image
+            uint32_t Format;
+            uint32_t TexelSize;
+            /// @brief Offset of the channel data relative to the start of the frame chunk
+            uint64_t ChunkOffset;
+        };
+        static_assert(sizeof(ChannelDesc) == 64);
+
+        struct FrameHeader
+        {
+            uint32_t Magic;
+            uint32_t RngSeed;
+            uint64_t FrameNumber;
+            /// @brief Size of the chunk including this header
+            uint64_t ChunkSize;
+            uint64_t Reserved;
+            float    ViewMatrix[16];
+            float    ProjectionMatrix[16];
+            float    PreviousViewMatrix[16];
+            float    PreviousProjectionMatrix[16];
+        };
+        static_assert(sizeof(FrameHeader) == 288);
+
+        struct IndexEntry
+        {
+            uint64_t FrameNumber;
+            uint64_t ChunkOffset;
+        };
+
+        inline constexpr uint64_t Align(uint64_t value) { return (value + CHUNK_ALIGNMENT - 1) & ~(CHUNK_ALIGNMENT - 1); }
+    }  // namespace format
+
+    struct ChannelInfo
+    {
+        std::string Name;
+        uint32_t    Format    = 0;
+        uint32_t    TexelSize = 0;
+    };
+
+    /// @brief Frame metadata stored next to the channel data
+    struct FrameMeta
+    {
+        uint64_t FrameNumber = 0;
+        uint32_t RngSeed     = 0;
+        float    ViewMatrix[16]{};
+        float    ProjectionMatrix[16]{};
+        float    PreviousViewMatrix[16]{};
+        float    PreviousProjectionMatrix[16]{};
+    };
+
+    /// @brief Appends frames to a capture file. Not thread safe, owned by a single writer thread.
+    class CaptureWriter
+    {
+      public:
+        bool Open(const std::string& utf8path, uint32_t width, uint32_t height, const std::vector<ChannelInfo>& channels);
+        /// @brief Writes one frame. channelData[i] must hold Width * Height * TexelSize bytes of channel i.
+        bool WriteFrame(const FrameMeta& meta, const std::vector<const void*>& channelData);
+        /// @brief Writes the index and finalizes the header
+        void Close();
+
+        inline uint64_t GetChunkSize() const { return mChunkSize; }
+        inline uint64_t GetFrameCount() const { return mIndex.size(); }
+        inline bool     IsOpen() const { return mFile.is_open(); }
+
+      protected:
+        std::fstream                    mFile;
+        format::FileHeader              mHeader{};
+        std::vector<format::ChannelDesc> mChannels;
+        std::vector<format::IndexEntry> mIndex;
+        uint64_t                        mChunkSize  = 0;
+        uint64_t                        mNextOffset = 0;
+    };
+
+    /// @brief Zero-copy view of a single frame of a mapped capture file
+    struct FrameView
+    {
+        const format::FrameHeader* Header = nullptr;
+        std::vector<const uint8_t*> Channels;
+    };
+
+    /// @brief Memory maps a capture file for random access to single frames
+    class CaptureReader
+    {
+      public:
+        bool Open(const std::string& utf8path);
+        void Close();
+
+        inline uint64_t                    GetFrameCount() const { return mIndex.size(); }
+        inline uint32_t                    GetWidth() const { return mHeader->Width; }
+        inline uint32_t                    GetHeight() const { return mHeader->Height; }
+        inline const std::vector<ChannelInfo>& GetChannels() const { return mChannels; }
+        /// @brief Returns the channel index by name, -1 if not present
+        int32_t                            FindChannel(std::string_view name) const;
+
+        /// @brief Access frame by position in the file
+        FrameView GetFrame(uint64_t index) const;
+        /// @brief Access frame by the frame number it was recorded at. Returns an empty view if not present.
+        FrameView FindFrame(uint64_t frameNumber) const;
+
+      protected:
+        /// @brief Walks the chunk headers. A partially written trailing chunk is reported and dropped
+        bool RebuildIndex(const std::string& utf8path);
+
+        util::MappedFile                  mFile;
+        const format::FileHeader*         mHeader = nullptr;
+        std::vector<ChannelInfo>          mChannels;
+        std::vector<uint64_t>             mChannelOffsets;
+        /// @brief Frame header plus the data of all channels. Open() rejects index entries with less than this many bytes left in the file
+        uint64_t                          mMinChunkSize = 0;
+        std::vector<format::IndexEntry>   mIndex;
+    };
+
+}  // namespace denoise::capture
@@ -0,0 +1,202 @@
+#include "framecapture.hpp"
+#include "../util/formatinfo.hpp"
+
+namespace denoise::capture {
+
+    bool FrameCapture::Init(foray::core::Context* context, const std::vector<ChannelSource>& channels, const std::string& utf8path, uint32_t frameLimit, uint32_t slotCount)
+    {
+        mContext    = context;
+        mChannels   = channels;
+        mFrameLimit = frameLimit;
+
+        VkExtent3D extent = mChannels.front().Image->GetExtent3D();
+        mExtent           = VkExtent2D{.width = extent.width, .height = extent.height};
+
+        std::vector<ChannelInfo> infos;
+        VkDeviceSize             slotSize = 0;
+        for(const ChannelSource& channel : mChannels)
+        {
+            VkFormat format    = channel.Image->GetFormat();
+            uint32_t texelSize = util::GetTexelSize(format);
+            foray::Assert(texelSize > 0, "Capture: Unsupported channel image format");
+            infos.push_back(ChannelInfo{.Name = channel.Name, .Format = static_cast<uint32_t>(format), .TexelSize = texelSize});
+            mChannelOffsets.push_back(slotSize);
+            slotSize += format::Align((VkDeviceSize)mExtent.width * mExtent.height * texelSize);
+        }
+
+        if(!mWriter.Open(utf8path, mExtent.width, mExtent.height, infos))
+        {
+            return false;
+        }
+
+        for(uint32_t i = 0; i < slotCount; i++)
+        {
+            std::unique_ptr<Slot>                  slot = std::make_unique<Slot>();
+            foray::core::ManagedBuffer::CreateInfo ci(VK_BUFFER_USAGE_TRANSFER_DST_BIT, slotSize, VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                                      VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, fmt::format("Capture Readback #{}", i));
+            slot->Buffer.Create(mContext, ci);
+            void* mapped = nullptr;
+            slot->Buffer.Map(mapped);
+            slot->Mapped = reinterpret_cast<uint8_t*>(mapped);
+            mSlots.push_back(std::move(slot));
+        }
+
+        mStopWriter   = false;
+        mWriterThread = std::thread([this]() { this->WriterMain(); });
+        foray::logger()->info("Capture: Recording {} channels at {}x{} ({:.1f} MiB per frame) to \"{}\"", mChannels.size(), mExtent.width, mExtent.height,
+                              mWriter.GetChunkSize() / (1024.0 * 1024.0), utf8path);
+        return true;
+    }
+
+    void FrameCapture::RecordFrame(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo, const FrameMeta& meta)
+    {
+        if(!Exists() || IsComplete())
+        {
+            return;
+        }
+
+        VkExtent3D extent = mChannels.front().Image->GetExtent3D();
+        if(extent.width != mExtent.width || extent.height != mExtent.height)
+        {
+            if(!mExtentWarned)
+            {
+                foray::logger()->warn("Capture: Render targets were resized, frames are no longer captured");
+                mExtentWarned = true;
+            }
+            return;
+        }
+
+        Slot* slot = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for(std::unique_ptr<Slot>& candidate : mSlots)
+            {
+                if(candidate->State == ESlotState::Free)
+                {
+                    slot = candidate.get();
+                    break;
+                }
+            }
+            if(!slot)
+            {
+                mFramesDropped++;
+                return;
+            }
+            slot->State = ESlotState::Recorded;
+            slot->Meta  = meta;
+        }
+        mFramesRecorded++;
+
+        foray::core::ImageLayoutCache::Barrier2 barrier{.SrcStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                        .SrcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                                        .DstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                        .DstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                                                        .NewLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        for(size_t i = 0; i < mChannels.size(); i++)
+        {
+            foray::core::ManagedImage* image = mChannels[i].Image;
+            renderInfo.GetImageLayoutCache().CmdBarrier(cmdBuffer, image, barrier);
+
+            VkBufferImageCopy region{.bufferOffset      = mChannelOffsets[i],
+                                     .bufferRowLength   = 0,
+                                     .bufferImageHeight = 0,
+                                     .imageSubresource  = VkImageSubresourceLayers{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                                     .imageOffset       = VkOffset3D{},
+                                     .imageExtent       = VkExtent3D{.width = mExtent.width, .height = mExtent.height, .depth = 1}};
+            vkCmdCopyImageToBuffer(cmdBuffer, image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->Buffer.GetBuffer(), 1, &region);
+        }
+
+        // Make the transfer writes visible to the host once the frame fence is signaled
+        VkMemoryBarrier2 hostBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                     .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                     .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                     .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+                                     .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT};
+        VkDependencyInfo dependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &hostBarrier};
+        vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+    }
+
+    void FrameCapture::OnFrameFinished(uint64_t frameIndex)
+    {
+        if(!Exists())
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(std::unique_ptr<Slot>& slot : mSlots)
+        {
+            if(slot->State == ESlotState::Recorded && slot->Meta.FrameNumber == frameIndex)
+            {
+                slot->State = ESlotState::Writing;
+                mWriteQueue.push_back(slot.get());
+                mCondition.notify_one();
+                return;
+            }
+        }
+    }
+
+    void FrameCapture::WriterMain()
+    {
+        std::vector<const void*> channelData(mChannels.size());
+        while(true)
+        {
+            Slot* slot = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCondition.wait(lock, [this]() { return mStopWriter || mWriteQueue.size() > 0; });
+                if(mWriteQueue.empty())
+                {
+                    return;  // Stop requested and all pending frames written
+                }
+                slot = mWriteQueue.front();
+                mWriteQueue.pop_front();
+            }
+
+            // The frame fence has been waited on, but the readback memory is not necessarily host coherent
+            vmaInvalidateAllocation(mContext->Allocator, slot->Buffer.GetAllocation(), 0, VK_WHOLE_SIZE);
+
+            for(size_t i = 0; i < mChannels.size(); i++)
+            {
+                channelData[i] = slot->Mapped + mChannelOffsets[i];
+            }
+            if(mWriter.WriteFrame(slot->Meta, channelData))
+            {
+                mFramesWritten++;
+            }
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            slot->State = ESlotState::Free;
+        }
+    }
+
+    void FrameCapture::Destroy()
+    {
+        if(mWriterThread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStopWriter = true;
+            }
+            mCondition.notify_all();
+            mWriterThread.join();
+        }
+        if(mWriter.IsOpen())
+        {
+            foray::logger()->info("Capture: {} frames written, {} dropped", mFramesWritten.load(), mFramesDropped);
+            mWriter.Close();
+        }
+        for(std::unique_ptr<Slot>& slot : mSlots)
+        {
+            slot->Buffer.Unmap();
+            slot->Buffer.Destroy();
+        }
+        mSlots.clear();
+        mWriteQueue.clear();
+        mChannels.clear();
+        mChannelOffsets.clear();
+        mFramesRecorded = 0;
+        mFramesDropped  = 0;
+        mFramesWritten  = 0;
+    }
+
+}  // namespace denoise::capture
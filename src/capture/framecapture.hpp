@@ -0,0 +1,81 @@
+#pragma once
+
+#include "capturefile.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <foray_api.hpp>
+#include <mutex>
+#include <thread>
+
+namespace denoise::capture {
+
+    /// @brief Image recorded into a capture channel
+    struct ChannelSource
+    {
+        std::string                Name;
+        foray::core::ManagedImage* Image = nullptr;
+    };
+
+    /// @brief Records render target images into a capture file without stalling the renderer
+    /// @details Every captured frame copies all channel images into one slot of a pool of persistently mapped readback buffers.
+    /// Once the frame finished executing, the slot is handed to a writer thread, which appends it to the file and returns the slot to the pool.
+    /// If no slot is free (disk slower than rendering), the frame is dropped instead of stalling.
+    class FrameCapture
+    {
+      public:
+        /// @param frameLimit Number of frames to capture, 0 for unlimited
+        bool Init(foray::core::Context* context, const std::vector<ChannelSource>& channels, const std::string& utf8path, uint32_t frameLimit = 0, uint32_t slotCount = 4);
+
+        /// @brief Records the readback of all channel images. Call after all channel images have been written for the frame.
+        void RecordFrame(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo, const FrameMeta& meta);
+        /// @brief Hands the slot of a finished frame to the writer thread
+        void OnFrameFinished(uint64_t frameIndex);
+
+        /// @brief Waits for all pending frames to be written and finalizes the file
+        void Destroy();
+
+        inline bool     Exists() const { return mWriter.IsOpen(); }
+        inline bool     IsComplete() const { return mFrameLimit > 0 && mFramesRecorded >= mFrameLimit; }
+        inline uint64_t GetFramesWritten() const { return mFramesWritten.load(); }
+        inline uint64_t GetFramesDropped() const { return mFramesDropped; }
+
+      protected:
+        enum class ESlotState
+        {
+            Free,
+            Recorded,
+            Writing
+        };
+
+        struct Slot
+        {
+            foray::core::ManagedBuffer Buffer;
+            uint8_t*                   Mapped = nullptr;
+            ESlotState                 State  = ESlotState::Free;
+            FrameMeta                  Meta;
+        };
+
+        void WriterMain();
+
+        foray::core::Context*      mContext = nullptr;
+        std::vector<ChannelSource> mChannels;
+        std::vector<VkDeviceSize>  mChannelOffsets;
+        VkExtent2D                 mExtent{};
+        uint32_t                   mFrameLimit     = 0;
+        uint64_t                   mFramesRecorded = 0;
+        uint64_t                   mFramesDropped  = 0;
+        std::atomic<uint64_t>      mFramesWritten  = 0;
+        bool                       mExtentWarned   = false;
+
+        CaptureWriter                      mWriter;
+        std::vector<std::unique_ptr<Slot>> mSlots;
+
+        std::mutex              mMutex;
+        std::condition_variable mCondition;
+        std::deque<Slot*>       mWriteQueue;
+        bool                    mStopWriter = false;
+        std::thread             mWriterThread;
+    };
+
+}  // namespace denoise::capture
@@ -0,0 +1,289 @@
+#include "referencegenerator.hpp"
+#include "../cpu/exrio.hpp"
+#include "../metrics/imagemetrics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <set>
+#include <tinygltf/tiny_gltf.h>
+
+namespace denoise::capture {
+
+    std::vector<uint64_t> ReadGltfKeyframeIndices(const std::string& utf8path, double frameDelta, uint32_t stride)
+    {
+        tinygltf::Model    model;
+        tinygltf::TinyGLTF loader;
+        std::string        error;
+        std::string        warning;
+        bool               binary = std::filesystem::u8path(utf8path).extension() == ".glb";
+        bool loaded = binary ? loader.LoadBinaryFromFile(&model, &error, &warning, utf8path) : loader.LoadASCIIFromFile(&model, &error, &warning, utf8path);
+        if(!loaded)
+        {
+            foray::logger()->error("Reference: Failed to read keyframes from \"{}\": {}", utf8path, error);
+            return {};
+        }
+
+        std::set<uint64_t> indices;
+        for(const tinygltf::Animation& animation : model.animations)
+        {
+            for(const tinygltf::AnimationSampler& sampler : animation.samplers)
+            {
+                const tinygltf::Accessor& accessor = model.accessors[sampler.input];
+                if(accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || accessor.bufferView < 0)
+                {
+                    continue;
+                }
+                const tinygltf::BufferView& view       = model.bufferViews[accessor.bufferView];
+                const uint8_t*              data       = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+                int32_t                     byteStride = accessor.ByteStride(view);
+                for(size_t i = 0; i < accessor.count; i++)
+                {
+                    float time;
+                    std::memcpy(&time, data + i * byteStride, sizeof(time));
+                    indices.insert(static_cast<uint64_t>(std::llround(std::max(time, 0.f) / frameDelta)));
+                }
+            }
+        }
+
+        std::vector<uint64_t> result;
+        size_t                keyframe = 0;
+        for(uint64_t index : indices)
+        {
+            if(keyframe++ % std::max(stride, 1u) == 0)
+            {
+                result.push_back(index);
+            }
+        }
+        return result;
+    }
+
+    bool ReferenceGenerator::Slot::IsBusy() const
+    {
+        return Recorded || (Written.valid() && Written.wait_for(std::chrono::seconds(0)) != std::future_status::ready);
+    }
+
+    bool ReferenceGenerator::Init(foray::core::Context* context, ComplexRaytracingStage* stage, const ReferenceConfig& config, util::ThreadPool* threadPool)
+    {
+        if(config.SequenceIndices.empty())
+        {
+            foray::logger()->error("Reference: No frames to generate");
+            return false;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::u8path(config.OutputDir), error);
+        if(error)
+        {
+            foray::logger()->error("Reference: Unable to create \"{}\": {}", config.OutputDir, error.message());
+            return false;
+        }
+
+        mContext       = context;
+        mStage         = stage;
+        mThreadPool    = threadPool;
+        mConfig        = config;
+        mState         = EState::Advancing;
+        mScenesUpdated = 0;
+        mNextReference = 0;
+        for(uint32_t i = 0; i < 2; i++)
+        {
+            mSlots.push_back(std::make_unique<Slot>());
+        }
+        foray::logger()->info("Reference: Generating {} frames (up to {} spp, error threshold {}) into \"{}\"", mConfig.SequenceIndices.size(), mConfig.MaxSamples,
+                              mConfig.Accumulation.ErrorThreshold, mConfig.OutputDir);
+        return true;
+    }
+
+    bool ReferenceGenerator::BeginFrame()
+    {
+        switch(mState)
+        {
+            case EState::Advancing: {
+                mSequenceIndex = mScenesUpdated++;
+                while(mNextReference < mConfig.SequenceIndices.size() && mConfig.SequenceIndices[mNextReference] < mSequenceIndex)
+                {
+                    mNextReference++;  // Indices already passed (unsorted input)
+                }
+                if(mNextReference >= mConfig.SequenceIndices.size())
+                {
+                    mState = EState::Finished;
+                }
+                else if(mConfig.SequenceIndices[mNextReference] == mSequenceIndex)
+                {
+                    // The scene is updated to the requested state this frame, which also traces the first sample
+                    mStage->BeginAccumulation(mConfig.Accumulation);
+                    mAccumulationStart = std::chrono::steady_clock::now();
+                    mState             = EState::Accumulating;
+                }
+                return true;
+            }
+            case EState::Accumulating: {
+                VkExtent3D extent     = mStage->GetAccumulationMean()->GetExtent3D();
+                uint64_t   pixelCount = (uint64_t)extent.width * extent.height;
+                uint32_t   samples    = mStage->GetAccumulatedSamples();
+                // The counter is reset by the first sample's frame, older values belong to the previous reference
+                uint32_t converged = samples > foray::INFLIGHT_FRAME_COUNT ? mStage->GetConvergedPixelCount() : 0;
+                if(samples >= mConfig.MaxSamples || converged >= pixelCount)
+                {
+                    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mAccumulationStart).count();
+                    foray::logger()->info("Reference {}/{}: frame {}, {} spp, {:.1f}% converged early, {:.1f} s", mNextReference + 1, mConfig.SequenceIndices.size(),
+                                          mSequenceIndex, samples, 100.0 * converged / pixelCount, seconds);
+                    mStage->EndAccumulation();
+                    mState = EState::ReadbackRequested;
+                }
+                return false;
+            }
+            case EState::ReadbackRequested:
+                return false;
+            case EState::Finished:
+            default:
+                return true;
+        }
+    }
+
+    ReferenceGenerator::Slot* ReferenceGenerator::FindFreeSlot()
+    {
+        for(std::unique_ptr<Slot>& slot : mSlots)
+        {
+            if(!slot->IsBusy())
+            {
+                return slot.get();
+            }
+        }
+        return nullptr;
+    }
+
+    void ReferenceGenerator::RecordFrame(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo)
+    {
+        if(mState != EState::ReadbackRequested)
+        {
+            return;
+        }
+        Slot* slot = FindFreeSlot();
+        if(!slot)
+        {
+            return;  // Previous references are still being written, the scene stays frozen
+        }
+
+        foray::core::ManagedImage* image  = mStage->GetAccumulationMean();
+        VkExtent3D                 extent = image->GetExtent3D();
+        VkDeviceSize               size   = (VkDeviceSize)extent.width * extent.height * 4 * sizeof(float);
+        if(slot->Extent.width != extent.width || slot->Extent.height != extent.height)
+        {
+            if(!!slot->Mapped)
+            {
+                slot->Buffer.Unmap();
+                slot->Buffer.Destroy();
+                slot->Mapped = nullptr;
+            }
+            foray::core::ManagedBuffer::CreateInfo ci(VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                                      VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, "Reference Readback");
+            slot->Buffer.Create(mContext, ci);
+            void* mapped = nullptr;
+            slot->Buffer.Map(mapped);
+            slot->Mapped = reinterpret_cast<const float*>(mapped);
+            slot->Extent = VkExtent2D{.width = extent.width, .height = extent.height};
+        }
+        slot->SequenceIndex = mSequenceIndex;
+        slot->FrameNumber   = renderInfo.GetFrameNumber();
+        slot->Recorded      = true;
+
+        foray::core::ImageLayoutCache::Barrier2 barrier{.SrcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                                        .SrcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                                        .DstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                        .DstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                                                        .NewLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        renderInfo.GetImageLayoutCache().CmdBarrier(cmdBuffer, image, barrier);
+
+        VkBufferImageCopy region{.bufferOffset      = 0,
+                                 .bufferRowLength   = 0,
+                                 .bufferImageHeight = 0,
+                                 .imageSubresource  = VkImageSubresourceLayers{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                                 .imageOffset       = VkOffset3D{},
+                                 .imageExtent       = VkExtent3D{.width = extent.width, .height = extent.height, .depth = 1}};
+        vkCmdCopyImageToBuffer(cmdBuffer, image->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->Buffer.GetBuffer(), 1, &region);
+
+        VkMemoryBarrier2 hostBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                     .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                     .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                     .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+                                     .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT};
+        VkDependencyInfo dependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &hostBarrier};
+        vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+
+        mNextReference++;
+        mState = mNextReference < mConfig.SequenceIndices.size() ? EState::Advancing : EState::Finished;
+    }
+
+    void ReferenceGenerator::OnFrameFinished(uint64_t frameIndex)
+    {
+        for(std::unique_ptr<Slot>& slotPtr : mSlots)
+        {
+            Slot* slot = slotPtr.get();
+            if(!slot->Recorded || slot->FrameNumber != frameIndex)
+            {
+                continue;
+            }
+            slot->Recorded = false;
+            // Invalidated here, before the pool thread reads it, since the readback memory may not be host coherent
+            vmaInvalidateAllocation(mContext->Allocator, slot->Buffer.GetAllocation(), 0, VK_WHOLE_SIZE);
+
+            std::shared_ptr<std::promise<bool>> promise = std::make_shared<std::promise<bool>>();
+            slot->Written                               = promise->get_future();
+            std::string path                            = metrics::GetReferenceFramePath(mConfig.OutputDir, slot->SequenceIndex);
+            mThreadPool->Submit([promise, slot, path]() {
+                slot->Image.Resize(slot->Extent.width, slot->Extent.height);
+                std::memcpy(slot->Image.Texels.data(), slot->Mapped, slot->Image.Texels.size() * sizeof(float));
+                for(size_t i = 3; i < slot->Image.Texels.size(); i += 4)
+                {
+                    slot->Image.Texels[i] = 1.f;  // Alpha holds the sample count
+                }
+                bool written = cpu::SaveExr(path, slot->Image, false);
+                if(!written)
+                {
+                    foray::logger()->error("Reference: Writing \"{}\" failed", path);
+                }
+                promise->set_value(written);
+            });
+        }
+    }
+
+    bool ReferenceGenerator::IsFinished() const
+    {
+        if(mState != EState::Finished)
+        {
+            return false;
+        }
+        for(const std::unique_ptr<Slot>& slot : mSlots)
+        {
+            if(slot->IsBusy())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ReferenceGenerator::Destroy()
+    {
+        for(std::unique_ptr<Slot>& slot : mSlots)
+        {
+            if(slot->Written.valid())
+            {
+                slot->Written.wait();
+            }
+            if(!!slot->Mapped)
+            {
+                slot->Buffer.Unmap();
+                slot->Buffer.Destroy();
+            }
+        }
+        mSlots.clear();
+        if(!!mStage)
+        {
+            mStage->EndAccumulation();
+        }
+        mStage = nullptr;
+    }
+
+}  // namespace denoise::capture
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "../cpu/cpuimage.hpp"
+#include "../foray_rtstage.hpp"
+#include "../util/threadpool.hpp"
+#include <chrono>
+#include <foray_api.hpp>
+#include <future>
+#include <memory>
+
+namespace denoise::capture {
+
+    struct ReferenceConfig
+    {
+        /// @brief References are written as <OutputDir>/<sequence index:06>.exr (see metrics::GetReferenceFramePath())
+        std::string OutputDir;
+        /// @brief Sequence indices (scene updates since start) a reference is generated for, ascending
+        std::vector<uint64_t> SequenceIndices;
+        /// @brief Accumulation of a reference ends after this many samples, or once all pixels converged
+        uint32_t           MaxSamples = 4096;
+        AccumulationConfig Accumulation;
+    };
+
+    /// @brief Reads the keyframe times of all animations in a glTF file and converts them to sequence indices (time / frameDelta)
+    /// @param stride Only every stride-th keyframe is returned
+    std::vector<uint64_t> ReadGltfKeyframeIndices(const std::string& utf8path, double frameDelta, uint32_t stride = 1);
+
+    /// @brief Generates ground truth references by progressive accumulation in the ComplexRaytracingStage
+    /// @details The scene advances normally until the next requested sequence index is reached. From there, the scene is frozen and every frame adds
+    /// one sample per pixel to the stage's accumulation images, until the sample budget is spent or all pixels converged. The accumulated mean is then
+    /// read back once and written as 32 bit EXR on the thread pool, while the scene advances to the next index.
+    class ReferenceGenerator
+    {
+      public:
+        bool Init(foray::core::Context* context, ComplexRaytracingStage* stage, const ReferenceConfig& config, util::ThreadPool* threadPool = &util::ThreadPool::Shared());
+
+        /// @brief Advances the generator at the beginning of a frame
+        /// @return False if the scene must not be updated this frame (accumulation in progress)
+        bool BeginFrame();
+        /// @brief Records the readback of a completed accumulation. Call after the raytracing stage recorded the frame.
+        void RecordFrame(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo);
+        /// @brief Hands the readback of a finished frame to the thread pool for writing
+        void OnFrameFinished(uint64_t frameIndex);
+
+        /// @brief Waits for pending writes
+        void Destroy();
+
+        inline bool Exists() const { return !!mStage; }
+        /// @brief True once all references were accumulated and written
+        bool        IsFinished() const;
+        inline size_t GetReferencesCompleted() const { return mNextReference; }
+        inline size_t GetReferenceCount() const { return mConfig.SequenceIndices.size(); }
+        inline uint64_t GetSequenceIndex() const { return mSequenceIndex; }
+
+      protected:
+        enum class EState
+        {
+            /// @brief Scene advances until the next sequence index
+            Advancing,
+            Accumulating,
+            /// @brief Accumulation done, waiting for a free readback slot
+            ReadbackRequested,
+            Finished
+        };
+
+        struct Slot
+        {
+            foray::core::ManagedBuffer Buffer;
+            const float*               Mapped = nullptr;
+            VkExtent2D                 Extent{};
+            uint64_t                   SequenceIndex = 0;
+            uint64_t                   FrameNumber   = 0;
+            bool                       Recorded      = false;
+            cpu::CpuImage              Image;
+            std::future<bool>          Written;
+
+            bool IsBusy() const;
+        };
+
+        Slot* FindFreeSlot();
+
+        foray::core::Context*   mContext    = nullptr;
+        ComplexRaytracingStage* mStage      = nullptr;
+        util::ThreadPool*       mThreadPool = nullptr;
+        ReferenceConfig         mConfig;
+
+        EState   mState         = EState::Advancing;
+        uint64_t mSequenceIndex = 0;
+        uint64_t mScenesUpdated = 0;
+        size_t   mNextReference = 0;
+
+        std::chrono::steady_clock::time_point mAccumulationStart;
+
+        std::vector<std::unique_ptr<Slot>> mSlots;
+    };
+
+}  // namespace denoise::capture
@@ -0,0 +1,142 @@
+#include "batchpipeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace denoise::cpu {
+
+    bool BatchPipeline::Run(uint64_t frameCount, const LoadFunc& load, const DenoiseFunc& denoise, const StoreFunc& store)
+    {
+        using clock = std::chrono::steady_clock;
+
+        const uint32_t depth = std::max(mConfig.Depth, 1u);
+        mInputStallSeconds   = 0.0;
+        mOutputStallSeconds  = 0.0;
+
+        struct OutputSlot
+        {
+            CpuImage Image;
+            uint64_t FrameNumber = 0;
+            /// @brief Frame index + 1 waiting for a writer, 0 if none
+            uint64_t Pending = 0;
+            /// @brief Holds a frame that is not written yet
+            bool Busy = false;
+        };
+
+        // Frame i always occupies slot i % depth. All state below is guarded by mutex, the slot contents by the state
+        std::vector<CpuFrame>   inputs(depth);
+        std::vector<OutputSlot> outputs(depth);
+        // Frame index + 1 that finished decoding into the slot, 0 if none
+        std::vector<uint64_t>   loaded(depth, 0);
+        std::mutex              mutex;
+        std::condition_variable changed;
+        uint64_t                nextLoad    = 0;
+        uint64_t                consumed    = 0;
+        bool                    denoiseDone = false;
+        bool                    failed      = false;
+
+        auto readerMain = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true)
+            {
+                changed.wait(lock, [&]() { return failed || nextLoad >= frameCount || nextLoad < consumed + depth; });
+                if(failed || nextLoad >= frameCount)
+                {
+                    return;
+                }
+                uint64_t index = nextLoad++;
+                lock.unlock();
+                bool ok = load(index, inputs[index % depth]);
+                lock.lock();
+                failed |= !ok;
+                loaded[index % depth] = index + 1;
+                changed.notify_all();
+            }
+        };
+
+        auto writerMain = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true)
+            {
+                OutputSlot* slot = nullptr;
+                changed.wait(lock, [&]() {
+                    slot = nullptr;
+                    for(OutputSlot& candidate : outputs)
+                    {
+                        if(candidate.Pending > 0 && (!slot || candidate.Pending < slot->Pending))
+                        {
+                            slot = &candidate;
+                        }
+                    }
+                    return failed || !!slot || denoiseDone;
+                });
+                if(failed || !slot)
+                {
+                    return;
+                }
+                uint64_t index = slot->Pending - 1;
+                slot->Pending  = 0;
+                lock.unlock();
+                bool ok = !store || store(index, slot->FrameNumber, slot->Image);
+                lock.lock();
+                failed |= !ok;
+                slot->Busy = false;
+                changed.notify_all();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(uint32_t i = 0; i < std::max(mConfig.ReaderThreads, 1u); i++)
+        {
+            threads.emplace_back(readerMain);
+        }
+        for(uint32_t i = 0; i < std::max(mConfig.WriterThreads, 1u); i++)
+        {
+            threads.emplace_back(writerMain);
+        }
+
+        for(uint64_t index = 0; index < frameCount; index++)
+        {
+            CpuFrame&   input  = inputs[index % depth];
+            OutputSlot& output = outputs[index % depth];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                auto                         start = clock::now();
+                changed.wait(lock, [&]() { return failed || loaded[index % depth] == index + 1; });
+                auto inputReady = clock::now();
+                changed.wait(lock, [&]() { return failed || !output.Busy; });
+                mInputStallSeconds += std::chrono::duration<double>(inputReady - start).count();
+                mOutputStallSeconds += std::chrono::duration<double>(clock::now() - inputReady).count();
+                if(failed)
+                {
+                    break;
+                }
+            }
+
+            denoise(index, input, output.Image);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            output.FrameNumber    = input.FrameNumber;
+            output.Pending        = index + 1;
+            output.Busy           = true;
+            loaded[index % depth] = 0;
+            consumed              = index + 1;
+            changed.notify_all();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            denoiseDone = true;
+            changed.notify_all();
+        }
+        for(std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        return !failed;
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "cpuimage.hpp"
+#include <functional>
+
+namespace denoise::cpu {
+
+    /// @brief Bounded decode -> denoise -> encode pipeline over a frame sequence
+    /// @details Reader threads decode frames ahead into a ring of input slots, the calling thread denoises them in sequence order into a ring of output
+    /// slots, and writer threads encode the results behind it. A stage blocks while the ring in front of it is full, so memory stays at Depth input
+    /// frames plus Depth output images no matter how long the sequence is.
+    class BatchPipeline
+    {
+      public:
+        struct Config
+        {
+            /// @brief Frames decoded ahead of (and encoded behind) the denoiser
+            uint32_t Depth         = 4;
+            uint32_t ReaderThreads = 2;
+            uint32_t WriterThreads = 2;
+        };
+
+        /// @brief Decodes frame index into frame. Called concurrently for different frames
+        using LoadFunc = std::function<bool(uint64_t index, CpuFrame& frame)>;
+        /// @brief Denoises frame index into output. Called in sequence order on the calling thread
+        using DenoiseFunc = std::function<void(uint64_t index, const CpuFrame& frame, CpuImage& output)>;
+        /// @brief Encodes the output of frame index. Called concurrently for different frames
+        using StoreFunc = std::function<bool(uint64_t index, uint64_t frameNumber, const CpuImage& output)>;
+
+        explicit BatchPipeline(const Config& config) : mConfig(config) {}
+
+        /// @brief Runs all stages over frames [0, frameCount) and returns once the last frame is stored
+        /// @param store May be empty, outputs are discarded then
+        /// @return False if a frame failed to load or store, the pipeline stops at the first failure
+        bool Run(uint64_t frameCount, const LoadFunc& load, const DenoiseFunc& denoise, const StoreFunc& store);
+
+        /// @brief Time the denoiser waited for decoded frames in the last Run() (the readers are the bottleneck if this is large)
+        inline double GetInputStallSeconds() const { return mInputStallSeconds; }
+        /// @brief Time the denoiser waited for free output slots in the last Run() (the writers are the bottleneck if this is large)
+        inline double GetOutputStallSeconds() const { return mOutputStallSeconds; }
+
+      protected:
+        Config mConfig;
+        double mInputStallSeconds  = 0.0;
+        double mOutputStallSeconds = 0.0;
+    };
+
+}  // namespace denoise::cpu
@@ -0,0 +1,381 @@
+#include "bvh4.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <foray_logger.hpp>
+
+namespace denoise::cpu {
+
+#pragma region Binary SAH build
+
+    /// @brief Bins per axis evaluated for a split
+    const uint32_t SAH_BIN_COUNT = 16;
+    /// @brief Ranges at or below this size always become leaves, above MAX_LEAF_SIZE they are always split
+    const uint32_t MIN_LEAF_SIZE = 2;
+    const uint32_t MAX_LEAF_SIZE = 8;
+    /// @brief Cost of a box test relative to a triangle test
+    const float TRAVERSAL_COST = 1.f;
+
+    struct BuildBounds
+    {
+        Vec3 Min{1e30f, 1e30f, 1e30f};
+        Vec3 Max{-1e30f, -1e30f, -1e30f};
+
+        inline void Grow(const Vec3& point)
+        {
+            Min = cpu::Min(Min, point);
+            Max = cpu::Max(Max, point);
+        }
+        inline void Grow(const BuildBounds& other)
+        {
+            Min = cpu::Min(Min, other.Min);
+            Max = cpu::Max(Max, other.Max);
+        }
+        inline float HalfArea() const
+        {
+            if(Min.x > Max.x)
+            {
+                return 0.f;
+            }
+            Vec3 extent = Max - Min;
+            return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+        }
+    };
+
+    struct BinaryNode
+    {
+        BuildBounds Bounds;
+        uint32_t    Left  = UINT32_MAX;
+        uint32_t    Right = UINT32_MAX;
+        /// @brief Triangle range of leaves (Count > 0)
+        uint32_t First = 0;
+        uint32_t Count = 0;
+    };
+
+    struct BuildTriangle
+    {
+        BuildBounds Bounds;
+        Vec3        Centroid;
+    };
+
+    /// @brief Splits [first, first + count) of order. Returns the size of the left half, 0 if the range should become a leaf
+    uint32_t lSplitSah(const std::vector<BuildTriangle>& triangles, std::vector<uint32_t>& order, uint32_t first, uint32_t count, const BuildBounds& bounds)
+    {
+        if(count <= MIN_LEAF_SIZE)
+        {
+            return 0;
+        }
+        BuildBounds centroidBounds;
+        for(uint32_t i = first; i < first + count; i++)
+        {
+            centroidBounds.Grow(triangles[order[i]].Centroid);
+        }
+
+        float    bestCost  = std::numeric_limits<float>::infinity();
+        int      bestAxis  = -1;
+        uint32_t bestSplit = 0;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            float extent = centroidBounds.Max[axis] - centroidBounds.Min[axis];
+            if(extent <= 0.f)
+            {
+                continue;
+            }
+            BuildBounds binBounds[SAH_BIN_COUNT];
+            uint32_t    binCounts[SAH_BIN_COUNT] = {};
+            float       scale                    = SAH_BIN_COUNT / extent;
+            for(uint32_t i = first; i < first + count; i++)
+            {
+                const BuildTriangle& triangle = triangles[order[i]];
+                uint32_t             bin      = std::min(SAH_BIN_COUNT - 1, static_cast<uint32_t>((triangle.Centroid[axis] - centroidBounds.Min[axis]) * scale));
+                binBounds[bin].Grow(triangle.Bounds);
+                binCounts[bin]++;
+            }
+            // Sweep from the right to get the cost of every split plane
+            float       rightAreas[SAH_BIN_COUNT];
+            uint32_t    rightCounts[SAH_BIN_COUNT];
+            BuildBounds accumulated;
+            uint32_t    accumulatedCount = 0;
+            for(uint32_t bin = SAH_BIN_COUNT - 1; bin > 0; bin--)
+            {
+                accumulated.Grow(binBounds[bin]);
+                accumulatedCount += binCounts[bin];
+                rightAreas[bin]  = accumulated.HalfArea();
+                rightCounts[bin] = accumulatedCount;
+            }
+            accumulated      = BuildBounds();
+            accumulatedCount = 0;
+            for(uint32_t split = 1; split < SAH_BIN_COUNT; split++)
+            {
+                accumulated.Grow(binBounds[split - 1]);
+                accumulatedCount += binCounts[split - 1];
+                float cost = accumulated.HalfArea() * accumulatedCount + rightAreas[split] * rightCounts[split];
+                if(accumulatedCount > 0 && rightCounts[split] > 0 && cost < bestCost)
+                {
+                    bestCost  = cost;
+                    bestAxis  = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        float leafCost = static_cast<float>(count);
+        float area     = bounds.HalfArea();
+        if(bestAxis < 0 || (count <= MAX_LEAF_SIZE && area > 0.f && TRAVERSAL_COST + bestCost / area >= leafCost))
+        {
+            if(count <= MAX_LEAF_SIZE)
+            {
+                return 0;
+            }
+            return count / 2;  // Coincident centroids, split by order to bound the leaf size
+        }
+
+        float scale  = SAH_BIN_COUNT / (centroidBounds.Max[bestAxis] - centroidBounds.Min[bestAxis]);
+        auto  middle = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t index) {
+            return std::min(SAH_BIN_COUNT - 1, static_cast<uint32_t>((triangles[index].Centroid[bestAxis] - centroidBounds.Min[bestAxis]) * scale)) < bestSplit;
+        });
+        return static_cast<uint32_t>(middle - (order.begin() + first));
+    }
+
+#pragma endregion
+#pragma region Build
+
+    void Bvh4::Build(const CpuScene& scene)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        const std::vector<Vec3>&        positions = scene.GetPositions();
+        const std::vector<CpuTriangle>& source    = scene.GetTriangles();
+        mNodes.clear();
+        mTriangles.clear();
+        mParents.clear();
+        if(source.empty())
+        {
+            return;
+        }
+
+        std::vector<BuildTriangle> triangles(source.size());
+        std::vector<uint32_t>      order(source.size());
+        for(uint32_t i = 0; i < source.size(); i++)
+        {
+            for(uint32_t vertex : source[i].Vertices)
+            {
+                triangles[i].Bounds.Grow(positions[vertex]);
+            }
+            triangles[i].Centroid = (triangles[i].Bounds.Min + triangles[i].Bounds.Max) * 0.5f;
+            order[i]              = i;
+        }
+
+        // Binary tree, built depth first with an explicit stack
+        std::vector<BinaryNode> binary;
+        binary.reserve(source.size() * 2 / MIN_LEAF_SIZE + 1);
+        binary.emplace_back();
+        binary[0].First = 0;
+        binary[0].Count = static_cast<uint32_t>(source.size());
+        std::vector<uint32_t> pending{0};
+        while(!pending.empty())
+        {
+            uint32_t index = pending.back();
+            pending.pop_back();
+            BuildBounds bounds;
+            for(uint32_t i = binary[index].First; i < binary[index].First + binary[index].Count; i++)
+            {
+                bounds.Grow(triangles[order[i]].Bounds);
+            }
+            binary[index].Bounds = bounds;
+
+            uint32_t first = binary[index].First;
+            uint32_t count = binary[index].Count;
+            uint32_t left  = lSplitSah(triangles, order, first, count, bounds);
+            if(left == 0 || left == count)
+            {
+                continue;
+            }
+            uint32_t leftIndex  = static_cast<uint32_t>(binary.size());
+            uint32_t rightIndex = leftIndex + 1;
+            binary.emplace_back().First = first;
+            binary[leftIndex].Count     = left;
+            binary.emplace_back().First = first + left;
+            binary[rightIndex].Count    = count - left;
+            binary[index].Left          = leftIndex;
+            binary[index].Right         = rightIndex;
+            binary[index].Count         = 0;
+            pending.push_back(rightIndex);
+            pending.push_back(leftIndex);
+        }
+
+        // Leaf triangles in tree order
+        mTriangles.resize(source.size());
+        mLeafIndices.resize(source.size());
+        mLeafNodes.resize(source.size());
+        for(uint32_t i = 0; i < source.size(); i++)
+        {
+            const CpuTriangle& triangle = source[order[i]];
+            Vec3               v0       = positions[triangle.Vertices[0]];
+            mTriangles[i] = LeafTriangle{.V0 = v0, .E1 = positions[triangle.Vertices[1]] - v0, .E2 = positions[triangle.Vertices[2]] - v0, .Index = order[i]};
+            mLeafIndices[order[i]] = i;
+        }
+
+        // Collapse into 4-wide nodes: open the child with the largest surface area until four children exist
+        struct Collapse
+        {
+            uint32_t Binary;
+            uint32_t Node;
+        };
+        mNodes.emplace_back();
+        mParents.push_back(UINT32_MAX);
+        std::vector<Collapse> collapse{{0, 0}};
+        while(!collapse.empty())
+        {
+            Collapse item = collapse.back();
+            collapse.pop_back();
+
+            uint32_t children[4];
+            uint32_t childCount = 0;
+            if(binary[item.Binary].Count > 0)
+            {
+                children[childCount++] = item.Binary;  // Leaf root
+            }
+            else
+            {
+                children[childCount++] = binary[item.Binary].Left;
+                children[childCount++] = binary[item.Binary].Right;
+            }
+            while(childCount < 4)
+            {
+                int32_t largest     = -1;
+                float   largestArea = -1.f;
+                for(uint32_t i = 0; i < childCount; i++)
+                {
+                    const BinaryNode& child = binary[children[i]];
+                    if(child.Count == 0 && child.Bounds.HalfArea() > largestArea)
+                    {
+                        largest     = static_cast<int32_t>(i);
+                        largestArea = child.Bounds.HalfArea();
+                    }
+                }
+                if(largest < 0)
+                {
+                    break;
+                }
+                const BinaryNode& opened = binary[children[largest]];
+                children[largest]        = opened.Left;
+                children[childCount++]   = opened.Right;
+            }
+
+            for(uint32_t slot = 0; slot < 4; slot++)
+            {
+                Node& node = mNodes[item.Node];
+                if(slot >= childCount)
+                {
+                    node.MinX[slot] = node.MinY[slot] = node.MinZ[slot] = std::numeric_limits<float>::infinity();
+                    node.MaxX[slot] = node.MaxY[slot] = node.MaxZ[slot] = -std::numeric_limits<float>::infinity();
+                    node.Child[slot] = 0;
+                    node.Count[slot] = 0;
+                    continue;
+                }
+                const BinaryNode& child = binary[children[slot]];
+                node.MinX[slot]         = child.Bounds.Min.x;
+                node.MinY[slot]         = child.Bounds.Min.y;
+                node.MinZ[slot]         = child.Bounds.Min.z;
+                node.MaxX[slot]         = child.Bounds.Max.x;
+                node.MaxY[slot]         = child.Bounds.Max.y;
+                node.MaxZ[slot]         = child.Bounds.Max.z;
+                if(child.Count > 0)
+                {
+                    node.Child[slot] = child.First;
+                    node.Count[slot] = child.Count;
+                    std::fill_n(mLeafNodes.begin() + child.First, child.Count, item.Node);
+                }
+                else
+                {
+                    uint32_t nodeIndex = static_cast<uint32_t>(mNodes.size());
+                    node.Child[slot]   = nodeIndex;
+                    node.Count[slot]   = 0;
+                    collapse.push_back(Collapse{children[slot], nodeIndex});
+                    mNodes.emplace_back();  // Invalidates node, which is looked up again per slot
+                    mParents.push_back(item.Node);
+                }
+            }
+        }
+
+        mRefitQueued.assign(mNodes.size(), false);
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        foray::logger()->info("Bvh4: {} triangles, {} nodes, built in {:.1f} ms", mTriangles.size(), mNodes.size(), milliseconds);
+    }
+
+#pragma endregion
+#pragma region Refit
+
+    void Bvh4::Refit(const CpuScene& scene)
+    {
+        const std::vector<Vec3>&        positions = scene.GetPositions();
+        const std::vector<CpuTriangle>& source    = scene.GetTriangles();
+
+        // Update the moved triangles and queue the nodes above them
+        std::vector<uint32_t> queued;
+        for(uint32_t instanceIndex : scene.GetDirtyInstances())
+        {
+            const CpuInstance& instance = scene.GetInstances()[instanceIndex];
+            for(uint32_t index = instance.FirstTriangle; index < instance.FirstTriangle + instance.TriangleCount; index++)
+            {
+                const CpuTriangle& triangle = source[index];
+                LeafTriangle&      leaf     = mTriangles[mLeafIndices[index]];
+                leaf.V0                     = positions[triangle.Vertices[0]];
+                leaf.E1                     = positions[triangle.Vertices[1]] - leaf.V0;
+                leaf.E2                     = positions[triangle.Vertices[2]] - leaf.V0;
+                for(uint32_t node = mLeafNodes[mLeafIndices[index]]; node != UINT32_MAX && !mRefitQueued[node]; node = mParents[node])
+                {
+                    mRefitQueued[node] = true;
+                    queued.push_back(node);
+                }
+            }
+        }
+
+        // Children always have larger indices than their parent, so refitting in descending order visits every node after its children
+        std::sort(queued.begin(), queued.end(), std::greater<uint32_t>());
+        for(uint32_t index : queued)
+        {
+            Node& node = mNodes[index];
+            for(uint32_t slot = 0; slot < 4; slot++)
+            {
+                BuildBounds bounds;
+                if(node.Count[slot] > 0)
+                {
+                    for(uint32_t i = node.Child[slot]; i < node.Child[slot] + node.Count[slot]; i++)
+                    {
+                        const LeafTriangle& triangle = mTriangles[i];
+                        bounds.Grow(triangle.V0);
+                        bounds.Grow(triangle.V0 + triangle.E1);
+                        bounds.Grow(triangle.V0 + triangle.E2);
+                    }
+                }
+                else if(node.Child[slot] != 0)
+                {
+                    const Node& child = mNodes[node.Child[slot]];
+                    for(uint32_t childSlot = 0; childSlot < 4; childSlot++)
+                    {
+                        // Empty slots of the child have inverted boxes and do not grow the bounds
+                        bounds.Grow(BuildBounds{Vec3{child.MinX[childSlot], child.MinY[childSlot], child.MinZ[childSlot]},
+                                                Vec3{child.MaxX[childSlot], child.MaxY[childSlot], child.MaxZ[childSlot]}});
+                    }
+                }
+                else
+                {
+                    continue;  // Empty slot
+                }
+                node.MinX[slot] = bounds.Min.x;
+                node.MinY[slot] = bounds.Min.y;
+                node.MinZ[slot] = bounds.Min.z;
+                node.MaxX[slot] = bounds.Max.x;
+                node.MaxY[slot] = bounds.Max.y;
+                node.MaxZ[slot] = bounds.Max.z;
+            }
+            mRefitQueued[index] = false;
+        }
+    }
+
+#pragma endregion
+
+}  // namespace denoise::cpu
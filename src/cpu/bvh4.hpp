@@ -0,0 +1,271 @@
+#pragma once
+
+#include "cpuscene.hpp"
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DENOISE_BVH_SSE2 1
+#endif
+
+namespace denoise::cpu {
+
+    struct CpuRay
+    {
+        Vec3  Origin;
+        Vec3  Direction;
+        float TMin = 0.001f;
+        float TMax = std::numeric_limits<float>::infinity();
+    };
+
+    struct CpuHit
+    {
+        float T = std::numeric_limits<float>::infinity();
+        /// @brief Barycentric coordinates of vertices 1 and 2 (hitAttributeEXT)
+        float U = 0.f;
+        float V = 0.f;
+        /// @brief Index into CpuScene::GetTriangles(), UINT32_MAX on miss
+        uint32_t Triangle = UINT32_MAX;
+    };
+
+    /// @brief 4-wide bounding volume hierarchy over the triangles of a CpuScene
+    /// @details Built as a binary binned SAH tree, then collapsed so every node tests the boxes of up to four children at once (SSE2 if available).
+    /// Refit() follows moved instances without a rebuild: only their triangles and the nodes above them are updated, the topology is kept.
+    /// Queries take an any-hit filter (bool(uint32_t triangle, float u, float v), false ignores the intersection) in the role of the any-hit shaders.
+    class Bvh4
+    {
+      public:
+        void Build(const CpuScene& scene);
+        /// @brief Updates the triangles of CpuScene::GetDirtyInstances() and the bounds of all nodes containing them
+        void Refit(const CpuScene& scene);
+
+        /// @brief Finds the closest accepted intersection within [ray.TMin, ray.TMax]
+        template <typename TFilter>
+        bool Intersect(const CpuRay& ray, CpuHit& hit, TFilter&& filter) const;
+        /// @brief Returns true if any accepted intersection exists within [ray.TMin, ray.TMax] (gl_RayFlagsTerminateOnFirstHitEXT)
+        template <typename TFilter>
+        bool Occluded(const CpuRay& ray, TFilter&& filter) const;
+
+        inline size_t GetNodeCount() const { return mNodes.size(); }
+
+      protected:
+        /// @brief Structure of arrays layout of four child boxes. Count > 0 marks a leaf (Child is the first triangle), empty slots have inverted boxes
+        struct alignas(64) Node
+        {
+            float    MinX[4];
+            float    MinY[4];
+            float    MinZ[4];
+            float    MaxX[4];
+            float    MaxY[4];
+            float    MaxZ[4];
+            uint32_t Child[4];
+            uint32_t Count[4];
+        };
+
+        /// @brief Triangle in leaf order, with edges precomputed for Moeller-Trumbore
+        struct LeafTriangle
+        {
+            Vec3     V0;
+            Vec3     E1;
+            Vec3     E2;
+            uint32_t Index = 0;
+        };
+
+        struct RayData
+        {
+            float Origin[3];
+            float InvDir[3];
+            bool  Negative[3];
+        };
+
+        static RayData PrepareRay(const CpuRay& ray);
+        /// @brief Slab test of the four child boxes. Writes entry distances and returns a mask of hit children
+        static uint32_t IntersectNode(const Node& node, const RayData& ray, float tMin, float tMax, float distances[4]);
+        static bool     IntersectTriangle(const LeafTriangle& triangle, const CpuRay& ray, float tMax, float& t, float& u, float& v);
+
+        template <bool TAnyHit, typename TFilter>
+        bool Traverse(const CpuRay& ray, CpuHit& hit, TFilter& filter) const;
+
+        std::vector<Node>         mNodes;
+        std::vector<LeafTriangle> mTriangles;
+        /// @brief Refit lookups: leaf position of every scene triangle, node referencing every leaf position, parent of every node
+        std::vector<uint32_t> mLeafIndices;
+        std::vector<uint32_t> mLeafNodes;
+        std::vector<uint32_t> mParents;
+        /// @brief Nodes queued by Refit()
+        std::vector<bool> mRefitQueued;
+    };
+
+    // Traversal is inlined into the callers, so the filter compiles into the loop
+
+    inline Bvh4::RayData Bvh4::PrepareRay(const CpuRay& ray)
+    {
+        RayData data;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            // Finite reciprocals keep axis parallel rays free of 0 * inf
+            float direction     = ray.Direction[axis];
+            data.Origin[axis]   = ray.Origin[axis];
+            data.InvDir[axis]   = std::abs(direction) > 1e-20f ? 1.f / direction : (std::signbit(direction) ? -1e20f : 1e20f);
+            data.Negative[axis] = data.InvDir[axis] < 0.f;
+        }
+        return data;
+    }
+
+    inline uint32_t Bvh4::IntersectNode(const Node& node, const RayData& ray, float tMin, float tMax, float distances[4])
+    {
+        const float* nearX = ray.Negative[0] ? node.MaxX : node.MinX;
+        const float* farX  = ray.Negative[0] ? node.MinX : node.MaxX;
+        const float* nearY = ray.Negative[1] ? node.MaxY : node.MinY;
+        const float* farY  = ray.Negative[1] ? node.MinY : node.MaxY;
+        const float* nearZ = ray.Negative[2] ? node.MaxZ : node.MinZ;
+        const float* farZ  = ray.Negative[2] ? node.MinZ : node.MaxZ;
+#if defined(DENOISE_BVH_SSE2)
+        __m128 originX = _mm_set1_ps(ray.Origin[0]);
+        __m128 originY = _mm_set1_ps(ray.Origin[1]);
+        __m128 originZ = _mm_set1_ps(ray.Origin[2]);
+        __m128 invX    = _mm_set1_ps(ray.InvDir[0]);
+        __m128 invY    = _mm_set1_ps(ray.InvDir[1]);
+        __m128 invZ    = _mm_set1_ps(ray.InvDir[2]);
+        __m128 entry   = _mm_max_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearX), originX), invX), _mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearY), originY), invY)),
+                                    _mm_max_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(nearZ), originZ), invZ), _mm_set1_ps(tMin)));
+        __m128 exit    = _mm_min_ps(_mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farX), originX), invX), _mm_mul_ps(_mm_sub_ps(_mm_load_ps(farY), originY), invY)),
+                                    _mm_min_ps(_mm_mul_ps(_mm_sub_ps(_mm_load_ps(farZ), originZ), invZ), _mm_set1_ps(tMax)));
+        _mm_storeu_ps(distances, entry);
+        return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit)));
+#else
+        uint32_t mask = 0;
+        for(int i = 0; i < 4; i++)
+        {
+            float entry = std::max(std::max((nearX[i] - ray.Origin[0]) * ray.InvDir[0], (nearY[i] - ray.Origin[1]) * ray.InvDir[1]),
+                                   std::max((nearZ[i] - ray.Origin[2]) * ray.InvDir[2], tMin));
+            float exit  = std::min(std::min((farX[i] - ray.Origin[0]) * ray.InvDir[0], (farY[i] - ray.Origin[1]) * ray.InvDir[1]),
+                                   std::min((farZ[i] - ray.Origin[2]) * ray.InvDir[2], tMax));
+            distances[i] = entry;
+            mask |= (entry <= exit ? 1u : 0u) << i;
+        }
+        return mask;
+#endif
+    }
+
+    inline bool Bvh4::IntersectTriangle(const LeafTriangle& triangle, const CpuRay& ray, float tMax, float& t, float& u, float& v)
+    {
+        Vec3  p           = Cross(ray.Direction, triangle.E2);
+        float determinant = Dot(triangle.E1, p);
+        if(std::abs(determinant) < 1e-12f)
+        {
+            return false;
+        }
+        float inverse = 1.f / determinant;
+        Vec3  s       = ray.Origin - triangle.V0;
+        u             = Dot(s, p) * inverse;
+        if(u < 0.f || u > 1.f)
+        {
+            return false;
+        }
+        Vec3 q = Cross(s, triangle.E1);
+        v      = Dot(ray.Direction, q) * inverse;
+        if(v < 0.f || u + v > 1.f)
+        {
+            return false;
+        }
+        t = Dot(triangle.E2, q) * inverse;
+        return t >= ray.TMin && t <= tMax;
+    }
+
+    template <bool TAnyHit, typename TFilter>
+    bool Bvh4::Traverse(const CpuRay& ray, CpuHit& hit, TFilter& filter) const
+    {
+        if(mNodes.empty())
+        {
+            return false;
+        }
+        RayData  data = PrepareRay(ray);
+        float    tMax = ray.TMax;
+        bool     found = false;
+        uint32_t stack[128];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while(stackSize > 0)
+        {
+            const Node& node = mNodes[stack[--stackSize]];
+            float       distances[4];
+            uint32_t    mask = IntersectNode(node, data, ray.TMin, tMax, distances);
+            if(mask == 0)
+            {
+                continue;
+            }
+
+            // Order hit children near to far
+            uint32_t order[4];
+            uint32_t count = 0;
+            for(uint32_t i = 0; i < 4; i++)
+            {
+                if(mask & (1u << i))
+                {
+                    uint32_t slot = count++;
+                    while(slot > 0 && distances[order[slot - 1]] > distances[i])
+                    {
+                        order[slot] = order[slot - 1];
+                        slot--;
+                    }
+                    order[slot] = i;
+                }
+            }
+
+            // Leaves are tested right away (shrinking tMax), inner nodes pushed far first so the nearest is popped next
+            for(uint32_t i = 0; i < count; i++)
+            {
+                uint32_t child = order[i];
+                if(node.Count[child] == 0 || distances[child] > tMax)
+                {
+                    continue;
+                }
+                for(uint32_t index = node.Child[child]; index < node.Child[child] + node.Count[child]; index++)
+                {
+                    const LeafTriangle& triangle = mTriangles[index];
+                    float               t, u, v;
+                    if(!IntersectTriangle(triangle, ray, tMax, t, u, v) || !filter(triangle.Index, u, v))
+                    {
+                        continue;
+                    }
+                    if constexpr(TAnyHit)
+                    {
+                        return true;
+                    }
+                    tMax         = t;
+                    hit.T        = t;
+                    hit.U        = u;
+                    hit.V        = v;
+                    hit.Triangle = triangle.Index;
+                    found        = true;
+                }
+            }
+            for(uint32_t i = count; i-- > 0;)
+            {
+                uint32_t child = order[i];
+                if(node.Count[child] == 0 && distances[child] <= tMax && stackSize < 128)
+                {
+                    stack[stackSize++] = node.Child[child];
+                }
+            }
+        }
+        return found;
+    }
+
+    template <typename TFilter>
+    bool Bvh4::Intersect(const CpuRay& ray, CpuHit& hit, TFilter&& filter) const
+    {
+        return Traverse<false>(ray, hit, filter);
+    }
+
+    template <typename TFilter>
+    bool Bvh4::Occluded(const CpuRay& ray, TFilter&& filter) const
+    {
+        CpuHit hit;
+        return Traverse<true>(ray, hit, filter);
+    }
+
+}  // namespace denoise::cpu
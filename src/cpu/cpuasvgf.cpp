@@ -0,0 +1,501 @@
+#include "cpuasvgf.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace denoise::cpu {
+
+    namespace {
+        /// @brief Per thread tile buffers of the a-trous filter
+        struct TileScratch
+        {
+            /// @brief Ping pong buffers, rgb color and variance per pixel
+            std::vector<float> Ping;
+            std::vector<float> Pong;
+            /// @brief Normal (xyz), position (xyz) and pixel footprint per pixel
+            std::vector<float> Guides;
+        };
+
+        constexpr uint32_t GUIDE_STRIDE = 7;
+        /// @brief 1D weights of the 5 tap B3 spline kernel, indexed by |offset|
+        constexpr float KERNEL_WEIGHTS[3] = {3.f / 8.f, 1.f / 4.f, 1.f / 16.f};
+
+        float lAlbedoDivisor(float albedo) { return std::max(albedo, 0.01f); }
+
+        float lLuminance(const float* rgb) { return 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2]; }
+
+        uint32_t lHash(uint32_t value)
+        {
+            value ^= value >> 16;
+            value *= 0x7feb352du;
+            value ^= value >> 15;
+            value *= 0x846ca68bu;
+            value ^= value >> 16;
+            return value;
+        }
+
+        /// @brief Radius of a-trous iteration (5 taps per axis at step 2^iteration)
+        int32_t lAtrousRadius(uint32_t iteration) { return 2 << iteration; }
+
+        /// @brief Axis aligned pixel rectangle, maximum exclusive
+        struct Rect
+        {
+            int32_t X0, Y0, X1, Y1;
+
+            Rect Expand(int32_t radius, int32_t width, int32_t height) const
+            {
+                return Rect{std::max(0, X0 - radius), std::max(0, Y0 - radius), std::min(width, X1 + radius), std::min(height, Y1 + radius)};
+            }
+        };
+    }  // namespace
+
+    uint32_t CpuAsvgfDenoiser::GetFootprintRadius() const
+    {
+        uint32_t radius = 3;  // Spatial variance estimate
+        for(uint32_t i = 0; i < mConfig.AtrousIterations; i++)
+        {
+            radius += static_cast<uint32_t>(lAtrousRadius(i));
+        }
+        return radius;
+    }
+
+    void CpuAsvgfDenoiser::Denoise(const CpuFrame& frame, CpuImage& output)
+    {
+        const uint32_t width      = frame.Primary.Width;
+        const uint32_t height     = frame.Primary.Height;
+        const size_t   pixelCount = frame.Primary.GetPixelCount();
+
+        bool sizeChanged = mAccumulated.Width != width || mAccumulated.Height != height;
+        if(sizeChanged)
+        {
+            mAccumulated.Resize(width, height);
+            mFilterInput.Resize(width, height);
+            mColorHistory.Resize(width, height);
+            mNextColorHistory.Resize(width, height);
+            mReprojected.assign(pixelCount, -1);
+            mNoisyLuminance.assign(pixelCount, 0.f);
+            mPrevNoisyLuminance.assign(pixelCount, 0.f);
+            mMoments.assign(pixelCount * 2, 0.f);
+            mPrevMoments.assign(pixelCount * 2, 0.f);
+            mHistoryLength.assign(pixelCount, 0.f);
+            mPrevHistoryLength.assign(pixelCount, 0.f);
+            mHistory.Valid = false;
+        }
+        if(mIgnoreHistory)
+        {
+            mHistory.Valid = false;
+            mIgnoreHistory = false;
+        }
+        output.Resize(width, height);
+
+        // Reprojection is shared by gradient estimation and temporal accumulation
+        mThreadPool->ParallelFor(height, [&](uint32_t y) {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                size_t index           = (size_t)y * width + x;
+                mReprojected[index]    = ReprojectPixel(frame, mHistory, x, y);
+                mNoisyLuminance[index] = lLuminance(frame.Primary.At(x, y));
+            }
+        });
+
+        // Step #1: Temporal gradients
+        EstimateGradients(frame);
+
+        // Step #2: Temporal accumulation of color and moments
+        AccumulateTemporal(frame);
+
+        // Step #3: Variance estimation
+        EstimateVariance(frame);
+
+        // Step #4: Tiled a-trous filter and remodulation
+        const uint32_t tileSize = std::max(8u, mConfig.TileSize);
+        const uint32_t tilesX   = (width + tileSize - 1) / tileSize;
+        const uint32_t tilesY   = (height + tileSize - 1) / tileSize;
+        mThreadPool->ParallelFor(tilesX * tilesY, [&](uint32_t tile) { FilterTile(frame, tile % tilesX, tile / tilesX, output); }, 1);
+
+        // Keep history for the next frame
+        std::swap(mColorHistory.Texels, mNextColorHistory.Texels);
+        std::swap(mMoments, mPrevMoments);
+        std::swap(mHistoryLength, mPrevHistoryLength);
+        std::swap(mNoisyLuminance, mPrevNoisyLuminance);
+        mHistory.Store(frame);
+    }
+
+    void CpuAsvgfDenoiser::EstimateGradients(const CpuFrame& frame)
+    {
+        const uint32_t width   = frame.Primary.Width;
+        const uint32_t height  = frame.Primary.Height;
+        const uint32_t stratum = std::max(1u, mConfig.GradientStratumSize);
+        mStrataX               = (width + stratum - 1) / stratum;
+        mStrataY               = (height + stratum - 1) / stratum;
+        const size_t strataCount = (size_t)mStrataX * mStrataY;
+        mGradient.assign(strataCount * 2, 0.f);
+        mGradientTemp.assign(strataCount * 2, 0.f);
+        mGradientLambda.assign(strataCount, 0.f);
+        if(!mConfig.UseGradient || !mHistory.Valid)
+        {
+            return;
+        }
+
+        // The GPU implementation reshades the previous frame's samples with the current scene (forward projection). Captured sequences can not
+        // be reshaded, so the gradient compares against the reprojected previous sample instead. Its noise is zero mean and averages out in
+        // the reconstruction below, while actual shading changes remain.
+        mThreadPool->ParallelFor(mStrataY, [&](uint32_t sy) {
+            for(uint32_t sx = 0; sx < mStrataX; sx++)
+            {
+                // One reprojectable pixel per stratum, chosen randomly per frame like the GPU implementation's gradient samples. Selecting e.g.
+                // the brightest pixel would bias the difference towards positive values.
+                uint32_t x0          = sx * stratum;
+                uint32_t y0          = sy * stratum;
+                uint32_t strataWidth = std::min(width, x0 + stratum) - x0;
+                uint32_t stratumSize = strataWidth * (std::min(height, y0 + stratum) - y0);
+                uint32_t start       = lHash(static_cast<uint32_t>(frame.FrameNumber) * 0x9e3779b9u ^ (sy * mStrataX + sx)) % stratumSize;
+                int64_t  best        = -1;
+                for(uint32_t i = 0; i < stratumSize && best < 0; i++)
+                {
+                    uint32_t offset = (start + i) % stratumSize;
+                    size_t   index  = (size_t)(y0 + offset / strataWidth) * width + x0 + offset % strataWidth;
+                    if(mReprojected[index] >= 0)
+                    {
+                        best = static_cast<int64_t>(index);
+                    }
+                }
+                float* gradient = mGradient.data() + ((size_t)sy * mStrataX + sx) * 2;
+                if(best >= 0)
+                {
+                    float lum     = mNoisyLuminance[best];
+                    float prevLum = mPrevNoisyLuminance[mReprojected[best]];
+                    gradient[0]   = lum - prevLum;
+                    gradient[1]   = std::max(lum, prevLum);
+                }
+            }
+        });
+
+        // Sparse a-trous reconstruction. Difference and normalization are filtered separately, so noise in the signed difference cancels.
+        for(uint32_t iteration = 0; iteration < mConfig.GradientIterations; iteration++)
+        {
+            const int32_t step = 1 << iteration;
+            mThreadPool->ParallelFor(mStrataY, [&](uint32_t sy) {
+                for(uint32_t sx = 0; sx < mStrataX; sx++)
+                {
+                    float sum[2]    = {};
+                    float weightSum = 0.f;
+                    for(int32_t dy = -1; dy <= 1; dy++)
+                    {
+                        int32_t qy = static_cast<int32_t>(sy) + dy * step;
+                        if(qy < 0 || qy >= static_cast<int32_t>(mStrataY))
+                        {
+                            continue;
+                        }
+                        for(int32_t dx = -1; dx <= 1; dx++)
+                        {
+                            int32_t qx = static_cast<int32_t>(sx) + dx * step;
+                            if(qx < 0 || qx >= static_cast<int32_t>(mStrataX))
+                            {
+                                continue;
+                            }
+                            float        weight = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+                            const float* q      = mGradient.data() + ((size_t)qy * mStrataX + qx) * 2;
+                            sum[0] += q[0] * weight;
+                            sum[1] += q[1] * weight;
+                            weightSum += weight;
+                        }
+                    }
+                    float* out = mGradientTemp.data() + ((size_t)sy * mStrataX + sx) * 2;
+                    out[0]     = sum[0] / weightSum;
+                    out[1]     = sum[1] / weightSum;
+                }
+            });
+            std::swap(mGradient, mGradientTemp);
+        }
+
+        for(size_t i = 0; i < strataCount; i++)
+        {
+            float difference   = mGradient[i * 2];
+            float normalizer   = mGradient[i * 2 + 1];
+            mGradientLambda[i] = normalizer > 1e-4f ? std::min(1.f, std::abs(difference) / normalizer) : 0.f;
+        }
+    }
+
+    void CpuAsvgfDenoiser::AccumulateTemporal(const CpuFrame& frame)
+    {
+        const uint32_t width   = frame.Primary.Width;
+        const uint32_t stratum = std::max(1u, mConfig.GradientStratumSize);
+
+        mThreadPool->ParallelFor(frame.Primary.Height, [&](uint32_t y) {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                size_t       index  = (size_t)y * width + x;
+                const float* noisy  = frame.Primary.At(x, y);
+                const float* albedo = frame.Albedo.At(x, y);
+                float*       acc    = mAccumulated.At(x, y);
+
+                float sample[3];
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    sample[c] = noisy[c] / lAlbedoDivisor(albedo[c]);
+                }
+                float luminance = lLuminance(sample);
+
+                int64_t prev = mReprojected[index];
+                if(prev >= 0)
+                {
+                    float lambda      = mGradientLambda[(size_t)(y / stratum) * mStrataX + x / stratum];
+                    float length      = std::max(1.f, mPrevHistoryLength[prev] * (1.f - lambda)) + 1.f;
+                    float alphaColor  = std::max(mConfig.ColorAlpha, 1.f / length);
+                    float alphaMoment = std::max(mConfig.MomentsAlpha, 1.f / length);
+                    alphaColor += (1.f - alphaColor) * lambda;
+                    alphaMoment += (1.f - alphaMoment) * lambda;
+
+                    const float* prevColor = mColorHistory.Texels.data() + prev * 4;
+                    for(uint32_t c = 0; c < 3; c++)
+                    {
+                        acc[c] = prevColor[c] + (sample[c] - prevColor[c]) * alphaColor;
+                    }
+                    const float* prevMoments = mPrevMoments.data() + prev * 2;
+                    mMoments[index * 2]      = prevMoments[0] + (luminance - prevMoments[0]) * alphaMoment;
+                    mMoments[index * 2 + 1]  = prevMoments[1] + (luminance * luminance - prevMoments[1]) * alphaMoment;
+                    mHistoryLength[index]    = length;
+                }
+                else
+                {
+                    std::copy(sample, sample + 3, acc);
+                    mMoments[index * 2]     = luminance;
+                    mMoments[index * 2 + 1] = luminance * luminance;
+                    mHistoryLength[index]   = 1.f;
+                }
+                acc[3] = 0.f;
+            }
+        });
+    }
+
+    void CpuAsvgfDenoiser::EstimateVariance(const CpuFrame& frame)
+    {
+        const int32_t width  = static_cast<int32_t>(frame.Primary.Width);
+        const int32_t height = static_cast<int32_t>(frame.Primary.Height);
+
+        mThreadPool->ParallelFor(frame.Primary.Height, [&](uint32_t row) {
+            const int32_t y = static_cast<int32_t>(row);
+            for(int32_t x = 0; x < width; x++)
+            {
+                size_t       index = (size_t)y * width + x;
+                const float* acc   = mAccumulated.At(x, y);
+                float*       out   = mFilterInput.At(x, y);
+                std::copy_n(acc, 3, out);
+
+                if(mHistoryLength[index] >= 4.f)
+                {
+                    out[3] = std::max(0.f, mMoments[index * 2 + 1] - mMoments[index * 2] * mMoments[index * 2]);
+                    continue;
+                }
+
+                // Short history: moments are unreliable, estimate them spatially from similar surfaces in a 7x7 neighbourhood
+                float normal[3];
+                float position[3];
+                frame.GetNormal(x, y, normal);
+                frame.GetPosition(x, y, position);
+                float luminance  = lLuminance(acc);
+                float moments[2] = {};
+                float weightSum  = 0.f;
+                for(int32_t qy = std::max(0, y - 3); qy <= std::min(height - 1, y + 3); qy++)
+                {
+                    for(int32_t qx = std::max(0, x - 3); qx <= std::min(width - 1, x + 3); qx++)
+                    {
+                        size_t qIndex = (size_t)qy * width + qx;
+                        float  qNormal[3];
+                        float  qPosition[3];
+                        frame.GetNormal(qx, qy, qNormal);
+                        frame.GetPosition(qx, qy, qPosition);
+                        float qLum = lLuminance(mAccumulated.At(qx, qy));
+
+                        float nDot   = std::max(0.f, normal[0] * qNormal[0] + normal[1] * qNormal[1] + normal[2] * qNormal[2]);
+                        float dist   = std::abs(normal[0] * (qPosition[0] - position[0]) + normal[1] * (qPosition[1] - position[1]) + normal[2] * (qPosition[2] - position[2]));
+                        float weight = std::pow(nDot, mConfig.PhiNormal) * std::exp(-dist / (mConfig.PhiDepth * 0.05f + 1e-4f) - std::abs(luminance - qLum) / mConfig.PhiColor);
+                        moments[0] += mMoments[qIndex * 2] * weight;
+                        moments[1] += mMoments[qIndex * 2 + 1] * weight;
+                        weightSum += weight;
+                    }
+                }
+                moments[0] /= std::max(weightSum, 1e-6f);
+                moments[1] /= std::max(weightSum, 1e-6f);
+                // Boost the variance of fresh history, so the spatial filter compensates for the missing temporal accumulation
+                out[3] = std::max(0.f, moments[1] - moments[0] * moments[0]) * 4.f / mHistoryLength[index];
+            }
+        });
+    }
+
+    void CpuAsvgfDenoiser::FilterTile(const CpuFrame& frame, uint32_t tileX, uint32_t tileY, CpuImage& output)
+    {
+        thread_local TileScratch scratch;
+
+        const int32_t  width      = static_cast<int32_t>(frame.Primary.Width);
+        const int32_t  height     = static_cast<int32_t>(frame.Primary.Height);
+        const int32_t  tileSize   = static_cast<int32_t>(std::max(8u, mConfig.TileSize));
+        const uint32_t iterations = mConfig.AtrousIterations;
+
+        const Rect core{static_cast<int32_t>(tileX) * tileSize, static_cast<int32_t>(tileY) * tileSize, std::min(width, static_cast<int32_t>(tileX + 1) * tileSize),
+                        std::min(height, static_cast<int32_t>(tileY + 1) * tileSize)};
+
+        // Every iteration only needs to produce the region the remaining iterations read, so the computed region shrinks towards the core
+        int32_t haloRadius = 0;
+        for(uint32_t i = 0; i < iterations; i++)
+        {
+            haloRadius += lAtrousRadius(i);
+        }
+        const Rect    region       = core.Expand(haloRadius, width, height);
+        const int32_t regionWidth  = region.X1 - region.X0;
+        const int32_t regionHeight = region.Y1 - region.Y0;
+        const size_t  regionPixels = (size_t)regionWidth * regionHeight;
+
+        scratch.Ping.resize(regionPixels * 4);
+        scratch.Pong.resize(regionPixels * 4);
+        scratch.Guides.resize(regionPixels * GUIDE_STRIDE);
+
+        auto local = [&](int32_t x, int32_t y) { return (size_t)(y - region.Y0) * regionWidth + (x - region.X0); };
+
+        // Load the tile. The pixel footprint scales the depth edge stopping to the distance of the surface.
+        for(int32_t y = region.Y0; y < region.Y1; y++)
+        {
+            for(int32_t x = region.X0; x < region.X1; x++)
+            {
+                size_t i = local(x, y);
+                float  position[3];
+                float  right[3];
+                float  below[3];
+                frame.GetPosition(x, y, position);
+                frame.GetPosition(std::min(x + 1, width - 1), y, right);
+                frame.GetPosition(x, std::min(y + 1, height - 1), below);
+                float dxSq = 0.f;
+                float dySq = 0.f;
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    dxSq += (right[c] - position[c]) * (right[c] - position[c]);
+                    dySq += (below[c] - position[c]) * (below[c] - position[c]);
+                }
+                float* guide = scratch.Guides.data() + i * GUIDE_STRIDE;
+                frame.GetNormal(x, y, guide);
+                std::copy_n(position, 3, guide + 3);
+                guide[6] = std::max(std::sqrt(std::min(dxSq, dySq)), 1e-4f);
+                std::copy_n(mFilterInput.At(x, y), 4, scratch.Ping.data() + i * 4);
+            }
+        }
+
+        auto storeHistory = [&](const float* source) {
+            for(int32_t y = core.Y0; y < core.Y1; y++)
+            {
+                for(int32_t x = core.X0; x < core.X1; x++)
+                {
+                    std::copy_n(source + local(x, y) * 4, 4, mNextColorHistory.At(x, y));
+                }
+            }
+        };
+
+        if(mConfig.HistoryFeedbackIteration >= iterations)
+        {
+            storeHistory(scratch.Ping.data());
+        }
+
+        float*  input     = scratch.Ping.data();
+        float*  filtered  = scratch.Pong.data();
+        int32_t remaining = haloRadius;
+        for(uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const int32_t step = 1 << iteration;
+            remaining -= lAtrousRadius(iteration);
+            const Rect target = core.Expand(remaining, width, height);
+
+            for(int32_t y = target.Y0; y < target.Y1; y++)
+            {
+                for(int32_t x = target.X0; x < target.X1; x++)
+                {
+                    size_t       i      = local(x, y);
+                    const float* center = input + i * 4;
+                    const float* guide  = scratch.Guides.data() + i * GUIDE_STRIDE;
+                    float        lum    = lLuminance(center);
+
+                    // 3x3 gaussian prefiltered variance guides the luminance edge stopping
+                    float variance  = 0.f;
+                    float varWeight = 0.f;
+                    for(int32_t dy = -1; dy <= 1; dy++)
+                    {
+                        for(int32_t dx = -1; dx <= 1; dx++)
+                        {
+                            int32_t qx = x + dx, qy = y + dy;
+                            if(qx < region.X0 || qy < region.Y0 || qx >= region.X1 || qy >= region.Y1)
+                            {
+                                continue;
+                            }
+                            float weight = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+                            variance += input[local(qx, qy) * 4 + 3] * weight;
+                            varWeight += weight;
+                        }
+                    }
+                    const float phiLum   = mConfig.PhiColor * std::sqrt(std::max(0.f, variance / varWeight)) + 1e-6f;
+                    const float phiDepth = mConfig.PhiDepth * guide[6] * static_cast<float>(step);
+
+                    float sum[4]    = {};
+                    float weightSum = 0.f;
+                    for(int32_t dy = -2; dy <= 2; dy++)
+                    {
+                        int32_t qy = y + dy * step;
+                        if(qy < region.Y0 || qy >= region.Y1)
+                        {
+                            continue;
+                        }
+                        for(int32_t dx = -2; dx <= 2; dx++)
+                        {
+                            int32_t qx = x + dx * step;
+                            if(qx < region.X0 || qx >= region.X1)
+                            {
+                                continue;
+                            }
+                            size_t       qi     = local(qx, qy);
+                            const float* q      = input + qi * 4;
+                            const float* qGuide = scratch.Guides.data() + qi * GUIDE_STRIDE;
+
+                            float weight = KERNEL_WEIGHTS[std::abs(dx)] * KERNEL_WEIGHTS[std::abs(dy)];
+                            if(dx != 0 || dy != 0)
+                            {
+                                float nDot  = std::max(0.f, guide[0] * qGuide[0] + guide[1] * qGuide[1] + guide[2] * qGuide[2]);
+                                float plane = std::abs(guide[0] * (qGuide[3] - guide[3]) + guide[1] * (qGuide[4] - guide[4]) + guide[2] * (qGuide[5] - guide[5]));
+                                weight *= std::pow(nDot, mConfig.PhiNormal) * std::exp(-std::abs(lum - lLuminance(q)) / phiLum - plane / phiDepth);
+                            }
+                            sum[0] += q[0] * weight;
+                            sum[1] += q[1] * weight;
+                            sum[2] += q[2] * weight;
+                            sum[3] += q[3] * weight * weight;
+                            weightSum += weight;
+                        }
+                    }
+                    float* out = filtered + i * 4;
+                    out[0]     = sum[0] / weightSum;
+                    out[1]     = sum[1] / weightSum;
+                    out[2]     = sum[2] / weightSum;
+                    out[3]     = sum[3] / (weightSum * weightSum);
+                }
+            }
+
+            std::swap(input, filtered);
+            if(iteration == mConfig.HistoryFeedbackIteration)
+            {
+                storeHistory(input);
+            }
+        }
+
+        // Remodulate
+        for(int32_t y = core.Y0; y < core.Y1; y++)
+        {
+            for(int32_t x = core.X0; x < core.X1; x++)
+            {
+                const float* filteredColor = input + local(x, y) * 4;
+                const float* albedo        = frame.Albedo.At(x, y);
+                float*       out           = output.At(x, y);
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    out[c] = std::max(0.f, filteredColor[c] * lAlbedoDivisor(albedo[c]));
+                }
+                out[3] = 1.f;
+            }
+        }
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../util/threadpool.hpp"
+#include "cpudenoiser.hpp"
+#include "reprojection.hpp"
+
+namespace denoise::cpu {
+
+    struct CpuAsvgfConfig
+    {
+        /// @brief Number of a-trous wavelet iterations (step sizes 1, 2, 4, ...)
+        uint32_t AtrousIterations = 5;
+        /// @brief Output of this a-trous iteration is fed back as color history. Values >= AtrousIterations feed back the unfiltered temporal result
+        uint32_t HistoryFeedbackIteration = 0;
+        /// @brief Edge stopping sensitivity on luminance, scaled by the local standard deviation
+        float PhiColor = 10.f;
+        /// @brief Exponent of the normal edge stopping function
+        float PhiNormal = 128.f;
+        /// @brief Edge stopping sensitivity on the distance to the tangent plane, in pixel footprints
+        float PhiDepth = 1.f;
+        /// @brief Minimum blend weight of the current frame for color accumulation
+        float ColorAlpha = 0.1f;
+        /// @brief Minimum blend weight of the current frame for moments accumulation
+        float MomentsAlpha = 0.2f;
+        /// @brief Enables temporal gradient estimation, which shortens the history where shading changed
+        bool UseGradient = true;
+        /// @brief Edge length of the square pixel strata one gradient sample is taken from
+        uint32_t GradientStratumSize = 3;
+        /// @brief Number of a-trous iterations reconstructing the sparse gradient
+        uint32_t GradientIterations = 3;
+        /// @brief Edge length of the output tile all a-trous iterations are computed for in one go. Tile plus halo should fit the L2 cache.
+        uint32_t TileSize = 64;
+    };
+
+    /// @brief CPU reference implementation of (A-)SVGF (Schied et al. 2017, 2018)
+    /// @details Mirrors the passes of foray::asvgf::ASvgfDenoiserStage:
+    ///  - Gradient estimation: per stratum luminance difference to the reprojected previous frame, reconstructed by a sparse a-trous filter
+    ///  - Temporal accumulation of demodulated color and luminance moments, with the history shortened by the gradient
+    ///  - Variance estimation from the moments, with a spatial 7x7 estimate for short histories
+    ///  - A-trous wavelet filter, edge stopping on luminance (variance guided), normal and depth
+    /// The a-trous filter runs per tile: all iterations of a tile are computed on a tile local buffer covering the tile plus the halo the remaining
+    /// iterations read, so the working set stays in cache instead of streaming the full image once per iteration. Tiles run in parallel and write
+    /// disjoint pixels, so the result does not depend on the thread count.
+    class CpuAsvgfDenoiser : public CpuDenoiser
+    {
+      public:
+        explicit CpuAsvgfDenoiser(util::ThreadPool* threadPool = &util::ThreadPool::Shared(), const CpuAsvgfConfig& config = CpuAsvgfConfig{})
+            : mThreadPool(threadPool), mConfig(config)
+        {
+        }
+
+        virtual void        Denoise(const CpuFrame& frame, CpuImage& output) override;
+        virtual void        IgnoreHistoryNextFrame() override { mIgnoreHistory = true; }
+        virtual bool        IsTemporal() const override { return true; }
+        virtual std::string GetUILabel() const override { return "A-SVGF (CPU)"; }
+        virtual uint32_t    GetFootprintRadius() const override;
+
+        inline CpuAsvgfConfig& GetConfig() { return mConfig; }
+
+      protected:
+        void EstimateGradients(const CpuFrame& frame);
+        void AccumulateTemporal(const CpuFrame& frame);
+        void EstimateVariance(const CpuFrame& frame);
+        /// @brief Runs all a-trous iterations for one output tile, writes the remodulated result into output and the feedback iteration into mNextColorHistory
+        void FilterTile(const CpuFrame& frame, uint32_t tileX, uint32_t tileY, CpuImage& output);
+
+        util::ThreadPool* mThreadPool = nullptr;
+        CpuAsvgfConfig    mConfig;
+        bool              mIgnoreHistory = false;
+
+        ReprojectionHistory mHistory;
+        /// @brief Previous frame pixel index per pixel (-1 if not reprojectable)
+        std::vector<int64_t> mReprojected;
+
+        /// @brief Luminance of the noisy input, current and previous frame (gradient estimation)
+        std::vector<float> mNoisyLuminance;
+        std::vector<float> mPrevNoisyLuminance;
+        uint32_t           mStrataX = 0;
+        uint32_t           mStrataY = 0;
+        /// @brief Per stratum (luminance difference, normalization) pairs, ping pong buffers of the gradient reconstruction
+        std::vector<float> mGradient;
+        std::vector<float> mGradientTemp;
+        /// @brief Per stratum history shortening factor in [0, 1]
+        std::vector<float> mGradientLambda;
+
+        /// @brief Temporally accumulated demodulated color (rgb)
+        CpuImage mAccumulated;
+        /// @brief Input of the a-trous filter: demodulated color (rgb) and variance (a)
+        CpuImage mFilterInput;
+        /// @brief Color history read by the temporal accumulation, and the one written by the a-trous filter for the next frame
+        CpuImage mColorHistory;
+        CpuImage mNextColorHistory;
+
+        /// @brief First and second luminance moment per pixel
+        std::vector<float> mMoments;
+        std::vector<float> mPrevMoments;
+        std::vector<float> mHistoryLength;
+        std::vector<float> mPrevHistoryLength;
+    };
+
+}  // namespace denoise::cpu
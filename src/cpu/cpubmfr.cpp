@@ -0,0 +1,308 @@
+#include "cpubmfr.hpp"
+#include "../util/simd.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace denoise::cpu {
+
+    namespace {
+        /// @brief Color channels appended to the feature matrix, so the QR factorization also yields Q^T * y
+        constexpr uint32_t COLOR_COUNT  = 3;
+        constexpr uint32_t COLUMN_COUNT = CpuBmfrDenoiser::FEATURE_COUNT + COLOR_COUNT;
+
+        /// @brief Per thread scratch memory of the block fit. Columns are stored planar (column major) for the vector kernels.
+        struct BlockScratch
+        {
+            std::vector<float>    Features;
+            std::vector<float>    Work;
+            std::vector<float>    Householder;
+            std::vector<float>    Fitted;
+            std::vector<uint32_t> PixelIndices;
+        };
+
+        float lAlbedoDivisor(float albedo) { return std::max(albedo, 0.01f); }
+
+        uint32_t lHash(uint32_t value)
+        {
+            value ^= value >> 16;
+            value *= 0x7feb352du;
+            value ^= value >> 15;
+            value *= 0x846ca68bu;
+            value ^= value >> 16;
+            return value;
+        }
+    }  // namespace
+
+    void CpuBmfrDenoiser::Denoise(const CpuFrame& frame, CpuImage& output)
+    {
+        const uint32_t width      = frame.Primary.Width;
+        const uint32_t height     = frame.Primary.Height;
+        const size_t   pixelCount = frame.Primary.GetPixelCount();
+
+        bool sizeChanged = mAccumulatedNoisy.Width != width || mAccumulatedNoisy.Height != height;
+        if(sizeChanged)
+        {
+            mAccumulatedNoisy.Resize(width, height);
+            mPrevAccumulatedNoisy.Resize(width, height);
+            mFitted.Resize(width, height);
+            mPrevOutput.Resize(width, height);
+            mHistoryLength.assign(pixelCount, 0);
+            mPrevHistoryLength.assign(pixelCount, 0);
+            mReprojected.assign(pixelCount, -1);
+            mHistory.Valid = false;
+        }
+        if(mIgnoreHistory)
+        {
+            mHistory.Valid = false;
+            mIgnoreHistory = false;
+        }
+        output.Resize(width, height);
+
+        // Step #1: Reproject and accumulate the (demodulated) noisy input
+        mThreadPool->ParallelFor(height, [&](uint32_t y) {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                size_t       index  = (size_t)y * width + x;
+                const float* noisy  = frame.Primary.At(x, y);
+                const float* albedo = frame.Albedo.At(x, y);
+                float*       acc    = mAccumulatedNoisy.At(x, y);
+
+                float sample[3];
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    sample[c] = mConfig.Demodulate ? noisy[c] / lAlbedoDivisor(albedo[c]) : noisy[c];
+                }
+
+                int64_t prev        = ReprojectPixel(frame, mHistory, x, y);
+                mReprojected[index] = prev;
+                if(prev >= 0)
+                {
+                    uint32_t     length  = mPrevHistoryLength[prev] + 1;
+                    float        alpha   = std::max(mConfig.NoisyBlendAlpha, 1.f / static_cast<float>(length));
+                    const float* prevAcc = mPrevAccumulatedNoisy.Texels.data() + prev * 4;
+                    for(uint32_t c = 0; c < 3; c++)
+                    {
+                        acc[c] = prevAcc[c] + (sample[c] - prevAcc[c]) * alpha;
+                    }
+                    mHistoryLength[index] = length;
+                }
+                else
+                {
+                    std::copy(sample, sample + 3, acc);
+                    mHistoryLength[index] = 1;
+                }
+                acc[3] = 1.f;
+            }
+        });
+
+        // Step #2: Fit the feature regression per block. Block boundaries are jittered per frame, the output accumulation hides the seams. The
+        // jitter follows the frame number, so tiles of a frame (CpuTiledDenoiser) see the block grid of the full frame.
+        const int32_t blockSize = static_cast<int32_t>(mConfig.BlockSize);
+        uint32_t      hash      = lHash(static_cast<uint32_t>(frame.FrameNumber));
+        mBlockOffsetX           = static_cast<int32_t>(hash % mConfig.BlockSize);
+        mBlockOffsetY           = static_cast<int32_t>((hash >> 16) % mConfig.BlockSize);
+        const int32_t blocksX   = (static_cast<int32_t>(width) + mBlockOffsetX + blockSize - 1) / blockSize;
+        const int32_t blocksY   = (static_cast<int32_t>(height) + mBlockOffsetY + blockSize - 1) / blockSize;
+        mThreadPool->ParallelFor(static_cast<uint32_t>(blocksX * blocksY), [&](uint32_t block) {
+            FitBlock(frame, static_cast<int32_t>(block) % blocksX, static_cast<int32_t>(block) / blocksX);
+        }, 1);
+
+        // Step #3: Remodulate and accumulate the fitted result
+        mThreadPool->ParallelFor(height, [&](uint32_t y) {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                size_t       index  = (size_t)y * width + x;
+                const float* fitted = mFitted.At(x, y);
+                const float* albedo = frame.Albedo.At(x, y);
+                float*       out    = output.At(x, y);
+
+                float value[3];
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    value[c] = std::max(0.f, mConfig.Demodulate ? fitted[c] * lAlbedoDivisor(albedo[c]) : fitted[c]);
+                }
+
+                int64_t prev = mReprojected[index];
+                if(prev >= 0)
+                {
+                    float        alpha    = std::max(mConfig.OutputBlendAlpha, 1.f / static_cast<float>(mHistoryLength[index]));
+                    const float* prevOut  = mPrevOutput.Texels.data() + prev * 4;
+                    for(uint32_t c = 0; c < 3; c++)
+                    {
+                        out[c] = prevOut[c] + (value[c] - prevOut[c]) * alpha;
+                    }
+                }
+                else
+                {
+                    std::copy(value, value + 3, out);
+                }
+                out[3] = 1.f;
+            }
+        });
+
+        // Keep history for the next frame
+        std::swap(mAccumulatedNoisy.Texels, mPrevAccumulatedNoisy.Texels);
+        std::swap(mHistoryLength, mPrevHistoryLength);
+        mPrevOutput.Texels = output.Texels;
+        mHistory.Store(frame);
+    }
+
+    void CpuBmfrDenoiser::FitBlock(const CpuFrame& frame, int32_t blockX, int32_t blockY)
+    {
+        thread_local BlockScratch scratch;
+
+        const int32_t blockSize = static_cast<int32_t>(mConfig.BlockSize);
+        const int32_t x0        = std::max(0, blockX * blockSize - mBlockOffsetX);
+        const int32_t y0        = std::max(0, blockY * blockSize - mBlockOffsetY);
+        const int32_t x1        = std::min(static_cast<int32_t>(frame.Primary.Width), (blockX + 1) * blockSize - mBlockOffsetX);
+        const int32_t y1        = std::min(static_cast<int32_t>(frame.Primary.Height), (blockY + 1) * blockSize - mBlockOffsetY);
+        if(x1 <= x0 || y1 <= y0)
+        {
+            return;
+        }
+        const uint32_t n = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+
+        // Too few samples for a meaningful regression (image corner blocks): pass the accumulated input through
+        if(n < 2 * FEATURE_COUNT)
+        {
+            for(int32_t y = y0; y < y1; y++)
+            {
+                for(int32_t x = x0; x < x1; x++)
+                {
+                    std::copy_n(mAccumulatedNoisy.At(x, y), 4, mFitted.At(x, y));
+                }
+            }
+            return;
+        }
+
+        scratch.Features.resize((size_t)n * FEATURE_COUNT);
+        scratch.Work.resize((size_t)n * COLUMN_COUNT);
+        scratch.Householder.resize(n);
+        scratch.Fitted.resize((size_t)n * COLOR_COUNT);
+        scratch.PixelIndices.resize(n);
+
+        float* features = scratch.Features.data();
+        float* work     = scratch.Work.data();
+        auto   column   = [n](float* base, uint32_t col) { return base + (size_t)col * n; };
+
+        // Gather features. Positions are normalized to [0, 1] per block to keep the regression well conditioned.
+        float minPos[3] = {INFINITY, INFINITY, INFINITY};
+        float maxPos[3] = {-INFINITY, -INFINITY, -INFINITY};
+        for(int32_t y = y0; y < y1; y++)
+        {
+            for(int32_t x = x0; x < x1; x++)
+            {
+                float position[3];
+                frame.GetPosition(x, y, position);
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    minPos[c] = std::min(minPos[c], position[c]);
+                    maxPos[c] = std::max(maxPos[c], position[c]);
+                }
+            }
+        }
+        float posScale[3];
+        for(uint32_t c = 0; c < 3; c++)
+        {
+            posScale[c] = 1.f / std::max(maxPos[c] - minPos[c], 1e-4f);
+        }
+
+        uint32_t row = 0;
+        for(int32_t y = y0; y < y1; y++)
+        {
+            for(int32_t x = x0; x < x1; x++, row++)
+            {
+                float        normal[3];
+                float        position[3];
+                const float* noisy = mAccumulatedNoisy.At(x, y);
+                frame.GetNormal(x, y, normal);
+                frame.GetPosition(x, y, position);
+
+                column(features, 0)[row] = 1.f;
+                for(uint32_t c = 0; c < 3; c++)
+                {
+                    float p                          = (position[c] - minPos[c]) * posScale[c];
+                    column(features, 1 + c)[row]     = normal[c];
+                    column(features, 4 + c)[row]     = p;
+                    column(features, 7 + c)[row]     = p * p;
+                    column(work, FEATURE_COUNT + c)[row] = noisy[c];
+                }
+                scratch.PixelIndices[row] = static_cast<uint32_t>(y) * frame.Primary.Width + static_cast<uint32_t>(x);
+            }
+        }
+        std::copy_n(features, (size_t)n * FEATURE_COUNT, work);
+
+        // Householder QR: transforms work into [R | Q^T * y] in its upper FEATURE_COUNT rows
+        float*      v             = scratch.Householder.data();
+        const float rankTolerance = 1e-3f * std::sqrt(static_cast<float>(n));
+        bool        usable[FEATURE_COUNT];
+        for(uint32_t k = 0; k < FEATURE_COUNT; k++)
+        {
+            float*       colK   = column(work, k) + k;
+            const size_t length = n - k;
+            float        norm   = std::sqrt(util::simd::Dot(colK, colK, length));
+            usable[k]           = norm > rankTolerance;
+            if(!usable[k])
+            {
+                continue;  // Feature is (numerically) linearly dependent on previous ones, e.g. constant normals on a flat wall
+            }
+
+            float alpha = colK[0] > 0.f ? -norm : norm;
+            std::copy_n(colK, length, v);
+            v[0] -= alpha;
+            float vNormSq = util::simd::Dot(v, v, length);
+            if(vNormSq <= 0.f)
+            {
+                continue;
+            }
+            for(uint32_t j = k + 1; j < COLUMN_COUNT; j++)
+            {
+                float* colJ = column(work, j) + k;
+                float  s    = 2.f * util::simd::Dot(v, colJ, length) / vNormSq;
+                util::simd::Axpy(-s, v, colJ, length);
+            }
+            colK[0] = alpha;
+        }
+
+        // Back substitution per color channel, then evaluate the fitted model for every pixel of the block
+        for(uint32_t c = 0; c < COLOR_COUNT; c++)
+        {
+            float        weights[FEATURE_COUNT] = {};
+            const float* qty                    = column(work, FEATURE_COUNT + c);
+            for(int32_t k = FEATURE_COUNT - 1; k >= 0; k--)
+            {
+                if(!usable[k])
+                {
+                    continue;
+                }
+                float sum = qty[k];
+                for(uint32_t j = static_cast<uint32_t>(k) + 1; j < FEATURE_COUNT; j++)
+                {
+                    sum -= column(work, j)[k] * weights[j];
+                }
+                weights[k] = sum / column(work, static_cast<uint32_t>(k))[k];
+            }
+
+            float* fitted = scratch.Fitted.data() + (size_t)c * n;
+            std::fill_n(fitted, n, 0.f);
+            for(uint32_t k = 0; k < FEATURE_COUNT; k++)
+            {
+                if(weights[k] != 0.f)
+                {
+                    util::simd::Axpy(weights[k], column(features, k), fitted, n);
+                }
+            }
+        }
+
+        for(uint32_t i = 0; i < n; i++)
+        {
+            float* out = mFitted.Texels.data() + (size_t)scratch.PixelIndices[i] * 4;
+            for(uint32_t c = 0; c < COLOR_COUNT; c++)
+            {
+                out[c] = scratch.Fitted[(size_t)c * n + i];
+            }
+            out[3] = 1.f;
+        }
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../util/threadpool.hpp"
+#include "cpudenoiser.hpp"
+#include "reprojection.hpp"
+
+namespace denoise::cpu {
+
+    struct CpuBmfrConfig
+    {
+        /// @brief Edge length of the square blocks a feature regression is fitted for
+        uint32_t BlockSize = 32;
+        /// @brief Minimum blend weight of the current frame for the noisy input accumulation
+        float NoisyBlendAlpha = 0.2f;
+        /// @brief Minimum blend weight of the current frame for the output accumulation
+        float OutputBlendAlpha = 0.1f;
+        /// @brief Fit on radiance divided by albedo, which keeps texture detail out of the regression
+        bool Demodulate = true;
+    };
+
+    /// @brief CPU reference implementation of Blockwise Multi-Order Feature Regression (Koskela et al. 2019)
+    /// @details Mirrors the steps of foray::bmfr::BmfrDenoiser: temporal accumulation of the noisy input, per block least squares fit of
+    /// the radiance against G-buffer features (1, normal, position, position^2), and temporal accumulation of the fitted result.
+    /// The per block fit is a Householder QR factorization of the feature matrix with vectorized column kernels (util/simd.hpp).
+    /// Blocks are fitted in parallel on a work stealing thread pool.
+    class CpuBmfrDenoiser : public CpuDenoiser
+    {
+      public:
+        static constexpr uint32_t FEATURE_COUNT = 10;
+
+        explicit CpuBmfrDenoiser(util::ThreadPool* threadPool = &util::ThreadPool::Shared(), const CpuBmfrConfig& config = CpuBmfrConfig{})
+            : mThreadPool(threadPool), mConfig(config)
+        {
+        }
+
+        virtual void        Denoise(const CpuFrame& frame, CpuImage& output) override;
+        virtual void        IgnoreHistoryNextFrame() override { mIgnoreHistory = true; }
+        virtual bool        IsTemporal() const override { return true; }
+        virtual std::string GetUILabel() const override { return "BMFR (CPU)"; }
+        virtual uint32_t    GetFootprintRadius() const override { return mConfig.BlockSize; }
+        virtual uint32_t    GetTileAlignment() const override { return mConfig.BlockSize; }
+
+        inline CpuBmfrConfig& GetConfig() { return mConfig; }
+
+      protected:
+        /// @brief Fits and evaluates the regression for one block. Writes the fitted radiance of all block pixels into mFitted.
+        void FitBlock(const CpuFrame& frame, int32_t blockX, int32_t blockY);
+
+        util::ThreadPool* mThreadPool = nullptr;
+        CpuBmfrConfig     mConfig;
+        bool              mIgnoreHistory = false;
+        int32_t           mBlockOffsetX  = 0;
+        int32_t           mBlockOffsetY  = 0;
+
+        ReprojectionHistory   mHistory;
+        CpuImage              mAccumulatedNoisy;
+        CpuImage              mPrevAccumulatedNoisy;
+        std::vector<uint32_t> mHistoryLength;
+        std::vector<uint32_t> mPrevHistoryLength;
+        /// @brief Previous frame pixel index per pixel (-1 if not reprojectable), shared by both accumulation passes
+        std::vector<int64_t>  mReprojected;
+        CpuImage              mFitted;
+        CpuImage              mPrevOutput;
+    };
+
+}  // namespace denoise::cpu
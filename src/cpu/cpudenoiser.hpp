@@ -0,0 +1,27 @@
+#pragma once
+
+#include "cpuimage.hpp"
+#include <string>
+
+namespace denoise::cpu {
+
+    /// @brief CPU counterpart of foray::stages::DenoiserStage, used for offline and GPU-less denoising
+    class CpuDenoiser
+    {
+      public:
+        virtual ~CpuDenoiser() = default;
+
+        /// @brief Denoises frame into output (resized as required). Frames are expected in sequence order for temporal denoisers.
+        virtual void Denoise(const CpuFrame& frame, CpuImage& output) = 0;
+        /// @brief Discards temporal history, the next frame is denoised without reprojection
+        virtual void IgnoreHistoryNextFrame() {}
+        /// @brief True if results depend on the previous frames (reprojected history)
+        virtual bool IsTemporal() const { return false; }
+        virtual std::string GetUILabel() const = 0;
+        /// @brief Radius in pixels an output pixel depends on (spatial filter footprint). Used to size tile halos.
+        virtual uint32_t GetFootprintRadius() const = 0;
+        /// @brief Tile origins are placed on multiples of this, so a tile sees the same pixel grid as the full frame (e.g. BMFR blocks)
+        virtual uint32_t GetTileAlignment() const { return 1; }
+    };
+
+}  // namespace denoise::cpu
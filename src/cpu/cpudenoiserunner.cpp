@@ -0,0 +1,308 @@
+#include "cpudenoiserunner.hpp"
+#include "../metrics/imagemetrics.hpp"
+#include "../util/simd.hpp"
+#include "batchpipeline.hpp"
+#include "cpuasvgf.hpp"
+#include "cpubmfr.hpp"
+#include "exrio.hpp"
+#include "framesource.hpp"
+#include "tileddenoiser.hpp"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <foray_logger.hpp>
+
+namespace denoise::cpu {
+
+    std::unique_ptr<CpuDenoiser> CreateCpuDenoiser(std::string_view name, util::ThreadPool* threadPool)
+    {
+        if(name == "bmfr")
+        {
+            return std::make_unique<CpuBmfrDenoiser>(threadPool);
+        }
+        if(name == "asvgf")
+        {
+            return std::make_unique<CpuAsvgfDenoiser>(threadPool);
+        }
+        return nullptr;
+    }
+
+    int RunCpuDenoise(const LaunchOptions& options)
+    {
+        namespace fs = std::filesystem;
+
+        util::ThreadPool threadPool;
+        threadPool.Init(options.CpuThreads);
+
+        std::unique_ptr<CpuDenoiser> denoiser = CreateCpuDenoiser(options.CpuDenoiser, &threadPool);
+        if(!denoiser)
+        {
+            foray::logger()->error("Unknown CPU denoiser \"{}\"", options.CpuDenoiser);
+            return 1;
+        }
+
+        // Frame source: capture file or EXR sequence directory
+        capture::CaptureReader        reader;
+        std::vector<ExrSequenceFrame> exrFrames;
+        uint64_t                      frameCount = 0;
+        bool                          fromExr    = fs::is_directory(fs::u8path(options.CpuInput));
+        if(fromExr)
+        {
+            exrFrames  = ListExrSequence(options.CpuInput);
+            frameCount = exrFrames.size();
+        }
+        else if(reader.Open(options.CpuInput))
+        {
+            frameCount = reader.GetFrameCount();
+        }
+        if(frameCount == 0)
+        {
+            foray::logger()->error("No frames found in \"{}\"", options.CpuInput);
+            return 1;
+        }
+        if(options.CpuPackedGBuffer && fromExr)
+        {
+            foray::logger()->error("--packed-gbuffer requires a capture file, EXR sequences carry no camera to reconstruct positions with");
+            return 1;
+        }
+        if(options.CpuTileSize > 0 && frameCount > 1 && denoiser->IsTemporal())
+        {
+            foray::logger()->error("--tile-size denoises every tile without temporal history, {} would lose the history of the other {} frames. Tile single frames only",
+                                   denoiser->GetUILabel(), frameCount - 1);
+            return 1;
+        }
+
+        // Tiled mode: the denoiser's buffers are sized by the tile instead of the frame. Verification compares against an untiled instance on the
+        // same single frame
+        CpuTiledDenoiser*            tiled = nullptr;
+        std::unique_ptr<CpuDenoiser> untiled;
+        if(options.CpuTileSize > 0)
+        {
+            auto tiledDenoiser = std::make_unique<CpuTiledDenoiser>(std::move(denoiser), &threadPool, CpuTiledDenoiserConfig{.TileSize = options.CpuTileSize});
+            tiled              = tiledDenoiser.get();
+            foray::logger()->info("{}: {} px tiles, {} px halo, {:.1f} MB tile buffers", tiled->GetUILabel(), tiled->GetTileSize(), tiled->GetHalo(),
+                                  tiled->GetTileBufferBytes() * 1e-6);
+            denoiser = std::move(tiledDenoiser);
+            if(options.CpuVerifyTiles)
+            {
+                untiled = CreateCpuDenoiser(options.CpuDenoiser, &threadPool);
+            }
+        }
+        if(!options.CpuOutputDir.empty())
+        {
+            fs::create_directories(fs::u8path(options.CpuOutputDir));
+        }
+
+        foray::logger()->info("{}: {} frames, {} threads, {} kernels", denoiser->GetUILabel(), frameCount, threadPool.GetConcurrency(), util::simd::GetInstructionSet());
+
+        double   denoiseSeconds = 0.0;
+        uint64_t pixelsDenoised = 0;
+        uint64_t gbufferBytes   = 0;
+
+        metrics::MetricsEngine metricsEngine(&threadPool);
+        CpuImage               reference;
+        metrics::ImageMetrics  metricsSum{};
+        uint32_t               framesScored   = 0;
+        uint32_t               temporalScored = 0;
+
+        // Largest difference of tiled and untiled result per frame, relative to the untiled value (absolute below 1)
+        constexpr double verifyTolerance = 1e-3;
+        CpuImage         untiledOutput;
+        double           verifyMaxError = 0.0;
+        uint32_t         verifyFailed   = 0;
+
+        auto load = [&](uint64_t index, CpuFrame& frame) {
+            bool loaded = fromExr ? LoadExrSequenceFrame(options.CpuInput, exrFrames[index], frame) : LoadCaptureFrame(reader, index, frame);
+            if(!loaded)
+            {
+                foray::logger()->error("Loading frame #{} failed", index);
+                return false;
+            }
+            if(options.CpuPackedGBuffer)
+            {
+                const capture::format::FrameHeader* header = reader.GetFrame(index).Header;
+                PackGBuffer(frame, GBufferCamera::FromMatrices(header->ViewMatrix, header->ProjectionMatrix));
+            }
+            return true;
+        };
+
+        auto account = [&](uint64_t frameNumber, uint64_t pixels, size_t frameGBufferBytes, double seconds) {
+            denoiseSeconds += seconds;
+            pixelsDenoised += pixels;
+            gbufferBytes += frameGBufferBytes;
+            foray::logger()->debug("Frame {}: {:.2f} ms, {:.1f} MP/s", frameNumber, seconds * 1000.0, pixels / seconds * 1e-6);
+        };
+
+        auto verify = [&](const CpuFrame& frame, const CpuImage& output) {
+            untiled->Denoise(frame, untiledOutput);
+            double maxError = 0.0;
+            for(size_t i = 0; i < output.Texels.size(); i++)
+            {
+                double expected = untiledOutput.Texels[i];
+                maxError        = std::max(maxError, std::abs(output.Texels[i] - expected) / std::max(1.0, std::abs(expected)));
+            }
+            verifyMaxError = std::max(verifyMaxError, maxError);
+            if(!(maxError <= verifyTolerance))
+            {
+                foray::logger()->error("Frame {}: tiled result differs from untiled by {:.3g}", frame.FrameNumber, maxError);
+                verifyFailed++;
+            }
+        };
+
+        auto score = [&](uint64_t index, const CpuImage& output) {
+            if(options.ReferenceDir.empty())
+            {
+                return;
+            }
+            std::string referencePath = metrics::GetReferenceFramePath(options.ReferenceDir, index);
+            if(!fs::exists(fs::u8path(referencePath)) || !LoadImageFile(referencePath, reference))
+            {
+                foray::logger()->warn("Reference frame \"{}\" missing, frame not scored", referencePath);
+                metricsEngine.ResetTemporal();
+                return;
+            }
+            metrics::ImageMetrics frameMetrics = metricsEngine.Evaluate(output, reference);
+            if(!std::isfinite(frameMetrics.Mse))
+            {
+                return;
+            }
+            metricsSum.Mse += frameMetrics.Mse;
+            metricsSum.Psnr += std::min(frameMetrics.Psnr, 100.0);  // Identical frames have infinite PSNR
+            metricsSum.Ssim += frameMetrics.Ssim;
+            metricsSum.Flip += frameMetrics.Flip;
+            framesScored++;
+            if(std::isfinite(frameMetrics.TemporalError))
+            {
+                metricsSum.TemporalError += frameMetrics.TemporalError;
+                temporalScored++;
+            }
+        };
+
+        auto denoise = [&](uint64_t index, const CpuFrame& frame, CpuImage& output) {
+            auto start = std::chrono::steady_clock::now();
+            denoiser->Denoise(frame, output);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            account(frame.FrameNumber, frame.Primary.GetPixelCount(), frame.GetGBufferByteSize(), seconds);
+            score(index, output);
+        };
+
+        auto outputPath = [&](uint64_t frameNumber) { return (fs::u8path(options.CpuOutputDir) / fmt::format("{:06}.denoised.exr", frameNumber)).string(); };
+
+        BatchPipeline::StoreFunc store;
+        if(!options.CpuOutputDir.empty())
+        {
+            store = [&](uint64_t index, uint64_t frameNumber, const CpuImage& output) {
+                std::string path = outputPath(frameNumber);
+                if(!SaveExr(path, output))
+                {
+                    foray::logger()->error("Writing \"{}\" failed", path);
+                    return false;
+                }
+                return true;
+            };
+        }
+
+        // Tiled: every tile is read straight from the mapped input and finished rows are written behind the tiles, no frame is resident as a whole
+        // (only verification and scoring keep the output, verification also the input). Denoise time includes reading and writing
+        auto denoiseTiled = [&](uint64_t index) {
+            CaptureTileSource     captureSource(&threadPool);
+            ExrSequenceTileSource exrSource(&threadPool);
+            TileSource&           source = fromExr ? static_cast<TileSource&>(exrSource) : captureSource;
+            if(!(fromExr ? exrSource.Open(options.CpuInput, exrFrames[index]) : captureSource.Open(reader, index)))
+            {
+                foray::logger()->error("Loading frame #{} failed", index);
+                return false;
+            }
+            const uint32_t width  = source.GetWidth();
+            const uint32_t height = source.GetHeight();
+            if(index == 0)
+            {
+                foray::logger()->info("{}: {:.1f} MB output strip at {} px width", tiled->GetUILabel(), tiled->GetStripBytes(width) * 1e-6, width);
+            }
+            ExrScanlineWriter writer;
+            if(!options.CpuOutputDir.empty() && !writer.Open(outputPath(source.GetFrameNumber()), width, height))
+            {
+                return false;
+            }
+            const bool keepOutput = !!untiled || !options.ReferenceDir.empty();
+            CpuImage   output;
+            output.Resize(keepOutput ? width : 0, keepOutput ? height : 0);
+
+            auto start    = std::chrono::steady_clock::now();
+            bool denoised = tiled->Denoise(source, [&](uint32_t y, uint32_t rowCount, const float* texels) {
+                if(keepOutput)
+                {
+                    std::copy_n(texels, (size_t)rowCount * width * 4, output.At(0, y));
+                }
+                return !writer.IsOpen() || writer.WriteRows(texels, rowCount);
+            });
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if(!denoised || (writer.IsOpen() && !writer.Close()))
+            {
+                foray::logger()->error("Denoising frame #{} failed", index);
+                return false;
+            }
+            account(source.GetFrameNumber(), (uint64_t)width * height, tiled->GetGBufferBytesRead(), seconds);
+
+            if(!!untiled)
+            {
+                CpuFrame frame;
+                if(!load(index, frame))
+                {
+                    return false;
+                }
+                verify(frame, output);
+            }
+            score(index, output);
+            return true;
+        };
+
+        // Decoding and encoding EXRs takes about as long as denoising, so both run on their own threads next to the denoiser
+        BatchPipeline pipeline(BatchPipeline::Config{.Depth = options.CpuQueueDepth, .ReaderThreads = options.CpuIoThreads, .WriterThreads = options.CpuIoThreads});
+        auto          start     = std::chrono::steady_clock::now();
+        bool          completed = true;
+        if(!!tiled)
+        {
+            for(uint64_t index = 0; completed && index < frameCount; index++)
+            {
+                completed = denoiseTiled(index);
+            }
+        }
+        else
+        {
+            completed = pipeline.Run(frameCount, load, denoise, store);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if(!completed)
+        {
+            return 1;
+        }
+
+        foray::logger()->info("{}: {} frames in {:.3f} s denoise time, {:.2f} ms/frame, {:.1f} MP/s", denoiser->GetUILabel(), frameCount, denoiseSeconds,
+                              denoiseSeconds * 1000.0 / frameCount, pixelsDenoised / denoiseSeconds * 1e-6);
+        if(framesScored > 0)
+        {
+            foray::logger()->info("{}: {} frames scored, avg MSE {:.6f}, PSNR {:.2f} dB, SSIM {:.4f}, FLIP {:.4f}, temporal error {:.6f}", denoiser->GetUILabel(),
+                                  framesScored, metricsSum.Mse / framesScored, metricsSum.Psnr / framesScored, metricsSum.Ssim / framesScored,
+                                  metricsSum.Flip / framesScored, temporalScored > 0 ? metricsSum.TemporalError / temporalScored : 0.0);
+        }
+        if(!!untiled)
+        {
+            foray::logger()->info("{}: tiled result verified against untiled, max relative error {:.3g}, {} of {} frames above {}", denoiser->GetUILabel(), verifyMaxError,
+                                  verifyFailed, frameCount, verifyTolerance);
+        }
+        foray::logger()->info("{}: {} G-buffer layout, {:.2f} MB/frame read", denoiser->GetUILabel(), options.CpuPackedGBuffer ? "packed" : "full precision",
+                              gbufferBytes / (1e6 * frameCount));
+        if(!!tiled)
+        {
+            foray::logger()->info("{}: {:.3f} s wall time, {:.2f} frames/s", denoiser->GetUILabel(), seconds, frameCount / seconds);
+        }
+        else
+        {
+            foray::logger()->info("{}: {:.3f} s wall time, {:.2f} frames/s, denoiser waited {:.3f} s for input and {:.3f} s for output slots", denoiser->GetUILabel(),
+                                  seconds, frameCount / seconds, pipeline.GetInputStallSeconds(), pipeline.GetOutputStallSeconds());
+        }
+        return verifyFailed > 0 ? 1 : 0;
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../launchoptions.hpp"
+#include "../util/threadpool.hpp"
+#include "cpudenoiser.hpp"
+#include <memory>
+
+namespace denoise::cpu {
+
+    /// @brief Creates a CPU denoiser by name ("bmfr", "asvgf"). Returns nullptr for unknown names.
+    std::unique_ptr<CpuDenoiser> CreateCpuDenoiser(std::string_view name, util::ThreadPool* threadPool);
+
+    /// @brief Denoises a capture file or EXR sequence directory on the CPU, optionally writes the results as EXR and reports throughput
+    /// @return Process exit code
+    int RunCpuDenoise(const LaunchOptions& options);
+
+}  // namespace denoise::cpu
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "packedgbuffer.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace denoise::cpu {
+
+    /// @brief Interleaved RGBA 32 bit float image
+    struct CpuImage
+    {
+        uint32_t           Width  = 0;
+        uint32_t           Height = 0;
+        std::vector<float> Texels;
+
+        inline void Resize(uint32_t width, uint32_t height)
+        {
+            Width  = width;
+            Height = height;
+            Texels.resize((size_t)width * height * 4);
+        }
+        inline bool   IsEmpty() const { return Texels.empty(); }
+        inline size_t GetPixelCount() const { return (size_t)Width * Height; }
+
+        inline float*       At(uint32_t x, uint32_t y) { return Texels.data() + ((size_t)y * Width + x) * 4; }
+        inline const float* At(uint32_t x, uint32_t y) const { return Texels.data() + ((size_t)y * Width + x) * 4; }
+    };
+
+    /// @brief 32 bit unsigned integer image, e.g. ids that float can not hold exactly (above 2^24)
+    struct CpuIdImage
+    {
+        /// @brief Id of pixels without a surface
+        static constexpr uint32_t NO_ID = UINT32_MAX;
+
+        uint32_t              Width  = 0;
+        uint32_t              Height = 0;
+        std::vector<uint32_t> Ids;
+
+        inline void Resize(uint32_t width, uint32_t height)
+        {
+            Width  = width;
+            Height = height;
+            Ids.resize((size_t)width * height);
+        }
+        inline bool   IsEmpty() const { return Ids.empty(); }
+        inline size_t GetPixelCount() const { return (size_t)Width * Height; }
+
+        inline uint32_t&       At(uint32_t x, uint32_t y) { return Ids[(size_t)y * Width + x]; }
+        inline const uint32_t& At(uint32_t x, uint32_t y) const { return Ids[(size_t)y * Width + x]; }
+    };
+
+    /// @brief Inputs of a CPU denoiser, mirroring foray::stages::DenoiserConfig (noisy primary input plus G-buffer outputs)
+    struct CpuFrame
+    {
+        uint64_t FrameNumber = 0;
+        /// @brief Noisy radiance
+        CpuImage Primary;
+        CpuImage Albedo;
+        /// @brief World space normal
+        CpuImage Normal;
+        /// @brief World space position
+        CpuImage Position;
+        /// @brief Screen space motion in UV units (xy). The previous frame's UV of a pixel is Uv - Motion
+        CpuImage Motion;
+        /// @brief Mesh instance id, CpuIdImage::NO_ID where no surface was hit (optional, used for reprojection validation)
+        CpuIdImage MeshInstanceId;
+        /// @brief Compact layout replacing Normal, Position, Motion and MeshInstanceId if not empty (see PackGBuffer()). Denoisers read the G-buffer
+        /// through the accessors below, which decode either layout
+        PackedGBuffer GBuffer;
+
+        inline bool IsGBufferPacked() const { return !GBuffer.IsEmpty(); }
+
+        inline void GetNormal(uint32_t x, uint32_t y, float normal[3]) const
+        {
+            if(IsGBufferPacked())
+            {
+                GBuffer.DecodeNormal(x, y, normal);
+                return;
+            }
+            std::copy_n(Normal.At(x, y), 3, normal);
+        }
+        inline void GetPosition(uint32_t x, uint32_t y, float position[3]) const
+        {
+            if(IsGBufferPacked())
+            {
+                GBuffer.DecodePosition(x, y, position);
+                return;
+            }
+            std::copy_n(Position.At(x, y), 3, position);
+        }
+        inline void GetMotion(uint32_t x, uint32_t y, float motion[2]) const
+        {
+            if(IsGBufferPacked())
+            {
+                GBuffer.DecodeMotion(x, y, motion);
+                return;
+            }
+            std::copy_n(Motion.At(x, y), 2, motion);
+        }
+        /// @brief CpuIdImage::NO_ID if the frame has no mesh instance ids
+        inline uint32_t GetMeshInstanceId(uint32_t x, uint32_t y) const
+        {
+            if(IsGBufferPacked())
+            {
+                return GBuffer.DecodeMeshInstanceId(x, y);
+            }
+            return MeshInstanceId.IsEmpty() ? CpuIdImage::NO_ID : MeshInstanceId.At(x, y);
+        }
+
+        /// @brief Bytes of G-buffer data (normal, position, motion, mesh instance id) the denoisers read per frame
+        inline size_t GetGBufferByteSize() const
+        {
+            if(IsGBufferPacked())
+            {
+                return GBuffer.GetByteSize();
+            }
+            return (Normal.Texels.size() + Position.Texels.size() + Motion.Texels.size()) * sizeof(float) + MeshInstanceId.Ids.size() * sizeof(uint32_t);
+        }
+    };
+
+}  // namespace denoise::cpu
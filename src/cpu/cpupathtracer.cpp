@@ -0,0 +1,507 @@
+#include "cpupathtracer.hpp"
+#include "../util/timeline.hpp"
+#include <cmath>
+
+namespace denoise::cpu {
+
+    const float PI = 3.14159265358979f;
+    /// @brief Maximum shadow rays per hit (DIRECT_LIGHT_SAMPLES in closesthit.rchit)
+    const uint32_t DIRECT_LIGHT_SAMPLES = 2;
+
+#pragma region Random numbers
+
+    /// @brief Per pixel seed (TEA, in place of xteanoise.glsl's CalculateSeedXTEA)
+    uint32_t lCalculateSeed(uint32_t x, uint32_t y, uint32_t frameSeed)
+    {
+        uint32_t v0  = x | (y << 16);
+        uint32_t v1  = frameSeed;
+        uint32_t sum = 0;
+        for(uint32_t round = 0; round < 16; round++)
+        {
+            sum += 0x9e3779b9;
+            v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + sum) ^ ((v1 >> 5) + 0xc8013ea4);
+            v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + sum) ^ ((v0 >> 5) + 0x7e95761e);
+        }
+        return v0;
+    }
+
+    /// @brief lcrng.glsl
+    inline uint32_t lLcgUint(uint32_t& state)
+    {
+        state = 1664525u * state + 1013904223u;
+        return state & 0x00FFFFFF;
+    }
+
+    inline float lLcgFloat(uint32_t& state) { return static_cast<float>(lLcgUint(state)) / static_cast<float>(0x01000000); }
+
+    /// @brief Samples a GGX distributed half vector around normal (sampling.glsl's importanceSample_GGX)
+    Vec3 lImportanceSampleGgx(uint32_t seed, float roughness, const Vec3& normal)
+    {
+        float alpha     = roughness * roughness;
+        float r1        = lLcgFloat(seed);
+        float r2        = lLcgFloat(seed);
+        float phi       = 2.f * PI * r1;
+        float cosTheta  = std::sqrt((1.f - r2) / (1.f + (alpha * alpha - 1.f) * r2));
+        float sinTheta  = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+        Vec3  up        = std::abs(normal.z) < 0.999f ? Vec3{0.f, 0.f, 1.f} : Vec3{1.f, 0.f, 0.f};
+        Vec3  tangent   = Normalize(Cross(up, normal));
+        Vec3  bitangent = Cross(normal, tangent);
+        return Normalize(tangent * (sinTheta * std::cos(phi)) + bitangent * (sinTheta * std::sin(phi)) + normal * cosTheta);
+    }
+
+#pragma endregion
+#pragma region Material
+
+    inline float lSrgbToLinear(float value) { return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f); }
+
+    /// @brief Offsets a ray origin slightly away from the surface to prevent self shadowing
+    inline void lCorrectOrigin(Vec3& origin, const Vec3& normal, float nDotL)
+    {
+        float correctorLength = std::clamp((1.f - nDotL) * 0.005f, 0.f, 1.f);
+        origin += normal * correctorLength;
+    }
+
+    void CpuPathTracer::ProbeMaterial(const CpuMaterial& material, float u, float v, MaterialProbe& probe, float lodBias) const
+    {
+        const std::vector<CpuTexture>& textures = mScene->GetTextures();
+        float                          texel[4];
+
+        auto sample = [&](int32_t index) {
+            const CpuTexture& texture = textures[index];
+            uint32_t          mip     = 0;
+            if(!std::isnan(lodBias))
+            {
+                const CpuTextureMip& finest = texture.Mips[0];
+                mip                         = texture.GetMipForLod(lodBias + 0.5f * std::log2(static_cast<float>(finest.Width) * static_cast<float>(finest.Height)));
+                mTextureStreamer->RequestMip(static_cast<uint32_t>(index), mip);
+            }
+            texture.Sample(u, v, texel, mip);
+        };
+
+        float baseColor[4] = {material.BaseColorFactor[0], material.BaseColorFactor[1], material.BaseColorFactor[2], material.BaseColorFactor[3]};
+        if(material.BaseColorTexture >= 0)
+        {
+            // Base color textures are sRGB images on the GPU, sampled as linear values
+            sample(material.BaseColorTexture);
+            for(int c = 0; c < 3; c++)
+            {
+                baseColor[c] *= lSrgbToLinear(texel[c]);
+            }
+            baseColor[3] *= texel[3];
+        }
+        probe.BaseColor = Vec3{baseColor[0], baseColor[1], baseColor[2]};
+        probe.Alpha     = baseColor[3];
+
+        probe.Metallic  = material.MetallicFactor;
+        probe.Roughness = material.RoughnessFactor;
+        if(material.MetallicRoughnessTexture >= 0)
+        {
+            sample(material.MetallicRoughnessTexture);
+            probe.Roughness *= texel[1];
+            probe.Metallic *= texel[2];
+        }
+
+        probe.EmissiveColor = material.EmissiveFactor;
+        if(material.EmissiveTexture >= 0)
+        {
+            sample(material.EmissiveTexture);
+            probe.EmissiveColor *= Vec3{lSrgbToLinear(texel[0]), lSrgbToLinear(texel[1]), lSrgbToLinear(texel[2])};
+        }
+
+        probe.TangentNormal = Vec3{0.f, 0.f, 1.f};
+        if(material.NormalTexture >= 0)
+        {
+            sample(material.NormalTexture);
+            probe.TangentNormal = Normalize(Vec3{texel[0] * 2.f - 1.f, texel[1] * 2.f - 1.f, texel[2] * 2.f - 1.f});
+        }
+    }
+
+    /// @brief Cook-Torrance GGX specular plus Lambert diffuse (metallic workflow), multiplied by NdotL
+    Vec3 CpuPathTracer::EvaluateMaterial(const HitSample& hit, const MaterialProbe& probe)
+    {
+        float nDotL = std::max(Dot(hit.Normal, hit.wIn), 0.f);
+        float nDotV = std::max(Dot(hit.Normal, hit.wOut), 0.f);
+        if(nDotL <= 0.f || nDotV <= 0.f)
+        {
+            return Vec3{};
+        }
+        float nDotH = std::max(Dot(hit.Normal, hit.wHalf), 0.f);
+        float vDotH = std::max(Dot(hit.wOut, hit.wHalf), 0.f);
+
+        float alpha   = std::max(probe.Roughness * probe.Roughness, 1e-3f);
+        float alpha2  = alpha * alpha;
+        float denom   = nDotH * nDotH * (alpha2 - 1.f) + 1.f;
+        float d       = alpha2 / (PI * denom * denom);
+        float k       = alpha * 0.5f;
+        float g       = (nDotL / (nDotL * (1.f - k) + k)) * (nDotV / (nDotV * (1.f - k) + k));
+        Vec3  f0      = Vec3{0.04f, 0.04f, 0.04f} * (1.f - probe.Metallic) + probe.BaseColor * probe.Metallic;
+        float fresnel = std::pow(1.f - vDotH, 5.f);
+        Vec3  f       = f0 + (Vec3{1.f, 1.f, 1.f} - f0) * fresnel;
+
+        Vec3 specular = f * (d * g / (4.f * nDotL * nDotV + 1e-4f));
+        Vec3 diffuse  = (Vec3{1.f, 1.f, 1.f} - f) * probe.BaseColor * ((1.f - probe.Metallic) / PI);
+        return (diffuse + specular) * nDotL;
+    }
+
+#pragma endregion
+#pragma region Any hit
+
+    /// @brief default/anyhit.rahit
+    bool CpuPathTracer::ProbeAlphaOpacity(uint32_t triangleIndex, float u, float v) const
+    {
+        const CpuTriangle& triangle = mScene->GetTriangles()[triangleIndex];
+        const CpuMaterial& material = mScene->GetMaterials()[triangle.Material];
+        if(material.AlphaMode == EAlphaMode::Opaque)
+        {
+            return true;
+        }
+        float alpha = material.BaseColorFactor[3];
+        if(material.BaseColorTexture >= 0)
+        {
+            const std::vector<CpuVertex>& vertices = mScene->GetVertices();
+            const CpuVertex&              v0       = vertices[triangle.Vertices[0]];
+            const CpuVertex&              v1       = vertices[triangle.Vertices[1]];
+            const CpuVertex&              v2       = vertices[triangle.Vertices[2]];
+            float                         w        = 1.f - u - v;
+            float                         texel[4];
+            mScene->GetTextures()[material.BaseColorTexture].Sample(v0.Uv[0] * w + v1.Uv[0] * u + v2.Uv[0] * v, v0.Uv[1] * w + v1.Uv[1] * u + v2.Uv[1] * v, texel);
+            alpha *= texel[3];
+        }
+        return alpha >= material.AlphaCutoff;
+    }
+
+    /// @brief visibilitytest/anyhit.rahit: transmissive surfaces let light pass
+    bool CpuPathTracer::IsVisibilityOccluder(uint32_t triangleIndex, float u, float v) const
+    {
+        const CpuTriangle& triangle = mScene->GetTriangles()[triangleIndex];
+        const CpuMaterial& material = mScene->GetMaterials()[triangle.Material];
+        if(material.TransmissionFactor > 0.f)
+        {
+            return false;
+        }
+        if(!ProbeAlphaOpacity(triangleIndex, u, v))
+        {
+            return false;
+        }
+        if(material.TransmissionTexture >= 0)
+        {
+            const std::vector<CpuVertex>& vertices = mScene->GetVertices();
+            const CpuVertex&              v0       = vertices[triangle.Vertices[0]];
+            const CpuVertex&              v1       = vertices[triangle.Vertices[1]];
+            const CpuVertex&              v2       = vertices[triangle.Vertices[2]];
+            float                         w        = 1.f - u - v;
+            float                         texel[4];
+            mScene->GetTextures()[material.TransmissionTexture].Sample(v0.Uv[0] * w + v1.Uv[0] * u + v2.Uv[0] * v, v0.Uv[1] * w + v1.Uv[1] * u + v2.Uv[1] * v, texel);
+            return texel[0] <= 0.f;
+        }
+        return true;
+    }
+
+#pragma endregion
+#pragma region Closest hit
+
+    void CpuPathTracer::GetSurface(const CpuHit& hit, SurfaceHit& surface, float footprint) const
+    {
+        const CpuTriangle& triangle = mScene->GetTriangles()[hit.Triangle];
+        const CpuVertex&   v0       = mScene->GetVertices()[triangle.Vertices[0]];
+        const CpuVertex&   v1       = mScene->GetVertices()[triangle.Vertices[1]];
+        const CpuVertex&   v2       = mScene->GetVertices()[triangle.Vertices[2]];
+        float              w        = 1.f - hit.U - hit.V;
+
+        const std::vector<Vec3>& positions = mScene->GetPositions();
+        const std::vector<Vec3>& previous  = mScene->GetPreviousPositions();
+        surface.Position         = positions[triangle.Vertices[0]] * w + positions[triangle.Vertices[1]] * hit.U + positions[triangle.Vertices[2]] * hit.V;
+        surface.PreviousPosition = previous[triangle.Vertices[0]] * w + previous[triangle.Vertices[1]] * hit.U + previous[triangle.Vertices[2]] * hit.V;
+        surface.Material = triangle.Material;
+        surface.Instance = triangle.Instance;
+
+        // Screen space level of detail estimate: a texture with a single texel covers sqrt(UV area / world area) texels per world unit of the triangle
+        float lodBias = std::numeric_limits<float>::quiet_NaN();
+        if(!!mTextureStreamer && footprint > 0.f)
+        {
+            Vec3  edge1     = positions[triangle.Vertices[1]] - positions[triangle.Vertices[0]];
+            Vec3  edge2     = positions[triangle.Vertices[2]] - positions[triangle.Vertices[0]];
+            float worldArea = Length(Cross(edge1, edge2));
+            float uvArea    = std::abs((v1.Uv[0] - v0.Uv[0]) * (v2.Uv[1] - v0.Uv[1]) - (v2.Uv[0] - v0.Uv[0]) * (v1.Uv[1] - v0.Uv[1]));
+            lodBias         = worldArea > 0.f && uvArea > 0.f ? std::log2(footprint * std::sqrt(uvArea / worldArea)) : -std::numeric_limits<float>::infinity();
+        }
+        ProbeMaterial(mScene->GetMaterials()[triangle.Material], v0.Uv[0] * w + v1.Uv[0] * hit.U + v2.Uv[0] * hit.V, v0.Uv[1] * w + v1.Uv[1] * hit.U + v2.Uv[1] * hit.V,
+                      surface.Probe, lodBias);
+
+        // CalculateTBN() and ApplyNormalMap() of normaltbn.glsl
+        Vec3 normal    = Normalize(v0.Normal * w + v1.Normal * hit.U + v2.Normal * hit.V);
+        Vec3 tangent   = Normalize(v0.Tangent * w + v1.Tangent * hit.U + v2.Tangent * hit.V);
+        tangent        = Normalize(tangent - normal * Dot(tangent, normal));
+        Vec3 bitangent = Cross(normal, tangent);
+        const Vec3& t  = surface.Probe.TangentNormal;
+        surface.Normal = Normalize(tangent * t.x + bitangent * t.y + normal * t.z);
+    }
+
+    void CpuPathTracer::TraceRay(const Vec3& origin, const Vec3& direction, Payload& payload, uint64_t& rays) const
+    {
+        rays++;
+        CpuHit hit;
+        if(!mBvh.Intersect(CpuRay{.Origin = origin, .Direction = direction}, hit, [this](uint32_t triangle, float u, float v) { return ProbeAlphaOpacity(triangle, u, v); }))
+        {
+            payload.Radiance = Vec3{};  // miss.rmiss
+            return;
+        }
+        SurfaceHit surface;
+        GetSurface(hit, surface);
+        ClosestHit(direction, surface, payload, rays);
+    }
+
+    void CpuPathTracer::ClosestHit(const Vec3& direction, const SurfaceHit& surface, Payload& payload, uint64_t& rays) const
+    {
+        Vec3 directLight   = CollectDirectLight(direction, surface, payload, rays);
+        Vec3 indirectLight = payload.Depth < 5 ? CollectIndirectLight(direction, surface, payload, rays) : Vec3{};
+        payload.Radiance   = directLight + indirectLight + surface.Probe.EmissiveColor;
+    }
+
+    Vec3 CpuPathTracer::CollectDirectLight(const Vec3& direction, const SurfaceHit& surface, Payload& payload, uint64_t& rays) const
+    {
+        const std::vector<CpuLight>& lights = mScene->GetLights();
+        if(lights.empty())
+        {
+            return Vec3{};
+        }
+        // Lights are drawn proportional to their power (lightsampler.glsl), a single light is sampled exactly by one ray
+        uint32_t lightTestCount = std::min<uint32_t>(DIRECT_LIGHT_SAMPLES, static_cast<uint32_t>(lights.size()));
+
+        Vec3 directLightSum;
+        for(uint32_t i = 0; i < lightTestCount; i++)
+        {
+            uint32_t        index    = util::SampleAliasTable(mLightTable.data(), static_cast<uint32_t>(mLightTable.size()), lLcgFloat(payload.Seed));
+            float           lightPdf = mLightTable[index].Pdf;
+            const CpuLight& light    = lights[index];
+
+            Vec3  origin = surface.Position;
+            Vec3  dir;
+            float len = std::numeric_limits<float>::infinity();
+            if(light.Type == ELightType::Directional)
+            {
+                dir = Normalize(light.PosOrDir);
+            }
+            else
+            {
+                dir = light.PosOrDir - origin;
+                len = Length(dir);
+                dir = Normalize(dir);
+            }
+            float nDotL = Dot(dir, surface.Normal);
+            lCorrectOrigin(origin, surface.Normal, nDotL);
+            if(nDotL <= 0.f)
+            {
+                continue;
+            }
+
+            rays++;
+            if(mBvh.Occluded(CpuRay{.Origin = origin, .Direction = dir, .TMax = len},
+                             [this](uint32_t triangle, float u, float v) { return IsVisibilityOccluder(triangle, u, v); }))
+            {
+                continue;
+            }
+
+            HitSample hit;
+            hit.Normal      = surface.Normal;
+            hit.wOut        = -direction;
+            hit.wIn         = dir;
+            hit.wHalf       = Normalize(hit.wOut + hit.wIn);
+            Vec3 reflection = payload.Attenuation * light.Color * (light.Intensity / (4.f * PI)) * EvaluateMaterial(hit, surface.Probe);
+            if(light.Type == ELightType::Point)
+            {
+                reflection = reflection / (len * len);
+            }
+            directLightSum += reflection / lightPdf;
+        }
+        // Occluded samples count as zero: the estimate is the sum over all lights
+        return directLightSum / static_cast<float>(lightTestCount);
+    }
+
+    Vec3 CpuPathTracer::CollectIndirectLight(const Vec3& direction, const SurfaceHit& surface, Payload& payload, uint64_t& rays) const
+    {
+        // Count of secondary rays to emit, the current ray's attenuation is used for bailout
+        float    attenuationModifier = std::min(Dot(payload.Attenuation, payload.Attenuation), 1.f);
+        float    rng                 = lLcgFloat(payload.Seed);
+        uint32_t secondary           = static_cast<uint32_t>(std::max(0.f, attenuationModifier + attenuationModifier * rng));
+
+        const MaterialProbe& probe               = surface.Probe;
+        bool                 perfectlyReflective = probe.Metallic > 0.99f && probe.Roughness < 0.01f;
+        if(perfectlyReflective)
+        {
+            secondary = std::min(secondary, 1u);
+        }
+
+        Vec3     sumIndirect;
+        uint32_t weightIndirect = 0;
+        uint32_t seed           = payload.Seed;
+        for(uint32_t i = 0; i < secondary; i++)
+        {
+            seed += 1;
+            Vec3 origin = surface.Position;
+
+            HitSample hit;
+            hit.wOut   = Normalize(-direction);
+            hit.Normal = perfectlyReflective ? surface.Normal : lImportanceSampleGgx(seed, probe.Roughness, surface.Normal);
+            hit.wIn    = Normalize(-Reflect(hit.wOut, hit.Normal));
+            hit.wHalf  = Normalize(hit.wOut + hit.wIn);
+            lCorrectOrigin(origin, surface.Normal, Dot(hit.wIn, hit.Normal));
+
+            Payload child;
+            child.Seed        = payload.Seed + i;
+            child.Attenuation = EvaluateMaterial(hit, probe);
+            child.Depth       = payload.Depth + 1;
+            if(Dot(child.Attenuation, child.Attenuation) > 0.001f)  // If the expected contribution is high enough
+            {
+                TraceRay(origin, hit.wIn, child, rays);
+                sumIndirect += child.Radiance;
+                weightIndirect++;
+            }
+        }
+        return weightIndirect > 0 ? sumIndirect / static_cast<float>(weightIndirect) : Vec3{};
+    }
+
+#pragma endregion
+#pragma region Ray generation
+
+    void CpuPathTracer::Init(const CpuScene* scene, CpuTextureStreamer* textureStreamer)
+    {
+        mScene           = scene;
+        mTextureStreamer = textureStreamer;
+        mBvh.Build(*scene);
+
+        const std::vector<CpuLight>& lights = scene->GetLights();
+        std::vector<float>           weights(lights.size());
+        for(size_t i = 0; i < lights.size(); i++)
+        {
+            weights[i] = std::max(lights[i].Intensity * (0.2126f * lights[i].Color.x + 0.7152f * lights[i].Color.y + 0.0722f * lights[i].Color.z), 0.f);
+        }
+        mLightTable.resize(lights.size());
+        util::BuildAliasTable(weights.data(), static_cast<uint32_t>(weights.size()), mLightTable.data());
+        mRayCount = 0;
+    }
+
+    void CpuPathTracer::OnSceneUpdated()
+    {
+        // Light power does not change with the transform, so the light table stays valid
+        mBvh.Refit(*mScene);
+    }
+
+    /// @brief Projects a world position into the UV space of a camera. Returns false if the point is behind it
+    bool lProjectToUv(const Mat4& worldToCamera, float tanHalfFov, float aspect, const Vec3& world, float uv[2])
+    {
+        Vec3 view = worldToCamera.TransformPoint(world);
+        if(view.z >= 0.f)
+        {
+            return false;
+        }
+        uv[0] = (view.x / (-view.z) / (tanHalfFov * aspect)) * 0.5f + 0.5f;
+        uv[1] = (-view.y / (-view.z) / tanHalfFov) * 0.5f + 0.5f;
+        return true;
+    }
+
+    void CpuPathTracer::RenderTile(
+        uint32_t tileIndex, const CpuCamera& camera, const Mat4& previousWorldToCamera, float previousTanHalfFov, uint32_t rngSeed, uint32_t samples, CpuFrame& out) const
+    {
+        util::TimelineScope scope("Render Tile");
+        uint32_t width      = out.Primary.Width;
+        uint32_t height     = out.Primary.Height;
+        uint32_t tilesX     = (width + TILE_SIZE - 1) / TILE_SIZE;
+        uint32_t beginX     = (tileIndex % tilesX) * TILE_SIZE;
+        uint32_t beginY     = (tileIndex / tilesX) * TILE_SIZE;
+        uint32_t endX       = std::min(beginX + TILE_SIZE, width);
+        uint32_t endY       = std::min(beginY + TILE_SIZE, height);
+        float    aspect     = static_cast<float>(width) / static_cast<float>(height);
+        float    tanHalfFov = std::tan(camera.YFov * 0.5f);
+        Vec3     origin     = camera.CameraToWorld.TransformPoint(Vec3{});
+        uint64_t rays       = 0;
+        // Angle covered by a pixel (at the image center)
+        float pixelSpread = 2.f * tanHalfFov / static_cast<float>(height);
+
+        for(uint32_t y = beginY; y < endY; y++)
+        {
+            for(uint32_t x = beginX; x < endX; x++)
+            {
+                float uv[2] = {(x + 0.5f) / width, (y + 0.5f) / height};
+                Vec3  view{(uv[0] * 2.f - 1.f) * tanHalfFov * aspect, -(uv[1] * 2.f - 1.f) * tanHalfFov, -1.f};
+                Vec3  direction = Normalize(camera.CameraToWorld.TransformDirection(view));
+
+                // Primary ray: the closest hit also provides the G-buffer (rasterized by the GBufferStage on the GPU)
+                rays++;
+                CpuHit hit;
+                bool   hasHit = mBvh.Intersect(CpuRay{.Origin = origin, .Direction = direction}, hit,
+                                               [this](uint32_t triangle, float u, float v) { return ProbeAlphaOpacity(triangle, u, v); });
+                float* primary  = out.Primary.At(x, y);
+                float* albedo   = out.Albedo.At(x, y);
+                float* normal   = out.Normal.At(x, y);
+                float* position = out.Position.At(x, y);
+                float* motion   = out.Motion.At(x, y);
+                Vec3   reprojected;
+                Vec3   radiance;
+                if(hasHit)
+                {
+                    SurfaceHit surface;
+                    GetSurface(hit, surface, hit.T * pixelSpread);
+                    for(uint32_t sample = 0; sample < samples; sample++)
+                    {
+                        // Sample 0 keeps the seed of single sample rendering, further paths decorrelate by a golden ratio offset
+                        Payload payload;
+                        payload.Seed = lCalculateSeed(x, y, rngSeed + sample * 0x9e3779b9u);
+                        ClosestHit(direction, surface, payload, rays);
+                        radiance += payload.Radiance;
+                    }
+                    radiance = samples > 1 ? radiance / static_cast<float>(samples) : radiance;
+                    const Vec3& baseColor = surface.Probe.BaseColor;
+                    for(int c = 0; c < 3; c++)
+                    {
+                        albedo[c]   = baseColor[c];
+                        normal[c]   = surface.Normal[c];
+                        position[c] = surface.Position[c];
+                    }
+                    out.MeshInstanceId.At(x, y) = surface.Instance;
+                    reprojected                 = surface.PreviousPosition;
+                }
+                else
+                {
+                    for(int c = 0; c < 3; c++)
+                    {
+                        albedo[c] = normal[c] = position[c] = 0.f;
+                    }
+                    out.MeshInstanceId.At(x, y) = CpuIdImage::NO_ID;
+                    reprojected                 = origin + direction * 1e6f;  // Background moves with the camera rotation only
+                }
+                for(int c = 0; c < 3; c++)
+                {
+                    primary[c] = radiance[c];
+                }
+                primary[3] = albedo[3] = normal[3] = position[3] = 1.f;
+
+                float previousUv[2] = {-1.f, -1.f};  // Points behind the previous camera reproject off screen
+                lProjectToUv(previousWorldToCamera, previousTanHalfFov, aspect, reprojected, previousUv);
+                motion[0] = uv[0] - previousUv[0];
+                motion[1] = uv[1] - previousUv[1];
+                motion[2] = motion[3] = 0.f;
+            }
+        }
+        mRayCount += rays;
+    }
+
+    void CpuPathTracer::Render(
+        const CpuCamera& camera, const CpuCamera& previousCamera, uint32_t width, uint32_t height, uint32_t rngSeed, CpuFrame& out, const uint32_t* tileSamples)
+    {
+        for(CpuImage* image : {&out.Primary, &out.Albedo, &out.Normal, &out.Position, &out.Motion})
+        {
+            image->Resize(width, height);
+        }
+        out.MeshInstanceId.Resize(width, height);
+        Mat4     previousWorldToCamera = previousCamera.CameraToWorld.InverseAffine();
+        float    previousTanHalfFov    = std::tan(previousCamera.YFov * 0.5f);
+        uint32_t tileCount             = ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
+        // One tile per task: tile cost varies strongly with the content, idle threads steal the remaining tiles
+        mThreadPool->ParallelFor(
+            tileCount, [&](uint32_t tile) { RenderTile(tile, camera, previousWorldToCamera, previousTanHalfFov, rngSeed, !!tileSamples ? tileSamples[tile] : 1, out); }, 1);
+    }
+
+#pragma endregion
+
+}  // namespace denoise::cpu
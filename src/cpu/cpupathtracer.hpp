@@ -0,0 +1,117 @@
+#pragma once
+
+#include "../util/aliastable.hpp"
+#include "../util/threadpool.hpp"
+#include "bvh4.hpp"
+#include "cpuimage.hpp"
+#include "cpuscene.hpp"
+#include "cputexturestreamer.hpp"
+#include <atomic>
+#include <vector>
+
+namespace denoise::cpu {
+
+    /// @brief CPU reimplementation of the ComplexRaytracingStage shaders (raygen.rgen, default/ and visibilitytest/)
+    /// @details Renders the noisy radiance of one sample per pixel plus the G-buffer outputs the denoisers consume, so denoiser pipelines can be
+    /// exercised without a ray tracing capable GPU. Shading follows the shaders step by step (light selection, visibility test, GGX sampled indirect
+    /// bounce with attenuation bailout, alpha and transmission any-hit filters), but random sequences and texture filtering differ, so images match
+    /// statistically, not bit for bit. Tiles are distributed over the work stealing thread pool.
+    class CpuPathTracer
+    {
+      public:
+        /// @brief Edge length of the square tiles scheduled as one task
+        static constexpr uint32_t TILE_SIZE = 16;
+
+        explicit CpuPathTracer(util::ThreadPool* threadPool) : mThreadPool(threadPool) {}
+
+        /// @brief Builds the acceleration structure. The scene must outlive the path tracer
+        /// @param textureStreamer Receives the mips primary hits want, and primary hits sample the mip matching their screen space footprint. Without
+        /// a streamer all lookups sample the finest resident mip
+        void Init(const CpuScene* scene, CpuTextureStreamer* textureStreamer = nullptr);
+        /// @brief Refits the acceleration structure to the instances moved by the last CpuScene::Update()
+        void OnSceneUpdated();
+
+        /// @brief Renders one frame into out (resized to width x height)
+        /// @param previousCamera Camera of the previous frame, used for the motion vectors
+        /// @param rngSeed Per frame seed (RtStageConfig::RngSeed)
+        /// @param tileSamples Paths per pixel for every tile (row major), nullptr for one. All paths of a pixel share the primary hit (which also
+        /// provides the G-buffer), pixels of tiles with 0 paths get black radiance
+        void Render(
+            const CpuCamera& camera, const CpuCamera& previousCamera, uint32_t width, uint32_t height, uint32_t rngSeed, CpuFrame& out, const uint32_t* tileSamples = nullptr);
+
+        /// @brief Rays (primary, secondary and visibility) traced by Render() calls since Init()
+        inline uint64_t GetRayCount() const { return mRayCount.load(); }
+
+      protected:
+        /// @brief Mirrors the HitPayload of shaders/hitpayload.glsl, without the BSDF pdf (the CPU path tracer does not sample an environment)
+        struct Payload
+        {
+            Vec3     Radiance;
+            Vec3     Attenuation{1.f, 1.f, 1.f};
+            uint32_t Seed  = 0;
+            uint32_t Depth = 0;
+        };
+
+        /// @brief Mirrors foray's MaterialProbe
+        struct MaterialProbe
+        {
+            Vec3  BaseColor;
+            float Alpha     = 1.f;
+            float Metallic  = 0.f;
+            float Roughness = 1.f;
+            Vec3  EmissiveColor;
+            /// @brief Tangent space normal from the normal texture, (0, 0, 1) without one
+            Vec3 TangentNormal{0.f, 0.f, 1.f};
+        };
+
+        /// @brief Mirrors HitSample of foray's material.glsl
+        struct HitSample
+        {
+            Vec3 Normal;
+            Vec3 wOut;
+            Vec3 wIn;
+            Vec3 wHalf;
+        };
+
+        /// @brief Surface attributes of a hit, computed as in the closest hit shader
+        struct SurfaceHit
+        {
+            Vec3          Position;
+            /// @brief Position of the surface point before the last scene update, for motion vectors
+            Vec3          PreviousPosition;
+            Vec3          Normal;
+            MaterialProbe Probe;
+            uint32_t      Material = 0;
+            uint32_t      Instance = 0;
+        };
+
+        /// @param footprint World space width of a pixel at the hit (primary rays), 0 for secondary rays
+        void GetSurface(const CpuHit& hit, SurfaceHit& surface, float footprint = 0.f) const;
+        /// @param lodBias Level of detail of a texture with a single texel (log2 of texel per pixel minus log2 of the texture size), NaN to sample the
+        /// finest resident mip
+        void        ProbeMaterial(const CpuMaterial& material, float u, float v, MaterialProbe& probe, float lodBias) const;
+        bool        ProbeAlphaOpacity(uint32_t triangle, float u, float v) const;
+        bool        IsVisibilityOccluder(uint32_t triangle, float u, float v) const;
+        static Vec3 EvaluateMaterial(const HitSample& hit, const MaterialProbe& probe);
+
+        /// @brief traceRayEXT() with the default hit group and miss shader
+        void TraceRay(const Vec3& origin, const Vec3& direction, Payload& payload, uint64_t& rays) const;
+        /// @brief closesthit.rchit
+        void ClosestHit(const Vec3& direction, const SurfaceHit& surface, Payload& payload, uint64_t& rays) const;
+        Vec3 CollectDirectLight(const Vec3& direction, const SurfaceHit& surface, Payload& payload, uint64_t& rays) const;
+        Vec3 CollectIndirectLight(const Vec3& direction, const SurfaceHit& surface, Payload& payload, uint64_t& rays) const;
+
+        void RenderTile(
+            uint32_t tileIndex, const CpuCamera& camera, const Mat4& previousWorldToCamera, float previousTanHalfFov, uint32_t rngSeed, uint32_t samples, CpuFrame& out) const;
+
+        util::ThreadPool*   mThreadPool      = nullptr;
+        const CpuScene*     mScene           = nullptr;
+        CpuTextureStreamer* mTextureStreamer = nullptr;
+        Bvh4                mBvh;
+        /// @brief Power weighted light selection (LightSampler on the GPU)
+        std::vector<util::AliasEntry> mLightTable;
+        /// @brief Written by the tile tasks of the const render functions
+        mutable std::atomic<uint64_t> mRayCount = 0;
+    };
+
+}  // namespace denoise::cpu
@@ -0,0 +1,156 @@
+#include "cpurenderrunner.hpp"
+#include "../util/timeline.hpp"
+#include "cpupathtracer.hpp"
+#include "cputexturestreamer.hpp"
+#include "exrio.hpp"
+#include "framesource.hpp"
+#include "samplebudget.hpp"
+#include <chrono>
+#include <filesystem>
+#include <foray_logger.hpp>
+
+namespace denoise::cpu {
+
+    /// @brief Upper limit for the texture mips decoded per frame with --texture-budget
+    const uint64_t TEXTURE_STREAM_BYTES_PER_FRAME = 64ull << 20;
+
+    int RunCpuRender(const LaunchOptions& options)
+    {
+        namespace fs = std::filesystem;
+
+        util::ThreadPool threadPool;
+        threadPool.Init(options.CpuThreads);
+
+        CpuScene scene;
+        bool     streamTextures = options.CpuTextureBudget > 0;
+        if(!scene.Load(ResolveScenePath(options.CpuRenderScene), &threadPool, streamTextures)
+           || (!options.CameraPath.empty() && !scene.Load(options.CameraPath, &threadPool, streamTextures)))
+        {
+            return 1;
+        }
+        if(!options.CpuOutputDir.empty())
+        {
+            fs::create_directories(fs::u8path(options.CpuOutputDir));
+        }
+
+        CpuTextureStreamer textureStreamer(&threadPool);
+        if(streamTextures)
+        {
+            textureStreamer.Init(&scene, static_cast<uint64_t>(options.CpuTextureBudget) << 20, TEXTURE_STREAM_BYTES_PER_FRAME);
+        }
+
+        CpuPathTracer pathTracer(&threadPool);
+        scene.Update(0.0);
+        pathTracer.Init(&scene, streamTextures ? &textureStreamer : nullptr);
+
+        uint32_t width  = options.CpuRenderExtent.width;
+        uint32_t height = options.CpuRenderExtent.height;
+        foray::logger()->info("CPU path tracer: {} frames at {}x{}, {} threads", options.CpuRenderFrames, width, height, threadPool.GetConcurrency());
+
+        // Adaptive sampling: the tile noise of a frame decides the paths per pixel of the next one, the first frame spreads the budget evenly
+        bool                  adaptiveSampling = options.CpuAdaptiveSamples > 0.f;
+        SampleBudgetConfig    budgetConfig{.SamplesPerPixel = options.CpuAdaptiveSamples, .MinSamples = 1, .MaxSamples = options.CpuMaxSamples};
+        std::vector<uint32_t> tilePixels;
+        std::vector<uint32_t> tileSamples;
+        std::vector<float>    tileError;
+        uint64_t              pathCount = 0;
+        if(adaptiveSampling)
+        {
+            GetTilePixels(width, height, CpuPathTracer::TILE_SIZE, tilePixels);
+            AllocateSamples(std::vector<float>(tilePixels.size(), 0.f), tilePixels, budgetConfig, tileSamples);
+        }
+
+        CpuFrame  frame;
+        double    renderSeconds  = 0.0;
+        double    updateSeconds  = 0.0;
+        double    streamSeconds  = 0.0;
+        CpuCamera previousCamera = scene.GetCamera(0.0);
+        for(uint32_t i = 0; i < options.CpuRenderFrames; i++)
+        {
+            // Same time steps and seeds as the GPU path (constant animation delta, RngSeed = frame number)
+            double    time    = i * static_cast<double>(ANIMATION_FRAME_DELTA);
+            CpuCamera camera  = scene.GetCamera(time);
+            frame.FrameNumber = i;
+
+            // Frame 0 was posed before the acceleration structure was built
+            auto updateStart = std::chrono::steady_clock::now();
+            {
+                util::TimelineScope scope("Scene Update");
+                if(i > 0 && scene.Update(time))
+                {
+                    pathTracer.OnSceneUpdated();
+                }
+            }
+            updateSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - updateStart).count();
+
+            uint64_t raysBefore = pathTracer.GetRayCount();
+            auto     start      = std::chrono::steady_clock::now();
+            {
+                util::TimelineScope scope("Render");
+                pathTracer.Render(camera, previousCamera, width, height, i, frame, adaptiveSampling ? tileSamples.data() : nullptr);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            renderSeconds += seconds;
+            previousCamera = camera;
+
+            if(adaptiveSampling)
+            {
+                for(size_t tile = 0; tile < tilePixels.size(); tile++)
+                {
+                    pathCount += static_cast<uint64_t>(tileSamples[tile]) * tilePixels[tile];
+                }
+                EstimateTileError(frame.Primary, CpuPathTracer::TILE_SIZE, tileSamples, tileError);
+                AllocateSamples(tileError, tilePixels, budgetConfig, tileSamples);
+            }
+
+            if(streamTextures)
+            {
+                // Mips requested by this frame are decoded while the next one renders
+                auto                streamStart = std::chrono::steady_clock::now();
+                util::TimelineScope scope("Texture Streaming");
+                textureStreamer.EndFrame();
+                streamSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - streamStart).count();
+            }
+            foray::logger()->debug("Frame {}: {:.2f} ms, {:.2f} MRays/s", i, seconds * 1000.0, (pathTracer.GetRayCount() - raysBefore) / seconds * 1e-6);
+
+            if(!options.CpuOutputDir.empty())
+            {
+                util::TimelineScope scope("Write Frame");
+                std::string         stem = fmt::format("{:06}", i);
+                // Positions need full float precision, the other outputs are stored as half like the GPU images
+                bool written = SaveExr(GetExrSequencePath(options.CpuOutputDir, stem, "color"), frame.Primary)
+                               && SaveExr(GetExrSequencePath(options.CpuOutputDir, stem, "albedo"), frame.Albedo)
+                               && SaveExr(GetExrSequencePath(options.CpuOutputDir, stem, "normal"), frame.Normal)
+                               && SaveExr(GetExrSequencePath(options.CpuOutputDir, stem, "position"), frame.Position, false)
+                               && SaveExr(GetExrSequencePath(options.CpuOutputDir, stem, "motion"), frame.Motion, false);
+                if(!written)
+                {
+                    foray::logger()->error("Writing frame #{} to \"{}\" failed", i, options.CpuOutputDir);
+                    return 1;
+                }
+            }
+        }
+
+        if(options.CpuRenderFrames > 0)
+        {
+            foray::logger()->info("CPU path tracer: {} frames in {:.3f} s, {:.2f} ms/frame, {:.2f} MRays/s, scene update {:.3f} ms/frame", options.CpuRenderFrames,
+                                  renderSeconds, renderSeconds * 1000.0 / options.CpuRenderFrames, pathTracer.GetRayCount() / renderSeconds * 1e-6,
+                                  updateSeconds * 1000.0 / options.CpuRenderFrames);
+        }
+        if(adaptiveSampling && options.CpuRenderFrames > 0)
+        {
+            foray::logger()->info("Adaptive sampling: {:.2f} paths per pixel on average (budget {:.2f}, at most {})",
+                                  pathCount / (static_cast<double>(width) * height * options.CpuRenderFrames), options.CpuAdaptiveSamples, options.CpuMaxSamples);
+        }
+        if(streamTextures)
+        {
+            const assets::TextureResidency& residency = textureStreamer.GetResidency();
+            foray::logger()->info("Texture streaming: {:.1f} of {:.1f} MB resident (budget {} MB), {:.1f} MB streamed in, {:.1f} MB evicted, {:.3f} ms/frame",
+                                  residency.GetResidentBytes() / (1024.0 * 1024.0), residency.GetTotalBytes() / (1024.0 * 1024.0), options.CpuTextureBudget,
+                                  residency.GetStreamedBytes() / (1024.0 * 1024.0), residency.GetEvictedBytes() / (1024.0 * 1024.0),
+                                  streamSeconds * 1000.0 / std::max(options.CpuRenderFrames, 1u));
+        }
+        return 0;
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "../launchoptions.hpp"
+
+namespace denoise::cpu {
+
+    /// @brief Renders the scene with the CPU path tracer, optionally writes an EXR sequence (consumable by --cpu-denoise --input) and reports throughput
+    /// @return Process exit code
+    int RunCpuRender(const LaunchOptions& options);
+
+}  // namespace denoise::cpu
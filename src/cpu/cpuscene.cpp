@@ -0,0 +1,766 @@
+#include "cpuscene.hpp"
+#include "../assets/gltfloader.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <foray_logger.hpp>
+#include <tinygltf/tiny_gltf.h>
+
+namespace denoise::cpu {
+
+#pragma region Texture
+
+    void CpuTexture::Sample(float u, float v, float out[4], uint32_t mip) const
+    {
+        const CpuTextureMip& level = Mips[std::max(mip, ResidentMip)];
+
+        float x  = u * level.Width - 0.5f;
+        float y  = v * level.Height - 0.5f;
+        float fx = std::floor(x);
+        float fy = std::floor(y);
+        float tx = x - fx;
+        float ty = y - fy;
+        // Repeat addressing, the modulo of negative coordinates wraps into [0, size)
+        auto wrap = [](int64_t value, uint32_t size) { return static_cast<uint32_t>(((value % (int64_t)size) + size) % size); };
+        uint32_t x0 = wrap(static_cast<int64_t>(fx), level.Width);
+        uint32_t x1 = wrap(static_cast<int64_t>(fx) + 1, level.Width);
+        uint32_t y0 = wrap(static_cast<int64_t>(fy), level.Height);
+        uint32_t y1 = wrap(static_cast<int64_t>(fy) + 1, level.Height);
+        const uint8_t* t00 = &level.Rgba[((size_t)y0 * level.Width + x0) * 4];
+        const uint8_t* t10 = &level.Rgba[((size_t)y0 * level.Width + x1) * 4];
+        const uint8_t* t01 = &level.Rgba[((size_t)y1 * level.Width + x0) * 4];
+        const uint8_t* t11 = &level.Rgba[((size_t)y1 * level.Width + x1) * 4];
+        for(int c = 0; c < 4; c++)
+        {
+            float top    = t00[c] + (t10[c] - t00[c]) * tx;
+            float bottom = t01[c] + (t11[c] - t01[c]) * tx;
+            out[c]       = (top + (bottom - top) * ty) * (1.f / 255.f);
+        }
+    }
+
+    /// @brief Converts an image decoded by tinygltf to 8 bit RGBA
+    bool lConvertToRgba(const tinygltf::Image& image, CpuTextureMip& out)
+    {
+        if(image.image.empty() || image.width <= 0 || image.height <= 0 || image.component < 1 || image.component > 4)
+        {
+            return false;
+        }
+        out.Width  = static_cast<uint32_t>(image.width);
+        out.Height = static_cast<uint32_t>(image.height);
+        out.Rgba.resize((size_t)out.Width * out.Height * 4);
+        uint32_t bytes = image.bits == 16 ? 2 : 1;
+        for(size_t i = 0; i < (size_t)out.Width * out.Height; i++)
+        {
+            for(uint32_t c = 0; c < 4; c++)
+            {
+                uint8_t value = c == 3 ? 255 : 0;
+                if(c < (uint32_t)image.component)
+                {
+                    // Most significant byte of 16 bit (little endian) components
+                    value = image.image[(i * image.component + c) * bytes + bytes - 1];
+                }
+                else if(image.component < 3 && c < 3)
+                {
+                    value = image.image[i * image.component * bytes + bytes - 1];  // Gray replicated into rgb
+                }
+                out.Rgba[i * 4 + c] = value;
+            }
+        }
+        return true;
+    }
+
+    bool CpuTexture::Decode(const std::vector<uint8_t>& encoded, CpuTextureMip& out)
+    {
+        tinygltf::Image image;
+        std::string     error;
+        std::string     warning;
+        if(encoded.empty() || !tinygltf::LoadImageData(&image, 0, &error, &warning, 0, 0, encoded.data(), static_cast<int>(encoded.size()), nullptr))
+        {
+            return false;
+        }
+        return lConvertToRgba(image, out);
+    }
+
+#pragma endregion
+#pragma region glTF access
+
+    /// @brief Reads count x components floats of an accessor (float or normalized integer components)
+    bool lReadAccessor(const tinygltf::Model& model, int32_t accessorIndex, uint32_t components, std::vector<float>& out)
+    {
+        out.clear();
+        if(accessorIndex < 0 || accessorIndex >= (int32_t)model.accessors.size())
+        {
+            return false;
+        }
+        const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+        if(accessor.bufferView < 0 || tinygltf::GetNumComponentsInType(accessor.type) != (int32_t)components)
+        {
+            return false;
+        }
+        const tinygltf::BufferView& view   = model.bufferViews[accessor.bufferView];
+        const uint8_t*              data   = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+        int32_t                     stride = accessor.ByteStride(view);
+        if(stride <= 0)
+        {
+            return false;
+        }
+        out.resize(accessor.count * components);
+        for(size_t i = 0; i < accessor.count; i++)
+        {
+            const uint8_t* element = data + i * stride;
+            for(uint32_t c = 0; c < components; c++)
+            {
+                float value = 0.f;
+                switch(accessor.componentType)
+                {
+                    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                        std::memcpy(&value, element + c * 4, 4);
+                        break;
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                        value = element[c] / 255.f;
+                        break;
+                    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+                        uint16_t raw;
+                        std::memcpy(&raw, element + c * 2, 2);
+                        value = raw / 65535.f;
+                        break;
+                    }
+                    default:
+                        return false;
+                }
+                out[i * components + c] = value;
+            }
+        }
+        return true;
+    }
+
+    bool lReadIndices(const tinygltf::Model& model, int32_t accessorIndex, std::vector<uint32_t>& out)
+    {
+        out.clear();
+        const tinygltf::Accessor&   accessor = model.accessors[accessorIndex];
+        const tinygltf::BufferView& view     = model.bufferViews[accessor.bufferView];
+        const uint8_t*              data     = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+        int32_t                     stride   = accessor.ByteStride(view);
+        out.resize(accessor.count);
+        for(size_t i = 0; i < accessor.count; i++)
+        {
+            switch(accessor.componentType)
+            {
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                    out[i] = data[i * stride];
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+                    uint16_t value;
+                    std::memcpy(&value, data + i * stride, 2);
+                    out[i] = value;
+                    break;
+                }
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                    std::memcpy(&out[i], data + i * stride, 4);
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    int32_t lGetTextureImage(const tinygltf::Model& model, int32_t textureIndex, int32_t imageOffset)
+    {
+        if(textureIndex < 0 || textureIndex >= (int32_t)model.textures.size() || model.textures[textureIndex].source < 0)
+        {
+            return -1;
+        }
+        return imageOffset + model.textures[textureIndex].source;
+    }
+
+    /// @brief Returns an orthogonal vector, used where a mesh has no tangents
+    Vec3 lAnyTangent(const Vec3& normal)
+    {
+        Vec3 axis = std::abs(normal.x) < 0.9f ? Vec3{1.f, 0.f, 0.f} : Vec3{0.f, 1.f, 0.f};
+        return Normalize(Cross(axis, normal));
+    }
+
+#pragma endregion
+#pragma region Load
+
+    bool CpuScene::Load(const std::string& utf8path, util::ThreadPool* threadPool, bool keepEncodedTextures)
+    {
+        tinygltf::Model                   model;
+        std::string                       error;
+        std::string                       warning;
+        assets::GltfLoadTimings           timings;
+        std::vector<std::vector<uint8_t>> encodedImages;
+        if(!assets::LoadGltf(model, utf8path, error, warning, threadPool, &timings, keepEncodedTextures ? &encodedImages : nullptr))
+        {
+            foray::logger()->error("CpuScene: Failed to load \"{}\": {}", utf8path, error);
+            return false;
+        }
+
+        // Textures: convert all decoded images to 8 bit RGBA
+        auto    convertStart = std::chrono::steady_clock::now();
+        int32_t imageOffset  = static_cast<int32_t>(mTextures.size());
+        mTextures.resize(mTextures.size() + model.images.size());
+        threadPool->ParallelFor(
+            static_cast<uint32_t>(model.images.size()),
+            [&](uint32_t index) {
+                CpuTexture& texture = mTextures[imageOffset + index];
+                texture.Mips.resize(1);
+                if(!lConvertToRgba(model.images[index], texture.Mips[0]))
+                {
+                    // Undecodable images become a white texel, so materials still evaluate their factors
+                    texture.Mips[0] = CpuTextureMip{.Width = 1, .Height = 1, .Rgba = {255, 255, 255, 255}};
+                    return;
+                }
+                if(keepEncodedTextures)
+                {
+                    texture.Source = std::move(encodedImages[index]);
+                }
+                model.images[index].image = {};
+            },
+            1);
+        if(!model.images.empty())
+        {
+            foray::logger()->info("CpuScene: \"{}\" parsed in {:.1f} ms, {} images decoded in {:.1f} ms and converted in {:.1f} ms ({} threads)", utf8path,
+                                  timings.ParseSeconds * 1000.0, timings.ImageCount, timings.DecodeSeconds * 1000.0,
+                                  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - convertStart).count(), threadPool->GetConcurrency());
+        }
+
+        uint32_t materialOffset = static_cast<uint32_t>(mMaterials.size());
+        for(const tinygltf::Material& source : model.materials)
+        {
+            CpuMaterial& material = mMaterials.emplace_back();
+            for(size_t c = 0; c < 4 && c < source.pbrMetallicRoughness.baseColorFactor.size(); c++)
+            {
+                material.BaseColorFactor[c] = static_cast<float>(source.pbrMetallicRoughness.baseColorFactor[c]);
+            }
+            material.BaseColorTexture         = lGetTextureImage(model, source.pbrMetallicRoughness.baseColorTexture.index, imageOffset);
+            material.MetallicFactor           = static_cast<float>(source.pbrMetallicRoughness.metallicFactor);
+            material.RoughnessFactor          = static_cast<float>(source.pbrMetallicRoughness.roughnessFactor);
+            material.MetallicRoughnessTexture = lGetTextureImage(model, source.pbrMetallicRoughness.metallicRoughnessTexture.index, imageOffset);
+            material.NormalTexture            = lGetTextureImage(model, source.normalTexture.index, imageOffset);
+            material.EmissiveTexture          = lGetTextureImage(model, source.emissiveTexture.index, imageOffset);
+            for(size_t c = 0; c < 3 && c < source.emissiveFactor.size(); c++)
+            {
+                material.EmissiveFactor[(int)c] = static_cast<float>(source.emissiveFactor[c]);
+            }
+            auto strength = source.extensions.find("KHR_materials_emissive_strength");
+            if(strength != source.extensions.end() && strength->second.Has("emissiveStrength"))
+            {
+                material.EmissiveFactor = material.EmissiveFactor * static_cast<float>(strength->second.Get("emissiveStrength").GetNumberAsDouble());
+            }
+            material.AlphaMode   = source.alphaMode == "MASK" ? EAlphaMode::Mask : (source.alphaMode == "BLEND" ? EAlphaMode::Blend : EAlphaMode::Opaque);
+            material.AlphaCutoff = static_cast<float>(source.alphaCutoff);
+            auto transmission    = source.extensions.find("KHR_materials_transmission");
+            if(transmission != source.extensions.end())
+            {
+                if(transmission->second.Has("transmissionFactor"))
+                {
+                    material.TransmissionFactor = static_cast<float>(transmission->second.Get("transmissionFactor").GetNumberAsDouble());
+                }
+                if(transmission->second.Has("transmissionTexture") && transmission->second.Get("transmissionTexture").Has("index"))
+                {
+                    material.TransmissionTexture = lGetTextureImage(model, transmission->second.Get("transmissionTexture").Get("index").GetNumberAsInt(), imageOffset);
+                }
+            }
+        }
+        // Fallback material for primitives without one
+        uint32_t fallbackMaterial = static_cast<uint32_t>(mMaterials.size());
+        mMaterials.emplace_back();
+
+        // Nodes: local transforms and hierarchy
+        uint32_t nodeOffset = static_cast<uint32_t>(mNodes.size());
+        for(const tinygltf::Node& source : model.nodes)
+        {
+            Node& node = mNodes.emplace_back();
+            if(source.matrix.size() == 16)
+            {
+                node.HasMatrix = true;
+                for(int i = 0; i < 16; i++)
+                {
+                    node.Matrix.m[i] = static_cast<float>(source.matrix[i]);
+                }
+            }
+            for(size_t i = 0; i < source.translation.size() && i < 3; i++)
+            {
+                node.Translation[(int)i] = static_cast<float>(source.translation[i]);
+            }
+            for(size_t i = 0; i < source.rotation.size() && i < 4; i++)
+            {
+                node.Rotation[i] = static_cast<float>(source.rotation[i]);
+            }
+            for(size_t i = 0; i < source.scale.size() && i < 3; i++)
+            {
+                node.Scale[(int)i] = static_cast<float>(source.scale[i]);
+            }
+            if(source.camera >= 0 && source.camera < (int32_t)model.cameras.size())
+            {
+                node.Camera = static_cast<int32_t>(mCameraYFovs.size());
+                mCameraYFovs.push_back(model.cameras[source.camera].type == "perspective" ? static_cast<float>(model.cameras[source.camera].perspective.yfov) : 1.0471976f);
+            }
+        }
+        for(size_t i = 0; i < model.nodes.size(); i++)
+        {
+            for(int32_t child : model.nodes[i].children)
+            {
+                mNodes[nodeOffset + child].Parent = static_cast<int32_t>(nodeOffset + i);
+            }
+        }
+
+        // Animations (the camera path)
+        for(const tinygltf::Animation& animation : model.animations)
+        {
+            for(const tinygltf::AnimationChannel& source : animation.channels)
+            {
+                if(source.target_node < 0 || source.sampler < 0)
+                {
+                    continue;
+                }
+                const tinygltf::AnimationSampler& sampler = animation.samplers[source.sampler];
+                Channel                           channel{.Node = nodeOffset + source.target_node, .Step = sampler.interpolation == "STEP"};
+                uint32_t                          components = 3;
+                if(source.target_path == "rotation")
+                {
+                    channel.Path = EChannelPath::Rotation;
+                    components   = 4;
+                }
+                else if(source.target_path == "scale")
+                {
+                    channel.Path = EChannelPath::Scale;
+                }
+                else if(source.target_path != "translation")
+                {
+                    continue;  // Morph target weights
+                }
+                if(!lReadAccessor(model, sampler.input, 1, channel.Times) || !lReadAccessor(model, sampler.output, components, channel.Values) || channel.Times.empty())
+                {
+                    continue;
+                }
+                if(sampler.interpolation == "CUBICSPLINE")
+                {
+                    // Keys are (in tangent, value, out tangent) triplets, keep the values and interpolate linearly
+                    std::vector<float> values;
+                    for(size_t key = 0; key < channel.Times.size(); key++)
+                    {
+                        values.insert(values.end(), channel.Values.begin() + (key * 3 + 1) * components, channel.Values.begin() + (key * 3 + 2) * components);
+                    }
+                    channel.Values = std::move(values);
+                }
+                if(channel.Values.size() < channel.Times.size() * components)
+                {
+                    continue;
+                }
+                mAnimationDuration = std::max(mAnimationDuration, (double)channel.Times.back());
+                mNodes[channel.Node].Channels.push_back(static_cast<uint32_t>(mChannels.size()));
+                mChannels.push_back(std::move(channel));
+            }
+        }
+
+        // Meshes, flattened to world space with the rest pose
+        uint32_t              firstInstance = static_cast<uint32_t>(mInstances.size());
+        uint32_t              firstLight    = static_cast<uint32_t>(mLights.size());
+        std::vector<float>    positions;
+        std::vector<float>    normals;
+        std::vector<float>    tangents;
+        std::vector<float>    uvs;
+        std::vector<uint32_t> indices;
+        for(size_t nodeIndex = 0; nodeIndex < model.nodes.size(); nodeIndex++)
+        {
+            const tinygltf::Node& node = model.nodes[nodeIndex];
+            Mat4                  world = GetNodeWorldMatrix(nodeOffset + static_cast<uint32_t>(nodeIndex), -1.0);
+
+            auto lightExtension = node.extensions.find("KHR_lights_punctual");
+            if(lightExtension != node.extensions.end() && lightExtension->second.Has("light"))
+            {
+                int32_t lightIndex = lightExtension->second.Get("light").GetNumberAsInt();
+                if(lightIndex >= 0 && lightIndex < (int32_t)model.lights.size())
+                {
+                    const tinygltf::Light& source = model.lights[lightIndex];
+                    CpuLight               light;
+                    light.Type      = source.type == "directional" ? ELightType::Directional : ELightType::Point;
+                    light.Intensity = static_cast<float>(source.intensity);
+                    for(size_t c = 0; c < 3 && c < source.color.size(); c++)
+                    {
+                        light.Color[(int)c] = static_cast<float>(source.color[c]);
+                    }
+                    // Lights shine along their local -z, the stored direction points towards the light
+                    light.PosOrDir = light.Type == ELightType::Directional ? Normalize(world.TransformDirection(Vec3{0.f, 0.f, 1.f})) : world.TransformPoint(Vec3{});
+                    mLights.push_back(light);
+                    mLightNodes.push_back(nodeOffset + static_cast<uint32_t>(nodeIndex));
+                }
+            }
+
+            if(node.mesh < 0)
+            {
+                continue;
+            }
+            for(const tinygltf::Primitive& primitive : model.meshes[node.mesh].primitives)
+            {
+                if(primitive.mode != TINYGLTF_MODE_TRIANGLES || !primitive.attributes.count("POSITION"))
+                {
+                    continue;
+                }
+                if(!lReadAccessor(model, primitive.attributes.at("POSITION"), 3, positions))
+                {
+                    continue;
+                }
+                size_t vertexCount = positions.size() / 3;
+                bool   hasNormals  = primitive.attributes.count("NORMAL") && lReadAccessor(model, primitive.attributes.at("NORMAL"), 3, normals);
+                bool   hasTangents = primitive.attributes.count("TANGENT") && lReadAccessor(model, primitive.attributes.at("TANGENT"), 4, tangents);
+                bool   hasUvs      = primitive.attributes.count("TEXCOORD_0") && lReadAccessor(model, primitive.attributes.at("TEXCOORD_0"), 2, uvs);
+                if(primitive.indices >= 0)
+                {
+                    if(!lReadIndices(model, primitive.indices, indices))
+                    {
+                        continue;
+                    }
+                }
+                else
+                {
+                    indices.resize(vertexCount);
+                    for(uint32_t i = 0; i < vertexCount; i++)
+                    {
+                        indices[i] = i;
+                    }
+                }
+
+                uint32_t vertexOffset = static_cast<uint32_t>(mPositions.size());
+                for(size_t i = 0; i < vertexCount; i++)
+                {
+                    Vec3 position = world.TransformPoint(Vec3{positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]});
+                    mPositions.push_back(position);
+                    mBoundsMin = Min(mBoundsMin, position);
+                    mBoundsMax = Max(mBoundsMax, position);
+
+                    CpuVertex vertex;
+                    if(hasNormals)
+                    {
+                        vertex.Normal = Normalize(world.TransformNormal(Vec3{normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]}));
+                    }
+                    if(hasTangents)
+                    {
+                        vertex.Tangent = Normalize(world.TransformDirection(Vec3{tangents[i * 4], tangents[i * 4 + 1], tangents[i * 4 + 2]}));
+                    }
+                    if(hasUvs)
+                    {
+                        vertex.Uv[0] = uvs[i * 2];
+                        vertex.Uv[1] = uvs[i * 2 + 1];
+                    }
+                    mVertices.push_back(vertex);
+                }
+
+                CpuInstance instance{.Node          = nodeOffset + static_cast<uint32_t>(nodeIndex),
+                                     .FirstVertex   = vertexOffset,
+                                     .VertexCount   = static_cast<uint32_t>(vertexCount),
+                                     .FirstTriangle = static_cast<uint32_t>(mTriangles.size())};
+                uint32_t    material = primitive.material >= 0 ? materialOffset + primitive.material : fallbackMaterial;
+                for(size_t i = 0; i + 2 < indices.size(); i += 3)
+                {
+                    CpuTriangle triangle{.Vertices = {vertexOffset + indices[i], vertexOffset + indices[i + 1], vertexOffset + indices[i + 2]},
+                                         .Material = material,
+                                         .Instance = static_cast<uint32_t>(mInstances.size())};
+                    if(triangle.Vertices[0] >= mPositions.size() || triangle.Vertices[1] >= mPositions.size() || triangle.Vertices[2] >= mPositions.size())
+                    {
+                        continue;
+                    }
+                    mTriangles.push_back(triangle);
+                    if(!hasNormals || !hasTangents)
+                    {
+                        Vec3 faceNormal = Normalize(Cross(mPositions[triangle.Vertices[1]] - mPositions[triangle.Vertices[0]],
+                                                          mPositions[triangle.Vertices[2]] - mPositions[triangle.Vertices[0]]));
+                        for(uint32_t vertex : triangle.Vertices)
+                        {
+                            if(!hasNormals)
+                            {
+                                mVertices[vertex].Normal = faceNormal;
+                            }
+                            if(!hasTangents)
+                            {
+                                mVertices[vertex].Tangent = lAnyTangent(mVertices[vertex].Normal);
+                            }
+                        }
+                    }
+                }
+                instance.TriangleCount = static_cast<uint32_t>(mTriangles.size()) - instance.FirstTriangle;
+                mInstances.push_back(instance);
+            }
+        }
+        PrepareAnimation(nodeOffset, firstInstance, firstLight);
+
+        foray::logger()->info("CpuScene: Loaded \"{}\" ({} triangles, {} materials, {} textures, {} lights total)", utf8path, mTriangles.size(), mMaterials.size(),
+                              mTextures.size(), mLights.size());
+        return true;
+    }
+
+#pragma endregion
+#pragma region Animation
+
+    Mat4 CpuScene::GetNodeLocalMatrix(uint32_t index, double time) const
+    {
+        const Node& node = mNodes[index];
+        if(node.HasMatrix)
+        {
+            return node.Matrix;
+        }
+        Vec3  translation = node.Translation;
+        float rotation[4] = {node.Rotation[0], node.Rotation[1], node.Rotation[2], node.Rotation[3]};
+        Vec3  scale       = node.Scale;
+        for(size_t i = 0; time >= 0.0 && i < node.Channels.size(); i++)
+        {
+            const Channel& channel    = mChannels[node.Channels[i]];
+            uint32_t       components = channel.Path == EChannelPath::Rotation ? 4 : 3;
+            // Key interval containing the time, clamped to the first and last key
+            size_t next = std::upper_bound(channel.Times.begin(), channel.Times.end(), static_cast<float>(time)) - channel.Times.begin();
+            size_t prev = next == 0 ? 0 : next - 1;
+            next        = std::min(next, channel.Times.size() - 1);
+            float t     = 0.f;
+            if(next != prev && !channel.Step)
+            {
+                t = static_cast<float>((time - channel.Times[prev]) / (channel.Times[next] - channel.Times[prev]));
+            }
+            float value[4] = {};
+            float sign     = 1.f;
+            if(channel.Path == EChannelPath::Rotation)
+            {
+                // Shortest path (normalized lerp, close to slerp for dense keys)
+                float dot = 0.f;
+                for(uint32_t c = 0; c < 4; c++)
+                {
+                    dot += channel.Values[prev * 4 + c] * channel.Values[next * 4 + c];
+                }
+                sign = dot < 0.f ? -1.f : 1.f;
+            }
+            for(uint32_t c = 0; c < components; c++)
+            {
+                float a  = channel.Values[prev * components + c];
+                float b  = channel.Values[next * components + c] * sign;
+                value[c] = a + (b - a) * t;
+            }
+            switch(channel.Path)
+            {
+                case EChannelPath::Translation:
+                    translation = Vec3{value[0], value[1], value[2]};
+                    break;
+                case EChannelPath::Scale:
+                    scale = Vec3{value[0], value[1], value[2]};
+                    break;
+                case EChannelPath::Rotation: {
+                    float length = std::sqrt(value[0] * value[0] + value[1] * value[1] + value[2] * value[2] + value[3] * value[3]);
+                    for(uint32_t c = 0; c < 4; c++)
+                    {
+                        rotation[c] = length > 0.f ? value[c] / length : rotation[c];
+                    }
+                    break;
+                }
+            }
+        }
+        return Mat4::FromTrs(translation, rotation, scale);
+    }
+
+    Mat4 CpuScene::GetNodeWorldMatrix(uint32_t nodeIndex, double time) const
+    {
+        Mat4 world;
+        for(int32_t index = static_cast<int32_t>(nodeIndex); index >= 0; index = mNodes[index].Parent)
+        {
+            world = Mat4::Multiply(GetNodeLocalMatrix(static_cast<uint32_t>(index), time), world);
+        }
+        return world;
+    }
+
+    void CpuScene::PrepareAnimation(uint32_t firstNode, uint32_t firstInstance, uint32_t firstLight)
+    {
+        std::vector<uint32_t> depths(mNodes.size() - firstNode, 0);
+        for(uint32_t index = firstNode; index < mNodes.size(); index++)
+        {
+            Node& node = mNodes[index];
+            node.Local = GetNodeLocalMatrix(index, -1.0);
+            node.World = GetNodeWorldMatrix(index, -1.0);
+            for(int32_t ancestor = static_cast<int32_t>(index); ancestor >= 0; ancestor = mNodes[ancestor].Parent)
+            {
+                node.Animated |= !mNodes[ancestor].Channels.empty();
+                depths[index - firstNode] += ancestor != static_cast<int32_t>(index) ? 1 : 0;
+            }
+        }
+
+        // Only nodes that place moving instances or lights are updated, a camera path alone costs nothing
+        std::vector<bool> needed(mNodes.size() - firstNode, false);
+        auto              require = [&](uint32_t index) {
+            for(int32_t node = static_cast<int32_t>(index); node >= 0 && mNodes[node].Animated && !needed[node - firstNode]; node = mNodes[node].Parent)
+            {
+                needed[node - firstNode] = true;
+            }
+        };
+        for(uint32_t index = firstInstance; index < mInstances.size(); index++)
+        {
+            CpuInstance& instance = mInstances[index];
+            if(!mNodes[instance.Node].Animated)
+            {
+                continue;
+            }
+            require(instance.Node);
+            mAnimatedInstances.push_back(index);
+
+            // Keep the vertices in object space, the rest pose is baked into the world space vertices
+            Mat4 worldToObject  = mNodes[instance.Node].World.InverseAffine();
+            instance.RestOffset = static_cast<uint32_t>(mRestPositions.size());
+            for(uint32_t vertex = instance.FirstVertex; vertex < instance.FirstVertex + instance.VertexCount; vertex++)
+            {
+                CpuVertex rest = mVertices[vertex];
+                rest.Normal    = worldToObject.TransformNormal(rest.Normal);
+                rest.Tangent   = worldToObject.TransformDirection(rest.Tangent);
+                mRestPositions.push_back(worldToObject.TransformPoint(mPositions[vertex]));
+                mRestVertices.push_back(rest);
+            }
+        }
+        for(uint32_t index = firstLight; index < mLights.size(); index++)
+        {
+            if(mNodes[mLightNodes[index]].Animated)
+            {
+                require(mLightNodes[index]);
+                mAnimatedLights.push_back(index);
+            }
+        }
+
+        std::vector<uint32_t> ordered;
+        for(uint32_t index = firstNode; index < mNodes.size(); index++)
+        {
+            if(needed[index - firstNode])
+            {
+                ordered.push_back(index);
+            }
+        }
+        std::stable_sort(ordered.begin(), ordered.end(), [&](uint32_t a, uint32_t b) { return depths[a - firstNode] < depths[b - firstNode]; });
+        mAnimatedNodes.insert(mAnimatedNodes.end(), ordered.begin(), ordered.end());
+    }
+
+    bool CpuScene::Update(double time)
+    {
+        mDirtyInstances.clear();
+        if(mAnimatedNodes.empty())
+        {
+            return false;
+        }
+        if(mAnimationDuration > 0.0)
+        {
+            time = std::fmod(time, mAnimationDuration);  // Animations loop
+        }
+
+        // Parents come first, so a dirty parent is known before its children
+        for(uint32_t index : mAnimatedNodes)
+        {
+            Node& node        = mNodes[index];
+            Mat4  local       = GetNodeLocalMatrix(index, time);
+            bool  parentDirty = node.Parent >= 0 && mNodes[node.Parent].Dirty;
+            node.Dirty        = parentDirty || std::memcmp(local.m, node.Local.m, sizeof(local.m)) != 0;
+            if(!node.Dirty)
+            {
+                continue;
+            }
+            node.Local = local;
+            node.World = node.Parent >= 0 ? Mat4::Multiply(mNodes[node.Parent].World, local) : local;
+        }
+        for(uint32_t index : mAnimatedInstances)
+        {
+            if(mNodes[mInstances[index].Node].Dirty)
+            {
+                mDirtyInstances.push_back(index);
+            }
+        }
+
+        // Previous positions only change where vertices moved in this or the last update
+        bool firstUpdate = mPreviousPositions.empty();
+        for(const std::vector<uint32_t>* instances : {&mMovedInstances, &mDirtyInstances})
+        {
+            for(uint32_t index = 0; !firstUpdate && index < instances->size(); index++)
+            {
+                const CpuInstance& instance = mInstances[(*instances)[index]];
+                std::copy_n(mPositions.begin() + instance.FirstVertex, instance.VertexCount, mPreviousPositions.begin() + instance.FirstVertex);
+            }
+        }
+        for(uint32_t index : mDirtyInstances)
+        {
+            const CpuInstance& instance = mInstances[index];
+            const Mat4&        world    = mNodes[instance.Node].World;
+            for(uint32_t i = 0; i < instance.VertexCount; i++)
+            {
+                const CpuVertex& rest   = mRestVertices[instance.RestOffset + i];
+                CpuVertex&       vertex = mVertices[instance.FirstVertex + i];
+                mPositions[instance.FirstVertex + i] = world.TransformPoint(mRestPositions[instance.RestOffset + i]);
+                vertex.Normal                        = Normalize(world.TransformNormal(rest.Normal));
+                vertex.Tangent                       = Normalize(world.TransformDirection(rest.Tangent));
+            }
+        }
+        if(firstUpdate)
+        {
+            mPreviousPositions = mPositions;  // No motion before the first pose
+        }
+        mMovedInstances = mDirtyInstances;
+
+        bool lightsMoved = false;
+        for(uint32_t index : mAnimatedLights)
+        {
+            const Node& node = mNodes[mLightNodes[index]];
+            if(!node.Dirty)
+            {
+                continue;
+            }
+            CpuLight& light = mLights[index];
+            light.PosOrDir  = light.Type == ELightType::Directional ? Normalize(node.World.TransformDirection(Vec3{0.f, 0.f, 1.f})) : node.World.TransformPoint(Vec3{});
+            lightsMoved     = true;
+        }
+        return !mDirtyInstances.empty() || lightsMoved;
+    }
+
+#pragma endregion
+#pragma region Camera
+
+    CpuCamera CpuScene::GetCamera(double time) const
+    {
+        if(mAnimationDuration > 0.0)
+        {
+            time = std::fmod(time, mAnimationDuration);  // Animations loop
+        }
+
+        int32_t selected = -1;
+        for(uint32_t i = 0; i < mNodes.size() && selected < 0; i++)
+        {
+            if(mNodes[i].Camera < 0)
+            {
+                continue;
+            }
+            for(int32_t index = static_cast<int32_t>(i); index >= 0 && selected < 0; index = mNodes[index].Parent)
+            {
+                if(!mNodes[index].Channels.empty())
+                {
+                    selected = static_cast<int32_t>(i);
+                }
+            }
+        }
+        for(uint32_t i = 0; i < mNodes.size() && selected < 0; i++)
+        {
+            if(mNodes[i].Camera >= 0)
+            {
+                selected = static_cast<int32_t>(i);
+            }
+        }
+
+        CpuCamera camera;
+        if(selected >= 0)
+        {
+            camera.CameraToWorld = GetNodeWorldMatrix(static_cast<uint32_t>(selected), time);
+            camera.YFov          = mCameraYFovs[mNodes[selected].Camera];
+            return camera;
+        }
+
+        // No camera: view the scene bounds from +z
+        Vec3  center                = (mBoundsMin + mBoundsMax) * 0.5f;
+        float radius                = Length(mBoundsMax - mBoundsMin) * 0.5f;
+        camera.CameraToWorld.At(0, 3) = center.x;
+        camera.CameraToWorld.At(1, 3) = center.y;
+        camera.CameraToWorld.At(2, 3) = center.z + radius * 2.f;
+        return camera;
+    }
+
+#pragma endregion
+
+}  // namespace denoise::cpu
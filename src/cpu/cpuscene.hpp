@@ -0,0 +1,225 @@
+#pragma once
+
+#include "../util/threadpool.hpp"
+#include "vecmath.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace denoise::cpu {
+
+    struct CpuTextureMip
+    {
+        uint32_t             Width  = 0;
+        uint32_t             Height = 0;
+        std::vector<uint8_t> Rgba;
+    };
+
+    /// @brief 8 bit RGBA texture
+    /// @details Loaded textures only hold mip 0. CpuTextureStreamer adds the mip chain and keeps only mips [ResidentMip, mip count) in memory.
+    struct CpuTexture
+    {
+        /// @brief Finest first. Mips finer than ResidentMip keep their size but no texels
+        std::vector<CpuTextureMip> Mips;
+        uint32_t                   ResidentMip = 0;
+        /// @brief Encoded image (as in the glTF file) the streamer decodes evicted mips from, empty unless kept by CpuScene::Load()
+        std::vector<uint8_t> Source;
+
+        /// @brief Bilinear lookup in mip max(mip, ResidentMip) with repeat addressing, channels in [0, 1] (no color space conversion)
+        void Sample(float u, float v, float out[4], uint32_t mip = 0) const;
+
+        /// @brief Mip for a level of detail (log2 of the texels per pixel), clamped to the mip chain
+        inline uint32_t GetMipForLod(float lod) const
+        {
+            return lod >= 1.f ? std::min(static_cast<uint32_t>(lod), static_cast<uint32_t>(Mips.size()) - 1) : 0;
+        }
+
+        /// @brief Decodes an encoded image (PNG, JPEG, ...) into 8 bit RGBA. Returns false if it can not be decoded
+        static bool Decode(const std::vector<uint8_t>& encoded, CpuTextureMip& out);
+    };
+
+    enum class EAlphaMode
+    {
+        Opaque,
+        Mask,
+        Blend
+    };
+
+    /// @brief glTF metallic roughness material, mirroring foray's MaterialBufferObject
+    struct CpuMaterial
+    {
+        float      BaseColorFactor[4]       = {1.f, 1.f, 1.f, 1.f};
+        int32_t    BaseColorTexture         = -1;
+        float      MetallicFactor           = 1.f;
+        float      RoughnessFactor          = 1.f;
+        int32_t    MetallicRoughnessTexture = -1;
+        Vec3       EmissiveFactor;
+        int32_t    EmissiveTexture = -1;
+        int32_t    NormalTexture   = -1;
+        EAlphaMode AlphaMode       = EAlphaMode::Opaque;
+        float      AlphaCutoff     = 0.5f;
+        /// @brief KHR_materials_transmission. Transmissive surfaces do not occlude light (see the visibility test any-hit shader)
+        float   TransmissionFactor  = 0.f;
+        int32_t TransmissionTexture = -1;
+    };
+
+    /// @brief Shading attributes of a vertex in world space
+    struct CpuVertex
+    {
+        Vec3  Normal;
+        Vec3  Tangent;
+        float Uv[2] = {};
+    };
+
+    struct CpuTriangle
+    {
+        uint32_t Vertices[3] = {};
+        uint32_t Material    = 0;
+        /// @brief Index of the mesh instance (node and primitive) the triangle belongs to
+        uint32_t Instance = 0;
+    };
+
+    enum class ELightType
+    {
+        Directional,
+        Point
+    };
+
+    /// @brief Mirrors foray's SimplifiedLight
+    struct CpuLight
+    {
+        ELightType Type = ELightType::Point;
+        /// @brief World position (point) or direction towards the light (directional)
+        Vec3  PosOrDir;
+        Vec3  Color{1.f, 1.f, 1.f};
+        float Intensity = 1.f;
+    };
+
+    struct CpuCamera
+    {
+        /// @brief Camera to world transform (the camera looks along -z, y up)
+        Mat4  CameraToWorld;
+        float YFov = 1.0471976f;
+    };
+
+    /// @brief Vertices and triangles of one mesh primitive placed by a node
+    struct CpuInstance
+    {
+        uint32_t Node          = 0;
+        uint32_t FirstVertex   = 0;
+        uint32_t VertexCount   = 0;
+        uint32_t FirstTriangle = 0;
+        uint32_t TriangleCount = 0;
+        /// @brief Offset into the object space copy of the vertices, UINT32_MAX if no node above the instance is animated
+        uint32_t RestOffset = UINT32_MAX;
+    };
+
+    /// @brief Triangle soup of one or more glTF files, flattened to world space
+    /// @details Meshes are placed with the rest pose of their nodes. Update() applies the node animations: local transforms of animated nodes are
+    /// compared against the previous update, dirty flags propagate down the hierarchy, and only instances and lights below dirty nodes are
+    /// transformed again. Scenes where only the camera moves (the benchmark camera paths) skip the update entirely.
+    class CpuScene
+    {
+      public:
+        /// @brief Appends the meshes, lights and cameras of all nodes of a glTF file. Returns false (and logs) if it can not be read
+        /// @param threadPool Decodes and converts the textures
+        /// @param keepEncodedTextures Keeps the encoded images in CpuTexture::Source, required by CpuTextureStreamer
+        bool Load(const std::string& utf8path, util::ThreadPool* threadPool = &util::ThreadPool::Shared(), bool keepEncodedTextures = false);
+
+        /// @brief Poses meshes and lights at the animation time (seconds). Returns true if any vertex or light moved since the last update
+        /// @details GetDirtyInstances() lists the instances whose vertices changed, GetPreviousPositions() holds the vertices of the previous update
+        bool Update(double time);
+
+        /// @brief Camera at the animation time (seconds). Prefers an animated camera, then the first camera, then a view of the scene bounds
+        CpuCamera GetCamera(double time) const;
+
+        inline const std::vector<Vec3>&        GetPositions() const { return mPositions; }
+        inline const std::vector<CpuVertex>&   GetVertices() const { return mVertices; }
+        inline const std::vector<CpuTriangle>& GetTriangles() const { return mTriangles; }
+        inline const std::vector<CpuMaterial>& GetMaterials() const { return mMaterials; }
+        inline const std::vector<CpuTexture>&  GetTextures() const { return mTextures; }
+        inline std::vector<CpuTexture>&        GetTextures() { return mTextures; }
+        inline const std::vector<CpuLight>&    GetLights() const { return mLights; }
+        inline uint32_t                        GetInstanceCount() const { return static_cast<uint32_t>(mInstances.size()); }
+        inline const std::vector<CpuInstance>& GetInstances() const { return mInstances; }
+        inline const std::vector<uint32_t>&    GetDirtyInstances() const { return mDirtyInstances; }
+        /// @brief Vertex positions before the last Update() (equal to GetPositions() for vertices that did not move)
+        inline const std::vector<Vec3>&        GetPreviousPositions() const { return mPreviousPositions.empty() ? mPositions : mPreviousPositions; }
+
+      protected:
+        struct Node
+        {
+            int32_t Parent = -1;
+            Mat4    Matrix;
+            bool    HasMatrix   = false;
+            Vec3    Translation;
+            float   Rotation[4] = {0.f, 0.f, 0.f, 1.f};
+            Vec3    Scale{1.f, 1.f, 1.f};
+            int32_t Camera = -1;
+            /// @brief Indices into mChannels targeting the node
+            std::vector<uint32_t> Channels;
+            /// @brief The node or one of its ancestors is targeted by an animation channel
+            bool Animated = false;
+            /// @brief Transforms of the last Update() (rest pose before), only maintained for animated nodes
+            Mat4 Local;
+            Mat4 World;
+            bool Dirty = false;
+        };
+
+        enum class EChannelPath
+        {
+            Translation,
+            Rotation,
+            Scale
+        };
+
+        struct Channel
+        {
+            uint32_t           Node = 0;
+            EChannelPath       Path = EChannelPath::Translation;
+            bool               Step = false;
+            std::vector<float> Times;
+            /// @brief 3 (translation, scale) or 4 (rotation) values per key
+            std::vector<float> Values;
+        };
+
+        /// @brief Local transform at the animation time, the rest pose for negative times
+        Mat4 GetNodeLocalMatrix(uint32_t node, double time) const;
+        Mat4 GetNodeWorldMatrix(uint32_t node, double time) const;
+        /// @brief Flags animated nodes, orders them parents first and keeps object space vertices of the instances below them
+        void PrepareAnimation(uint32_t firstNode, uint32_t firstInstance, uint32_t firstLight);
+
+        std::vector<Vec3>        mPositions;
+        std::vector<CpuVertex>   mVertices;
+        std::vector<CpuTriangle> mTriangles;
+        std::vector<CpuMaterial> mMaterials;
+        std::vector<CpuTexture>  mTextures;
+        std::vector<CpuLight>    mLights;
+        /// @brief Node placing each light
+        std::vector<uint32_t>    mLightNodes;
+        Vec3                     mBoundsMin{1e30f, 1e30f, 1e30f};
+        Vec3                     mBoundsMax{-1e30f, -1e30f, -1e30f};
+
+        /// @brief Nodes of all loaded files (indices offset per file), kept to evaluate the animations
+        std::vector<Node>    mNodes;
+        std::vector<float>   mCameraYFovs;
+        std::vector<Channel> mChannels;
+        double               mAnimationDuration = 0.0;
+
+        std::vector<CpuInstance> mInstances;
+        /// @brief Animated nodes, parents before children
+        std::vector<uint32_t> mAnimatedNodes;
+        /// @brief Instances and lights below animated nodes
+        std::vector<uint32_t> mAnimatedInstances;
+        std::vector<uint32_t> mAnimatedLights;
+        /// @brief Object space vertices of the animated instances (CpuInstance::RestOffset)
+        std::vector<Vec3>      mRestPositions;
+        std::vector<CpuVertex> mRestVertices;
+        std::vector<Vec3>      mPreviousPositions;
+        std::vector<uint32_t>  mDirtyInstances;
+        /// @brief Dirty instances of the update before, their previous positions are refreshed even if they stopped moving
+        std::vector<uint32_t> mMovedInstances;
+    };
+
+}  // namespace denoise::cpu
@@ -0,0 +1,168 @@
+#include "cputexturestreamer.hpp"
+#include <foray_logger.hpp>
+
+namespace denoise::cpu {
+
+    /// @brief 2x2 box filter (odd edges drop their last row or column)
+    void lDownsample(const CpuTextureMip& source, CpuTextureMip& out)
+    {
+        out.Width  = std::max(source.Width / 2, 1u);
+        out.Height = std::max(source.Height / 2, 1u);
+        out.Rgba.resize((size_t)out.Width * out.Height * 4);
+        for(uint32_t y = 0; y < out.Height; y++)
+        {
+            uint32_t y0 = std::min(y * 2, source.Height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, source.Height - 1);
+            for(uint32_t x = 0; x < out.Width; x++)
+            {
+                uint32_t       x0  = std::min(x * 2, source.Width - 1);
+                uint32_t       x1  = std::min(x * 2 + 1, source.Width - 1);
+                const uint8_t* t00 = &source.Rgba[((size_t)y0 * source.Width + x0) * 4];
+                const uint8_t* t10 = &source.Rgba[((size_t)y0 * source.Width + x1) * 4];
+                const uint8_t* t01 = &source.Rgba[((size_t)y1 * source.Width + x0) * 4];
+                const uint8_t* t11 = &source.Rgba[((size_t)y1 * source.Width + x1) * 4];
+                for(uint32_t c = 0; c < 4; c++)
+                {
+                    out.Rgba[((size_t)y * out.Width + x) * 4 + c] = static_cast<uint8_t>((t00[c] + t10[c] + t01[c] + t11[c] + 2) / 4);
+                }
+            }
+        }
+    }
+
+    void CpuTextureStreamer::Init(CpuScene* scene, uint64_t budgetBytes, uint64_t streamBytesPerFrame)
+    {
+        Destroy();
+        mScene = scene;
+        mResidency.Init(budgetBytes, streamBytesPerFrame);
+
+        std::vector<CpuTexture>& textures = scene->GetTextures();
+        std::vector<uint32_t>    tailMips(textures.size());
+        mThreadPool->ParallelFor(
+            static_cast<uint32_t>(textures.size()),
+            [&](uint32_t index) {
+                CpuTexture& texture = textures[index];
+                while(texture.Mips.back().Width > 1 || texture.Mips.back().Height > 1)
+                {
+                    CpuTextureMip mip;
+                    lDownsample(texture.Mips.back(), mip);
+                    texture.Mips.push_back(std::move(mip));
+                }
+                uint32_t tailMip = 0;
+                while(!texture.Source.empty() && std::max(texture.Mips[tailMip].Width, texture.Mips[tailMip].Height) > TAIL_SIZE)
+                {
+                    texture.Mips[tailMip++].Rgba = {};
+                }
+                texture.ResidentMip = tailMip;
+                tailMips[index]     = tailMip;
+            },
+            1);
+
+        for(size_t i = 0; i < textures.size(); i++)
+        {
+            std::vector<uint64_t> mipBytes;
+            for(const CpuTextureMip& mip : textures[i].Mips)
+            {
+                mipBytes.push_back((uint64_t)mip.Width * mip.Height * 4);
+            }
+            mResidency.AddTexture(mipBytes, tailMips[i]);
+        }
+        foray::logger()->info("CpuTextureStreamer: {} textures, {:.1f} of {:.1f} MB resident, budget {:.1f} MB", textures.size(),
+                              mResidency.GetResidentBytes() / (1024.0 * 1024.0), mResidency.GetTotalBytes() / (1024.0 * 1024.0), budgetBytes / (1024.0 * 1024.0));
+    }
+
+    void CpuTextureStreamer::Destroy()
+    {
+        WaitForLoads();
+        mLoads.clear();
+        mScene = nullptr;
+    }
+
+    void CpuTextureStreamer::RunLoad(Load& load) const
+    {
+        const CpuTexture& texture = mScene->GetTextures()[load.Texture];
+        CpuTextureMip     mip;
+        if(!CpuTexture::Decode(texture.Source, mip) || mip.Width != texture.Mips[0].Width || mip.Height != texture.Mips[0].Height)
+        {
+            load.Failed = true;
+            return;
+        }
+        load.Mips.resize(load.FromMip - load.ToMip);
+        for(uint32_t level = 0; level < load.FromMip; level++)
+        {
+            if(level > 0)
+            {
+                CpuTextureMip smaller;
+                lDownsample(mip, smaller);
+                mip = std::move(smaller);
+            }
+            if(level >= load.ToMip)
+            {
+                load.Mips[level - load.ToMip] = mip;
+            }
+        }
+    }
+
+    void CpuTextureStreamer::WaitForLoads()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mLoadsDone.wait(lock, [this]() { return mPendingLoads == 0; });
+    }
+
+    void CpuTextureStreamer::EndFrame()
+    {
+        std::vector<CpuTexture>& textures = mScene->GetTextures();
+
+        WaitForLoads();
+        for(const std::unique_ptr<Load>& load : mLoads)
+        {
+            CpuTexture& texture = textures[load->Texture];
+            if(load->Failed)
+            {
+                // The residency still accounts the mips, the texture keeps sampling coarser ones
+                foray::logger()->warn("CpuTextureStreamer: Decoding texture {} failed", load->Texture);
+                continue;
+            }
+            for(uint32_t level = load->ToMip; level < load->FromMip; level++)
+            {
+                texture.Mips[level] = std::move(load->Mips[level - load->ToMip]);
+            }
+            texture.ResidentMip = load->ToMip;
+        }
+        mLoads.clear();
+
+        std::vector<assets::ResidencyChange> changes;
+        mResidency.Update(changes);
+        for(const assets::ResidencyChange& change : changes)
+        {
+            CpuTexture& texture = textures[change.Texture];
+            if(change.ToMip > change.FromMip)
+            {
+                for(uint32_t level = change.FromMip; level < change.ToMip; level++)
+                {
+                    texture.Mips[level].Rgba = {};
+                }
+                texture.ResidentMip = change.ToMip;
+                continue;
+            }
+            mLoads.push_back(std::make_unique<Load>(Load{.Texture = change.Texture, .FromMip = change.FromMip, .ToMip = change.ToMip}));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPendingLoads = static_cast<uint32_t>(mLoads.size());
+        }
+        for(const std::unique_ptr<Load>& load : mLoads)
+        {
+            Load* task = load.get();
+            mThreadPool->Submit([this, task]() {
+                RunLoad(*task);
+                std::lock_guard<std::mutex> lock(mMutex);
+                if(--mPendingLoads == 0)
+                {
+                    mLoadsDone.notify_all();
+                }
+            });
+        }
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../assets/textureresidency.hpp"
+#include "../util/threadpool.hpp"
+#include "cpuscene.hpp"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace denoise::cpu {
+
+    /// @brief Keeps the textures of a CpuScene within a memory budget
+    /// @details Builds the mip chain of every texture, keeps the mips up to TAIL_SIZE texels resident and streams finer mips in as the path tracer
+    /// requests them (assets::TextureResidency decides what to stream in and evict). Mips are decoded from CpuTexture::Source on the thread pool
+    /// while the next frame renders and become visible at the EndFrame() after, so images do not depend on how long decoding takes.
+    class CpuTextureStreamer
+    {
+      public:
+        /// @brief Largest edge of the mips that are always resident
+        static constexpr uint32_t TAIL_SIZE = 64;
+
+        explicit CpuTextureStreamer(util::ThreadPool* threadPool) : mThreadPool(threadPool) {}
+        ~CpuTextureStreamer() { Destroy(); }
+
+        /// @brief Builds the mip chains and evicts all mips finer than the tails
+        /// @param scene Loaded with keepEncodedTextures (textures without source stay fully resident). Must outlive the streamer
+        /// @param streamBytesPerFrame Upper limit for the mips streamed in per EndFrame()
+        void Init(CpuScene* scene, uint64_t budgetBytes, uint64_t streamBytesPerFrame);
+        /// @brief Waits for loads in flight
+        void Destroy();
+
+        /// @brief Reports a texture lookup wanting mip. Thread safe
+        inline void RequestMip(uint32_t texture, uint32_t mip) { mResidency.RequestMip(texture, mip); }
+
+        /// @brief Call between frames: publishes the mips decoded since the last call, evicts and starts decoding according to the requests of the
+        /// frame just rendered
+        void EndFrame();
+
+        inline const assets::TextureResidency& GetResidency() const { return mResidency; }
+
+      protected:
+        struct Load
+        {
+            uint32_t Texture = 0;
+            uint32_t FromMip = 0;
+            uint32_t ToMip   = 0;
+            /// @brief Decoded mips [ToMip, FromMip)
+            std::vector<CpuTextureMip> Mips;
+            bool                       Failed = false;
+        };
+
+        /// @brief Decodes the source of the texture and downsamples it to the mips of the load
+        void RunLoad(Load& load) const;
+        void WaitForLoads();
+
+        util::ThreadPool*        mThreadPool = nullptr;
+        CpuScene*                mScene      = nullptr;
+        assets::TextureResidency mResidency;
+        /// @brief Loads started by the last EndFrame()
+        std::vector<std::unique_ptr<Load>> mLoads;
+        std::mutex                         mMutex;
+        std::condition_variable            mLoadsDone;
+        uint32_t                           mPendingLoads = 0;
+    };
+
+}  // namespace denoise::cpu
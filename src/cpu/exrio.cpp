@@ -0,0 +1,370 @@
+#include "exrio.hpp"
+#include "../util/half.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <foray_logger.hpp>
+#include <string_view>
+#include <tinyexr/tinyexr.h>
+#include <util/foray_imageloader.hpp>
+
+namespace denoise::cpu {
+
+    namespace {
+        constexpr uint32_t EXR_MAGIC = 20000630;
+        /// @brief Version field flags of files that are not single part scanline images
+        constexpr uint32_t EXR_TILED_FLAG     = 0x200;
+        constexpr uint32_t EXR_NON_IMAGE_FLAG = 0x800;
+        constexpr uint32_t EXR_MULTIPART_FLAG = 0x1000;
+        constexpr int32_t  EXR_PIXEL_HALF     = 1;
+        constexpr int32_t  EXR_PIXEL_FLOAT    = 2;
+
+        template <typename T>
+        bool lRead(const util::MappedFile& file, size_t& offset, T& out)
+        {
+            if(offset + sizeof(T) > file.GetSize())
+            {
+                return false;
+            }
+            std::memcpy(&out, file.GetData() + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        /// @brief Reads a null terminated string ending before end
+        bool lReadString(const util::MappedFile& file, size_t& offset, size_t end, std::string_view& out)
+        {
+            const char* begin      = reinterpret_cast<const char*>(file.GetData());
+            const char* terminator = offset < end ? static_cast<const char*>(std::memchr(begin + offset, 0, end - offset)) : nullptr;
+            if(!terminator)
+            {
+                return false;
+            }
+            out    = std::string_view(begin + offset, terminator - (begin + offset));
+            offset = terminator - begin + 1;
+            return true;
+        }
+
+        template <typename T>
+        void lAppend(std::vector<uint8_t>& bytes, const T& value)
+        {
+            bytes.resize(bytes.size() + sizeof(T));
+            std::memcpy(bytes.data() + bytes.size() - sizeof(T), &value, sizeof(T));
+        }
+
+        void lAppendAttribute(std::vector<uint8_t>& bytes, std::string_view name, std::string_view type, const std::vector<uint8_t>& value)
+        {
+            bytes.insert(bytes.end(), name.begin(), name.end());
+            bytes.push_back(0);
+            bytes.insert(bytes.end(), type.begin(), type.end());
+            bytes.push_back(0);
+            lAppend(bytes, static_cast<uint32_t>(value.size()));
+            bytes.insert(bytes.end(), value.begin(), value.end());
+        }
+
+        template <typename T>
+        std::vector<uint8_t> lBytes(const T& value)
+        {
+            std::vector<uint8_t> bytes;
+            lAppend(bytes, value);
+            return bytes;
+        }
+    }  // namespace
+
+    bool LoadImageFile(const std::string& utf8path, CpuImage& out)
+    {
+        constexpr VkFormat                 format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        foray::util::ImageLoader<format> imageLoader;
+        if(!imageLoader.Init(utf8path) || !imageLoader.Load())
+        {
+            foray::logger()->warn("Loading image failed \"{}\"", utf8path);
+            return false;
+        }
+
+        const VkExtent3D& extent = imageLoader.GetInfo().Extent;
+        out.Resize(extent.width, extent.height);
+        const std::vector<uint8_t>& raw = imageLoader.GetRawData();
+        std::memcpy(out.Texels.data(), raw.data(), std::min(raw.size(), out.Texels.size() * sizeof(float)));
+        imageLoader.Destroy();
+        return true;
+    }
+
+    bool SaveExr(const std::string& utf8path, const CpuImage& image, bool half)
+    {
+        const char* error  = nullptr;
+        int         result = SaveEXR(image.Texels.data(), static_cast<int>(image.Width), static_cast<int>(image.Height), 4, half ? 1 : 0, utf8path.c_str(), &error);
+        if(result != TINYEXR_SUCCESS)
+        {
+            foray::logger()->warn("Writing EXR failed \"{}\": {}", utf8path, !!error ? error : "unknown error");
+            if(!!error)
+            {
+                FreeEXRErrorMessage(error);
+            }
+            return false;
+        }
+        return true;
+    }
+
+    bool ExrRegionReader::Open(const std::string& utf8path)
+    {
+        Close();
+        if(!mFile.Open(utf8path))
+        {
+            return false;
+        }
+
+        size_t   offset  = 0;
+        uint32_t magic   = 0;
+        uint32_t version = 0;
+        if(!lRead(mFile, offset, magic) || !lRead(mFile, offset, version) || magic != EXR_MAGIC
+           || (version & (EXR_TILED_FLAG | EXR_NON_IMAGE_FLAG | EXR_MULTIPART_FLAG)) != 0)
+        {
+            Close();
+            return false;
+        }
+
+        // Attributes: name, type, value size and value, terminated by an empty name
+        int32_t dataWindow[4] = {0, 0, -1, -1};
+        uint8_t compression   = UINT8_MAX;
+        size_t  channelsBegin = 0;
+        size_t  channelsEnd   = 0;
+        while(true)
+        {
+            std::string_view name;
+            std::string_view type;
+            uint32_t         size = 0;
+            if(!lReadString(mFile, offset, mFile.GetSize(), name))
+            {
+                Close();
+                return false;
+            }
+            if(name.empty())
+            {
+                break;
+            }
+            if(!lReadString(mFile, offset, mFile.GetSize(), type) || !lRead(mFile, offset, size) || offset + size > mFile.GetSize())
+            {
+                Close();
+                return false;
+            }
+            if(name == "channels" && type == "chlist")
+            {
+                channelsBegin = offset;
+                channelsEnd   = offset + size;
+            }
+            else if(name == "compression" && size == 1)
+            {
+                compression = mFile.GetData()[offset];
+            }
+            else if(name == "dataWindow" && type == "box2i" && size == sizeof(dataWindow))
+            {
+                std::memcpy(dataWindow, mFile.GetData() + offset, sizeof(dataWindow));
+            }
+            offset += size;
+        }
+        if(compression != 0 || channelsEnd == 0 || dataWindow[2] < dataWindow[0] || dataWindow[3] < dataWindow[1])
+        {
+            Close();
+            return false;
+        }
+        mWidth  = static_cast<uint32_t>(dataWindow[2] - dataWindow[0] + 1);
+        mHeight = static_cast<uint32_t>(dataWindow[3] - dataWindow[1] + 1);
+
+        // Channels are sorted by name, a row chunk holds the row's samples channel after channel behind its row and size fields
+        size_t lineEnd = 2 * sizeof(int32_t);
+        size_t channel = channelsBegin;
+        while(true)
+        {
+            std::string_view name;
+            int32_t          pixelType   = 0;
+            uint32_t         linear      = 0;  // Linear flag and 3 reserved bytes
+            int32_t          sampling[2] = {0, 0};
+            if(!lReadString(mFile, channel, channelsEnd, name))
+            {
+                Close();
+                return false;
+            }
+            if(name.empty())
+            {
+                break;
+            }
+            if(!lRead(mFile, channel, pixelType) || !lRead(mFile, channel, linear) || !lRead(mFile, channel, sampling) || sampling[0] != 1 || sampling[1] != 1)
+            {
+                Close();
+                return false;
+            }
+            const uint32_t sampleSize = pixelType == EXR_PIXEL_HALF ? 2 : 4;
+            const size_t   slot       = std::string_view("RGBA").find(name);
+            if(name.size() == 1 && slot != std::string_view::npos)
+            {
+                if(pixelType != EXR_PIXEL_HALF && pixelType != EXR_PIXEL_FLOAT)
+                {
+                    Close();
+                    return false;
+                }
+                mChannels[slot] = Channel{.LineOffset = lineEnd, .SampleSize = sampleSize};
+            }
+            lineEnd += (size_t)mWidth * sampleSize;
+        }
+
+        // Without compression every row is a chunk of its own, the offset table follows the header
+        mLineOffsets.resize(mHeight);
+        for(uint64_t& lineOffset : mLineOffsets)
+        {
+            if(!lRead(mFile, offset, lineOffset) || lineOffset + lineEnd > mFile.GetSize())
+            {
+                Close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void ExrRegionReader::Close()
+    {
+        mFile.Close();
+        mWidth  = 0;
+        mHeight = 0;
+        std::fill(std::begin(mChannels), std::end(mChannels), Channel{});
+        mLineOffsets.clear();
+    }
+
+    void ExrRegionReader::ReadRow(uint32_t x0, uint32_t x1, uint32_t y, float* rgba) const
+    {
+        const uint8_t* chunk = mFile.GetData() + mLineOffsets[y];
+        for(uint32_t c = 0; c < 4; c++)
+        {
+            const Channel& channel = mChannels[c];
+            const uint8_t* samples = chunk + channel.LineOffset + (size_t)x0 * channel.SampleSize;
+            for(uint32_t i = 0; i < x1 - x0; i++)
+            {
+                float& value = rgba[(size_t)i * 4 + c];
+                if(channel.SampleSize == 2)
+                {
+                    uint16_t half;
+                    std::memcpy(&half, samples + (size_t)i * 2, 2);
+                    value = util::HalfToFloat(half);
+                }
+                else if(channel.SampleSize == 4)
+                {
+                    std::memcpy(&value, samples + (size_t)i * 4, 4);
+                }
+                else
+                {
+                    value = c == 3 ? 1.f : 0.f;
+                }
+            }
+        }
+    }
+
+    bool ExrScanlineWriter::Open(const std::string& utf8path, uint32_t width, uint32_t height, bool half)
+    {
+        mFile.open(std::filesystem::u8path(utf8path), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if(!mFile.is_open())
+        {
+            foray::logger()->warn("Writing EXR failed \"{}\": unable to open", utf8path);
+            return false;
+        }
+        mPath        = utf8path;
+        mWidth       = width;
+        mHeight      = height;
+        mRowsWritten = 0;
+        mHalf        = half;
+
+        std::vector<uint8_t> header;
+        lAppend(header, EXR_MAGIC);
+        lAppend(header, uint32_t(2));
+
+        // Channels sorted by name, linear flag and reserved bytes 0, no subsampling
+        std::vector<uint8_t> channels;
+        for(const char* name : {"A", "B", "G", "R"})
+        {
+            channels.push_back(static_cast<uint8_t>(name[0]));
+            channels.push_back(0);
+            lAppend(channels, half ? EXR_PIXEL_HALF : EXR_PIXEL_FLOAT);
+            lAppend(channels, uint32_t(0));
+            lAppend(channels, int32_t(1));
+            lAppend(channels, int32_t(1));
+        }
+        channels.push_back(0);
+        const int32_t window[4] = {0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1};
+        const float   center[2] = {0.f, 0.f};
+        lAppendAttribute(header, "channels", "chlist", channels);
+        lAppendAttribute(header, "compression", "compression", {0});
+        lAppendAttribute(header, "dataWindow", "box2i", lBytes(window));
+        lAppendAttribute(header, "displayWindow", "box2i", lBytes(window));
+        lAppendAttribute(header, "lineOrder", "lineOrder", {0});
+        lAppendAttribute(header, "pixelAspectRatio", "float", lBytes(1.f));
+        lAppendAttribute(header, "screenWindowCenter", "v2f", lBytes(center));
+        lAppendAttribute(header, "screenWindowWidth", "float", lBytes(1.f));
+        header.push_back(0);
+
+        // Rows are stored uncompressed in a chunk each, so their offsets are known before any row is written
+        const size_t lineBytes   = (size_t)width * 4 * (half ? 2 : 4);
+        uint64_t     chunkOffset = header.size() + (uint64_t)height * sizeof(uint64_t);
+        for(uint32_t y = 0; y < height; y++)
+        {
+            lAppend(header, chunkOffset);
+            chunkOffset += 2 * sizeof(int32_t) + lineBytes;
+        }
+        mLine.resize(2 * sizeof(int32_t) + lineBytes);
+        mFile.write(reinterpret_cast<const char*>(header.data()), header.size());
+        return mFile.good();
+    }
+
+    bool ExrScanlineWriter::WriteRows(const float* rgba, uint32_t rowCount)
+    {
+        if(!mFile.is_open() || mRowsWritten + rowCount > mHeight)
+        {
+            return false;
+        }
+        const uint32_t sampleSize = mHalf ? 2 : 4;
+        const int32_t  lineBytes  = static_cast<int32_t>(mLine.size() - 2 * sizeof(int32_t));
+        for(uint32_t row = 0; row < rowCount; row++)
+        {
+            const int32_t y = static_cast<int32_t>(mRowsWritten + row);
+            std::memcpy(mLine.data(), &y, sizeof(y));
+            std::memcpy(mLine.data() + sizeof(y), &lineBytes, sizeof(lineBytes));
+            const float* texels = rgba + (size_t)row * mWidth * 4;
+            // Channels are stored in name order: A, B, G, R
+            for(uint32_t c = 0; c < 4; c++)
+            {
+                const uint32_t component = 3 - c;
+                uint8_t*       samples   = mLine.data() + 2 * sizeof(int32_t) + (size_t)c * mWidth * sampleSize;
+                for(uint32_t x = 0; x < mWidth; x++)
+                {
+                    const float value = texels[(size_t)x * 4 + component];
+                    if(mHalf)
+                    {
+                        const uint16_t half = util::FloatToHalf(value);
+                        std::memcpy(samples + (size_t)x * 2, &half, 2);
+                    }
+                    else
+                    {
+                        std::memcpy(samples + (size_t)x * 4, &value, 4);
+                    }
+                }
+            }
+            mFile.write(reinterpret_cast<const char*>(mLine.data()), mLine.size());
+        }
+        mRowsWritten += rowCount;
+        return mFile.good();
+    }
+
+    bool ExrScanlineWriter::Close()
+    {
+        if(!mFile.is_open())
+        {
+            return false;
+        }
+        mFile.close();
+        const bool complete = mRowsWritten == mHeight && !mFile.fail();
+        if(!complete)
+        {
+            foray::logger()->warn("Writing EXR failed \"{}\": {} of {} rows written", mPath, mRowsWritten, mHeight);
+        }
+        mLine.clear();
+        return complete;
+    }
+
+}  // namespace denoise::cpu
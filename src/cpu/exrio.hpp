@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../util/mappedfile.hpp"
+#include "cpuimage.hpp"
+#include <fstream>
+#include <string>
+
+namespace denoise::cpu {
+
+    /// @brief Loads an EXR (or any format supported by foray::util::ImageLoader) as RGBA float image
+    bool LoadImageFile(const std::string& utf8path, CpuImage& out);
+
+    /// @brief Writes the image as RGBA EXR
+    /// @param half If true, channels are stored as 16 bit floats
+    bool SaveExr(const std::string& utf8path, const CpuImage& image, bool half = true);
+
+    /// @brief Memory mapped uncompressed scanline EXR, reads rows of a region without decoding the whole image
+    /// @details Only single part scanline files without compression can be addressed by pixel, everything else has to go through LoadImageFile()
+    class ExrRegionReader
+    {
+      public:
+        /// @brief Maps the file and parses its header
+        /// @return False if the file can not be mapped or is not an uncompressed single part scanline EXR with half or float RGBA channels
+        bool Open(const std::string& utf8path);
+        void Close();
+
+        inline bool     IsOpen() const { return mFile.IsOpen(); }
+        inline uint32_t GetWidth() const { return mWidth; }
+        inline uint32_t GetHeight() const { return mHeight; }
+
+        /// @brief Converts pixels [x0, x1) of row y to RGBA floats. Missing color channels read as 0, a missing alpha channel as 1. Thread safe
+        void ReadRow(uint32_t x0, uint32_t x1, uint32_t y, float* rgba) const;
+
+      protected:
+        struct Channel
+        {
+            /// @brief Offset of the channel's samples within a scanline chunk, after the chunk's row and size fields
+            size_t   LineOffset = 0;
+            /// @brief 2 for half, 4 for float samples
+            uint32_t SampleSize = 0;
+        };
+
+        util::MappedFile      mFile;
+        uint32_t              mWidth  = 0;
+        uint32_t              mHeight = 0;
+        /// @brief R, G, B and A, SampleSize 0 for channels the file does not have
+        Channel               mChannels[4];
+        /// @brief File offset of the chunk of every row
+        std::vector<uint64_t> mLineOffsets;
+    };
+
+    /// @brief Writes an uncompressed scanline RGBA EXR top to bottom, so an image can be written in row bands without ever being resident as a whole
+    class ExrScanlineWriter
+    {
+      public:
+        /// @param half If true, channels are stored as 16 bit floats
+        bool Open(const std::string& utf8path, uint32_t width, uint32_t height, bool half = true);
+        /// @brief Appends rowCount rows of Width RGBA texels below the rows written before
+        bool WriteRows(const float* rgba, uint32_t rowCount);
+        /// @return False if writing failed or not all rows were written
+        bool Close();
+
+        inline bool IsOpen() const { return mFile.is_open(); }
+
+      protected:
+        std::ofstream        mFile;
+        std::string          mPath;
+        uint32_t             mWidth       = 0;
+        uint32_t             mHeight      = 0;
+        uint32_t             mRowsWritten = 0;
+        bool                 mHalf        = true;
+        std::vector<uint8_t> mLine;
+    };
+
+}  // namespace denoise::cpu
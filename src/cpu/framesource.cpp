@@ -0,0 +1,302 @@
+#include "framesource.hpp"
+#include "../util/half.hpp"
+#include "exrio.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <foray_logger.hpp>
+#include <vulkan/vulkan.h>
+
+namespace denoise::cpu {
+
+    /// @brief Texel layout of a float capture channel
+    struct CaptureChannelLayout
+    {
+        uint32_t Components = 0;
+        bool     Half       = false;
+    };
+
+    bool lGetChannelLayout(uint32_t format, CaptureChannelLayout& layout)
+    {
+        switch(static_cast<VkFormat>(format))
+        {
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                layout = CaptureChannelLayout{.Components = 4, .Half = true};
+                return true;
+            case VK_FORMAT_R16G16_SFLOAT:
+                layout = CaptureChannelLayout{.Components = 2, .Half = true};
+                return true;
+            case VK_FORMAT_R16_SFLOAT:
+                layout = CaptureChannelLayout{.Components = 1, .Half = true};
+                return true;
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+                layout = CaptureChannelLayout{.Components = 4};
+                return true;
+            case VK_FORMAT_R32G32_SFLOAT:
+                layout = CaptureChannelLayout{.Components = 2};
+                return true;
+            case VK_FORMAT_R32_SFLOAT:
+                layout = CaptureChannelLayout{.Components = 1};
+                return true;
+            default:
+                foray::logger()->warn("Capture channel format {} is not supported by the CPU denoisers", format);
+                return false;
+        }
+    }
+
+    /// @brief Converts pixels [x0, x0 + count) of row y of a channel to RGBA floats, missing components are 0
+    void lConvertRow(const uint8_t* data, const CaptureChannelLayout& layout, uint32_t imageWidth, uint32_t x0, uint32_t y, uint32_t count, float* dst)
+    {
+        const size_t first = (size_t)y * imageWidth + x0;
+        for(size_t i = 0; i < count; i++)
+        {
+            for(uint32_t c = 0; c < 4; c++)
+            {
+                size_t element = (first + i) * layout.Components + c;
+                if(c >= layout.Components)
+                {
+                    dst[i * 4 + c] = 0.f;
+                }
+                else if(layout.Half)
+                {
+                    uint16_t value;
+                    std::memcpy(&value, data + element * 2, 2);
+                    dst[i * 4 + c] = util::HalfToFloat(value);
+                }
+                else
+                {
+                    std::memcpy(&dst[i * 4 + c], data + element * 4, 4);
+                }
+            }
+        }
+    }
+
+    bool lIsIdFormat(uint32_t format)
+    {
+        VkFormat vkFormat = static_cast<VkFormat>(format);
+        if(vkFormat == VK_FORMAT_R32_UINT || vkFormat == VK_FORMAT_R32_SINT || vkFormat == VK_FORMAT_R32_SFLOAT)
+        {
+            return true;
+        }
+        foray::logger()->warn("Capture id channel format {} is not supported by the CPU denoisers", format);
+        return false;
+    }
+
+    /// @brief Ids stay integral. Negative signed or float ids mark pixels without a surface
+    void lConvertIdRow(const uint8_t* data, uint32_t format, uint32_t imageWidth, uint32_t x0, uint32_t y, uint32_t count, uint32_t* dst)
+    {
+        const uint8_t* first = data + ((size_t)y * imageWidth + x0) * 4;
+        switch(static_cast<VkFormat>(format))
+        {
+            case VK_FORMAT_R32_UINT:
+                std::memcpy(dst, first, (size_t)count * sizeof(uint32_t));
+                break;
+            case VK_FORMAT_R32_SINT:
+                for(size_t i = 0; i < count; i++)
+                {
+                    int32_t value;
+                    std::memcpy(&value, first + i * 4, 4);
+                    dst[i] = value < 0 ? CpuIdImage::NO_ID : static_cast<uint32_t>(value);
+                }
+                break;
+            default:
+                for(size_t i = 0; i < count; i++)
+                {
+                    float value;
+                    std::memcpy(&value, first + i * 4, 4);
+                    // Through int64_t, as float ids may exceed the int32_t range (undefined to convert)
+                    dst[i] = value >= 0.f && value < 4294967295.f ? static_cast<uint32_t>(static_cast<int64_t>(value)) : CpuIdImage::NO_ID;
+                }
+                break;
+        }
+    }
+
+    /// @brief Capture channels and EXR sequence AOVs of the CPU denoiser inputs, in the order of lGetChannelTarget()
+    constexpr const char* CAPTURE_CHANNELS[] = {"Noisy", "Albedo", "Normal", "Position", "Motion"};
+    constexpr const char* EXR_AOVS[]         = {"color", "albedo", "normal", "position", "motion"};
+
+    CpuImage* lGetChannelTarget(CpuFrame& frame, size_t channel)
+    {
+        CpuImage* targets[] = {&frame.Primary, &frame.Albedo, &frame.Normal, &frame.Position, &frame.Motion};
+        return targets[channel];
+    }
+
+    bool LoadCaptureFrame(const capture::CaptureReader& reader, uint64_t index, CpuFrame& out)
+    {
+        // The whole frame as a single region, converted on the calling thread (frames are loaded in parallel)
+        CaptureTileSource source(nullptr);
+        return source.Open(reader, index) && source.ReadRegion(TileRect{.X1 = reader.GetWidth(), .Y1 = reader.GetHeight()}, out);
+    }
+
+    bool CaptureTileSource::Open(const capture::CaptureReader& reader, uint64_t index)
+    {
+        mReader = &reader;
+        mView   = reader.GetFrame(index);
+        if(!mView.Header)
+        {
+            return false;
+        }
+        for(size_t i = 0; i < std::size(CAPTURE_CHANNELS); i++)
+        {
+            mChannels[i] = reader.FindChannel(CAPTURE_CHANNELS[i]);
+            if(mChannels[i] < 0)
+            {
+                foray::logger()->warn("Capture is missing channel \"{}\"", CAPTURE_CHANNELS[i]);
+                return false;
+            }
+            CaptureChannelLayout layout;
+            if(!lGetChannelLayout(reader.GetChannels()[mChannels[i]].Format, layout))
+            {
+                return false;
+            }
+        }
+        // Optional, used for reprojection validation
+        mIdChannel = reader.FindChannel("MeshInstanceId");
+        return mIdChannel < 0 || lIsIdFormat(reader.GetChannels()[mIdChannel].Format);
+    }
+
+    bool CaptureTileSource::ReadRegion(const TileRect& region, CpuFrame& frame)
+    {
+        const uint32_t width  = region.GetWidth();
+        const uint32_t height = region.GetHeight();
+        frame.FrameNumber     = mView.Header->FrameNumber;
+        CaptureChannelLayout layouts[std::size(CAPTURE_CHANNELS)];
+        for(size_t i = 0; i < std::size(CAPTURE_CHANNELS); i++)
+        {
+            lGetChannelLayout(mReader->GetChannels()[mChannels[i]].Format, layouts[i]);
+            lGetChannelTarget(frame, i)->Resize(width, height);
+        }
+        frame.MeshInstanceId.Resize(mIdChannel >= 0 ? width : 0, mIdChannel >= 0 ? height : 0);
+
+        auto convertRow = [&](uint32_t row) {
+            const uint32_t y = region.Y0 + row;
+            for(size_t i = 0; i < std::size(CAPTURE_CHANNELS); i++)
+            {
+                lConvertRow(mView.Channels[mChannels[i]], layouts[i], mReader->GetWidth(), region.X0, y, width, lGetChannelTarget(frame, i)->At(0, row));
+            }
+            if(mIdChannel >= 0)
+            {
+                lConvertIdRow(mView.Channels[mIdChannel], mReader->GetChannels()[mIdChannel].Format, mReader->GetWidth(), region.X0, y, width,
+                              &frame.MeshInstanceId.At(0, row));
+            }
+        };
+        if(!mThreadPool)
+        {
+            for(uint32_t row = 0; row < height; row++)
+            {
+                convertRow(row);
+            }
+            return true;
+        }
+        mThreadPool->ParallelFor(height, convertRow);
+        return true;
+    }
+
+    std::vector<ExrSequenceFrame> ListExrSequence(const std::string& directory)
+    {
+        namespace fs = std::filesystem;
+
+        constexpr std::string_view    suffix = ".color.exr";
+        std::vector<ExrSequenceFrame> frames;
+        std::error_code               error;
+        for(const fs::directory_entry& entry : fs::directory_iterator(fs::u8path(directory), error))
+        {
+            std::string name = entry.path().filename().string();
+            if(!entry.is_regular_file() || name.size() <= suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+            {
+                continue;
+            }
+            ExrSequenceFrame frame{.Stem = name.substr(0, name.size() - suffix.size())};
+            auto             result = std::from_chars(frame.Stem.data(), frame.Stem.data() + frame.Stem.size(), frame.FrameNumber);
+            if(result.ec != std::errc() || result.ptr != frame.Stem.data() + frame.Stem.size())
+            {
+                continue;
+            }
+            frames.push_back(std::move(frame));
+        }
+        if(!!error)
+        {
+            foray::logger()->warn("Unable to list EXR sequence \"{}\": {}", directory, error.message());
+        }
+        std::sort(frames.begin(), frames.end(), [](const ExrSequenceFrame& a, const ExrSequenceFrame& b) { return a.FrameNumber < b.FrameNumber; });
+        return frames;
+    }
+
+    std::string GetExrSequencePath(const std::string& directory, const std::string& stem, const char* aov)
+    {
+        return (std::filesystem::u8path(directory) / std::filesystem::u8path(stem + "." + aov + ".exr")).string();
+    }
+
+    bool LoadExrSequenceFrame(const std::string& directory, const ExrSequenceFrame& frame, CpuFrame& out)
+    {
+        out.FrameNumber = frame.FrameNumber;
+        return LoadImageFile(GetExrSequencePath(directory, frame.Stem, "color"), out.Primary) && LoadImageFile(GetExrSequencePath(directory, frame.Stem, "albedo"), out.Albedo)
+               && LoadImageFile(GetExrSequencePath(directory, frame.Stem, "normal"), out.Normal)
+               && LoadImageFile(GetExrSequencePath(directory, frame.Stem, "position"), out.Position)
+               && LoadImageFile(GetExrSequencePath(directory, frame.Stem, "motion"), out.Motion);
+    }
+
+    bool ExrSequenceTileSource::Open(const std::string& directory, const ExrSequenceFrame& frame)
+    {
+        mFrameNumber = frame.FrameNumber;
+        for(size_t i = 0; i < std::size(EXR_AOVS); i++)
+        {
+            Aov&        aov  = mAovs[i];
+            std::string path = GetExrSequencePath(directory, frame.Stem, EXR_AOVS[i]);
+            aov.Decoded      = CpuImage();
+            if(!aov.Reader.Open(path))
+            {
+                foray::logger()->warn("\"{}\" is not an uncompressed scanline EXR and is decoded whole, its memory grows with the resolution", path);
+                if(!LoadImageFile(path, aov.Decoded))
+                {
+                    return false;
+                }
+            }
+            const uint32_t width  = aov.Reader.IsOpen() ? aov.Reader.GetWidth() : aov.Decoded.Width;
+            const uint32_t height = aov.Reader.IsOpen() ? aov.Reader.GetHeight() : aov.Decoded.Height;
+            if(i == 0)
+            {
+                mWidth  = width;
+                mHeight = height;
+            }
+            else if(width != mWidth || height != mHeight)
+            {
+                foray::logger()->warn("\"{}\" is {}x{}, the frame's color is {}x{}", path, width, height, mWidth, mHeight);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ExrSequenceTileSource::ReadRegion(const TileRect& region, CpuFrame& frame)
+    {
+        const uint32_t width  = region.GetWidth();
+        const uint32_t height = region.GetHeight();
+        frame.FrameNumber     = mFrameNumber;
+        for(size_t i = 0; i < std::size(EXR_AOVS); i++)
+        {
+            lGetChannelTarget(frame, i)->Resize(width, height);
+        }
+        frame.MeshInstanceId.Resize(0, 0);
+
+        mThreadPool->ParallelFor(height, [&](uint32_t row) {
+            const uint32_t y = region.Y0 + row;
+            for(size_t i = 0; i < std::size(EXR_AOVS); i++)
+            {
+                const Aov& aov    = mAovs[i];
+                float*     target = lGetChannelTarget(frame, i)->At(0, row);
+                if(aov.Reader.IsOpen())
+                {
+                    aov.Reader.ReadRow(region.X0, region.X1, y, target);
+                }
+                else
+                {
+                    std::copy_n(aov.Decoded.At(region.X0, y), (size_t)width * 4, target);
+                }
+            }
+        });
+        return true;
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../capture/capturefile.hpp"
+#include "cpuimage.hpp"
+#include "exrio.hpp"
+#include "tilesource.hpp"
+#include <array>
+#include <string>
+#include <vector>
+
+namespace denoise::cpu {
+
+    /// @brief Converts frame index of a capture file into CPU denoiser inputs
+    bool LoadCaptureFrame(const capture::CaptureReader& reader, uint64_t index, CpuFrame& out);
+
+    /// @brief Converts regions of a capture frame straight from the mapped file, so only the region is ever resident as float
+    class CaptureTileSource : public TileSource
+    {
+      public:
+        /// @param threadPool Converts the rows of a region in parallel, if null they are converted on the calling thread
+        explicit CaptureTileSource(util::ThreadPool* threadPool = &util::ThreadPool::Shared()) : mThreadPool(threadPool) {}
+
+        /// @brief Resolves the channels of frame index. The reader has to outlive the source
+        bool Open(const capture::CaptureReader& reader, uint64_t index);
+
+        virtual uint32_t GetWidth() const override { return mReader->GetWidth(); }
+        virtual uint32_t GetHeight() const override { return mReader->GetHeight(); }
+        virtual uint64_t GetFrameNumber() const override { return mView.Header->FrameNumber; }
+        virtual bool     ReadRegion(const TileRect& region, CpuFrame& frame) override;
+
+      protected:
+        util::ThreadPool*             mThreadPool = nullptr;
+        const capture::CaptureReader* mReader     = nullptr;
+        capture::FrameView            mView;
+        /// @brief Capture channel of primary, albedo, normal, position and motion
+        std::array<int32_t, 5>        mChannels{};
+        int32_t                       mIdChannel = -1;
+    };
+
+    /// @brief Frame of an EXR sequence directory
+    /// @details A sequence directory holds per frame files "<stem>.color.exr", "<stem>.albedo.exr", "<stem>.normal.exr",
+    /// "<stem>.position.exr" and "<stem>.motion.exr", where stem is the (optionally zero padded) frame number
+    struct ExrSequenceFrame
+    {
+        uint64_t    FrameNumber = 0;
+        std::string Stem;
+    };
+
+    /// @brief Lists all frames of an EXR sequence directory in frame order
+    std::vector<ExrSequenceFrame> ListExrSequence(const std::string& directory);
+    /// @brief Path of an AOV file ("color", "albedo", ...) of a frame in a sequence directory
+    std::string GetExrSequencePath(const std::string& directory, const std::string& stem, const char* aov);
+    bool        LoadExrSequenceFrame(const std::string& directory, const ExrSequenceFrame& frame, CpuFrame& out);
+
+    /// @brief Reads regions of an EXR sequence frame. Uncompressed scanline EXRs are read straight from the mapped files, other AOVs are decoded
+    /// whole when the source is opened
+    class ExrSequenceTileSource : public TileSource
+    {
+      public:
+        explicit ExrSequenceTileSource(util::ThreadPool* threadPool = &util::ThreadPool::Shared()) : mThreadPool(threadPool) {}
+
+        bool Open(const std::string& directory, const ExrSequenceFrame& frame);
+
+        virtual uint32_t GetWidth() const override { return mWidth; }
+        virtual uint32_t GetHeight() const override { return mHeight; }
+        virtual uint64_t GetFrameNumber() const override { return mFrameNumber; }
+        virtual bool     ReadRegion(const TileRect& region, CpuFrame& frame) override;
+
+      protected:
+        struct Aov
+        {
+            ExrRegionReader Reader;
+            /// @brief Used if Reader is not open
+            CpuImage        Decoded;
+        };
+
+        util::ThreadPool*  mThreadPool  = nullptr;
+        uint64_t           mFrameNumber = 0;
+        uint32_t           mWidth       = 0;
+        uint32_t           mHeight      = 0;
+        /// @brief Color, albedo, normal, position and motion
+        std::array<Aov, 5> mAovs;
+    };
+
+}  // namespace denoise::cpu
@@ -0,0 +1,77 @@
+#include "packedgbuffer.hpp"
+#include "cpuimage.hpp"
+#include "cpuscene.hpp"
+#include <cmath>
+#include <cstring>
+
+namespace denoise::cpu {
+
+    GBufferCamera lMakeGBufferCamera(const Mat4& cameraToWorld, const Vec3& corner, const Vec3& stepU, const Vec3& stepV)
+    {
+        return GBufferCamera{.Origin    = cameraToWorld.TransformPoint(Vec3{}),
+                             .Forward   = Normalize(cameraToWorld.TransformDirection(Vec3{0.f, 0.f, -1.f})),
+                             .RayCorner = cameraToWorld.TransformDirection(corner),
+                             .RayStepU  = cameraToWorld.TransformDirection(stepU),
+                             .RayStepV  = cameraToWorld.TransformDirection(stepV)};
+    }
+
+    GBufferCamera GBufferCamera::FromMatrices(const float view[16], const float projection[16])
+    {
+        Mat4 worldToCamera;
+        Mat4 cameraProjection;
+        std::memcpy(worldToCamera.m, view, sizeof(worldToCamera.m));
+        std::memcpy(cameraProjection.m, projection, sizeof(cameraProjection.m));
+
+        // A perspective projection maps camera space (x, y, -1) to NDC ((P00 x - P02), (P11 y - P12)), NDC = 2 * UV - 1
+        float scaleX  = cameraProjection.At(0, 0);
+        float scaleY  = cameraProjection.At(1, 1);
+        float offsetX = cameraProjection.At(0, 2);
+        float offsetY = cameraProjection.At(1, 2);
+        return lMakeGBufferCamera(worldToCamera.InverseAffine(), Vec3{(offsetX - 1.f) / scaleX, (offsetY - 1.f) / scaleY, -1.f}, Vec3{2.f / scaleX, 0.f, 0.f},
+                                  Vec3{0.f, 2.f / scaleY, 0.f});
+    }
+
+    GBufferCamera GBufferCamera::FromCpuCamera(const CpuCamera& camera, float aspect)
+    {
+        // Same rays as CpuPathTracer::RenderTile()
+        float tanHalfFov = std::tan(camera.YFov * 0.5f);
+        return lMakeGBufferCamera(camera.CameraToWorld, Vec3{-tanHalfFov * aspect, tanHalfFov, -1.f}, Vec3{2.f * tanHalfFov * aspect, 0.f, 0.f},
+                                  Vec3{0.f, -2.f * tanHalfFov, 0.f});
+    }
+
+    void PackGBuffer(CpuFrame& frame, const GBufferCamera& camera)
+    {
+        PackedGBuffer& packed = frame.GBuffer;
+        packed.Width          = frame.Primary.Width;
+        packed.Height         = frame.Primary.Height;
+        packed.Camera         = camera;
+        packed.Texels.resize(frame.Primary.GetPixelCount());
+
+        // Ray depth differs from 1 only if the camera transform scales
+        const float inverseRayDepth = 1.f / Dot(camera.RayCorner, camera.Forward);
+        const bool  hasInstanceId   = !frame.MeshInstanceId.IsEmpty();
+        for(uint32_t y = 0; y < packed.Height; y++)
+        {
+            for(uint32_t x = 0; x < packed.Width; x++)
+            {
+                const float*        normal   = frame.Normal.At(x, y);
+                const float*        position = frame.Position.At(x, y);
+                const float*        motion   = frame.Motion.At(x, y);
+                PackedGBufferTexel& texel    = packed.Texels[(size_t)y * packed.Width + x];
+
+                bool hit             = normal[0] != 0.f || normal[1] != 0.f || normal[2] != 0.f;
+                texel.Normal         = util::PackOctNormal(normal);
+                texel.Depth          = hit ? std::max(Dot(Vec3{position[0], position[1], position[2]} - camera.Origin, camera.Forward) * inverseRayDepth, 1e-30f) : 0.f;
+                texel.Motion         = util::PackHalf2(motion[0], motion[1]);
+                texel.MeshInstanceId = hasInstanceId ? frame.MeshInstanceId.At(x, y) : UINT32_MAX;
+            }
+        }
+
+        for(CpuImage* image : {&frame.Normal, &frame.Position, &frame.Motion})
+        {
+            *image = CpuImage();
+        }
+        frame.MeshInstanceId = CpuIdImage();
+    }
+
+}  // namespace denoise::cpu
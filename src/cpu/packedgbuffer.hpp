@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../util/gbufferpacking.hpp"
+#include "vecmath.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace denoise::cpu {
+
+    struct CpuCamera;
+    struct CpuFrame;
+
+    /// @brief Pinhole camera rays of a frame, used to reconstruct world space positions from linear depth
+    struct GBufferCamera
+    {
+        Vec3 Origin;
+        /// @brief Unit view direction, depth is measured along it
+        Vec3 Forward;
+        /// @brief World space ray through UV (u, v) with view depth 1 is RayCorner + u * RayStepU + v * RayStepV
+        Vec3 RayCorner;
+        Vec3 RayStepU;
+        Vec3 RayStepV;
+
+        /// @brief From glm style view and (Vulkan) projection matrices, as stored in capture files
+        static GBufferCamera FromMatrices(const float view[16], const float projection[16]);
+        /// @brief Camera the CPU path tracer renders with
+        static GBufferCamera FromCpuCamera(const CpuCamera& camera, float aspect);
+    };
+
+    /// @brief Packed texel of the compact G-buffer layout (16 instead of 64 bytes for normal, position, motion and mesh instance id)
+    struct PackedGBufferTexel
+    {
+        /// @brief Octahedral normal, 2x16 bit signed normalized (util::PackOctNormal())
+        uint32_t Normal = 0;
+        /// @brief Distance along the camera forward axis, 0 where no surface was hit
+        float Depth = 0.f;
+        /// @brief Screen space motion in UV units, 2x binary16
+        uint32_t Motion = 0;
+        uint32_t MeshInstanceId = UINT32_MAX;
+    };
+    static_assert(sizeof(PackedGBufferTexel) == 16);
+
+    /// @brief Compact G-buffer. Positions are reconstructed from depth and the camera rays, normals decode to within 0.005 degrees and motion keeps
+    /// binary16 precision (below 0.5 pixels for motion of up to half the screen width at 4K).
+    struct PackedGBuffer
+    {
+        uint32_t                        Width  = 0;
+        uint32_t                        Height = 0;
+        GBufferCamera                   Camera;
+        std::vector<PackedGBufferTexel> Texels;
+
+        inline bool   IsEmpty() const { return Texels.empty(); }
+        inline size_t GetByteSize() const { return Texels.size() * sizeof(PackedGBufferTexel); }
+
+        inline const PackedGBufferTexel& At(uint32_t x, uint32_t y) const { return Texels[(size_t)y * Width + x]; }
+
+        inline void DecodeNormal(uint32_t x, uint32_t y, float normal[3]) const
+        {
+            const PackedGBufferTexel& texel = At(x, y);
+            if(texel.Depth <= 0.f)
+            {
+                normal[0] = normal[1] = normal[2] = 0.f;
+                return;
+            }
+            util::UnpackOctNormal(texel.Normal, normal);
+        }
+        inline void DecodePosition(uint32_t x, uint32_t y, float position[3]) const
+        {
+            float depth = At(x, y).Depth;
+            if(depth <= 0.f)
+            {
+                position[0] = position[1] = position[2] = 0.f;
+                return;
+            }
+            float u             = (static_cast<float>(x) + 0.5f) / static_cast<float>(Width);
+            float v             = (static_cast<float>(y) + 0.5f) / static_cast<float>(Height);
+            Vec3  reconstructed = Camera.Origin + (Camera.RayCorner + Camera.RayStepU * u + Camera.RayStepV * v) * depth;
+            position[0]         = reconstructed.x;
+            position[1]         = reconstructed.y;
+            position[2]         = reconstructed.z;
+        }
+        inline void  DecodeMotion(uint32_t x, uint32_t y, float motion[2]) const { util::UnpackHalf2(At(x, y).Motion, motion); }
+        inline uint32_t DecodeMeshInstanceId(uint32_t x, uint32_t y) const { return At(x, y).MeshInstanceId; }
+    };
+
+    /// @brief Packs the G-buffer images of frame into frame.GBuffer and releases them. Positions must have been rendered with camera
+    void PackGBuffer(CpuFrame& frame, const GBufferCamera& camera);
+
+}  // namespace denoise::cpu
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "cpuimage.hpp"
+#include <cmath>
+
+namespace denoise::cpu {
+
+    /// @brief G-buffer of the previous frame, kept by temporal CPU denoisers to validate reprojected samples
+    struct ReprojectionHistory
+    {
+        /// @brief Only the G-buffer (Normal and Position, or the packed GBuffer) and the extent of Primary are kept
+        CpuFrame Geometry;
+        bool     Valid = false;
+
+        inline void Store(const CpuFrame& frame)
+        {
+            Geometry.Primary.Width  = frame.Primary.Width;
+            Geometry.Primary.Height = frame.Primary.Height;
+            Geometry.Normal         = frame.Normal;
+            Geometry.Position       = frame.Position;
+            Geometry.GBuffer        = frame.GBuffer;
+            Valid                   = true;
+        }
+    };
+
+    /// @brief Finds the pixel of the previous frame showing the same surface as pixel (x, y)
+    /// @return Linear pixel index into the previous frame, or -1 if the surface was not visible (disocclusion, off screen or geometry mismatch)
+    inline int64_t ReprojectPixel(const CpuFrame& frame, const ReprojectionHistory& history, uint32_t x, uint32_t y)
+    {
+        const CpuFrame& previous = history.Geometry;
+        if(!history.Valid || previous.Primary.Width != frame.Primary.Width || previous.Primary.Height != frame.Primary.Height)
+        {
+            return -1;
+        }
+        float motion[2];
+        frame.GetMotion(x, y, motion);
+        float prevX = (static_cast<float>(x) + 0.5f) - motion[0] * static_cast<float>(frame.Primary.Width);
+        float prevY = (static_cast<float>(y) + 0.5f) - motion[1] * static_cast<float>(frame.Primary.Height);
+        if(prevX < 0.f || prevY < 0.f || prevX >= static_cast<float>(frame.Primary.Width) || prevY >= static_cast<float>(frame.Primary.Height))
+        {
+            return -1;
+        }
+        uint32_t px = static_cast<uint32_t>(prevX);
+        uint32_t py = static_cast<uint32_t>(prevY);
+
+        float normal[3];
+        float prevNormal[3];
+        frame.GetNormal(x, y, normal);
+        previous.GetNormal(px, py, prevNormal);
+        if(normal[0] * prevNormal[0] + normal[1] * prevNormal[1] + normal[2] * prevNormal[2] < 0.9f)
+        {
+            return -1;
+        }
+
+        float position[3];
+        float prevPosition[3];
+        frame.GetPosition(x, y, position);
+        previous.GetPosition(px, py, prevPosition);
+        float dx = position[0] - prevPosition[0], dy = position[1] - prevPosition[1], dz = position[2] - prevPosition[2];
+        float scale = 1.f + std::sqrt(position[0] * position[0] + position[1] * position[1] + position[2] * position[2]);
+        if(dx * dx + dy * dy + dz * dz > (0.02f * scale) * (0.02f * scale))
+        {
+            return -1;
+        }
+        return (int64_t)py * frame.Primary.Width + px;
+    }
+
+}  // namespace denoise::cpu
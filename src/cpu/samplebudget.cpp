@@ -0,0 +1,159 @@
+#include "samplebudget.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace denoise::cpu {
+
+    void AllocateSamples(const std::vector<float>& tileError, const std::vector<uint32_t>& tilePixels, const SampleBudgetConfig& config, std::vector<uint32_t>& tileSamples)
+    {
+        const size_t   tileCount   = tileError.size();
+        const uint32_t minSamples  = std::min(config.MinSamples, config.MaxSamples);
+        const uint32_t maxSamples  = config.MaxSamples;
+        const uint64_t totalPixels = std::accumulate(tilePixels.begin(), tilePixels.end(), uint64_t(0));
+        const uint64_t budget      = static_cast<uint64_t>(std::max(config.SamplesPerPixel, 0.f) * static_cast<double>(totalPixels));
+
+        tileSamples.assign(tileCount, minSamples);
+        if(budget <= minSamples * totalPixels)
+        {
+            return;
+        }
+        if(budget >= maxSamples * totalPixels)
+        {
+            tileSamples.assign(tileCount, maxSamples);
+            return;
+        }
+
+        // Samples proportional to the square root of the error. Without any error estimate all tiles weigh the same
+        std::vector<double> weights(tileCount);
+        double              maxWeight = 0.0;
+        for(size_t i = 0; i < tileCount; i++)
+        {
+            weights[i] = std::sqrt(std::max(static_cast<double>(tileError[i]), 0.0));
+            maxWeight  = std::max(maxWeight, weights[i]);
+        }
+        if(maxWeight <= 0.0)
+        {
+            std::fill(weights.begin(), weights.end(), 1.0);
+            maxWeight = 1.0;
+        }
+        double minWeight = maxWeight;
+        for(double weight : weights)
+        {
+            minWeight = weight > 0.0 ? std::min(minWeight, weight) : minWeight;
+        }
+
+        auto samplesAt = [&](double scale, size_t tile) { return std::clamp(scale * weights[tile], static_cast<double>(minSamples), static_cast<double>(maxSamples)); };
+        auto costAt    = [&](double scale) {
+            double cost = 0.0;
+            for(size_t i = 0; i < tileCount; i++)
+            {
+                cost += samplesAt(scale, i) * tilePixels[i];
+            }
+            return cost;
+        };
+
+        // At scale maxSamples / minWeight every tile with an error estimate is saturated, tiles without one can not use the rest of the budget
+        double low  = 0.0;
+        double high = maxSamples / minWeight;
+        if(costAt(high) > static_cast<double>(budget))
+        {
+            for(uint32_t iteration = 0; iteration < 64; iteration++)
+            {
+                double middle = 0.5 * (low + high);
+                if(costAt(middle) > static_cast<double>(budget))
+                {
+                    high = middle;
+                }
+                else
+                {
+                    low = middle;
+                }
+            }
+        }
+        else
+        {
+            low = high;
+        }
+
+        // Round down, then hand out the remaining budget by largest fraction
+        uint64_t            spent = 0;
+        std::vector<double> fractions(tileCount);
+        for(size_t i = 0; i < tileCount; i++)
+        {
+            double samples = samplesAt(low, i);
+            tileSamples[i] = static_cast<uint32_t>(samples);
+            fractions[i]   = samples - tileSamples[i];
+            spent += static_cast<uint64_t>(tileSamples[i]) * tilePixels[i];
+        }
+        std::vector<uint32_t> order(tileCount);
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&fractions](uint32_t a, uint32_t b) { return fractions[a] > fractions[b]; });
+        for(uint32_t tile : order)
+        {
+            if(fractions[tile] <= 0.0 || spent >= budget)
+            {
+                break;
+            }
+            if(tileSamples[tile] < maxSamples && spent + tilePixels[tile] <= budget)
+            {
+                tileSamples[tile]++;
+                spent += tilePixels[tile];
+            }
+        }
+    }
+
+    void EstimateTileError(const CpuImage& color, uint32_t tileSize, const std::vector<uint32_t>& tileSamples, std::vector<float>& tileError)
+    {
+        const uint32_t tilesX = (color.Width + tileSize - 1) / tileSize;
+        const uint32_t tilesY = (color.Height + tileSize - 1) / tileSize;
+        tileError.assign((size_t)tilesX * tilesY, 0.f);
+
+        // Noise is compared after Reinhard tonemapping, as that is what ends up on screen (bright tiles would otherwise draw all samples)
+        auto luminance = [&color](uint32_t x, uint32_t y) {
+            const float* texel = color.At(x, y);
+            float        value = 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2];
+            return value / (1.f + value);
+        };
+        for(uint32_t tileY = 0; tileY < tilesY; tileY++)
+        {
+            for(uint32_t tileX = 0; tileX < tilesX; tileX++)
+            {
+                uint32_t endX        = std::min((tileX + 1) * tileSize, color.Width);
+                uint32_t endY        = std::min((tileY + 1) * tileSize, color.Height);
+                double   sumResidual = 0.0;
+                for(uint32_t y = tileY * tileSize; y < endY; y++)
+                {
+                    for(uint32_t x = tileX * tileSize; x < endX; x++)
+                    {
+                        // Neighbours clamp to the image border
+                        float center    = luminance(x, y);
+                        float neighbors = luminance(x > 0 ? x - 1 : x, y) + luminance(x + 1 < color.Width ? x + 1 : x, y) + luminance(x, y > 0 ? y - 1 : y)
+                                          + luminance(x, y + 1 < color.Height ? y + 1 : y);
+                        float residual  = center - neighbors * 0.25f;
+                        sumResidual += residual * residual;
+                    }
+                }
+                size_t tile   = (size_t)tileY * tilesX + tileX;
+                double pixels = static_cast<double>(endX - tileX * tileSize) * (endY - tileY * tileSize);
+                // Measured noise shrinks with the samples per pixel, scale it back to the error of a single sample
+                tileError[tile] = static_cast<float>(sumResidual / pixels * std::max(tileSamples[tile], 1u));
+            }
+        }
+    }
+
+    void GetTilePixels(uint32_t width, uint32_t height, uint32_t tileSize, std::vector<uint32_t>& tilePixels)
+    {
+        const uint32_t tilesX = (width + tileSize - 1) / tileSize;
+        const uint32_t tilesY = (height + tileSize - 1) / tileSize;
+        tilePixels.resize((size_t)tilesX * tilesY);
+        for(uint32_t tileY = 0; tileY < tilesY; tileY++)
+        {
+            for(uint32_t tileX = 0; tileX < tilesX; tileX++)
+            {
+                tilePixels[(size_t)tileY * tilesX + tileX] = (std::min((tileX + 1) * tileSize, width) - tileX * tileSize) * (std::min((tileY + 1) * tileSize, height) - tileY * tileSize);
+            }
+        }
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "cpuimage.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace denoise::cpu {
+
+    struct SampleBudgetConfig
+    {
+        /// @brief Average samples per pixel over the image, the total budget is this times the pixel count
+        float    SamplesPerPixel = 1.f;
+        uint32_t MinSamples      = 1;
+        uint32_t MaxSamples      = 8;
+    };
+
+    /// @brief Distributes a fixed sample budget over tiles
+    /// @details The error of a tile is modelled as tileError / samples per pixel. Minimizing the summed error of all pixels under a fixed total
+    /// yields samples proportional to sqrt(tileError), clamped to [MinSamples, MaxSamples]. The scale is found by bisection, fractions are rounded by
+    /// handing the remaining samples to the tiles with the largest fractional parts, so the total never exceeds the budget (unless SamplesPerPixel is
+    /// below MinSamples, then every tile takes MinSamples). Among tiles of equal size, a larger error never gets fewer samples.
+    /// @param tileError Per sample error estimate per tile (e.g. EstimateTileError()). If all are 0, samples are spread evenly
+    /// @param tilePixels Pixel count per tile
+    /// @param tileSamples Receives the samples per pixel per tile
+    void AllocateSamples(const std::vector<float>& tileError, const std::vector<uint32_t>& tilePixels, const SampleBudgetConfig& config, std::vector<uint32_t>& tileSamples);
+
+    /// @brief Estimates the per sample error of square tiles from a rendered image
+    /// @details Noise is measured as the squared difference of every tonemapped pixel luminance to the mean of its four neighbours, scaled by the
+    /// samples the tile was rendered with. Edges and texture detail count as noise too, which is acceptable as a relative measure between tiles.
+    /// @param tileSamples Samples per pixel the image was rendered with per tile
+    void EstimateTileError(const CpuImage& color, uint32_t tileSize, const std::vector<uint32_t>& tileSamples, std::vector<float>& tileError);
+
+    /// @brief Pixel count of every square tile of an image, in row major tile order
+    void GetTilePixels(uint32_t width, uint32_t height, uint32_t tileSize, std::vector<uint32_t>& tilePixels);
+
+}  // namespace denoise::cpu
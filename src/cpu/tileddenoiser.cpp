@@ -0,0 +1,151 @@
+#include "tileddenoiser.hpp"
+#include <algorithm>
+
+namespace denoise::cpu {
+
+    namespace {
+        uint32_t lAlignUp(uint32_t value, uint32_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+        /// @brief Rises from 0 to 1 across the blend band [boundary - halfBand, boundary + halfBand)
+        float lRamp(uint32_t x, uint32_t boundary, uint32_t halfBand)
+        {
+            if(halfBand == 0)
+            {
+                return x >= boundary ? 1.f : 0.f;
+            }
+            float t = (static_cast<float>(x) + 0.5f - static_cast<float>(boundary) + static_cast<float>(halfBand)) / static_cast<float>(2 * halfBand);
+            return std::clamp(t, 0.f, 1.f);
+        }
+
+        /// @brief Cross fade weight of the tile owning [begin, end) along one axis of length size. Neighbouring tiles' weights add up to 1
+        float lAxisWeight(uint32_t x, uint32_t begin, uint32_t end, uint32_t size, uint32_t halfBand)
+        {
+            float weight = begin > 0 ? lRamp(x, begin, halfBand) : 1.f;
+            return end < size ? weight * (1.f - lRamp(x, end, halfBand)) : weight;
+        }
+    }  // namespace
+
+    CpuTiledDenoiser::CpuTiledDenoiser(std::unique_ptr<CpuDenoiser> denoiser, util::ThreadPool* threadPool, const CpuTiledDenoiserConfig& config)
+        : mDenoiser(std::move(denoiser)), mThreadPool(threadPool), mConfig(config)
+    {
+        uint32_t alignment = std::max(1u, mDenoiser->GetTileAlignment());
+        mTileSize          = lAlignUp(std::max(mConfig.TileSize, 16u), alignment);
+        mConfig.BlendWidth = std::min(mConfig.BlendWidth, mTileSize);
+        mHalo              = lAlignUp(mDenoiser->GetFootprintRadius() + (mConfig.BlendWidth + 1) / 2, alignment);
+    }
+
+    size_t CpuTiledDenoiser::GetTileBufferBytes() const
+    {
+        size_t regionPixels = (size_t)(mTileSize + 2 * mHalo) * (mTileSize + 2 * mHalo);
+        // Primary, albedo, normal, position, motion, mesh instance id and the tile output
+        return regionPixels * 4 * sizeof(float) * 7;
+    }
+
+    size_t CpuTiledDenoiser::GetStripBytes(uint32_t width) const
+    {
+        return (size_t)width * (mTileSize + mConfig.BlendWidth) * 4 * sizeof(float);
+    }
+
+    bool CpuTiledDenoiser::Denoise(TileSource& source, const RowSink& sink)
+    {
+        const uint32_t width    = source.GetWidth();
+        const uint32_t height   = source.GetHeight();
+        const uint32_t halfBand = mConfig.BlendWidth / 2;
+        mStrip.Resize(width, std::min(height, mTileSize + 2 * halfBand));
+        std::fill(mStrip.Texels.begin(), mStrip.Texels.end(), 0.f);
+        mGBufferBytesRead = 0;
+
+        const uint32_t tilesX  = (width + mTileSize - 1) / mTileSize;
+        const uint32_t tilesY  = (height + mTileSize - 1) / mTileSize;
+        uint32_t       stripY0 = 0;
+        for(uint32_t tileY = 0; tileY < tilesY; tileY++)
+        {
+            for(uint32_t tileX = 0; tileX < tilesX; tileX++)
+            {
+                TileRect owned{.X0 = tileX * mTileSize, .Y0 = tileY * mTileSize, .X1 = std::min(width, (tileX + 1) * mTileSize), .Y1 = std::min(height, (tileY + 1) * mTileSize)};
+                TileRect region{.X0 = owned.X0 - std::min(owned.X0, mHalo),
+                                .Y0 = owned.Y0 - std::min(owned.Y0, mHalo),
+                                .X1 = std::min(width, owned.X1 + mHalo),
+                                .Y1 = std::min(height, owned.Y1 + mHalo)};
+                if(!source.ReadRegion(region, mTileFrame))
+                {
+                    return false;
+                }
+                mGBufferBytesRead += mTileFrame.GetGBufferByteSize();
+                RescaleMotion(width, height);
+                // The wrapped denoiser's history belongs to the previous tile
+                mDenoiser->IgnoreHistoryNextFrame();
+                mDenoiser->Denoise(mTileFrame, mTileOutput);
+                BlendTile(region, owned, width, height, stripY0);
+            }
+
+            // Rows above the blend band shared with the next tile row are final. The band moves to the top of the strip
+            const uint32_t finalY = tileY + 1 < tilesY ? (tileY + 1) * mTileSize - halfBand : height;
+            if(!sink(stripY0, finalY - stripY0, mStrip.Texels.data()))
+            {
+                return false;
+            }
+            auto carried = mStrip.Texels.begin() + (size_t)(finalY - stripY0) * width * 4;
+            auto end     = std::copy(carried, mStrip.Texels.end(), mStrip.Texels.begin());
+            std::fill(end, mStrip.Texels.end(), 0.f);
+            stripY0 = finalY;
+        }
+        return true;
+    }
+
+    void CpuTiledDenoiser::Denoise(const CpuFrame& frame, CpuImage& output)
+    {
+        FrameTileSource source(frame, mThreadPool);
+        output.Resize(frame.Primary.Width, frame.Primary.Height);
+        Denoise(source, [&output](uint32_t y, uint32_t rowCount, const float* texels) {
+            std::copy_n(texels, (size_t)rowCount * output.Width * 4, output.At(0, y));
+            return true;
+        });
+    }
+
+    void CpuTiledDenoiser::RescaleMotion(uint32_t width, uint32_t height)
+    {
+        const float scaleX = static_cast<float>(width) / static_cast<float>(mTileFrame.Motion.Width);
+        const float scaleY = static_cast<float>(height) / static_cast<float>(mTileFrame.Motion.Height);
+        mThreadPool->ParallelFor(mTileFrame.Motion.Height, [&](uint32_t row) {
+            for(uint32_t column = 0; column < mTileFrame.Motion.Width; column++)
+            {
+                float* motion = mTileFrame.Motion.At(column, row);
+                motion[0] *= scaleX;
+                motion[1] *= scaleY;
+            }
+        });
+    }
+
+    void CpuTiledDenoiser::BlendTile(const TileRect& region, const TileRect& owned, uint32_t width, uint32_t height, uint32_t stripY0)
+    {
+        const uint32_t halfBand = mConfig.BlendWidth / 2;
+        const uint32_t x0       = owned.X0 - std::min(owned.X0, halfBand);
+        const uint32_t x1       = std::min(width, owned.X1 + halfBand);
+        const uint32_t y0       = owned.Y0 - std::min(owned.Y0, halfBand);
+        const uint32_t y1       = std::min(height, owned.Y1 + halfBand);
+        mThreadPool->ParallelFor(y1 - y0, [&](uint32_t row) {
+            const uint32_t y       = y0 + row;
+            const float    weightY = lAxisWeight(y, owned.Y0, owned.Y1, height, halfBand);
+            if(weightY <= 0.f)
+            {
+                return;
+            }
+            for(uint32_t x = x0; x < x1; x++)
+            {
+                float weight = weightY * lAxisWeight(x, owned.X0, owned.X1, width, halfBand);
+                if(weight <= 0.f)
+                {
+                    continue;
+                }
+                const float* source = mTileOutput.At(x - region.X0, y - region.Y0);
+                float*       target = mStrip.At(x, y - stripY0);
+                for(uint32_t c = 0; c < 4; c++)
+                {
+                    target[c] += source[c] * weight;
+                }
+            }
+        });
+    }
+
+}  // namespace denoise::cpu
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../util/threadpool.hpp"
+#include "cpudenoiser.hpp"
+#include "tilesource.hpp"
+#include <functional>
+#include <memory>
+
+namespace denoise::cpu {
+
+    struct CpuTiledDenoiserConfig
+    {
+        /// @brief Edge length of the output region a tile owns. Rounded up to the tile alignment of the wrapped denoiser
+        uint32_t TileSize = 512;
+        /// @brief Width of the band neighbouring tiles are cross faded over
+        uint32_t BlendWidth = 16;
+    };
+
+    /// @brief Denoises a frame as a sequence of overlapping tiles with a wrapped denoiser, so the denoiser's buffers are sized by the tile
+    /// @details Tiles are processed in scanline order, one at a time, with the same wrapped denoiser instance. Each tile is read from a TileSource
+    /// with a halo of the denoiser's footprint radius (plus half the blend band) around the region it owns, so every pixel it contributes sees the
+    /// same neighbourhood as in the full frame. Tile origins sit on the denoiser's tile alignment, keeping block grids (BMFR) identical. Tile results
+    /// are cross faded with weights forming a partition of unity, hiding seams of denoisers whose footprint is understated.
+    /// Tile results are blended into a strip of one tile row plus the blend band. Rows above the band the next tile row shares are final
+    /// and handed to a RowSink, the band moves to the top of the strip. With a source reading tiles from the input file and a sink writing rows to
+    /// the output file, no buffer holds a whole frame: the tile buffers depend on TileSize only, the strip on TileSize and the frame width.
+    /// The wrapped denoiser's temporal history would be overwritten by the next tile, so every tile is denoised without history (suited for
+    /// stills, e.g. print renders).
+    class CpuTiledDenoiser : public CpuDenoiser
+    {
+      public:
+        CpuTiledDenoiser(std::unique_ptr<CpuDenoiser> denoiser, util::ThreadPool* threadPool = &util::ThreadPool::Shared(), const CpuTiledDenoiserConfig& config = {});
+
+        /// @brief Receives rowCount finished rows of RGBA texels starting at row y, top to bottom. Returns false to abort
+        using RowSink = std::function<bool(uint32_t y, uint32_t rowCount, const float* texels)>;
+
+        /// @brief Denoises a frame that is read tile by tile, finished rows go to sink
+        /// @return False if reading a tile failed or sink returned false
+        bool Denoise(TileSource& source, const RowSink& sink);
+
+        virtual void        Denoise(const CpuFrame& frame, CpuImage& output) override;
+        virtual std::string GetUILabel() const override { return mDenoiser->GetUILabel() + " tiled"; }
+        virtual uint32_t    GetFootprintRadius() const override { return mDenoiser->GetFootprintRadius(); }
+
+        /// @brief Output region edge length of a tile
+        inline uint32_t GetTileSize() const { return mTileSize; }
+        /// @brief Pixels cropped around the output region of a tile
+        inline uint32_t GetHalo() const { return mHalo; }
+        /// @brief Bytes of the cropped inputs and tile output, the wrapped denoiser's buffers come on top (also sized by the tile)
+        size_t GetTileBufferBytes() const;
+        /// @brief Bytes of the output strip for frames of this width
+        size_t GetStripBytes(uint32_t width) const;
+        /// @brief G-buffer bytes the last Denoise() read, halos included
+        inline size_t GetGBufferBytesRead() const { return mGBufferBytesRead; }
+
+      protected:
+        /// @brief Rescales the motion of mTileFrame from UV units of the frame to UV units of the tile
+        void RescaleMotion(uint32_t width, uint32_t height);
+        /// @brief Adds the owned region (plus blend band) of mTileOutput into mStrip, weighted by the cross fade
+        void BlendTile(const TileRect& region, const TileRect& owned, uint32_t width, uint32_t height, uint32_t stripY0);
+
+        std::unique_ptr<CpuDenoiser> mDenoiser;
+        util::ThreadPool*            mThreadPool = nullptr;
+        CpuTiledDenoiserConfig       mConfig;
+        uint32_t                     mTileSize         = 0;
+        uint32_t                     mHalo             = 0;
+        size_t                       mGBufferBytesRead = 0;
+
+        CpuFrame mTileFrame;
+        CpuImage mTileOutput;
+        /// @brief Rows of the frame that tiles of the current row blend into, top row is the first row not handed to the sink yet
+        CpuImage mStrip;
+    };
+
+}  // namespace denoise::cpu
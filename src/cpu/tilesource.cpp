@@ -0,0 +1,56 @@
+#include "tilesource.hpp"
+
+namespace denoise::cpu {
+
+    namespace {
+        void lCropImage(const CpuImage& source, uint32_t x0, uint32_t y, uint32_t width, uint32_t row, CpuImage& target)
+        {
+            if(!source.IsEmpty())
+            {
+                std::copy_n(source.At(x0, y), (size_t)width * 4, target.At(0, row));
+            }
+        }
+    }  // namespace
+
+    bool FrameTileSource::ReadRegion(const TileRect& region, CpuFrame& frame)
+    {
+        const uint32_t width      = region.GetWidth();
+        const uint32_t height     = region.GetHeight();
+        const bool     packed     = mFrame.IsGBufferPacked();
+        const bool     hasMeshIds = !mFrame.MeshInstanceId.IsEmpty() || packed;
+        frame.FrameNumber         = mFrame.FrameNumber;
+        frame.Primary.Resize(width, height);
+        frame.Albedo.Resize(width, height);
+        frame.Normal.Resize(width, height);
+        frame.Position.Resize(width, height);
+        frame.Motion.Resize(width, height);
+        frame.MeshInstanceId.Resize(hasMeshIds ? width : 0, hasMeshIds ? height : 0);
+
+        mThreadPool->ParallelFor(height, [&](uint32_t row) {
+            const uint32_t y = region.Y0 + row;
+            lCropImage(mFrame.Primary, region.X0, y, width, row, frame.Primary);
+            lCropImage(mFrame.Albedo, region.X0, y, width, row, frame.Albedo);
+            if(!packed)
+            {
+                lCropImage(mFrame.Normal, region.X0, y, width, row, frame.Normal);
+                lCropImage(mFrame.Position, region.X0, y, width, row, frame.Position);
+                lCropImage(mFrame.Motion, region.X0, y, width, row, frame.Motion);
+                if(hasMeshIds)
+                {
+                    std::copy_n(&mFrame.MeshInstanceId.At(region.X0, y), width, &frame.MeshInstanceId.At(0, row));
+                }
+                return;
+            }
+            for(uint32_t column = 0; column < width; column++)
+            {
+                const uint32_t x = region.X0 + column;
+                mFrame.GBuffer.DecodeNormal(x, y, frame.Normal.At(column, row));
+                mFrame.GBuffer.DecodePosition(x, y, frame.Position.At(column, row));
+                mFrame.GBuffer.DecodeMotion(x, y, frame.Motion.At(column, row));
+                frame.MeshInstanceId.At(column, row) = mFrame.GBuffer.DecodeMeshInstanceId(x, y);
+            }
+        });
+        return true;
+    }
+
+}  // namespace denoise::cpu
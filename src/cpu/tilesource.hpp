@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../util/threadpool.hpp"
+#include "cpuimage.hpp"
+
+namespace denoise::cpu {
+
+    /// @brief Axis aligned pixel rectangle, maximum exclusive
+    struct TileRect
+    {
+        uint32_t X0 = 0;
+        uint32_t Y0 = 0;
+        uint32_t X1 = 0;
+        uint32_t Y1 = 0;
+
+        inline uint32_t GetWidth() const { return X1 - X0; }
+        inline uint32_t GetHeight() const { return Y1 - Y0; }
+    };
+
+    /// @brief Frame the tiled denoiser reads one region at a time, so the frame never has to be resident as a whole
+    class TileSource
+    {
+      public:
+        virtual ~TileSource() = default;
+
+        virtual uint32_t GetWidth() const = 0;
+        virtual uint32_t GetHeight() const = 0;
+        virtual uint64_t GetFrameNumber() const = 0;
+        /// @brief Reads the region into the full precision layout of frame, resizing its images to the region. Motion stays in UV units of the
+        /// whole frame. Mesh instance ids are left empty if the frame has none
+        virtual bool     ReadRegion(const TileRect& region, CpuFrame& frame) = 0;
+    };
+
+    /// @brief Regions of a frame that is resident anyway, packed G-buffers are decoded
+    class FrameTileSource : public TileSource
+    {
+      public:
+        explicit FrameTileSource(const CpuFrame& frame, util::ThreadPool* threadPool = &util::ThreadPool::Shared()) : mFrame(frame), mThreadPool(threadPool) {}
+
+        virtual uint32_t GetWidth() const override { return mFrame.Primary.Width; }
+        virtual uint32_t GetHeight() const override { return mFrame.Primary.Height; }
+        virtual uint64_t GetFrameNumber() const override { return mFrame.FrameNumber; }
+        virtual bool     ReadRegion(const TileRect& region, CpuFrame& frame) override;
+
+      protected:
+        const CpuFrame&   mFrame;
+        util::ThreadPool* mThreadPool = nullptr;
+    };
+
+}  // namespace denoise::cpu
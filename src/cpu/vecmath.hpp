@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+namespace denoise::cpu {
+
+    /// @brief Minimal 3 component vector for the CPU renderer (the GPU side uses glm, which is not required for CPU only builds)
+    struct Vec3
+    {
+        float x = 0.f;
+        float y = 0.f;
+        float z = 0.f;
+
+        inline float&       operator[](int i) { return (&x)[i]; }
+        inline const float& operator[](int i) const { return (&x)[i]; }
+    };
+
+    inline Vec3  operator+(const Vec3& a, const Vec3& b) { return Vec3{a.x + b.x, a.y + b.y, a.z + b.z}; }
+    inline Vec3  operator-(const Vec3& a, const Vec3& b) { return Vec3{a.x - b.x, a.y - b.y, a.z - b.z}; }
+    inline Vec3  operator-(const Vec3& a) { return Vec3{-a.x, -a.y, -a.z}; }
+    inline Vec3  operator*(const Vec3& a, const Vec3& b) { return Vec3{a.x * b.x, a.y * b.y, a.z * b.z}; }
+    inline Vec3  operator*(const Vec3& a, float s) { return Vec3{a.x * s, a.y * s, a.z * s}; }
+    inline Vec3  operator*(float s, const Vec3& a) { return a * s; }
+    inline Vec3  operator/(const Vec3& a, float s) { return a * (1.f / s); }
+    inline Vec3& operator+=(Vec3& a, const Vec3& b) { return a = a + b; }
+    inline Vec3& operator*=(Vec3& a, const Vec3& b) { return a = a * b; }
+
+    inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline Vec3  Cross(const Vec3& a, const Vec3& b) { return Vec3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+    inline float Length(const Vec3& a) { return std::sqrt(Dot(a, a)); }
+    inline Vec3  Normalize(const Vec3& a)
+    {
+        float length = Length(a);
+        return length > 0.f ? a / length : a;
+    }
+    inline Vec3 Min(const Vec3& a, const Vec3& b) { return Vec3{std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)}; }
+    inline Vec3 Max(const Vec3& a, const Vec3& b) { return Vec3{std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)}; }
+    /// @brief Reflects the incident direction at the plane with the given normal (GLSL reflect())
+    inline Vec3 Reflect(const Vec3& incident, const Vec3& normal) { return incident - normal * (2.f * Dot(normal, incident)); }
+
+    /// @brief Column major 4x4 matrix (glTF and GLSL layout)
+    struct Mat4
+    {
+        float m[16] = {1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f};
+
+        inline float&       At(int row, int column) { return m[column * 4 + row]; }
+        inline const float& At(int row, int column) const { return m[column * 4 + row]; }
+
+        inline Vec3 TransformPoint(const Vec3& p) const
+        {
+            return Vec3{At(0, 0) * p.x + At(0, 1) * p.y + At(0, 2) * p.z + At(0, 3), At(1, 0) * p.x + At(1, 1) * p.y + At(1, 2) * p.z + At(1, 3),
+                        At(2, 0) * p.x + At(2, 1) * p.y + At(2, 2) * p.z + At(2, 3)};
+        }
+        inline Vec3 TransformDirection(const Vec3& d) const
+        {
+            return Vec3{At(0, 0) * d.x + At(0, 1) * d.y + At(0, 2) * d.z, At(1, 0) * d.x + At(1, 1) * d.y + At(1, 2) * d.z,
+                        At(2, 0) * d.x + At(2, 1) * d.y + At(2, 2) * d.z};
+        }
+        /// @brief Transforms a normal by the inverse transpose of the upper 3x3 (unnormalized)
+        inline Vec3 TransformNormal(const Vec3& n) const
+        {
+            Vec3 c0{At(0, 0), At(1, 0), At(2, 0)};
+            Vec3 c1{At(0, 1), At(1, 1), At(2, 1)};
+            Vec3 c2{At(0, 2), At(1, 2), At(2, 2)};
+            // The cofactor matrix equals the inverse transpose up to the (positive or negative) determinant
+            Vec3  r0  = Cross(c1, c2);
+            Vec3  r1  = Cross(c2, c0);
+            Vec3  r2  = Cross(c0, c1);
+            float det = Dot(c0, r0);
+            Vec3  result{r0.x * n.x + r1.x * n.y + r2.x * n.z, r0.y * n.x + r1.y * n.y + r2.y * n.z, r0.z * n.x + r1.z * n.y + r2.z * n.z};
+            return det < 0.f ? -result : result;
+        }
+
+        /// @brief Inverse of an affine transform (the last row is assumed to be 0, 0, 0, 1)
+        inline Mat4 InverseAffine() const
+        {
+            Vec3  c0{At(0, 0), At(1, 0), At(2, 0)};
+            Vec3  c1{At(0, 1), At(1, 1), At(2, 1)};
+            Vec3  c2{At(0, 2), At(1, 2), At(2, 2)};
+            Vec3  r0  = Cross(c1, c2);
+            Vec3  r1  = Cross(c2, c0);
+            Vec3  r2  = Cross(c0, c1);
+            float det = Dot(c0, r0);
+            float inv = det != 0.f ? 1.f / det : 0.f;
+            Mat4  result;
+            for(int column = 0; column < 3; column++)
+            {
+                result.At(0, column) = r0[column] * inv;
+                result.At(1, column) = r1[column] * inv;
+                result.At(2, column) = r2[column] * inv;
+            }
+            Vec3 translation = result.TransformDirection(Vec3{At(0, 3), At(1, 3), At(2, 3)});
+            result.At(0, 3)  = -translation.x;
+            result.At(1, 3)  = -translation.y;
+            result.At(2, 3)  = -translation.z;
+            return result;
+        }
+
+        static Mat4 Multiply(const Mat4& a, const Mat4& b)
+        {
+            Mat4 result;
+            for(int column = 0; column < 4; column++)
+            {
+                for(int row = 0; row < 4; row++)
+                {
+                    float sum = 0.f;
+                    for(int k = 0; k < 4; k++)
+                    {
+                        sum += a.At(row, k) * b.At(k, column);
+                    }
+                    result.At(row, column) = sum;
+                }
+            }
+            return result;
+        }
+
+        /// @brief Composes translation * rotation (quaternion xyzw) * scale
+        static Mat4 FromTrs(const Vec3& t, const float q[4], const Vec3& s)
+        {
+            float x = q[0], y = q[1], z = q[2], w = q[3];
+            Mat4  result;
+            result.At(0, 0) = (1.f - 2.f * (y * y + z * z)) * s.x;
+            result.At(1, 0) = (2.f * (x * y + z * w)) * s.x;
+            result.At(2, 0) = (2.f * (x * z - y * w)) * s.x;
+            result.At(0, 1) = (2.f * (x * y - z * w)) * s.y;
+            result.At(1, 1) = (1.f - 2.f * (x * x + z * z)) * s.y;
+            result.At(2, 1) = (2.f * (y * z + x * w)) * s.y;
+            result.At(0, 2) = (2.f * (x * z + y * w)) * s.z;
+            result.At(1, 2) = (2.f * (y * z - x * w)) * s.z;
+            result.At(2, 2) = (1.f - 2.f * (x * x + y * y)) * s.z;
+            result.At(0, 3) = t.x;
+            result.At(1, 3) = t.y;
+            result.At(2, 3) = t.z;
+            return result;
+        }
+    };
+
+}  // namespace denoise::cpu
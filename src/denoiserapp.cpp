@@ -1,11 +1,15 @@
 #include "denoiserapp.hpp"
 #include <bench/foray_hostbenchmark.hpp>
+#include <cctype>
+#include <chrono>
 #include <filesystem>
+#include <glm/gtc/type_ptr.hpp>
 #include <gltf/foray_modelconverter.hpp>
 #include <imgui/imgui.h>
 #include <scene/components/foray_camera.hpp>
 #include <scene/globalcomponents/foray_animationmanager.hpp>
 #include <scene/globalcomponents/foray_cameramanager.hpp>
+#include <set>
 #include <util/foray_imageloader.hpp>
 
 namespace denoise {
@@ -14,7 +18,8 @@ namespace denoise {
 
     void DenoiserApp::ApiBeforeInit()
     {
-        mAuxiliaryCommandBufferCount = 1;
+        // Aux 0 records tracing, aux 1 the handoff to a pipelined external denoiser
+        mAuxiliaryCommandBufferCount = 2;
 #ifdef SHADER_PRINTF
         mInstance.SetEnableDebugReport(true);
 #else
@@ -52,58 +57,167 @@ namespace denoise {
 
     void DenoiserApp::ApiInit()
     {
-        // LoadEnvironmentMap(); Current Testing scene does not use an environment map
-        LoadScene();
+        if(mOptions.Bench)
+        {
+            InitBenchMode();
+        }
+        mPipelineExternalDenoise = mOptions.PipelineExternalDenoise;
+
+        if(!mOptions.SceneCacheDir.empty())
+        {
+            mSceneCache.Init(mOptions.SceneCacheDir);
+        }
+
+        if(!mOptions.EnvMapPath.empty())
+        {
+            LoadEnvironmentMap();
+        }
+        std::string scenePath = SCENE_PATH;
+        if(!!mBenchRunner)
+        {
+            scenePath = mBenchRunner->GetCurrentCase().ScenePath;
+        }
+        else if(mOptions.Scenes.size() > 0)
+        {
+            scenePath = ResolveScenePath(mOptions.Scenes.front());
+        }
+        ReloadScene(scenePath);
+        mRaytraycingStage.SetAccumulationSupported(!mOptions.GenerateReferenceDir.empty());
+        mRaytraycingStage.SetRenderScaleSupported(mOptions.TargetFrameTime > 0.f);
+        mRaytraycingStage.SetEnvironmentMap(mEnvMap.Exists() ? &mEnvMapSampled : nullptr, &mEnvMapDistribution);
+        if(!mOptions.ShaderCacheDir.empty() && mShaderCache.Init(mOptions.ShaderCacheDir))
+        {
+            mRaytraycingStage.SetShaderCache(&mShaderCache);
+        }
         ConfigureStages();
+        RegisterStages();
+        if(!mOptions.ProfilePath.empty() || mOptions.TargetFrameTime > 0.f)
+        {
+            mFrameProfiler.Init(&mContext);
+        }
+        if(mOptions.TargetFrameTime > 0.f)
+        {
+            bench::ResolutionControllerConfig config{.TargetFrameMs = mOptions.TargetFrameTime, .MinScale = mOptions.MinRenderScale};
+            mResolutionController.Init(config);
+            if(!mOptions.FrameTimeTracePath.empty())
+            {
+                mFrameTimeTrace.open(mOptions.FrameTimeTracePath);
+                foray::Assert(mFrameTimeTrace.is_open(), "Failed to open the frame time trace");
+                mFrameTimeTrace << "scale,device_ms\n";
+            }
+        }
+        if(mShaderCache.Exists())
+        {
+            foray::logger()->info("ShaderCache: {} hits, {} compiled into \"{}\"", mShaderCache.GetHits(), mShaderCache.GetMisses(), mOptions.ShaderCacheDir);
+        }
     }
 
-    void DenoiserApp::LoadScene()
+    void DenoiserApp::LoadScene(const std::vector<std::string>& scenePaths)
     {
-        std::vector<std::string> scenePaths({SCENE_PATH});
-
         mScene = std::make_unique<foray::scene::Scene>(&mContext);
+
+        // With the scene cache, several scenes are cooked into one entry sharing identical assets across them and converted as one model.
+        // Otherwise resolving cooks scenes missing from the cache (parsing and decoding their textures on the thread pool). Cook all of them at once, only
+        // the conversion and upload below has to run in order. Scenes sharing a file name share cache entry names and are resolved one by one.
+        std::vector<std::string>             resolvedPaths;
+        std::vector<std::string>             labels;
+        std::vector<double>                  resolveSeconds;
+        std::vector<assets::AssetDedupStats> dedupStats;
+        if(scenePaths.size() > 1 && mSceneCache.Exists())
+        {
+            auto                    start = std::chrono::steady_clock::now();
+            assets::AssetDedupStats stats;
+            std::string             merged = mSceneCache.ResolveMerged(scenePaths, &stats);
+            if(!merged.empty())
+            {
+                resolvedPaths  = {merged};
+                labels         = {scenePaths[0]};
+                resolveSeconds = {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+                dedupStats     = {stats};
+                for(size_t i = 1; i < scenePaths.size(); i++)
+                {
+                    labels[0] += "\", \"" + scenePaths[i];
+                }
+            }
+        }
+        if(resolvedPaths.empty())
+        {
+            resolvedPaths.resize(scenePaths.size());
+            labels = scenePaths;
+            resolveSeconds.resize(scenePaths.size());
+            dedupStats.resize(scenePaths.size());
+            std::set<std::string> stems;
+            for(const auto& path : scenePaths)
+            {
+                stems.insert(std::filesystem::u8path(path).stem().string());
+            }
+            auto resolve = [&](uint32_t index) {
+                auto start            = std::chrono::steady_clock::now();
+                resolvedPaths[index]  = mSceneCache.Resolve(scenePaths[index], &dedupStats[index]);
+                resolveSeconds[index] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            };
+            if(stems.size() == scenePaths.size())
+            {
+                util::ThreadPool::Shared().ParallelFor(static_cast<uint32_t>(scenePaths.size()), resolve, 1);
+            }
+            else
+            {
+                for(uint32_t i = 0; i < scenePaths.size(); i++)
+                {
+                    resolve(i);
+                }
+            }
+        }
+
         foray::gltf::ModelConverter converter(mScene.get());
-        for(const auto& path : scenePaths)
+        std::vector<double>         convertSeconds(resolvedPaths.size());
+        for(size_t i = 0; i < resolvedPaths.size(); i++)
         {
+            auto                               start = std::chrono::steady_clock::now();
             foray::gltf::ModelConverterOptions options{.FlipY = false};
-            converter.LoadGltfModel(path, nullptr, options);
+            converter.LoadGltfModel(resolvedPaths[i], nullptr, options);
+            convertSeconds[i] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
         }
 
         mScene->UpdateTlasManager();
         mScene->UpdateLightManager();
 
-#if !ENABLE_BENCHMODE
-        mScene->UseDefaultCamera(true);
-#else
-        auto camManager  = mScene->GetComponent<foray::scene::gcomp::CameraManager>();
-        auto animManager = mScene->GetComponent<foray::scene::gcomp::AnimationManager>();
-        if(!!animManager)
+        if(!mBenchRunner && mOptions.CameraPath.empty())
+        {
+            mScene->UseDefaultCamera(true);
+        }
+        else
         {
-            foray::scene::ncomp::Camera* camera = nullptr;
-            for(auto& animation : animManager->GetAnimations())
+            auto camManager  = mScene->GetComponent<foray::scene::gcomp::CameraManager>();
+            auto animManager = mScene->GetComponent<foray::scene::gcomp::AnimationManager>();
+            if(!!animManager)
             {
-                animation.GetPlaybackConfig().ConstantDelta = 0.01666666667f;
-                camera                                      = (!!camera) ? camera : animation.GetChannels()[0].Target->GetComponent<foray::scene::ncomp::Camera>();
+                foray::scene::ncomp::Camera* camera = nullptr;
+                for(auto& animation : animManager->GetAnimations())
+                {
+                    animation.GetPlaybackConfig().ConstantDelta = ANIMATION_FRAME_DELTA;
+                    camera                                      = (!!camera) ? camera : animation.GetChannels()[0].Target->GetComponent<foray::scene::ncomp::Camera>();
+                }
+
+                if(!!camera)
+                {
+                    camera->SetName("Animated Camera");
+                    camManager->SelectCamera(camera);
+                }
             }
 
-            if(!!camera)
+            if(camManager->GetSelectedCamera() == nullptr)
             {
-                camera->SetName("Animated Camera");
-                camManager->SelectCamera(camera);
+                mScene->UseDefaultCamera(true);
             }
         }
 
-        if(camManager->GetSelectedCamera() == nullptr)
-        {
-            mScene->UseDefaultCamera(true);
-        }
-#endif
-
-        for(int32_t i = 0; i < scenePaths.size(); i++)
+        for(int32_t i = 0; i < resolvedPaths.size(); i++)
         {
-            const auto& path = scenePaths[i];
-            const auto& log  = converter.GetBenchmark().GetLogs()[i];
-            foray::logger()->info("Model Load \"{}\":\n{}", path, log.PrintPretty());
+            const auto& log   = converter.GetBenchmark().GetLogs()[i];
+            std::string dedup = dedupStats[i].Models > 0 ? "\n" + dedupStats[i].PrintPretty() : "";
+            foray::logger()->info("Model Load \"{}\" (resolve {:.1f} ms, convert {:.1f} ms):\n{}{}", labels[i], resolveSeconds[i] * 1000.0, convertSeconds[i] * 1000.0,
+                                  log.PrintPretty(), dedup);
         }
     }
 
@@ -113,7 +227,7 @@ namespace denoise {
         constexpr VkFormat                    hdrVkFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
         foray::util::ImageLoader<hdrVkFormat> imageLoader;
         // env maps at https://polyhaven.com/a/alps_field
-        std::string pathToEnvMap = DATA_DIR "/env/default/envmap.exr";
+        std::string pathToEnvMap = mOptions.EnvMapPath;
         if(!imageLoader.Init(pathToEnvMap))
         {
             foray::logger()->warn("Loading env map failed \"{}\"", pathToEnvMap);
@@ -131,6 +245,7 @@ namespace denoise {
                                                  "Environment map");
 
         imageLoader.InitManagedImage(&mContext, &mEnvMap, ci);
+        mEnvMapDistribution.Build(reinterpret_cast<const float*>(imageLoader.GetRawData().data()), ext2D.width, ext2D.height, util::ThreadPool::Shared());
         imageLoader.Destroy();
 
         VkSamplerCreateInfo samplerCi{.sType                   = VkStructureType::VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -161,7 +276,10 @@ namespace denoise {
                                                  VkFormat::VK_FORMAT_R16G16B16A16_SFLOAT, mContext.GetSwapchainSize(), "Denoised Image");
 
         mDenoisedImage.Create(&mContext, ci);
+        mRenderSize = mContext.GetSwapchainSize();
 
+        InitFrameSemaphores();
+        InitDenoisers();
         ActivateOrSwitchDenoiser();
 
         mOutputs      = {&mDenoisedImage, mRaytraycingStage.GetRtOutput()};
@@ -173,6 +291,27 @@ namespace denoise {
         mImguiStage.InitForSwapchain(&mContext);
         mImguiStage.AddWindowDraw([this]() { this->ImGui(); });
 
+        if(!mOptions.CapturePath.empty())
+        {
+            InitCapture();
+        }
+        foray::Assert(mBenchLogPipeline.Init(mOptions.BenchLogPath), "Failed to initialize the benchmark log");
+        if(!mOptions.GenerateReferenceDir.empty())
+        {
+            InitReferenceGenerator();
+        }
+        if(!mOptions.ReferenceDir.empty())
+        {
+            mMetricsRecorder.Init(&mContext, &mDenoisedImage);
+            if(!mBenchRunner)
+            {
+                mMetricsRecorder.SetReferenceDirectory(mOptions.ReferenceDir);  // Bench mode sets the directory per case
+            }
+        }
+    }
+
+    void DenoiserApp::RegisterStages()
+    {
         RegisterRenderStage(&mGbufferStage);
         RegisterRenderStage(&mRaytraycingStage);
         RegisterRenderStage(&mBmfrDenoiser);
@@ -189,93 +328,212 @@ namespace denoise {
 
     void DenoiserApp::ApiRender(foray::base::FrameRenderInfo& renderInfo)
     {
+        util::TimelineScope recordScope("Record Frame");
+        if(!!mBenchRunner)
+        {
+            ApplyBenchCase(renderInfo.GetFrameNumber());
+        }
+        if(mResolutionController.Exists())
+        {
+            ApplyRenderScale();
+        }
+        if(mReferenceGenerator.Exists() && mReferenceGenerator.IsFinished())
+        {
+            mRenderLoop.RequestStop();
+        }
         ActivateOrSwitchDenoiser();
         ActivateOrSwitchOutput();
 
         foray::stages::ExternalDenoiserStage* externalDenoiser = dynamic_cast<foray::stages::ExternalDenoiserStage*>(mActiveDenoiser);
+        EDenoiseSchedule                      schedule         = EDenoiseSchedule::Internal;
+        if(!!externalDenoiser)
+        {
+            schedule = mPipelineExternalDenoise ? EDenoiseSchedule::ExternalPipelined : EDenoiseSchedule::External;
+        }
+        if(!!mPipelinedDenoiser && (schedule != EDenoiseSchedule::ExternalPipelined || mPipelinedDenoiser != externalDenoiser))
+        {
+            // Denoiser or schedule switched: the previous frame's result is dropped. The serial schedule would overwrite the external denoiser's
+            // buffers without waiting, so its last denoise is waited for once
+            WaitForExternalDenoise();
+        }
 
         foray::core::DeviceSyncCommandBuffer& auxCmdBuffer     = renderInfo.GetAuxCommandBuffer(0);
+        foray::core::DeviceSyncCommandBuffer& handoffCmdBuffer = renderInfo.GetAuxCommandBuffer(1);
         foray::core::DeviceSyncCommandBuffer& primaryCmdBuffer = renderInfo.GetPrimaryCommandBuffer();
 
+        SelectFrameSemaphores(primaryCmdBuffer, schedule);
+        mFrameDenoiserIndices[renderInfo.GetFrameNumber() % mFrameDenoiserIndices.size()] = mActiveDenoiserIndex;
+
+        // Every dispatch advances the timeline by two: the handoff signals the first value, the external denoiser the second once it finished
         foray::core::DeviceSyncCommandBuffer* cmdBuffer                 = &primaryCmdBuffer;
-        uint64_t                              timelineValueSignal       = renderInfo.GetFrameNumber() * 2 + 1;
-        uint64_t                              timelineValueWaitExternal = renderInfo.GetFrameNumber() * 2 + 2;
-        if(!!externalDenoiser)
+        uint64_t                              timelineValueSignal       = mDenoiseTimelineValue + 1;
+        uint64_t                              timelineValueWaitExternal = mDenoiseTimelineValue + 2;
+        if(schedule == EDenoiseSchedule::External)
         {
             auxCmdBuffer.GetSignalSemaphores().back().TimelineValue   = timelineValueSignal;
             primaryCmdBuffer.GetWaitSemaphores().back().TimelineValue = timelineValueWaitExternal;
             cmdBuffer                                                 = &auxCmdBuffer;
         }
-
+        else if(schedule == EDenoiseSchedule::ExternalPipelined)
+        {
+            // Reached already if no denoise is pending
+            handoffCmdBuffer.GetWaitSemaphores().back().TimelineValue   = mDenoiseTimelineValue;
+            handoffCmdBuffer.GetSignalSemaphores().back().TimelineValue = timelineValueSignal;
+            cmdBuffer                                                   = &auxCmdBuffer;
+        }
 
         // Begin aux command buffer
         cmdBuffer->Begin();
+        mFrameProfiler.BeginFrame(*cmdBuffer, renderInfo.GetFrameNumber());
 
-        mScene->Update(renderInfo, *cmdBuffer);
-        mGbufferStage.RecordFrame(*cmdBuffer, renderInfo);
+        // Reference accumulation keeps the scene (and camera) frozen
+        if(!mReferenceGenerator.Exists() || mReferenceGenerator.BeginFrame())
+        {
+            bench::StageScope scope(mFrameProfiler, *cmdBuffer, "Scene Update");
+            mScene->Update(renderInfo, *cmdBuffer);
+        }
+        {
+            bench::StageScope scope(mFrameProfiler, *cmdBuffer, "GBufferStage");
+            mGbufferStage.RecordFrame(*cmdBuffer, renderInfo);
+        }
+        {
+            bench::StageScope scope(mFrameProfiler, *cmdBuffer, "ComplexRaytracingStage");
+            mRaytraycingStage.RecordFrame(*cmdBuffer, renderInfo);
+        }
+        mReferenceGenerator.RecordFrame(*cmdBuffer, renderInfo);
 
-        mRaytraycingStage.RecordFrame(*cmdBuffer, renderInfo);
+        mFrameCapture.RecordFrame(*cmdBuffer, renderInfo, MakeCaptureMeta(renderInfo.GetFrameNumber()));
 
-        if(!!externalDenoiser)
+        // Frames the denoised image lags behind the traced one
+        uint64_t    denoisedLag  = 0;
+        bool        denoised     = true;
+        const char* denoiserName = mDenoiserProfileNames[mActiveDenoiserIndex];
+        if(schedule == EDenoiseSchedule::External)
         {
-            externalDenoiser->BeforeDenoise(*cmdBuffer, renderInfo);
-            cmdBuffer->Submit();
-            externalDenoiser->DispatchDenoise(timelineValueSignal, timelineValueWaitExternal);
+            {
+                bench::StageScope scope(mFrameProfiler, *cmdBuffer, denoiserName);
+                externalDenoiser->BeforeDenoise(*cmdBuffer, renderInfo);
+            }
+            SubmitProfiled(*cmdBuffer);
+            {
+                util::TimelineScope scope("Dispatch Denoise");
+                externalDenoiser->DispatchDenoise(timelineValueSignal, timelineValueWaitExternal);
+            }
+            mDenoiseTimelineValue = timelineValueWaitExternal;
             primaryCmdBuffer.Begin();
+            bench::StageScope scope(mFrameProfiler, primaryCmdBuffer, denoiserName);
             externalDenoiser->AfterDenoise(primaryCmdBuffer, renderInfo);
         }
+        else if(schedule == EDenoiseSchedule::ExternalPipelined)
+        {
+            // Submitted without waiting, so tracing overlaps the external denoiser still working on the previous frame
+            SubmitProfiled(*cmdBuffer);
+
+            // The external denoiser's buffers are reused: the previous result is copied out before this frame is copied in
+            handoffCmdBuffer.Begin();
+            denoised    = mPipelinedDenoiser == externalDenoiser;
+            denoisedLag = 1;
+            {
+                bench::StageScope scope(mFrameProfiler, handoffCmdBuffer, denoiserName);
+                if(denoised)
+                {
+                    externalDenoiser->AfterDenoise(handoffCmdBuffer, renderInfo);
+                }
+                externalDenoiser->BeforeDenoise(handoffCmdBuffer, renderInfo);
+            }
+            SubmitProfiled(handoffCmdBuffer);
+            {
+                util::TimelineScope scope("Dispatch Denoise");
+                externalDenoiser->DispatchDenoise(timelineValueSignal, timelineValueWaitExternal);
+            }
+            mDenoiseTimelineValue = timelineValueWaitExternal;
+            mPipelinedDenoiser    = externalDenoiser;
+            primaryCmdBuffer.Begin();
+        }
         else
         {
+            bench::StageScope scope(mFrameProfiler, primaryCmdBuffer, denoiserName);
             mActiveDenoiser->RecordFrame(primaryCmdBuffer, renderInfo);
         }
 
+        if(mMetricsRecorder.Exists() && denoised)
+        {
+            uint64_t sequenceIndex = renderInfo.GetFrameNumber() - std::min(renderInfo.GetFrameNumber(), denoisedLag);
+            if(!!mBenchRunner)
+            {
+                sequenceIndex -= std::min(sequenceIndex, mBenchRunner->GetCaseFirstFrame());
+            }
+            mMetricsRecorder.RecordFrame(primaryCmdBuffer, renderInfo, sequenceIndex);
+        }
+
         // copy final image to swapchain
-        mImageToSwapchainStage.RecordFrame(primaryCmdBuffer, renderInfo);
+        {
+            bench::StageScope scope(mFrameProfiler, primaryCmdBuffer, "ImageToSwapchainStage");
+            mImageToSwapchainStage.RecordFrame(primaryCmdBuffer, renderInfo);
+        }
 
-        // draw imgui windows
-        mImguiStage.RecordFrame(primaryCmdBuffer, renderInfo);
+        // draw imgui windows (bench mode measures without UI overhead)
+        if(!mBenchRunner)
+        {
+            bench::StageScope scope(mFrameProfiler, primaryCmdBuffer, "ImguiStage");
+            mImguiStage.RecordFrame(primaryCmdBuffer, renderInfo);
+        }
 
         renderInfo.PrepareSwapchainImageForPresent(primaryCmdBuffer);
 
-        primaryCmdBuffer.Submit();
+        SubmitProfiled(primaryCmdBuffer);
     }
 
-    void DenoiserApp::ApiFrameFinishedExecuting(uint64_t frameIndex)
+    void DenoiserApp::SubmitProfiled(foray::core::DeviceSyncCommandBuffer& cmdBuffer)
     {
-        namespace fs = std::filesystem;
+        util::TimelineScope scope("Submit");
+        mFrameProfiler.OnSubmit();
+        cmdBuffer.Submit();
+    }
 
-        if(mDenoiserBenchmark.Exists() && mDenoiserBenchmark.LogQueryResults(frameIndex))
+    void DenoiserApp::ApiFrameFinishedExecuting(uint64_t frameIndex)
+    {
+        util::TimelineScope scope("Frame Finished");
+        if(mFrameProfiler.OnFrameFinished(frameIndex) && mResolutionController.Exists())
         {
-            mDenoiserBenchmarkLog = mDenoiserBenchmark.GetLogs().back();
-#if !ENABLE_BENCHMODE
-            mDenoiserBenchmark.GetLogs().clear();
-#endif
+            if(mFrameTimeTrace.is_open())
+            {
+                mFrameTimeTrace << mResolutionController.GetScale() << ',' << mFrameProfiler.GetLastFrameDeviceMs() << '\n';
+            }
+            mResolutionController.Update(mFrameProfiler.GetLastFrameDeviceMs());
         }
-#if ENABLE_BENCHMODE
-        if(frameIndex >= BENCH_FRAMES)
-        {
-            std::filesystem::path path(SCENE_PATH);
+        mFrameCapture.OnFrameFinished(frameIndex);
+        mReferenceGenerator.OnFrameFinished(frameIndex);
 
-            foray::osi::Utf8Path savePath = foray::osi::Utf8Path(fmt::format("Bench {} {}.csv", path.filename().c_str(), mActiveDenoiser->GetUILabel())).MakeAbsolute();
-            std::fstream         out((fs::path)savePath, std::ios_base::out);
-            foray::Assert(out.is_open() && !out.bad(), "Write Benchmark failed");
-            out << mDenoiserBenchmark.GetLogs().front().PrintCsvHeader();
-            for(const foray::bench::BenchmarkLog& log : mDenoiserBenchmark.GetLogs())
+        metrics::ImageMetrics frameMetrics;
+        bool                  scored = mMetricsRecorder.OnFrameFinished(frameIndex, frameMetrics);
+
+        // The frame may have been recorded with the previously active denoiser
+        foray::bench::DeviceBenchmark& benchmark = *mDenoiserBenchmarks[mFrameDenoiserIndices[frameIndex % mFrameDenoiserIndices.size()]];
+        if(benchmark.Exists() && benchmark.LogQueryResults(frameIndex))
+        {
+            foray::bench::BenchmarkLog& log = benchmark.GetLogs().back();
+            if(!!mBenchRunner && !mBenchRunner->IsFinished())
             {
-                out << log.PrintCsvLine();
+                mBenchRunner->LogFrame(frameIndex, log, scored ? &frameMetrics : nullptr);
             }
-            out.flush();
-            out.close();
-            mRenderLoop.RequestStop();
+            mBenchLogPipeline.Push(frameIndex, log, scored ? &frameMetrics : nullptr);
+            benchmark.GetLogs().clear();
         }
-#endif
     }
 
     void DenoiserApp::ApiOnResized(VkExtent2D size)
     {
+        WaitForExternalDenoise();
         mScene->InvokeOnResized(size);
 
         mDenoisedImage.Resize(size);
+        // Registered stages follow the swapchain size. Bench mode and the frame time controller re-apply their render resolution on the next frame.
+        mRenderSize = size;
+        if(mResolutionController.Exists())
+        {
+            mResolutionController.Settle();
+        }
     }
 
     void DenoiserApp::ApiOnEvent(const foray::osi::Event* event)
@@ -294,6 +552,11 @@ namespace denoise {
         {
             ImGui::Text("FPS: %f avg %f min", 1.f / analysis.AvgFrameTime, 1.f / analysis.MaxFrameTime);
         }
+        if(mResolutionController.Exists())
+        {
+            ImGui::Text("Render scale: %.0f%% (%ux%u), device %.2f / %.2f ms", mResolutionController.GetScale() * 100.f, mRenderSize.width, mRenderSize.height,
+                        mResolutionController.GetSmoothedFrameMs(), mOptions.TargetFrameTime);
+        }
 
         {  // Output Switching
             std::string outputLabel(mActiveOutput->GetName());
@@ -332,6 +595,11 @@ namespace denoise {
             }
         }
 
+        if(!!dynamic_cast<foray::stages::ExternalDenoiserStage*>(mActiveDenoiser))
+        {
+            ImGui::Checkbox("Pipelined (+1 frame latency)", &mPipelineExternalDenoise);
+        }
+
         if(ImGui::CollapsingHeader("Denoiser Config"))
         {
             this->mActiveDenoiser->DisplayImguiConfiguration();
@@ -339,7 +607,23 @@ namespace denoise {
 
         if(ImGui::CollapsingHeader("Denoiser Benchmark"))
         {
-            this->mDenoiserBenchmarkLog.PrintImGui();
+            this->mBenchLogPipeline.PrintImGui();
+        }
+
+        if(mReferenceGenerator.Exists())
+        {
+            ImGui::Text("Reference %zu / %zu (frame %llu), %u spp", mReferenceGenerator.GetReferencesCompleted(), mReferenceGenerator.GetReferenceCount(),
+                        static_cast<unsigned long long>(mReferenceGenerator.GetSequenceIndex()), mRaytraycingStage.GetAccumulatedSamples());
+        }
+
+        if(mMetricsRecorder.Exists() && ImGui::CollapsingHeader("Image Quality"))
+        {
+            const metrics::ImageMetrics& quality = mMetricsRecorder.GetLastMetrics();
+            ImGui::Text("MSE: %.6f", quality.Mse);
+            ImGui::Text("PSNR: %.2f dB", quality.Psnr);
+            ImGui::Text("SSIM: %.4f", quality.Ssim);
+            ImGui::Text("FLIP: %.4f", quality.Flip);
+            ImGui::Text("Temporal Error: %.6f", quality.TemporalError);
         }
 
         {
@@ -397,65 +681,125 @@ namespace denoise {
 
     void DenoiserApp::ApiDestroy()
     {
+        WaitForExternalDenoise();
+        mFrameProfiler.Destroy();
+        mFrameCapture.Destroy();
+        mBenchLogPipeline.Destroy();
+        mMetricsRecorder.Destroy();
+        mReferenceGenerator.Destroy();
         mScene->Destroy();
         mScene = nullptr;
-        mASvgfDenoiser.Destroy();
-        mBmfrDenoiser.Destroy();
-#ifdef ENABLE_OPTIX
-        mOptiXDenoiser.Destroy();
-#endif
+        DestroyDenoisers();
         mGbufferStage.Destroy();
         mImguiStage.Destroy();
         mRaytraycingStage.Destroy();
         mEnvMap.Destroy();
         mDenoiseSemaphore.Destroy();
         mDenoisedImage.Destroy();
+        if(!!mBenchRunner)
+        {
+            mBenchRunner->Destroy();
+            mBenchRunner = nullptr;
+        }
     }
 
 #pragma endregion
 #pragma region Denoiser& Output selection
 
-    void DenoiserApp::ActivateOrSwitchDenoiser()
+    void DenoiserApp::InitDenoisers()
     {
-        if(mActiveDenoiser == mDenoisers[mActiveDenoiserIndex])
+        mDenoiserBenchmarks.resize(mDenoisers.size());
+        mDenoiserProfileNames.resize(mDenoisers.size());
+        for(size_t i = 0; i < mDenoisers.size(); i++)
         {
-            return;
+            if(!mDenoiserBenchmarks[i])
+            {
+                mDenoiserBenchmarks[i] = std::make_unique<foray::bench::DeviceBenchmark>();
+            }
+            foray::stages::DenoiserConfig config(mRaytraycingStage.GetRtOutput(), &mDenoisedImage, &mGbufferStage);
+            config.Benchmark = mDenoiserBenchmarks[i].get();
+            config.Semaphore = &mDenoiseSemaphore;
+
+            mDenoisers[i]->Init(&mContext, config);
+            mDenoiserProfileNames[i] = util::Timeline::Shared().InternName(mDenoisers[i]->GetUILabel());
         }
+    }
 
-        vkDeviceWaitIdle(mDevice);
+    void DenoiserApp::DestroyDenoisers()
+    {
+        for(foray::stages::DenoiserStage* denoiser : mDenoisers)
+        {
+            denoiser->Destroy();
+        }
+        mActiveDenoiser = nullptr;
+    }
 
-        if(!!mActiveDenoiser)
+    void DenoiserApp::ActivateOrSwitchDenoiser()
+    {
+        if(mActiveDenoiser == mDenoisers[mActiveDenoiserIndex])
         {
-            mActiveDenoiser->Destroy();
+            return;
         }
+        // All denoisers are resident, frames still in flight keep using the previous one. The semaphores follow per frame in SelectFrameSemaphores().
         mActiveDenoiser = mDenoisers[mActiveDenoiserIndex];
-        foray::stages::DenoiserConfig config(mRaytraycingStage.GetRtOutput(), &mDenoisedImage, &mGbufferStage);
-        config.Benchmark = &mDenoiserBenchmark;
-        config.Semaphore = &mDenoiseSemaphore;
-
-        mActiveDenoiser->Init(&mContext, config);
+        // History was accumulated the last time this denoiser was active
+        mActiveDenoiser->IgnoreHistoryNextFrame();
+    }
 
-        foray::stages::ExternalDenoiserStage* externalDenoiser = dynamic_cast<foray::stages::ExternalDenoiserStage*>(mActiveDenoiser);
+    void DenoiserApp::InitFrameSemaphores()
+    {
+        mFrameSemaphores.clear();
+        for(foray::base::InFlightFrame& frame : mInFlightFrames)
+        {
+            foray::core::DeviceSyncCommandBuffer& auxCmdBuffer     = frame.GetAuxiliaryCommandBuffer(0);
+            foray::core::DeviceSyncCommandBuffer& handoffCmdBuffer = frame.GetAuxiliaryCommandBuffer(1);
+            foray::core::DeviceSyncCommandBuffer& primaryCmdBuffer = frame.GetPrimaryCommandBuffer();
+
+            FrameSemaphores semaphores{.PrimaryCmdBuffer = &primaryCmdBuffer, .AuxCmdBuffer = &auxCmdBuffer};
+            semaphores.WaitInternal  = {foray::core::SemaphoreReference::Binary(frame.GetSwapchainImageReady(), VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR)};
+            semaphores.WaitExternal  = {foray::core::SemaphoreReference::Binary(frame.GetSwapchainImageReady(), VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR),
+                                        foray::core::SemaphoreReference::Timeline(mDenoiseSemaphore, 0)};
+            semaphores.SignalHandoff = {foray::core::SemaphoreReference::Timeline(mDenoiseSemaphore, 0)};
+            primaryCmdBuffer.SetWaitSemaphores(semaphores.WaitInternal);
+            auxCmdBuffer.SetSignalSemaphores(std::vector<foray::core::SemaphoreReference>());
+            // Only submitted in the pipelined schedule, where it always waits for the previous denoise and signals the next
+            handoffCmdBuffer.SetWaitSemaphores(std::vector<foray::core::SemaphoreReference>({foray::core::SemaphoreReference::Timeline(mDenoiseSemaphore, 0)}));
+            handoffCmdBuffer.SetSignalSemaphores(semaphores.SignalHandoff);
+            mFrameSemaphores.push_back(std::move(semaphores));
+        }
+    }
 
-        {  // Setup semaphores
-            for(foray::base::InFlightFrame& frame : mInFlightFrames)
+    void DenoiserApp::SelectFrameSemaphores(foray::core::DeviceSyncCommandBuffer& primaryCmdBuffer, EDenoiseSchedule schedule)
+    {
+        for(FrameSemaphores& semaphores : mFrameSemaphores)
+        {
+            if(semaphores.PrimaryCmdBuffer != &primaryCmdBuffer)
             {
-                foray::core::DeviceSyncCommandBuffer& auxCmdBuffer     = frame.GetAuxiliaryCommandBuffer(0);
-                foray::core::DeviceSyncCommandBuffer& primaryCmdBuffer = frame.GetPrimaryCommandBuffer();
-                auxCmdBuffer.SetSignalSemaphores(std::vector<foray::core::SemaphoreReference>({foray::core::SemaphoreReference::Timeline(mDenoiseSemaphore, 0)}));
-                if(!!externalDenoiser)
-                {
-                    primaryCmdBuffer.SetWaitSemaphores(std::vector<foray::core::SemaphoreReference>(
-                        {foray::core::SemaphoreReference::Binary(frame.GetSwapchainImageReady(), VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR),
-                         foray::core::SemaphoreReference::Timeline(mDenoiseSemaphore, 0)}));
-                }
-                else
-                {
-                    primaryCmdBuffer.SetWaitSemaphores(std::vector<foray::core::SemaphoreReference>(
-                        {foray::core::SemaphoreReference::Binary(frame.GetSwapchainImageReady(), VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR)}));
-                }
+                continue;
             }
+            if(semaphores.Schedule != schedule)
+            {
+                // Only the serial external schedule synchronizes the primary and tracing command buffers with the timeline
+                bool external = schedule == EDenoiseSchedule::External;
+                primaryCmdBuffer.SetWaitSemaphores(external ? semaphores.WaitExternal : semaphores.WaitInternal);
+                semaphores.AuxCmdBuffer->SetSignalSemaphores(external ? semaphores.SignalHandoff : std::vector<foray::core::SemaphoreReference>());
+                semaphores.Schedule = schedule;
+            }
+            return;
+        }
+    }
+
+    void DenoiserApp::WaitForExternalDenoise()
+    {
+        mPipelinedDenoiser = nullptr;
+        if(mDenoiseTimelineValue == 0)
+        {
+            return;
         }
+        util::TimelineScope scope("Wait External Denoise");
+        VkSemaphore         semaphore = mDenoiseSemaphore.GetSemaphore();
+        VkSemaphoreWaitInfo waitInfo{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, .semaphoreCount = 1, .pSemaphores = &semaphore, .pValues = &mDenoiseTimelineValue};
+        vkWaitSemaphores(mDevice, &waitInfo, UINT64_MAX);
     }
 
     void lUpdateOutput(std::map<std::string_view, foray::core::ManagedImage*>& map, foray::stages::RenderStage& stage, const std::string_view name)
@@ -469,10 +813,243 @@ namespace denoise {
         {
             return;
         }
-        vkDeviceWaitIdle(mDevice);
+        // Called at a frame boundary, only frames recorded from now on read the new source
         mActiveOutput = mOutputs[mActiveOutputIndex];
         mImageToSwapchainStage.SetSrcImage(mActiveOutput);
     }
 
+#pragma endregion
+#pragma region Capture
+
+    void DenoiserApp::InitCapture()
+    {
+        using EOutput = foray::stages::GBufferStage::EOutput;
+
+        std::vector<capture::ChannelSource> channels({
+            {"Noisy", mRaytraycingStage.GetRtOutput()},
+            {"Albedo", mGbufferStage.GetImageEOutput(EOutput::Albedo)},
+            {"Normal", mGbufferStage.GetImageEOutput(EOutput::Normal)},
+            {"Position", mGbufferStage.GetImageEOutput(EOutput::Position)},
+            {"Motion", mGbufferStage.GetImageEOutput(EOutput::Motion)},
+            {"MeshInstanceId", mGbufferStage.GetImageEOutput(EOutput::MeshInstanceIdx)},
+        });
+        if(!mFrameCapture.Init(&mContext, channels, mOptions.CapturePath, mOptions.CaptureFrames, INFLIGHT_FRAME_COUNT + 2))
+        {
+            foray::logger()->warn("Capture disabled");
+        }
+    }
+
+    void DenoiserApp::InitReferenceGenerator()
+    {
+        capture::ReferenceConfig config{.OutputDir       = mOptions.GenerateReferenceDir,
+                                        .SequenceIndices = capture::ReadGltfKeyframeIndices(mOptions.CameraPath, ANIMATION_FRAME_DELTA, mOptions.ReferenceKeyframeStride),
+                                        .MaxSamples      = mOptions.ReferenceSamples,
+                                        .Accumulation    = AccumulationConfig{.ErrorThreshold = mOptions.ReferenceErrorThreshold}};
+        foray::Assert(mReferenceGenerator.Init(&mContext, &mRaytraycingStage, config), "Reference generation: Failed to initialize");
+        // Show the accumulating image
+        mActiveOutputIndex = 1;
+    }
+
+    capture::FrameMeta DenoiserApp::MakeCaptureMeta(uint64_t frameNumber)
+    {
+        capture::FrameMeta meta{.FrameNumber = frameNumber, .RngSeed = mRaytraycingStage.GetRngSeed()};
+        if(!mFrameCapture.Exists())
+        {
+            return meta;
+        }
+
+        const foray::shader::CameraUboBlock& camera = mScene->GetComponent<foray::scene::gcomp::CameraManager>()->GetUbo().GetData();
+        std::memcpy(meta.ViewMatrix, glm::value_ptr(camera.ViewMatrix), sizeof(meta.ViewMatrix));
+        std::memcpy(meta.ProjectionMatrix, glm::value_ptr(camera.ProjectionMatrix), sizeof(meta.ProjectionMatrix));
+        std::memcpy(meta.PreviousViewMatrix, glm::value_ptr(camera.PreviousViewMatrix), sizeof(meta.PreviousViewMatrix));
+        std::memcpy(meta.PreviousProjectionMatrix, glm::value_ptr(camera.PreviousProjectionMatrix), sizeof(meta.PreviousProjectionMatrix));
+        return meta;
+    }
+
+#pragma endregion
+#pragma region Bench mode
+
+    std::string lNormalizeName(std::string_view name)
+    {
+        std::string result;
+        for(char c : name)
+        {
+            if(std::isalnum(static_cast<unsigned char>(c)))
+            {
+                result.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+            }
+        }
+        return result;
+    }
+
+    int32_t DenoiserApp::FindDenoiserIndex(std::string_view name) const
+    {
+        std::string normalized = lNormalizeName(name);
+        for(int32_t i = 0; i < mDenoisers.size(); i++)
+        {
+            if(normalized.size() > 0 && lNormalizeName(mDenoisers[i]->GetUILabel()).find(normalized) != std::string::npos)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void DenoiserApp::InitBenchMode()
+    {
+        bench::BenchConfig config{.Scenes        = mOptions.BenchScenes,
+                                  .Denoisers     = mOptions.BenchDenoisers,
+                                  .Resolutions   = mOptions.BenchResolutions,
+                                  .FramesPerCase = mOptions.BenchFrames,
+                                  .ReportPath    = mOptions.BenchReportPath};
+        if(config.Denoisers.empty())
+        {
+            for(foray::stages::DenoiserStage* denoiser : mDenoisers)
+            {
+                config.Denoisers.push_back(denoiser->GetUILabel());
+            }
+        }
+        for(const std::string& denoiser : config.Denoisers)
+        {
+            if(FindDenoiserIndex(denoiser) < 0)
+            {
+                foray::logger()->error("Benchmark: No denoiser matches \"{}\"", denoiser);
+                foray::Assert(false, "Benchmark: Unknown denoiser");
+            }
+        }
+        if(config.Resolutions.empty())
+        {
+            config.Resolutions.push_back(mContext.GetSwapchainSize());
+        }
+
+        config.RecordMetrics = !mOptions.ReferenceDir.empty();
+
+        mBenchRunner = std::make_unique<bench::BenchRunner>();
+        foray::Assert(mBenchRunner->Init(config), "Benchmark: Failed to initialize");
+    }
+
+    void DenoiserApp::ApplyBenchCase(uint64_t frameNumber)
+    {
+        if(mBenchRunner->IsFinished())
+        {
+            return;
+        }
+        if(mBenchRunner->IsCaseComplete())
+        {
+            mBenchRunner->NextCase();
+            mBenchCaseApplied = false;
+            if(mBenchRunner->IsFinished())
+            {
+                mRenderLoop.RequestStop();
+                return;
+            }
+        }
+
+        const bench::BenchCase& benchCase = mBenchRunner->GetCurrentCase();
+        if(!mBenchCaseApplied)
+        {
+            if(benchCase.ScenePath != mLoadedScenePath)
+            {
+                ReloadScene(benchCase.ScenePath);
+            }
+            mActiveDenoiserIndex = FindDenoiserIndex(benchCase.Denoiser);
+            ActivateOrSwitchDenoiser();
+        }
+
+        // Also re-applied after swapchain resizes, which reset the render targets to the swapchain size
+        ResizeRenderTargets(benchCase.Resolution);
+
+        if(!mBenchCaseApplied)
+        {
+            mBenchRunner->BeginCase(frameNumber);
+            ApplyMetricsReference();
+            mBenchCaseApplied = true;
+        }
+    }
+
+    void DenoiserApp::ApplyMetricsReference()
+    {
+        if(!mMetricsRecorder.Exists())
+        {
+            return;
+        }
+        std::filesystem::path sceneDir = std::filesystem::u8path(mOptions.ReferenceDir) / std::filesystem::u8path(mBenchRunner->GetCurrentCase().SceneName);
+        if(std::filesystem::is_directory(sceneDir))
+        {
+            mMetricsRecorder.SetReferenceDirectory(sceneDir.string());
+        }
+        else
+        {
+            mMetricsRecorder.SetReferenceDirectory(mOptions.ReferenceDir);
+        }
+    }
+
+    void DenoiserApp::ReloadScene(const std::string& scenePath)
+    {
+        bool stagesInitialized = !!mScene;
+        if(stagesInitialized)
+        {
+            WaitForExternalDenoise();
+            vkDeviceWaitIdle(mDevice);
+            DestroyDenoisers();
+            mGbufferStage.Destroy();
+            mRaytraycingStage.Destroy();
+            mScene->Destroy();
+            mScene = nullptr;
+        }
+
+        std::vector<std::string> scenePaths({scenePath});
+        if(!mOptions.CameraPath.empty())
+        {
+            scenePaths.push_back(mOptions.CameraPath);
+        }
+        LoadScene(scenePaths);
+        mLoadedScenePath = scenePath;
+
+        if(stagesInitialized)
+        {
+            mGbufferStage.Init(&mContext, mScene.get());
+            mRaytraycingStage.Init(&mContext, mScene.get());
+            mDenoisedImage.Resize(mContext.GetSwapchainSize());
+            mRenderSize = mContext.GetSwapchainSize();
+            mImageToSwapchainStage.SetSrcImage(mActiveOutput);
+            InitDenoisers();
+            ActivateOrSwitchDenoiser();
+        }
+    }
+
+    void DenoiserApp::ApplyRenderScale()
+    {
+        VkExtent2D output = mContext.GetSwapchainSize();
+        VkExtent2D size{};
+        mResolutionController.GetExtent(output.width, output.height, size.width, size.height);
+        if(size.width != mRenderSize.width || size.height != mRenderSize.height)
+        {
+            // Only the traced region changes, all targets keep the output size: nothing is reallocated, the device is not idled and the denoisers
+            // keep their history (reprojected with the full resolution motion vectors of the G-buffer)
+            mRenderSize = size;
+            mRaytraycingStage.SetActiveExtent(size);
+        }
+    }
+
+    void DenoiserApp::ResizeRenderTargets(VkExtent2D size)
+    {
+        if(mRenderSize.width == size.width && mRenderSize.height == size.height)
+        {
+            return;
+        }
+        WaitForExternalDenoise();
+        vkDeviceWaitIdle(mDevice);
+        mRenderSize = size;
+        mScene->InvokeOnResized(size);
+        mDenoisedImage.Resize(size);
+        mGbufferStage.OnResized(size);
+        mRaytraycingStage.OnResized(size);
+        for(foray::stages::DenoiserStage* denoiser : mDenoisers)
+        {
+            denoiser->OnResized(size);
+        }
+    }
+
 #pragma endregion
 }  // namespace denoise
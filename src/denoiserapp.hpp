@@ -20,7 +20,17 @@
 #include <stdint.h>
 #include <vector>
 
+#include "assets/scenecache.hpp"
+#include "bench/benchlogpipeline.hpp"
+#include "bench/benchrunner.hpp"
+#include "bench/frameprofiler.hpp"
+#include "bench/resolutioncontroller.hpp"
+#include "capture/framecapture.hpp"
+#include "capture/referencegenerator.hpp"
 #include "foray_rtstage.hpp"
+#include "launchoptions.hpp"
+#include "metrics/metricsrecorder.hpp"
+#include "util/shadercache.hpp"
 #ifdef ENABLE_OPTIX
 #include <foray_optix.hpp>
 #endif
@@ -32,14 +42,10 @@ namespace denoise {
 
     inline const char* SCENE_PATH = DATA_DIR "/gltf/testbox/scene.gltf";
 
-#if ENABLE_BENCHMODE
-    inline const uint32_t BENCH_FRAMES = 2000;
-#endif
-
     class DenoiserApp : public foray::base::DefaultAppBase
     {
       public:
-        DenoiserApp()  = default;
+        explicit DenoiserApp(const LaunchOptions& options) : mOptions(options) {}
         ~DenoiserApp() = default;
 
       protected:
@@ -49,8 +55,9 @@ namespace denoise {
         virtual void ApiBeforeDeviceBuilding(vkb::DeviceBuilder& deviceBuilder) override;
         virtual void ApiInit() override;
         void         LoadEnvironmentMap();
-        void         LoadScene();
+        void         LoadScene(const std::vector<std::string>& scenePaths);
         void         ConfigureStages();
+        void         RegisterStages();
 
         virtual void ApiRender(foray::base::FrameRenderInfo& renderInfo) override;
         virtual void ApiFrameFinishedExecuting(uint64_t frameIndex) override;
@@ -61,7 +68,12 @@ namespace denoise {
         virtual void ApiDestroy() override;
 
 
+        LaunchOptions mOptions;
+
         std::unique_ptr<foray::scene::Scene> mScene;
+        std::string                          mLoadedScenePath;
+        /// @brief Cooked versions of the loaded glTF files
+        assets::SceneCache mSceneCache;
 
 
         /// @brief generates a GBuffer (Albedo, Positions, Normal, Motion Vectors, Mesh Instance Id as output images)
@@ -72,9 +84,12 @@ namespace denoise {
         foray::stages::ImageToSwapchainStage mImageToSwapchainStage;
         /// @brief Generates a raytraced image
         denoise::ComplexRaytracingStage mRaytraycingStage;
+        util::ShaderCache               mShaderCache;
 
         foray::core::ManagedImage         mEnvMap{};
         foray::core::CombinedImageSampler mEnvMapSampled;
+        /// @brief Importance sampling tables of mEnvMap
+        util::EnvMapDistribution mEnvMapDistribution;
 
         VkPhysicalDeviceTimelineSemaphoreFeatures mTimelineFeature{};
         foray::core::ManagedImage                 mDenoisedImage;
@@ -86,8 +101,14 @@ namespace denoise {
         foray::optix::OptiXDenoiserStage mOptiXDenoiser;
 #endif
 
-        foray::bench::DeviceBenchmark mDenoiserBenchmark;
-        foray::bench::BenchmarkLog    mDenoiserBenchmarkLog;
+        /// @brief One benchmark per denoiser (indices match mDenoisers), resident denoisers each keep their own queries
+        std::vector<std::unique_ptr<foray::bench::DeviceBenchmark>> mDenoiserBenchmarks;
+        /// @brief Streams the denoiser timings (soak log, rolling statistics) off the render thread
+        bench::BenchLogPipeline mBenchLogPipeline;
+        /// @brief Device timings of the render stages for the --profile timeline
+        bench::FrameProfiler mFrameProfiler;
+        /// @brief Denoiser UI labels as timeline names (indices match mDenoisers)
+        std::vector<const char*> mDenoiserProfileNames;
 
         int32_t                                    mActiveDenoiserIndex = 0;
         std::vector<foray::stages::DenoiserStage*> mDenoisers           = {&mBmfrDenoiser, &mASvgfDenoiser,
@@ -96,12 +117,92 @@ namespace denoise {
 #endif
         };
         foray::stages::DenoiserStage* mActiveDenoiser = nullptr;
+        /// @brief Denoiser index each in flight frame was recorded with (indexed by frame number % INFLIGHT_FRAME_COUNT)
+        std::array<int32_t, foray::INFLIGHT_FRAME_COUNT> mFrameDenoiserIndices{};
 
+        /// @brief Initializes all denoisers, they stay resident so switching does not stall the device
+        void InitDenoisers();
+        void DestroyDenoisers();
+        /// @brief Switches the denoiser used for the next recorded frame
         void ActivateOrSwitchDenoiser();
         void ActivateOrSwitchOutput();
 
+        /// @brief How a frame's command buffers are synchronized with the active denoiser
+        enum class EDenoiseSchedule
+        {
+            /// @brief Everything is recorded into the primary command buffer
+            Internal,
+            /// @brief Tracing (aux 0) signals the external denoiser, the primary command buffer waits for its result
+            External,
+            /// @brief Tracing (aux 0) waits for nothing. The handoff command buffer (aux 1) waits for the previous frame's denoise, copies its result
+            /// and hands the new frame to the external denoiser, so tracing the next frame overlaps denoising this one. Adds one frame of latency
+            ExternalPipelined,
+        };
+
+        /// @brief Semaphore sets of an in flight frame's command buffers, prepared once for all schedules
+        struct FrameSemaphores
+        {
+            foray::core::DeviceSyncCommandBuffer*        PrimaryCmdBuffer = nullptr;
+            foray::core::DeviceSyncCommandBuffer*        AuxCmdBuffer     = nullptr;
+            std::vector<foray::core::SemaphoreReference> WaitInternal;
+            /// @brief Additionally waits for the external denoiser's timeline semaphore
+            std::vector<foray::core::SemaphoreReference> WaitExternal;
+            /// @brief Timeline signal of the command buffer handing the noisy frame to the external denoiser
+            std::vector<foray::core::SemaphoreReference> SignalHandoff;
+            EDenoiseSchedule                             Schedule = EDenoiseSchedule::Internal;
+        };
+        std::vector<FrameSemaphores> mFrameSemaphores;
+
+        void InitFrameSemaphores();
+        /// @brief Submits and marks the submit on the timeline
+        void SubmitProfiled(foray::core::DeviceSyncCommandBuffer& cmdBuffer);
+        /// @brief Selects the semaphores of the frame being recorded. Its previous submission finished (in flight fence), so no device wait is needed
+        void SelectFrameSemaphores(foray::core::DeviceSyncCommandBuffer& primaryCmdBuffer, EDenoiseSchedule schedule);
+
+        /// @brief External denoisers run one frame behind tracing (EDenoiseSchedule::ExternalPipelined)
+        bool mPipelineExternalDenoise = false;
+        /// @brief Last value of mDenoiseSemaphore used by a dispatch, which the timeline reaches once that denoise finished
+        uint64_t mDenoiseTimelineValue = 0;
+        /// @brief External denoiser holding the previous frame (ExternalPipelined), its result is copied out by the next frame
+        foray::stages::ExternalDenoiserStage* mPipelinedDenoiser = nullptr;
+        /// @brief Waits on the host for the last dispatched external denoise and drops a pipelined result. Required before the denoisers'
+        /// resources change, as the device waiting idle does not cover the external denoiser
+        void WaitForExternalDenoise();
+
         std::vector<foray::core::ManagedImage*> mOutputs;
         int32_t                                 mActiveOutputIndex = 0;
         foray::core::ManagedImage*              mActiveOutput      = nullptr;
+
+        /// @brief Matches a denoiser name from the command line against the UI labels. Returns -1 if no denoiser matches.
+        int32_t FindDenoiserIndex(std::string_view name) const;
+        void    InitBenchMode();
+        /// @brief Applies the current bench case (scene, denoiser, resolution) at a frame boundary
+        void    ApplyBenchCase(uint64_t frameNumber);
+        void    ReloadScene(const std::string& scenePath);
+        /// @brief Resizes all render targets independent of the swapchain (the final blit to the swapchain scales)
+        void    ResizeRenderTargets(VkExtent2D size);
+        /// @brief Traces the extent of the level of mResolutionController if it changed (or the swapchain was resized). The render targets keep
+        /// the swapchain size
+        void    ApplyRenderScale();
+
+        void               InitCapture();
+        capture::FrameMeta MakeCaptureMeta(uint64_t frameNumber);
+
+        capture::FrameCapture mFrameCapture;
+
+        void                        InitReferenceGenerator();
+        capture::ReferenceGenerator mReferenceGenerator;
+
+        /// @brief Sets the metrics reference directory for the current bench case (<ReferenceDir>/<scene name> if it exists)
+        void                     ApplyMetricsReference();
+        metrics::MetricsRecorder mMetricsRecorder;
+
+        std::unique_ptr<bench::BenchRunner> mBenchRunner;
+        bool                                mBenchCaseApplied = false;
+        VkExtent2D                          mRenderSize{};
+        /// @brief Picks the render resolution from the device frame times (--target-frame-time)
+        bench::ResolutionController mResolutionController;
+        /// @brief Frame times fed to mResolutionController (--frame-time-trace)
+        std::ofstream mFrameTimeTrace;
     };
 }  // namespace denoise
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "environmentsampler.hpp"
+
+namespace denoise {
+
+    void EnvironmentSampler::Create(foray::core::Context* context, foray::core::CombinedImageSampler* envMap, const util::EnvMapDistribution* distribution)
+    {
+        mEnvMap  = envMap;
+        mEnabled = !!envMap && !!distribution && distribution->Exists() && distribution->GetIntegral() > 0.f;
+        if(!mEnvMap)
+        {
+            CreatePlaceholder(context);
+        }
+
+        util::EnvMapDistribution::Header header;
+        size_t                           entriesSize = 0;
+        if(mEnabled)
+        {
+            header      = distribution->GetHeader();
+            entriesSize = distribution->GetEntries().size() * sizeof(util::AliasEntry);
+        }
+        foray::core::ManagedBuffer::CreateInfo ci(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(header) + entriesSize,
+                                                  VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, "EnvironmentSampler");
+        mBuffer.Create(context, ci);
+
+        // Written once through a staging buffer, the tables are too large for inline updates
+        mBuffer.WriteDataDeviceLocal(&header, sizeof(header));
+        if(entriesSize > 0)
+        {
+            mBuffer.WriteDataDeviceLocal(distribution->GetEntries().data(), entriesSize, sizeof(header));
+        }
+    }
+
+    void EnvironmentSampler::CreatePlaceholder(foray::core::Context* context)
+    {
+        VkExtent2D                            extent{.width = 1, .height = 1};
+        foray::core::ManagedImage::CreateInfo ci(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_R32G32B32A32_SFLOAT, extent,
+                                                 "Environment map placeholder");
+        mPlaceholder.Create(context, ci);
+        const float black[4] = {0.f, 0.f, 0.f, 1.f};
+        mPlaceholder.WriteDeviceLocalData(black, sizeof(black), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        VkSamplerCreateInfo samplerCi{.sType                   = VkStructureType::VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                                      .magFilter               = VkFilter::VK_FILTER_NEAREST,
+                                      .minFilter               = VkFilter::VK_FILTER_NEAREST,
+                                      .addressModeU            = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                                      .addressModeV            = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                                      .addressModeW            = VkSamplerAddressMode::VK_SAMPLER_ADDRESS_MODE_REPEAT,
+                                      .anisotropyEnable        = VK_FALSE,
+                                      .compareEnable           = VK_FALSE,
+                                      .minLod                  = 0,
+                                      .maxLod                  = 0,
+                                      .unnormalizedCoordinates = VK_FALSE};
+        mPlaceholderSampled.Init(context, &mPlaceholder, samplerCi);
+    }
+
+    void EnvironmentSampler::Destroy()
+    {
+        mBuffer.Destroy();
+        mPlaceholderSampled.Destroy();
+        mPlaceholder.Destroy();
+        mEnvMap  = nullptr;
+        mEnabled = false;
+    }
+
+}  // namespace denoise
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "util/envmapdistribution.hpp"
+#include <foray_api.hpp>
+
+namespace denoise {
+
+    /// @brief Environment map and its importance sampling tables as bound by the ComplexRaytracingStage (see shaders/envsampler.glsl)
+    /// @details Without an environment map a black 1x1 placeholder is bound and the table header reports a width of 0, which disables
+    /// environment sampling in the shaders.
+    class EnvironmentSampler
+    {
+      public:
+        /// @param envMap Sampled equirectangular environment map, nullptr for a black environment
+        /// @param distribution Tables built from the texels of envMap. Ignored if envMap is nullptr
+        void Create(foray::core::Context* context, foray::core::CombinedImageSampler* envMap, const util::EnvMapDistribution* distribution);
+        void Destroy();
+
+        inline foray::core::ManagedBuffer&        GetBuffer() { return mBuffer; }
+        inline foray::core::CombinedImageSampler* GetEnvMap() { return !!mEnvMap ? mEnvMap : &mPlaceholderSampled; }
+        /// @brief Whether the shaders sample the environment (an environment map with a non black distribution is set)
+        inline bool IsEnabled() const { return mEnabled; }
+
+      protected:
+        void CreatePlaceholder(foray::core::Context* context);
+
+        foray::core::CombinedImageSampler* mEnvMap = nullptr;
+        foray::core::ManagedBuffer         mBuffer;
+        foray::core::ManagedImage          mPlaceholder;
+        foray::core::CombinedImageSampler  mPlaceholderSampled;
+        bool                               mEnabled = false;
+    };
+
+}  // namespace denoise
@@ -1,4 +1,5 @@
 #include "foray_rtstage.hpp"
+#include <algorithm>
 #include <gltf/foray_modelconverter.hpp>
 #include <scene/globalcomponents/foray_lightmanager.hpp>
 
@@ -6,17 +7,267 @@ namespace denoise {
     void ComplexRaytracingStage::Init(foray::core::Context* context, foray::scene::Scene* scene)
     {
         mLightManager = scene->GetComponent<foray::scene::gcomp::LightManager>();
+        mLightSampler.Create(context, static_cast<uint32_t>(mLightManager->GetSimplifiedLights().size()));
+        mEnvironmentSampler.Create(context, mEnvMap, mEnvMapDistribution);
+
+        foray::core::ManagedBuffer::CreateInfo ci(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(RtStageConfig),
+                                                  VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, "RtStageConfig");
+        mConfigBuffer.Create(context, ci);
+
+        foray::core::ManagedBuffer::CreateInfo statusCi(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(uint32_t),
+                                                        VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                                                        "RtStage Accumulation Status");
+        mAccumulationStatus.Create(context, statusCi);
+        void* mapped = nullptr;
+        mAccumulationStatus.Map(mapped);
+        mAccumulationStatusMapped = reinterpret_cast<const uint32_t*>(mapped);
+
+        // The shaders always bind the accumulation images, they are only allocated full size if accumulation is used
+        CreateAccumulationImages(context, mAccumulationSupported ? context->GetSwapchainSize() : VkExtent2D{.width = 1, .height = 1});
+
         foray::stages::DefaultRaytracingStageBase::Init(context, scene);
+
+        VkExtent3D outputExtent = GetRtOutput()->GetExtent3D();
+        mActiveExtent           = VkExtent2D{.width = outputExtent.width, .height = outputExtent.height};
+        if(mRenderScaleSupported)
+        {
+            foray::core::ManagedImage::CreateInfo scratchCi(VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, GetRtOutput()->GetFormat(), mActiveExtent,
+                                                            "RtStage Upscale Scratch");
+            mUpscaleScratch.Create(context, scratchCi);
+        }
+    }
+
+    void ComplexRaytracingStage::CreateAccumulationImages(foray::core::Context* context, VkExtent2D extent)
+    {
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if(mAccumulationMean.Exists())
+        {
+            mAccumulationMean.Resize(extent);
+            mAccumulationM2.Resize(extent);
+            return;
+        }
+        foray::core::ManagedImage::CreateInfo meanCi(usage, VK_FORMAT_R32G32B32A32_SFLOAT, extent, "RtStage Accumulation Mean");
+        mAccumulationMean.Create(context, meanCi);
+        foray::core::ManagedImage::CreateInfo m2Ci(usage, VK_FORMAT_R32G32B32A32_SFLOAT, extent, "RtStage Accumulation M2");
+        mAccumulationM2.Create(context, m2Ci);
+    }
+
+    void ComplexRaytracingStage::BeginAccumulation(const AccumulationConfig& config)
+    {
+        foray::Assert(mAccumulationSupported, "ComplexRaytracingStage: Accumulation requires SetAccumulationSupported(true) before Init()");
+        mAccumulationConfig = config;
+        mAccumulating       = true;
+        mAccumulationReset  = true;
+        mAccumulatedSamples = 0;
+    }
+
+    void ComplexRaytracingStage::EndAccumulation()
+    {
+        mAccumulating = false;
+    }
+
+    uint32_t ComplexRaytracingStage::GetConvergedPixelCount() const
+    {
+        if(!mAccumulationStatusMapped)
+        {
+            return 0;
+        }
+        // The host barrier recorded with each frame makes the counter available, the memory may still not be host coherent
+        vmaInvalidateAllocation(mContext->Allocator, mAccumulationStatus.GetAllocation(), 0, VK_WHOLE_SIZE);
+        return *mAccumulationStatusMapped;
+    }
+
+    void ComplexRaytracingStage::SetActiveExtent(VkExtent2D extent)
+    {
+        VkExtent3D outputExtent = GetRtOutput()->GetExtent3D();
+        extent.width            = std::clamp(extent.width, 1u, outputExtent.width);
+        extent.height           = std::clamp(extent.height, 1u, outputExtent.height);
+        foray::Assert(mUpscaleScratch.Exists() || (extent.width == outputExtent.width && extent.height == outputExtent.height),
+                      "ComplexRaytracingStage: Tracing below the output size requires SetRenderScaleSupported(true) before Init()");
+        mActiveExtent = extent;
+    }
+
+    void ComplexRaytracingStage::OnResized(const VkExtent2D& extent)
+    {
+        if(mAccumulationSupported)
+        {
+            CreateAccumulationImages(mContext, extent);
+            mAccumulationReset  = true;
+            mAccumulatedSamples = 0;
+        }
+        if(mUpscaleScratch.Exists())
+        {
+            mUpscaleScratch.Resize(extent);
+        }
+        mActiveExtent = extent;
+        foray::stages::DefaultRaytracingStageBase::OnResized(extent);
+    }
+
+    void ComplexRaytracingStage::RecordFrame(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo)
+    {
+        mConfig.RngSeed                  = mRngSeedOverride.value_or(static_cast<uint32_t>(renderInfo.GetFrameNumber()));
+        mConfig.Flags                    = 0;
+        mConfig.AccumulateMinSamples     = mAccumulationConfig.MinSamples;
+        mConfig.AccumulateErrorThreshold = mAccumulationConfig.ErrorThreshold;
+        mConfig.ActiveWidth              = mActiveExtent.width;
+        mConfig.ActiveHeight             = mActiveExtent.height;
+        if(mAccumulating)
+        {
+            mConfig.Flags |= RTSTAGEFLAG_ACCUMULATE | (mAccumulationReset ? RTSTAGEFLAG_ACCUMULATE_RESET : 0u);
+            RecordAccumulationBarriers(cmdBuffer, renderInfo, mAccumulationReset);
+            mAccumulationReset = false;
+            mAccumulatedSamples++;
+        }
+
+        // The config is small enough to be recorded inline, which keeps it in sync with the frame without per frame staging buffers
+        VkMemoryBarrier2 barriers[2]{{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                      .srcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                      .srcAccessMask = VK_ACCESS_2_NONE,
+                                      .dstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                      .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT},
+                                     {.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                      .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                      .dstStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                      .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT}};
+        VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barriers[0]};
+        vkCmdPipelineBarrier2(cmdBuffer, &depInfo);
+        vkCmdUpdateBuffer(cmdBuffer, mConfigBuffer.GetBuffer(), 0, sizeof(mConfig), &mConfig);
+        depInfo.pMemoryBarriers = &barriers[1];
+        vkCmdPipelineBarrier2(cmdBuffer, &depInfo);
+
+        mLightSampler.Update(mLightManager->GetSimplifiedLights());
+        mLightSampler.CmdUpload(cmdBuffer);
+
+        // The base stage launches one invocation per output texel, those outside the active extent return right away
+        foray::stages::DefaultRaytracingStageBase::RecordFrame(cmdBuffer, renderInfo);
+        VkExtent3D outputExtent = GetRtOutput()->GetExtent3D();
+        if(mActiveExtent.width != outputExtent.width || mActiveExtent.height != outputExtent.height)
+        {
+            RecordUpscale(cmdBuffer, renderInfo);
+        }
+
+        if(mAccumulating)
+        {
+            // Converged pixel count is read by the host once the frame finished
+            VkMemoryBarrier2 hostBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                         .srcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                         .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                         .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+                                         .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT};
+            VkDependencyInfo hostDepInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &hostBarrier};
+            vkCmdPipelineBarrier2(cmdBuffer, &hostDepInfo);
+        }
+    }
+
+    void ComplexRaytracingStage::RecordAccumulationBarriers(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo, bool reset)
+    {
+        if(reset)
+        {
+            VkMemoryBarrier2 fillBarriers[2]{{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                              .srcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                              .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                              .dstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                              .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT},
+                                             {.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                              .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                              .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                              .dstStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                              .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT}};
+            VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &fillBarriers[0]};
+            vkCmdPipelineBarrier2(cmdBuffer, &depInfo);
+            vkCmdFillBuffer(cmdBuffer, mAccumulationStatus.GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+            depInfo.pMemoryBarriers = &fillBarriers[1];
+            vkCmdPipelineBarrier2(cmdBuffer, &depInfo);
+        }
+
+        // The images are never cleared: the reset sample overwrites them. Accumulation happens in place, nothing is copied per frame.
+        foray::core::ImageLayoutCache::Barrier2 barrier{.SrcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                        .SrcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_READ_BIT,
+                                                        .DstStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                                        .DstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                                        .NewLayout     = VK_IMAGE_LAYOUT_GENERAL};
+        renderInfo.GetImageLayoutCache().CmdBarrier(cmdBuffer, &mAccumulationMean, barrier);
+        renderInfo.GetImageLayoutCache().CmdBarrier(cmdBuffer, &mAccumulationM2, barrier);
+    }
+
+    void ComplexRaytracingStage::RecordUpscale(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo)
+    {
+        foray::core::ManagedImage*     output       = GetRtOutput();
+        VkExtent3D                     outputExtent = output->GetExtent3D();
+        foray::core::ImageLayoutCache& layoutCache  = renderInfo.GetImageLayoutCache();
+        const VkImageSubresourceLayers subresource{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1};
+
+        foray::core::ImageLayoutCache::Barrier2 traced{.SrcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                                       .SrcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                                                       .DstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                       .DstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                                                       .NewLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        foray::core::ImageLayoutCache::Barrier2 scratchWrite{.SrcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                             .SrcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                                                             .DstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                             .DstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                                             .NewLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+        layoutCache.CmdBarrier(cmdBuffer, output, traced);
+        layoutCache.CmdBarrier(cmdBuffer, &mUpscaleScratch, scratchWrite);
+        VkImageCopy copy{.srcSubresource = subresource, .dstSubresource = subresource, .extent = {mActiveExtent.width, mActiveExtent.height, 1}};
+        vkCmdCopyImage(cmdBuffer, output->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, mUpscaleScratch.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+        foray::core::ImageLayoutCache::Barrier2 scratchRead{.SrcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                            .SrcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                                            .DstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                            .DstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                                                            .NewLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        foray::core::ImageLayoutCache::Barrier2 outputWrite{.SrcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                            .SrcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                                                            .DstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                            .DstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                                            .NewLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+        layoutCache.CmdBarrier(cmdBuffer, &mUpscaleScratch, scratchRead);
+        layoutCache.CmdBarrier(cmdBuffer, output, outputWrite);
+        // Nearest keeps every output texel a single path sample, so the denoisers' noise estimates hold
+        VkImageBlit blit{.srcSubresource = subresource,
+                         .srcOffsets     = {{0, 0, 0}, {static_cast<int32_t>(mActiveExtent.width), static_cast<int32_t>(mActiveExtent.height), 1}},
+                         .dstSubresource = subresource,
+                         .dstOffsets     = {{0, 0, 0}, {static_cast<int32_t>(outputExtent.width), static_cast<int32_t>(outputExtent.height), 1}}};
+        vkCmdBlitImage(cmdBuffer, mUpscaleScratch.GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, output->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                       VK_FILTER_NEAREST);
+
+        // Consumers expect the output where the ray tracing shaders left it
+        foray::core::ImageLayoutCache::Barrier2 upscaled{.SrcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                         .SrcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                                         .DstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                         .DstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                                         .NewLayout     = VK_IMAGE_LAYOUT_GENERAL};
+        layoutCache.CmdBarrier(cmdBuffer, output, upscaled);
+    }
+
+    void ComplexRaytracingStage::Destroy()
+    {
+        foray::stages::DefaultRaytracingStageBase::Destroy();
+        mConfigBuffer.Destroy();
+        mLightSampler.Destroy();
+        mEnvironmentSampler.Destroy();
+        if(!!mAccumulationStatusMapped)
+        {
+            mAccumulationStatus.Unmap();
+            mAccumulationStatusMapped = nullptr;
+        }
+        mAccumulationStatus.Destroy();
+        mAccumulationMean.Destroy();
+        mAccumulationM2.Destroy();
+        mUpscaleScratch.Destroy();
+        mAccumulating = false;
     }
 
     void ComplexRaytracingStage::ApiCreateRtPipeline()
     {
-        mShaderKeys.push_back(mRaygen.CompileFromSource(mContext, RAYGEN_FILE));
-        mShaderKeys.push_back(mClosestHit.CompileFromSource(mContext, CLOSESTHIT_FILE));
-        mShaderKeys.push_back(mAnyHit.CompileFromSource(mContext, ANYHIT_FILE));
-        mShaderKeys.push_back(mMiss.CompileFromSource(mContext, MISS_FILE));
-        mShaderKeys.push_back(mVisiMiss.CompileFromSource(mContext, VISI_MISS_FILE));
-        mShaderKeys.push_back(mVisiAnyHit.CompileFromSource(mContext, VISI_ANYHIT_FILE));
+        LoadShader(mRaygen, RAYGEN_FILE);
+        LoadShader(mClosestHit, CLOSESTHIT_FILE);
+        LoadShader(mAnyHit, ANYHIT_FILE);
+        LoadShader(mMiss, MISS_FILE);
+        LoadShader(mVisiMiss, VISI_MISS_FILE);
+        LoadShader(mVisiAnyHit, VISI_ANYHIT_FILE);
 
         mPipeline.GetRaygenSbt().SetGroup(0, &mRaygen);
         mPipeline.GetHitSbt().SetGroup(0, &mClosestHit, &mAnyHit, nullptr);
@@ -26,6 +277,15 @@ namespace denoise {
         mPipeline.Build(mContext, mPipelineLayout);
     }
 
+    void ComplexRaytracingStage::LoadShader(foray::core::ShaderModule& module, const std::string& sourcePath)
+    {
+        if(!!mShaderCache && mShaderCache->Load(mContext, sourcePath, module))
+        {
+            return;
+        }
+        mShaderKeys.push_back(module.CompileFromSource(mContext, sourcePath));
+    }
+
     void ComplexRaytracingStage::ApiDestroyRtPipeline()
     {
         mPipeline.Destroy();
@@ -39,9 +299,31 @@ namespace denoise {
 
     void ComplexRaytracingStage::CreateOrUpdateDescriptors()
     {
-        const uint32_t bindpoint_lights = 11;
+        const uint32_t bindpoint_lights             = 11;
+        const uint32_t bindpoint_stageconfig        = 12;
+        const uint32_t bindpoint_accumulationmean   = 13;
+        const uint32_t bindpoint_accumulationm2     = 14;
+        const uint32_t bindpoint_accumulationstatus = 15;
+        const uint32_t bindpoint_lightsampler       = 16;
+        const uint32_t bindpoint_envsampler         = 17;
+        const uint32_t bindpoint_envmap             = 18;
 
         mDescriptorSet.SetDescriptorAt(bindpoint_lights, mLightManager->GetBuffer().GetVkDescriptorInfo(), VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, foray::stages::RTSTAGEFLAGS);
+        mDescriptorSet.SetDescriptorAt(bindpoint_stageconfig, mConfigBuffer.GetVkDescriptorInfo(), VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, foray::stages::RTSTAGEFLAGS);
+        mDescriptorSet.SetDescriptorAt(bindpoint_accumulationmean, &mAccumulationMean, VK_IMAGE_LAYOUT_GENERAL, nullptr, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                       foray::stages::RTSTAGEFLAGS);
+        mDescriptorSet.SetDescriptorAt(bindpoint_accumulationm2, &mAccumulationM2, VK_IMAGE_LAYOUT_GENERAL, nullptr, VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                       foray::stages::RTSTAGEFLAGS);
+        mDescriptorSet.SetDescriptorAt(bindpoint_accumulationstatus, mAccumulationStatus.GetVkDescriptorInfo(), VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                       foray::stages::RTSTAGEFLAGS);
+
+        mDescriptorSet.SetDescriptorAt(bindpoint_lightsampler, mLightSampler.GetBuffer().GetVkDescriptorInfo(), VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                       foray::stages::RTSTAGEFLAGS);
+        mDescriptorSet.SetDescriptorAt(bindpoint_envsampler, mEnvironmentSampler.GetBuffer().GetVkDescriptorInfo(), VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                       foray::stages::RTSTAGEFLAGS);
+        foray::core::CombinedImageSampler* envMap = mEnvironmentSampler.GetEnvMap();
+        mDescriptorSet.SetDescriptorAt(bindpoint_envmap, envMap->GetManagedImage(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, envMap->GetSampler(),
+                                       VkDescriptorType::VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, foray::stages::RTSTAGEFLAGS);
 
         foray::stages::DefaultRaytracingStageBase::CreateOrUpdateDescriptors();
     }
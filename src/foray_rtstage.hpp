@@ -1,5 +1,9 @@
 #pragma once
+#include "environmentsampler.hpp"
+#include "lightsampler.hpp"
+#include "util/shadercache.hpp"
 #include <foray_api.hpp>
+#include <optional>
 #include <stages/foray_defaultraytracingstage.hpp>
 #include <util/foray_noisesource.hpp>
 #include <scene/globalcomponents/foray_lightmanager.hpp>
@@ -13,10 +17,84 @@ namespace denoise {
     inline const std::string VISI_MISS_FILE  = APP_SHADER_DIR "/visibilitytest/miss.rmiss";
     inline const std::string VISI_ANYHIT_FILE  = APP_SHADER_DIR "/visibilitytest/anyhit.rahit";
 
+    /// @brief Bits of RtStageConfig::Flags (see shaders/rtstageconfig.glsl)
+    enum ERtStageFlags : uint32_t
+    {
+        /// @brief Radiance is accumulated into the accumulation images (running mean and variance), the output shows the mean
+        RTSTAGEFLAG_ACCUMULATE = 1u,
+        /// @brief First sample of an accumulation, the previous contents of the accumulation images are ignored
+        RTSTAGEFLAG_ACCUMULATE_RESET = 2u,
+    };
+
+    /// @brief Per frame configuration uploaded to the stage config buffer (see shaders/rtstageconfig.glsl)
+    struct RtStageConfig
+    {
+        uint32_t RngSeed = 0;
+        uint32_t Flags   = 0;
+        /// @brief Samples a pixel accumulates before its convergence is tested
+        uint32_t AccumulateMinSamples = 0;
+        /// @brief A pixel stops accumulating once the standard error of its mean falls below this fraction of the mean (per channel)
+        float AccumulateErrorThreshold = 0.f;
+        /// @brief Top left region of the output that is traced (see ComplexRaytracingStage::SetActiveExtent())
+        uint32_t ActiveWidth  = 0;
+        uint32_t ActiveHeight = 0;
+    };
+
+    /// @brief Progressive accumulation of a reference image with a frozen camera
+    struct AccumulationConfig
+    {
+        uint32_t MinSamples = 64;
+        /// @brief Relative standard error a pixel converges at. 0 disables the early stop
+        float ErrorThreshold = 0.01f;
+    };
+
     class ComplexRaytracingStage : public foray::stages::DefaultRaytracingStageBase
     {
       public:
         virtual void Init(foray::core::Context* context, foray::scene::Scene* scene);
+        virtual void RecordFrame(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo) override;
+        virtual void Destroy() override;
+
+        /// @brief Seed used by the most recently recorded frame
+        inline uint32_t GetRngSeed() const { return mConfig.RngSeed; }
+        /// @brief If set, every frame is traced with this seed instead of the frame number (used to reproduce captured frames)
+        inline void SetRngSeedOverride(std::optional<uint32_t> seed) { mRngSeedOverride = seed; }
+
+        /// @brief Allocates full size accumulation images. Call before Init()
+        inline void SetAccumulationSupported(bool supported) { mAccumulationSupported = supported; }
+        /// @brief Starts a new accumulation with the next recorded frame. The camera must not move until EndAccumulation()
+        void BeginAccumulation(const AccumulationConfig& config);
+        void EndAccumulation();
+        inline bool IsAccumulating() const { return mAccumulating; }
+        /// @brief Samples recorded since BeginAccumulation() (pixels that converged early hold fewer)
+        inline uint32_t GetAccumulatedSamples() const { return mAccumulatedSamples; }
+        /// @brief Number of pixels that stopped accumulating, as of the most recently finished frame
+        uint32_t GetConvergedPixelCount() const;
+        /// @brief Running mean (rgb) and sample count (a) of the accumulation
+        inline foray::core::ManagedImage* GetAccumulationMean() { return &mAccumulationMean; }
+
+        /// @brief Allocates the scratch image SetActiveExtent() needs to trace below the output size. Call before Init()
+        inline void SetRenderScaleSupported(bool supported) { mRenderScaleSupported = supported; }
+        /// @brief Traces only the top left extent of the output (holding the full view) and scales it up to the full output in place, so the
+        /// G-buffer, denoisers and all other consumers keep working at the output size. Takes effect with the next recorded frame without
+        /// reallocating anything. OnResized() resets it to the full output
+        void SetActiveExtent(VkExtent2D extent);
+        inline VkExtent2D GetActiveExtent() const { return mActiveExtent; }
+
+        /// @brief Resizes the output and resets the active extent to it
+        virtual void OnResized(const VkExtent2D& extent) override;
+
+        /// @brief Equirectangular environment map lighting the scene (miss shader and next event estimation). Call before Init()
+        /// @param envMap Sampled environment map, nullptr for a black environment
+        /// @param distribution Importance sampling tables built from the environment map's texels, must outlive Init()
+        inline void SetEnvironmentMap(foray::core::CombinedImageSampler* envMap, const util::EnvMapDistribution* distribution)
+        {
+            mEnvMap             = envMap;
+            mEnvMapDistribution = distribution;
+        }
+
+        /// @brief Shaders are loaded from this cache instead of being compiled on every pipeline build. Cached shaders are not hot reloaded
+        inline void SetShaderCache(util::ShaderCache* cache) { mShaderCache = cache; }
 
       protected:
         virtual void ApiCreateRtPipeline() override;
@@ -24,14 +102,50 @@ namespace denoise {
 
         virtual void CreateOrUpdateDescriptors() override;
 
+        /// @brief Loads the shader from the shader cache, falls back to compiling it (with hot reload) if there is none or loading fails
+        void LoadShader(foray::core::ShaderModule& module, const std::string& sourcePath);
+
+        void CreateAccumulationImages(foray::core::Context* context, VkExtent2D extent);
+        /// @brief Scales the active extent of the output up to the full output
+        void RecordUpscale(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo);
+        /// @brief Clears the converged pixel counter and transitions the accumulation images for the ray tracing shaders
+        void RecordAccumulationBarriers(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo, bool reset);
+
         foray::core::ShaderModule mRaygen;
         foray::core::ShaderModule mClosestHit;
         foray::core::ShaderModule mAnyHit;
         foray::core::ShaderModule mMiss;
         foray::core::ShaderModule mVisiMiss;
         foray::core::ShaderModule mVisiAnyHit;
+        util::ShaderCache*        mShaderCache = nullptr;
 
         foray::scene::gcomp::LightManager* mLightManager;
+        LightSampler                       mLightSampler;
+
+        foray::core::CombinedImageSampler* mEnvMap             = nullptr;
+        const util::EnvMapDistribution*    mEnvMapDistribution = nullptr;
+        EnvironmentSampler                 mEnvironmentSampler;
+
+        RtStageConfig              mConfig;
+        std::optional<uint32_t>    mRngSeedOverride;
+        foray::core::ManagedBuffer mConfigBuffer;
+
+        bool               mAccumulationSupported = false;
+        bool               mAccumulating          = false;
+        bool               mAccumulationReset     = false;
+        AccumulationConfig mAccumulationConfig;
+        uint32_t           mAccumulatedSamples = 0;
+        /// @brief Running mean (rgb) and sample count (a), sum of squared deviations (rgb) and converged flag (a). 1x1 unless accumulation is supported
+        foray::core::ManagedImage mAccumulationMean;
+        foray::core::ManagedImage mAccumulationM2;
+        /// @brief Host visible counter of converged pixels
+        foray::core::ManagedBuffer mAccumulationStatus;
+        const uint32_t*            mAccumulationStatusMapped = nullptr;
+
+        bool       mRenderScaleSupported = false;
+        VkExtent2D mActiveExtent{};
+        /// @brief Copy of the traced region, the blit scaling it up can not read and write overlapping regions of the output
+        foray::core::ManagedImage mUpscaleScratch;
     };
 
 }  // namespace denoise
@@ -0,0 +1,619 @@
+#include "launchoptions.hpp"
+#include <charconv>
+#include <foray_logger.hpp>
+#include <map>
+#include <string_view>
+
+namespace denoise {
+
+    std::vector<std::string> lSplitList(std::string_view list)
+    {
+        std::vector<std::string> result;
+        while(list.size() > 0)
+        {
+            size_t           split = list.find(',');
+            std::string_view item  = list.substr(0, split);
+            if(item.size() > 0)
+            {
+                result.emplace_back(item);
+            }
+            if(split == std::string_view::npos)
+            {
+                break;
+            }
+            list = list.substr(split + 1);
+        }
+        return result;
+    }
+
+    bool lParseUint(std::string_view text, uint32_t& out)
+    {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size();
+    }
+
+    bool lParseFloat(std::string_view text, float& out)
+    {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), out);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size() && out >= 0.f;
+    }
+
+    bool lParseExtent(std::string_view text, VkExtent2D& out)
+    {
+        size_t split = text.find('x');
+        if(split == std::string_view::npos)
+        {
+            return false;
+        }
+        return lParseUint(text.substr(0, split), out.width) && lParseUint(text.substr(split + 1), out.height) && out.width > 0 && out.height > 0;
+    }
+
+    bool LaunchOptions::Parse(int argc, char** argv)
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            std::string_view arg(argv[i]);
+
+            // Options taking a value
+            const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+            auto        takeValue = [&]() -> bool {
+                if(!value)
+                {
+                    foray::logger()->error("Missing value for option \"{}\"", arg);
+                    return false;
+                }
+                i++;
+                return true;
+            };
+
+            if(arg == "--help" || arg == "-h")
+            {
+                PrintUsage();
+                return false;
+            }
+            else if(arg == "--bench")
+            {
+                Bench = true;
+            }
+            else if(arg == "--scene" || arg == "--scenes")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                Scenes      = lSplitList(value);
+                BenchScenes = Scenes;
+            }
+            else if(arg == "--camera")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                CameraPath = value;
+            }
+            else if(arg == "--envmap")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                EnvMapPath = std::string_view(value) == "default" ? DATA_DIR "/env/default/envmap.exr" : value;
+            }
+            else if(arg == "--denoisers")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                BenchDenoisers = lSplitList(value);
+            }
+            else if(arg == "--resolutions")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                BenchResolutions.clear();
+                for(const std::string& item : lSplitList(value))
+                {
+                    VkExtent2D extent{};
+                    if(!lParseExtent(item, extent))
+                    {
+                        foray::logger()->error("Invalid resolution \"{}\", expected <width>x<height>", item);
+                        return false;
+                    }
+                    BenchResolutions.push_back(extent);
+                }
+            }
+            else if(arg == "--frames")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, BenchFrames) || BenchFrames == 0)
+                {
+                    foray::logger()->error("Invalid frame count \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--report")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                BenchReportPath = value;
+            }
+            else if(arg == "--bench-log")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                BenchLogPath = value;
+            }
+            else if(arg == "--bench-baseline")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                GateBaseline = value;
+            }
+            else if(arg == "--bench-candidate")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                GateCandidate = value;
+            }
+            else if(arg == "--gate-threshold")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseFloat(value, GateThreshold))
+                {
+                    foray::logger()->error("Invalid threshold \"{}\", expected a percentage", value);
+                    return false;
+                }
+            }
+            else if(arg == "--gate-summary")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                GateSummaryPath = value;
+            }
+            else if(arg == "--warmup-frames")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, GateWarmupFrames))
+                {
+                    foray::logger()->error("Invalid frame count \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--profile")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                ProfilePath = value;
+            }
+            else if(arg == "--capture")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                CapturePath = value;
+            }
+            else if(arg == "--capture-frames")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, CaptureFrames))
+                {
+                    foray::logger()->error("Invalid frame count \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--reference")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                ReferenceDir = value;
+            }
+            else if(arg == "--generate-reference")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                GenerateReferenceDir = value;
+            }
+            else if(arg == "--reference-spp")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, ReferenceSamples) || ReferenceSamples == 0)
+                {
+                    foray::logger()->error("Invalid sample count \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--reference-error")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseFloat(value, ReferenceErrorThreshold))
+                {
+                    foray::logger()->error("Invalid error threshold \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--keyframe-stride")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, ReferenceKeyframeStride) || ReferenceKeyframeStride == 0)
+                {
+                    foray::logger()->error("Invalid keyframe stride \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--cpu-denoise")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                CpuDenoiser = value;
+            }
+            else if(arg == "--input")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                CpuInput = value;
+            }
+            else if(arg == "--output")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                CpuOutputDir = value;
+            }
+            else if(arg == "--threads")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, CpuThreads))
+                {
+                    foray::logger()->error("Invalid thread count \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--queue-depth")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, CpuQueueDepth) || CpuQueueDepth == 0)
+                {
+                    foray::logger()->error("Invalid queue depth \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--io-threads")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, CpuIoThreads) || CpuIoThreads == 0)
+                {
+                    foray::logger()->error("Invalid I/O thread count \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--packed-gbuffer")
+            {
+                CpuPackedGBuffer = true;
+            }
+            else if(arg == "--tile-size")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, CpuTileSize))
+                {
+                    foray::logger()->error("Invalid tile size \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--verify-tiles")
+            {
+                CpuVerifyTiles = true;
+            }
+            else if(arg == "--cpu-render")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                CpuRenderScene = value;
+            }
+            else if(arg == "--render-frames")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, CpuRenderFrames))
+                {
+                    foray::logger()->error("Invalid frame count \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--resolution")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseExtent(value, CpuRenderExtent))
+                {
+                    foray::logger()->error("Invalid resolution \"{}\", expected <width>x<height>", value);
+                    return false;
+                }
+            }
+            else if(arg == "--texture-budget")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, CpuTextureBudget))
+                {
+                    foray::logger()->error("Invalid texture budget \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--adaptive-spp")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseFloat(value, CpuAdaptiveSamples) || !(CpuAdaptiveSamples >= 1.f))
+                {
+                    // Every tile takes at least one sample, a lower average would exceed the budget
+                    foray::logger()->error("Invalid sample count \"{}\" (at least 1)", value);
+                    return false;
+                }
+            }
+            else if(arg == "--max-spp")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseUint(value, CpuMaxSamples) || CpuMaxSamples == 0)
+                {
+                    foray::logger()->error("Invalid sample count \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--pipeline-denoise")
+            {
+                PipelineExternalDenoise = true;
+            }
+            else if(arg == "--target-frame-time")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseFloat(value, TargetFrameTime) || TargetFrameTime < 0.f)
+                {
+                    foray::logger()->error("Invalid frame time \"{}\"", value);
+                    return false;
+                }
+            }
+            else if(arg == "--min-render-scale")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                if(!lParseFloat(value, MinRenderScale) || !(MinRenderScale > 0.f && MinRenderScale <= 1.f))
+                {
+                    foray::logger()->error("Invalid render scale \"{}\", expected (0, 1]", value);
+                    return false;
+                }
+            }
+            else if(arg == "--frame-time-trace")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                FrameTimeTracePath = value;
+            }
+            else if(arg == "--scene-cache")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                SceneCacheDir = value;
+            }
+            else if(arg == "--no-scene-cache")
+            {
+                SceneCacheDir.clear();
+            }
+            else if(arg == "--shader-cache")
+            {
+                if(!takeValue())
+                {
+                    return false;
+                }
+                ShaderCacheDir = value;
+            }
+            else
+            {
+                foray::logger()->error("Unknown option \"{}\"", arg);
+                PrintUsage();
+                return false;
+            }
+        }
+
+        if(GateBaseline.empty() != GateCandidate.empty())
+        {
+            foray::logger()->error("The regression gate requires both --bench-baseline <csv> and --bench-candidate <csv>");
+            return false;
+        }
+        if(!CpuDenoiser.empty() && !CpuRenderScene.empty())
+        {
+            foray::logger()->error("--cpu-denoise and --cpu-render can not be combined, render into an --output directory first");
+            return false;
+        }
+        if(!CpuDenoiser.empty() && CpuInput.empty())
+        {
+            foray::logger()->error("--cpu-denoise requires --input <capture file|EXR sequence directory>");
+            return false;
+        }
+        if(CpuVerifyTiles && CpuTileSize == 0)
+        {
+            foray::logger()->error("--verify-tiles requires --tile-size <pixels>");
+            return false;
+        }
+        if(CpuPackedGBuffer && CpuTileSize > 0)
+        {
+            foray::logger()->error("--packed-gbuffer can not be combined with --tile-size, tiles are read straight from the input file");
+            return false;
+        }
+        if(!GenerateReferenceDir.empty())
+        {
+            if(Bench)
+            {
+                foray::logger()->error("--generate-reference can not be combined with --bench");
+                return false;
+            }
+            if(CameraPath.empty())
+            {
+                CameraPath = DATA_DIR "/animatedCamera.gltf";
+            }
+        }
+        if(TargetFrameTime > 0.f && (Bench || !GenerateReferenceDir.empty()))
+        {
+            foray::logger()->error("--target-frame-time can not be combined with --bench or --generate-reference, which render at fixed resolutions");
+            return false;
+        }
+        if(!FrameTimeTracePath.empty() && !(TargetFrameTime > 0.f))
+        {
+            foray::logger()->error("--frame-time-trace requires --target-frame-time");
+            return false;
+        }
+        if(Bench && BenchScenes.empty())
+        {
+            BenchScenes = {"testbox"};
+        }
+        return true;
+    }
+
+    void LaunchOptions::PrintUsage()
+    {
+        foray::logger()->info(
+            "Usage: foray-denoising [options]\n"
+            "  --scene <name|path>[,...]     Scenes to load (testbox, outdoorbox, testboxanimated, sponza or glTF paths)\n"
+            "  --camera <path>               Additional glTF file providing an animated camera\n"
+            "  --envmap <path|default>       Importance sampled equirectangular EXR environment map (default: data/env/default/envmap.exr)\n"
+            "  --bench                       Run the benchmark matrix (scenes x resolutions x denoisers) and exit\n"
+            "  --denoisers <name>[,...]      Denoisers benchmarked (default: all)\n"
+            "  --resolutions <WxH>[,...]     Render resolutions benchmarked (default: swapchain size)\n"
+            "  --frames <count>              Frames recorded per benchmark case (default: 2000)\n"
+            "  --report <path>               Benchmark report output (default: bench.csv)\n"
+            "  --bench-log <path>            Stream per frame denoiser timings (CSV, binary if .bin) with constant memory, e.g. for soak tests\n"
+            "  --bench-baseline <csv>        Compare --bench-candidate against this benchmark CSV (--report or --bench-log), exit 1 on regressions\n"
+            "  --bench-candidate <csv>       Benchmark CSV of the run checked by the regression gate\n"
+            "  --gate-threshold <percent>    Smallest significant median change counted as regression (default: 2)\n"
+            "  --gate-summary <path>         Write the regression gate verdict per scene, denoiser, resolution and metric as CSV\n"
+            "  --warmup-frames <count>       Leading values per series ignored by the regression gate (default: 100)\n"
+            "  --profile <path>              Record a timeline of host scopes and render stage device timings, written as Chrome trace JSON on exit\n"
+            "  --capture <path>              Record noisy input, G-buffer, camera and RNG seed of every frame to a capture file\n"
+            "  --capture-frames <count>      Number of frames captured (default: 0 = until exit)\n"
+            "  --reference <dir>             Score denoised frames (MSE, PSNR, SSIM, FLIP, temporal error) against <frame:06>.exr references\n"
+            "                                (in bench mode <dir>/<scene>/ is used if it exists)\n"
+            "  --generate-reference <dir>    Accumulate a reference at every camera keyframe (--camera, default data/animatedCamera.gltf) and exit\n"
+            "  --reference-spp <count>       Maximum samples per reference pixel (default: 4096)\n"
+            "  --reference-error <fraction>  Pixels stop accumulating below this relative standard error (default: 0.01, 0 = never)\n"
+            "  --keyframe-stride <n>         Generate a reference for every n-th keyframe only (default: 1)\n"
+            "  --cpu-denoise <bmfr|asvgf>    Denoise --input on the CPU (no GPU required) and report throughput\n"
+            "  --input <path>                Capture file or EXR sequence directory (<frame>.color|albedo|normal|position|motion.exr)\n"
+            "  --output <dir>                Write denoised frames as EXR\n"
+            "  --threads <count>             CPU threads (default: all)\n"
+            "  --queue-depth <count>         Frames decoded ahead of and encoded behind the CPU denoiser (default: 4)\n"
+            "  --io-threads <count>          Reader and writer threads each for CPU denoising (default: 2)\n"
+            "  --packed-gbuffer              CPU denoisers read a compact G-buffer (16 instead of 64 bytes per pixel), capture input only\n"
+            "  --tile-size <pixels>          CPU denoise in tiles of this size with bounded memory, single frames only (default: 0, untiled)\n"
+            "  --verify-tiles                Also denoise untiled and fail if the tiled result differs\n"
+            "  --cpu-render <name|path>      Render a scene with the CPU path tracer (no GPU required) and report throughput\n"
+            "  --render-frames <count>       Frames rendered along the camera animation (default: 16)\n"
+            "  --resolution <WxH>            CPU render resolution (default: 1280x720)\n"
+            "  --texture-budget <MiB>        Stream CPU render texture mips within this budget (default: 0, all resident)\n"
+            "  --adaptive-spp <average>      CPU render paths per pixel, distributed by the noise of the previous frame (default: 0, one per pixel)\n"
+            "  --max-spp <count>             Maximum paths per pixel with --adaptive-spp (default: 8)\n"
+            "  --pipeline-denoise            Overlap tracing with external (OptiX) denoising of the previous frame, adds one frame of latency\n"
+            "  --target-frame-time <ms>      Scale the render resolution to hold this device frame time (default: 0, output resolution)\n"
+            "  --min-render-scale <fraction> Lowest render scale per axis with --target-frame-time (default: 0.5)\n"
+            "  --frame-time-trace <path>     Write the render scale and device frame time of every frame with --target-frame-time as CSV\n"
+            "  --scene-cache <dir>           Cooked scene cache (default: src/scenecache)\n"
+            "  --no-scene-cache              Always load scenes from their source files\n"
+            "  --shader-cache <dir>          Cache compiled shaders, e.g. shadercache for src/shadercache (disables shader hot reload)");
+    }
+
+    std::string ResolveScenePath(const std::string& nameOrPath)
+    {
+        static const std::map<std::string_view, const char*> sKnownScenes{
+            {"testbox", DATA_DIR "/gltf/testbox/scene.gltf"},
+            {"outdoorbox", DATA_DIR "/gltf/outdoorbox/scene.gltf"},
+            {"testboxanimated", DATA_DIR "/gltf/testboxanimated/scene.gltf"},
+            {"sponza", DATA_DIR "/intel-sponza/main_sponza/NewSponza_Main_glTF_002.gltf"},
+        };
+        auto iter = sKnownScenes.find(nameOrPath);
+        if(iter != sKnownScenes.end())
+        {
+            return iter->second;
+        }
+        return nameOrPath;
+    }
+
+}  // namespace denoise
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace denoise {
+
+    /// @brief Animations advance by this constant time step per scene update
+    inline constexpr float ANIMATION_FRAME_DELTA = 0.01666666667f;
+
+    /// @brief Command line options of the application
+    struct LaunchOptions
+    {
+        /// @brief Scene names (testbox, outdoorbox, testboxanimated, sponza) or glTF paths rendered in interactive mode
+        std::vector<std::string> Scenes;
+        /// @brief Additional glTF file providing an animated camera (e.g. data/animatedCamera.gltf)
+        std::string CameraPath;
+        /// @brief Equirectangular EXR environment map lighting the scene, empty for a black environment
+        std::string EnvMapPath;
+        /// @brief External denoisers (OptiX) denoise the previous frame while the current one is traced: higher throughput, one frame more latency
+        bool PipelineExternalDenoise = false;
+        /// @brief If set, the traced resolution is scaled below the output size to hold this device frame time in milliseconds. The traced region is
+        /// scaled up before denoising, G-buffer and denoisers stay at the output size
+        float TargetFrameTime = 0.f;
+        /// @brief Lowest render scale per axis the frame time controller may choose
+        float MinRenderScale = 0.5f;
+        /// @brief If set with TargetFrameTime, the render scale and device frame time fed to the controller are written to this CSV for every timed
+        /// frame. tests/resolutioncontrollertest replays such traces
+        std::string FrameTimeTracePath;
+
+        /// @brief If set, the application runs the benchmark matrix and terminates
+        bool                    Bench = false;
+        std::vector<std::string> BenchScenes;
+        /// @brief Denoiser names matched against DenoiserStage::GetUILabel() (case and punctuation insensitive)
+        std::vector<std::string> BenchDenoisers;
+        std::vector<VkExtent2D>  BenchResolutions;
+        uint32_t                 BenchFrames = 2000;
+        std::string              BenchReportPath = "bench.csv";
+
+        /// @brief If both are set, the application compares these benchmark CSVs (--report or CSV --bench-log output) and exits with the verdict
+        std::string GateBaseline;
+        std::string GateCandidate;
+        /// @brief Smallest significant median change in percent that fails the regression gate
+        float       GateThreshold = 2.f;
+        /// @brief Leading values dropped per series by the regression gate
+        uint32_t    GateWarmupFrames = 100;
+        /// @brief If set, the regression gate writes one CSV row per compared series to this file
+        std::string GateSummaryPath;
+
+        /// @brief If set, the denoiser timings of every frame are streamed to this file (CSV, or binary if the extension is .bin)
+        std::string BenchLogPath;
+        /// @brief If set, host scopes and device timings of the render stages are recorded and written to this file as Chrome trace JSON on exit
+        /// (chrome://tracing, ui.perfetto.dev)
+        std::string ProfilePath;
+
+        /// @brief If set, noisy input, G-buffer, camera and RNG seed of every frame are recorded to this capture file
+        std::string CapturePath;
+        /// @brief Number of frames to capture, 0 for unlimited
+        uint32_t    CaptureFrames = 0;
+
+        /// @brief If set, denoised frames are scored against the reference frames <index:06>.exr in this directory. The index counts from application
+        /// start (interactive, CPU denoising) or case start (benchmark, where <dir>/<scene name> is preferred if it exists)
+        std::string ReferenceDir;
+
+        /// @brief If set, a reference is accumulated for every keyframe of the camera animation and written into this directory, then the application exits
+        std::string GenerateReferenceDir;
+        uint32_t    ReferenceSamples = 4096;
+        /// @brief Relative standard error at which a reference pixel stops accumulating, 0 to always take ReferenceSamples
+        float       ReferenceErrorThreshold = 0.01f;
+        /// @brief Only every n-th keyframe gets a reference
+        uint32_t    ReferenceKeyframeStride = 1;
+
+        /// @brief If set, the application denoises CpuInput on the CPU with this denoiser ("bmfr", "asvgf") and exits without creating a window
+        std::string CpuDenoiser;
+        /// @brief Capture file or EXR sequence directory
+        std::string CpuInput;
+        /// @brief If set, denoised frames are written as EXR into this directory
+        std::string CpuOutputDir;
+        /// @brief Threads used by CPU denoising and rendering, 0 for all hardware threads
+        uint32_t    CpuThreads       = 0;
+        /// @brief Frames CPU denoising decodes ahead and encodes behind. Bounds memory to about twice this many frames
+        uint32_t    CpuQueueDepth    = 4;
+        /// @brief Reader and writer threads each for CPU denoising
+        uint32_t    CpuIoThreads     = 2;
+        /// @brief CPU denoisers read a compact G-buffer (octahedral normals, depth instead of positions, binary16 motion), capture input only
+        bool        CpuPackedGBuffer = false;
+        /// @brief If not 0, CPU denoisers process frames in tiles of this edge length (plus halo) read straight from the input file, and finished
+        /// rows are written as they complete, which bounds memory independent of the frame height. Tiles are denoised without temporal history, so
+        /// temporal denoisers only accept single frame inputs
+        uint32_t    CpuTileSize      = 0;
+        /// @brief Additionally denoise every frame untiled and fail if the tiled result differs
+        bool        CpuVerifyTiles   = false;
+
+        /// @brief If set, the application renders this scene with the CPU path tracer and exits without creating a window. Frames are written to
+        /// CpuOutputDir as EXR sequence if set
+        std::string CpuRenderScene;
+        uint32_t    CpuRenderFrames = 16;
+        VkExtent2D  CpuRenderExtent = {1280, 720};
+        /// @brief Memory budget for the textures of the CPU path tracer in MiB. Mips are streamed in as the frames need them, 0 keeps all textures
+        /// resident at full resolution
+        uint32_t CpuTextureBudget = 0;
+        /// @brief Average paths per pixel of the CPU path tracer, distributed over screen tiles by the noise measured in the previous frame. 0 traces
+        /// one path per pixel
+        float    CpuAdaptiveSamples = 0.f;
+        uint32_t CpuMaxSamples      = 8;
+
+        /// @brief Scenes are cooked into self-contained glTF binaries with uncompressed textures in this directory (relative to the source directory),
+        /// empty to always load the source files
+        std::string SceneCacheDir = "scenecache";
+        /// @brief Compiled shaders are cached in this directory (relative to the source directory). Empty by default: shaders are always compiled
+        /// through foray, which keeps shader hot reload working
+        std::string ShaderCacheDir;
+
+        /// @brief Parses the command line. Logs an error and returns false on invalid input
+        bool Parse(int argc, char** argv);
+        static void PrintUsage();
+    };
+
+    /// @brief Resolves the short scene names shipped in the data directory to glTF paths. Other values are returned unchanged.
+    std::string ResolveScenePath(const std::string& nameOrPath);
+
+}  // namespace denoise
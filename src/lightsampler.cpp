@@ -0,0 +1,105 @@
+#include "lightsampler.hpp"
+#include <cstring>
+
+namespace denoise {
+
+    void LightSampler::Create(foray::core::Context* context, uint32_t capacity)
+    {
+        mCapacity = std::max(capacity, 1u);
+        foray::core::ManagedBuffer::CreateInfo ci(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                  sizeof(Header) + mCapacity * sizeof(util::AliasEntry), VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, "LightSampler");
+        mBuffer.Create(context, ci);
+        mLights.clear();
+        mWeights.clear();
+
+        // The shader falls back to uniform selection until the first table is uploaded
+        mUploadData.assign(sizeof(Header), 0);
+        mUploadPending = true;
+    }
+
+    void LightSampler::Destroy()
+    {
+        mBuffer.Destroy();
+        mLights.clear();
+        mWeights.clear();
+        mUploadData.clear();
+        mUploadPending = false;
+    }
+
+    float LightSampler::GetLightWeight(const foray::shader::SimplifiedLight& light)
+    {
+        float luminance = 0.2126f * light.Color.r + 0.7152f * light.Color.g + 0.0722f * light.Color.b;
+        return std::max(light.Intensity * luminance, 0.f);
+    }
+
+    void LightSampler::Update(const std::vector<foray::shader::SimplifiedLight>& lights)
+    {
+        uint32_t count = static_cast<uint32_t>(lights.size());
+        if(count > mCapacity)
+        {
+            if(mLights.size() <= mCapacity)
+            {
+                foray::logger()->warn("LightSampler: {} lights exceed the capacity of {}, lights are selected uniformly", count, mCapacity);
+                mUploadData.assign(sizeof(Header), 0);
+                mUploadPending = true;
+            }
+            mLights = lights;
+            return;
+        }
+
+        bool changed = count != mLights.size();
+        mWeights.resize(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            if(i < mLights.size() && std::memcmp(&mLights[i], &lights[i], sizeof(foray::shader::SimplifiedLight)) == 0)
+            {
+                continue;
+            }
+            float weight = GetLightWeight(lights[i]);
+            changed |= weight != mWeights[i] || i >= mLights.size();
+            mWeights[i] = weight;
+        }
+        mLights = lights;
+        if(!changed)
+        {
+            return;  // Moved lights keep their power, the table stays valid
+        }
+
+        mUploadData.resize(sizeof(Header) + count * sizeof(util::AliasEntry));
+        util::AliasEntry* entries = reinterpret_cast<util::AliasEntry*>(mUploadData.data() + sizeof(Header));
+        Header            header{.Count = count, .TotalWeight = static_cast<float>(util::BuildAliasTable(mWeights.data(), count, entries))};
+        std::memcpy(mUploadData.data(), &header, sizeof(Header));
+        mUploadPending = true;
+    }
+
+    void LightSampler::CmdUpload(VkCommandBuffer cmdBuffer)
+    {
+        if(!mUploadPending)
+        {
+            return;
+        }
+        mUploadPending = false;
+
+        VkMemoryBarrier2 barriers[2]{{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                      .srcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                      .srcAccessMask = VK_ACCESS_2_NONE,
+                                      .dstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                      .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT},
+                                     {.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                      .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                      .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                      .dstStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                      .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT}};
+        VkDependencyInfo depInfo{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barriers[0]};
+        vkCmdPipelineBarrier2(cmdBuffer, &depInfo);
+        // vkCmdUpdateBuffer is limited to 64 KiB per call
+        const size_t maxChunk = 65536;
+        for(size_t offset = 0; offset < mUploadData.size(); offset += maxChunk)
+        {
+            vkCmdUpdateBuffer(cmdBuffer, mBuffer.GetBuffer(), offset, std::min(maxChunk, mUploadData.size() - offset), mUploadData.data() + offset);
+        }
+        depInfo.pMemoryBarriers = &barriers[1];
+        vkCmdPipelineBarrier2(cmdBuffer, &depInfo);
+    }
+
+}  // namespace denoise
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "util/aliastable.hpp"
+#include <foray_api.hpp>
+#include <scene/globalcomponents/foray_lightmanager.hpp>
+#include <vector>
+
+namespace denoise {
+
+    /// @brief Power weighted alias table over the LightManager's simplified lights (see shaders/lightsampler.glsl)
+    /// @details Update() compares the lights against the previous frame and only reweights changed ones, the table itself is rebuilt in O(lights)
+    /// only if any weight changed. Uploads are recorded inline into the frame's command buffer, so frames in flight keep reading a consistent table.
+    class LightSampler
+    {
+      public:
+        /// @param capacity Maximum number of lights. Larger light arrays fall back to uniform selection in the shader
+        void Create(foray::core::Context* context, uint32_t capacity);
+        void Destroy();
+
+        /// @brief Reweights changed lights and rebuilds the table if necessary
+        void Update(const std::vector<foray::shader::SimplifiedLight>& lights);
+        /// @brief Records the upload of a table rebuilt since the last call
+        void CmdUpload(VkCommandBuffer cmdBuffer);
+
+        inline foray::core::ManagedBuffer& GetBuffer() { return mBuffer; }
+
+        /// @brief Selection weight of a light: its intensity times the luminance of its color (the unit distance contribution in the shaders)
+        static float GetLightWeight(const foray::shader::SimplifiedLight& light);
+
+      protected:
+        /// @brief Layout of the buffer header, followed by the alias entries
+        struct Header
+        {
+            uint32_t Count       = 0;
+            float    TotalWeight = 0.f;
+            uint32_t Padding[2]  = {};
+        };
+
+        foray::core::ManagedBuffer                  mBuffer;
+        uint32_t                                    mCapacity = 0;
+        std::vector<foray::shader::SimplifiedLight> mLights;
+        std::vector<float>                          mWeights;
+        /// @brief Header and entries as uploaded
+        std::vector<uint8_t> mUploadData;
+        bool                 mUploadPending = false;
+    };
+
+}  // namespace denoise
@@ -1,9 +1,44 @@
+#include "bench/regressiongate.hpp"
+#include "cpu/cpudenoiserunner.hpp"
+#include "cpu/cpurenderrunner.hpp"
 #include "denoiserapp.hpp"
+#include "util/timeline.hpp"
 #include <osi/foray_env.hpp>
 
 int main(int argv, char** args)
 {
     foray::osi::OverrideCurrentWorkingDirectory(CWD_OVERRIDE);
-    denoise::DenoiserApp project;
-    return project.Run();
+    denoise::LaunchOptions options;
+    if(!options.Parse(argv, args))
+    {
+        return 1;
+    }
+    if(!options.ProfilePath.empty())
+    {
+        denoise::util::Timeline::Shared().SetThreadName("Main");
+        denoise::util::Timeline::Shared().Enable();
+    }
+    int result = 0;
+    if(!options.GateBaseline.empty())
+    {
+        result = denoise::bench::RunRegressionGate(options);
+    }
+    else if(!options.CpuDenoiser.empty())
+    {
+        result = denoise::cpu::RunCpuDenoise(options);
+    }
+    else if(!options.CpuRenderScene.empty())
+    {
+        result = denoise::cpu::RunCpuRender(options);
+    }
+    else
+    {
+        denoise::DenoiserApp project(options);
+        result = project.Run();
+    }
+    if(!options.ProfilePath.empty())
+    {
+        denoise::util::Timeline::Shared().WriteChromeTrace(options.ProfilePath);
+    }
+    return result;
 }
\ No newline at end of file
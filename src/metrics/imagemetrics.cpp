@@ -0,0 +1,391 @@
+#include "imagemetrics.hpp"
+#include "../util/simd.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <fmt/format.h>
+#include <limits>
+
+namespace denoise::metrics {
+
+    namespace {
+        constexpr int32_t TILE_WIDTH  = 512;
+        constexpr int32_t TILE_HEIGHT = 64;
+        constexpr int32_t SSIM_RADIUS = 5;
+        constexpr int32_t FLIP_RADIUS = 2;
+        constexpr int32_t SSIM_TAPS   = 2 * SSIM_RADIUS + 1;
+        constexpr int32_t FLIP_TAPS   = 2 * FLIP_RADIUS + 1;
+        constexpr float   SSIM_C1     = 0.01f * 0.01f;
+        constexpr float   SSIM_C2     = 0.03f * 0.03f;
+        constexpr float   FLIP_PC     = 0.4f;
+        constexpr float   FLIP_PT     = 0.95f;
+        constexpr float   FLIP_QC     = 0.7f;
+        constexpr float   FLIP_PREFILTER[FLIP_TAPS] = {1.f / 16.f, 4.f / 16.f, 6.f / 16.f, 4.f / 16.f, 1.f / 16.f};
+
+        /// @brief Signals filtered for SSIM: x, y, x^2, y^2, xy
+        constexpr uint32_t SSIM_SIGNALS = 5;
+        /// @brief Signals filtered for FLIP: L*a*b* of image and reference
+        constexpr uint32_t LAB_SIGNALS = 6;
+        /// @brief Rows are filtered horizontally as they are converted, SSIM_RADIUS rows ahead of the row evaluated. Ring buffers hold the rows still read
+        /// by the vertical passes (power of two sizes).
+        constexpr int32_t SSIM_RING = 16;
+        constexpr int32_t LAB_RING  = 8;
+
+        /// @brief Per thread buffers of a tile. All rows span the tile width plus the horizontal filter halo.
+        struct TileScratch
+        {
+            /// @brief Unfiltered signals of the row being converted
+            std::vector<float> Signals;
+            std::vector<float> SsimFiltered;
+            std::vector<float> LabFiltered;
+            /// @brief Unfiltered L* of image and reference (FLIP feature detection)
+            std::vector<float> Lightness;
+            /// @brief Vertically filtered signals and SSIM map of the row being evaluated
+            std::vector<float> Output;
+            std::vector<float> Padded;
+        };
+
+        struct TileSums
+        {
+            double SquaredError  = 0.0;
+            double Ssim          = 0.0;
+            double Flip          = 0.0;
+            double TemporalError = 0.0;
+        };
+
+        float lTonemap(float value) { return std::max(value, 0.f) / (1.f + std::max(value, 0.f)); }
+
+        /// @brief L*a*b* companding function. Tonemapped input stays in [0, 1], so a table with linear interpolation replaces the cube root (error < 1e-5).
+        class LabCompanding
+        {
+          public:
+            static constexpr uint32_t SIZE = 4096;
+
+            LabCompanding()
+            {
+                for(uint32_t i = 0; i <= SIZE; i++)
+                {
+                    mTable[i] = Evaluate(static_cast<float>(i) / SIZE);
+                }
+            }
+
+            static float Evaluate(float t) { return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.f / 116.f; }
+
+            float operator()(float t) const
+            {
+                if(t >= 1.f)
+                {
+                    return Evaluate(t);
+                }
+                float    position = std::max(t, 0.f) * SIZE;
+                uint32_t index    = static_cast<uint32_t>(position);
+                float    fraction = position - static_cast<float>(index);
+                return mTable[index] + (mTable[index + 1] - mTable[index]) * fraction;
+            }
+
+          private:
+            std::array<float, SIZE + 1> mTable;
+        };
+
+        void lLinearRgbToLab(const LabCompanding& f, const float* rgb, float* lab)
+        {
+            constexpr float invWhiteX = 1.f / 0.95047f;
+            constexpr float invWhiteZ = 1.f / 1.08883f;
+            float           fx        = f((0.4124f * rgb[0] + 0.3576f * rgb[1] + 0.1805f * rgb[2]) * invWhiteX);
+            float           fy        = f(0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2]);
+            float           fz        = f((0.0193f * rgb[0] + 0.1192f * rgb[1] + 0.9505f * rgb[2]) * invWhiteZ);
+            lab[0]                    = 116.f * fy - 16.f;
+            lab[1]                    = 500.f * (fx - fy);
+            lab[2]                    = 200.f * (fy - fz);
+        }
+
+        float lHyAB(const float* a, const float* b) { return std::abs(a[0] - b[0]) + std::sqrt((a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2])); }
+
+        /// @brief Largest color difference FLIP normalizes against (green vs. blue), after the power remap
+        float lFlipMaxError(const LabCompanding& f)
+        {
+            const float green[3] = {0.f, 1.f, 0.f};
+            const float blue[3]  = {0.f, 0.f, 1.f};
+            float       greenLab[3], blueLab[3];
+            lLinearRgbToLab(f, green, greenLab);
+            lLinearRgbToLab(f, blue, blueLab);
+            return std::pow(lHyAB(greenLab, blueLab), FLIP_QC);
+        }
+
+        std::array<float, SSIM_TAPS> lGaussianWeights(float sigma)
+        {
+            std::array<float, SSIM_TAPS> weights;
+            float                        sum = 0.f;
+            for(int32_t i = -SSIM_RADIUS; i <= SSIM_RADIUS; i++)
+            {
+                weights[i + SSIM_RADIUS] = std::exp(-0.5f * static_cast<float>(i * i) / (sigma * sigma));
+                sum += weights[i + SSIM_RADIUS];
+            }
+            for(float& weight : weights)
+            {
+                weight /= sum;
+            }
+            return weights;
+        }
+
+        /// @brief Horizontal filter of one row with replicated borders
+        void lFilterRow(const float* src, float* dst, uint32_t width, const float* weights, int32_t radius, std::vector<float>& padded)
+        {
+            padded.resize(width + 2 * radius);
+            std::fill_n(padded.data(), radius, src[0]);
+            std::copy_n(src, width, padded.data() + radius);
+            std::fill_n(padded.data() + radius + width, radius, src[width - 1]);
+            util::simd::Convolve(padded.data(), weights, 2 * radius + 1, dst, width);
+        }
+    }  // namespace
+
+    ImageMetrics ImageMetrics::Unavailable()
+    {
+        constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+        return ImageMetrics{.Mse = nan, .Psnr = nan, .Ssim = nan, .Flip = nan, .TemporalError = nan};
+    }
+
+    std::string ImageMetrics::PrintCsvHeader()
+    {
+        return ",MSE,PSNR,SSIM,FLIP,TemporalError";
+    }
+
+    std::string ImageMetrics::PrintCsvLine() const
+    {
+        return fmt::format(",{},{},{},{},{}", Mse, Psnr, Ssim, Flip, TemporalError);
+    }
+
+    ImageMetrics MetricsEngine::Evaluate(const cpu::CpuImage& image, const cpu::CpuImage& reference)
+    {
+        const int32_t width      = static_cast<int32_t>(image.Width);
+        const int32_t height     = static_cast<int32_t>(image.Height);
+        const size_t  pixelCount = image.GetPixelCount();
+        if(image.Width != reference.Width || image.Height != reference.Height || pixelCount == 0)
+        {
+            return ImageMetrics::Unavailable();
+        }
+
+        if(mImageLuminance.size() != pixelCount)
+        {
+            mImageLuminance.assign(pixelCount, 0.f);
+            mReferenceLuminance.assign(pixelCount, 0.f);
+            mPrevImageLuminance.assign(pixelCount, 0.f);
+            mPrevReferenceLuminance.assign(pixelCount, 0.f);
+            mHasPrevious = false;
+        }
+
+        static const LabCompanding                labF        = LabCompanding();
+        static const std::array<float, SSIM_TAPS> ssimWeights = lGaussianWeights(1.5f);
+        static const float                        flipMax     = lFlipMaxError(labF);
+
+        const uint32_t        tilesX = static_cast<uint32_t>((width + TILE_WIDTH - 1) / TILE_WIDTH);
+        const uint32_t        tilesY = static_cast<uint32_t>((height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+        std::vector<TileSums> sums(tilesX * tilesY);
+
+        mThreadPool->ParallelFor(tilesX * tilesY, [&](uint32_t tile) {
+            thread_local TileScratch scratch;
+
+            // Output region, and the columns read by the horizontal filters
+            const int32_t x0     = static_cast<int32_t>(tile % tilesX) * TILE_WIDTH;
+            const int32_t x1     = std::min(width, x0 + TILE_WIDTH);
+            const int32_t y0     = static_cast<int32_t>(tile / tilesX) * TILE_HEIGHT;
+            const int32_t y1     = std::min(height, y0 + TILE_HEIGHT);
+            const int32_t cx0    = std::max(0, x0 - SSIM_RADIUS);
+            const int32_t cx1    = std::min(width, x1 + SSIM_RADIUS);
+            const size_t  stride = static_cast<size_t>(cx1 - cx0);
+            const int32_t count  = x1 - x0;
+            const int32_t offset = x0 - cx0;
+
+            scratch.Signals.resize((SSIM_SIGNALS + LAB_SIGNALS) * stride);
+            scratch.SsimFiltered.resize(SSIM_SIGNALS * SSIM_RING * stride);
+            scratch.LabFiltered.resize(LAB_SIGNALS * LAB_RING * stride);
+            scratch.Lightness.resize(2 * LAB_RING * stride);
+            scratch.Output.resize((SSIM_SIGNALS + LAB_SIGNALS + 1) * stride);
+
+            auto signal   = [&](uint32_t index) { return scratch.Signals.data() + index * stride; };
+            auto ssimRow  = [&](uint32_t index, int32_t y) { return scratch.SsimFiltered.data() + (index * SSIM_RING + (y & (SSIM_RING - 1))) * stride; };
+            auto labRow   = [&](uint32_t index, int32_t y) { return scratch.LabFiltered.data() + (index * LAB_RING + (y & (LAB_RING - 1))) * stride; };
+            auto lightRow = [&](uint32_t index, int32_t y) { return scratch.Lightness.data() + (index * LAB_RING + (y & (LAB_RING - 1))) * stride; };
+            auto output   = [&](uint32_t index) { return scratch.Output.data() + index * stride; };
+            auto clampRow = [&](int32_t y) { return std::clamp(y, 0, height - 1); };
+            TileSums& result = sums[tile];
+
+            // Tonemaps and converts row y, accumulates the per pixel metrics and runs the horizontal filter passes
+            auto convertRow = [&](int32_t y) {
+                const bool inTile             = y >= y0 && y < y1;
+                float*     imageLightness     = lightRow(0, y);
+                float*     referenceLightness = lightRow(1, y);
+                for(int32_t x = cx0; x < cx1; x++)
+                {
+                    const size_t i              = static_cast<size_t>(x - cx0);
+                    const float* imageTexel     = image.At(x, y);
+                    const float* referenceTexel = reference.At(x, y);
+                    float        imageRgb[3], referenceRgb[3];
+                    for(uint32_t c = 0; c < 3; c++)
+                    {
+                        imageRgb[c]     = lTonemap(imageTexel[c]);
+                        referenceRgb[c] = lTonemap(referenceTexel[c]);
+                    }
+                    float imageLum     = 0.2126f * imageRgb[0] + 0.7152f * imageRgb[1] + 0.0722f * imageRgb[2];
+                    float referenceLum = 0.2126f * referenceRgb[0] + 0.7152f * referenceRgb[1] + 0.0722f * referenceRgb[2];
+                    signal(0)[i]       = imageLum;
+                    signal(1)[i]       = referenceLum;
+                    signal(2)[i]       = imageLum * imageLum;
+                    signal(3)[i]       = referenceLum * referenceLum;
+                    signal(4)[i]       = imageLum * referenceLum;
+
+                    float imageLab[3], referenceLab[3];
+                    lLinearRgbToLab(labF, imageRgb, imageLab);
+                    lLinearRgbToLab(labF, referenceRgb, referenceLab);
+                    for(uint32_t c = 0; c < 3; c++)
+                    {
+                        signal(SSIM_SIGNALS + c)[i]     = imageLab[c];
+                        signal(SSIM_SIGNALS + 3 + c)[i] = referenceLab[c];
+                    }
+                    imageLightness[i]     = imageLab[0];
+                    referenceLightness[i] = referenceLab[0];
+
+                    if(inTile && x >= x0 && x < x1)
+                    {
+                        size_t index = (size_t)y * width + x;
+                        for(uint32_t c = 0; c < 3; c++)
+                        {
+                            result.SquaredError += (imageRgb[c] - referenceRgb[c]) * (imageRgb[c] - referenceRgb[c]);
+                        }
+                        if(mHasPrevious)
+                        {
+                            float change = (imageLum - mPrevImageLuminance[index]) - (referenceLum - mPrevReferenceLuminance[index]);
+                            result.TemporalError += change * change;
+                        }
+                        mImageLuminance[index]     = imageLum;
+                        mReferenceLuminance[index] = referenceLum;
+                    }
+                }
+                for(uint32_t s = 0; s < SSIM_SIGNALS; s++)
+                {
+                    lFilterRow(signal(s), ssimRow(s, y), static_cast<uint32_t>(stride), ssimWeights.data(), SSIM_RADIUS, scratch.Padded);
+                }
+                for(uint32_t s = 0; s < LAB_SIGNALS; s++)
+                {
+                    lFilterRow(signal(SSIM_SIGNALS + s), labRow(s, y), static_cast<uint32_t>(stride), FLIP_PREFILTER, FLIP_RADIUS, scratch.Padded);
+                }
+            };
+
+            // Rows are converted SSIM_RADIUS rows ahead of evaluation, so the ring buffers hold all rows the vertical passes read
+            int32_t nextRow = std::max(0, y0 - SSIM_RADIUS);
+            for(int32_t y = y0; y < y1; y++)
+            {
+                for(; nextRow <= std::min(height - 1, y + SSIM_RADIUS); nextRow++)
+                {
+                    convertRow(nextRow);
+                }
+
+                // Vertical passes
+                const float* rows[SSIM_TAPS];
+                for(uint32_t s = 0; s < SSIM_SIGNALS; s++)
+                {
+                    for(int32_t k = -SSIM_RADIUS; k <= SSIM_RADIUS; k++)
+                    {
+                        rows[k + SSIM_RADIUS] = ssimRow(s, clampRow(y + k)) + offset;
+                    }
+                    util::simd::ConvolveRows(rows, ssimWeights.data(), SSIM_TAPS, output(s), count);
+                }
+                for(uint32_t s = 0; s < LAB_SIGNALS; s++)
+                {
+                    for(int32_t k = -FLIP_RADIUS; k <= FLIP_RADIUS; k++)
+                    {
+                        rows[k + FLIP_RADIUS] = labRow(s, clampRow(y + k)) + offset;
+                    }
+                    util::simd::ConvolveRows(rows, FLIP_PREFILTER, FLIP_TAPS, output(SSIM_SIGNALS + s), count);
+                }
+
+                // SSIM map, kept free of calls and branches so the compiler vectorizes it
+                const float* muXs    = output(0);
+                const float* muYs    = output(1);
+                const float* xxs     = output(2);
+                const float* yys     = output(3);
+                const float* xys     = output(4);
+                float*       ssimMap = output(SSIM_SIGNALS + LAB_SIGNALS);
+                for(int32_t i = 0; i < count; i++)
+                {
+                    float muX   = muXs[i];
+                    float muY   = muYs[i];
+                    float varX  = xxs[i] - muX * muX;
+                    float varY  = yys[i] - muY * muY;
+                    float covXY = xys[i] - muX * muY;
+                    ssimMap[i]  = ((2.f * muX * muY + SSIM_C1) * (2.f * covXY + SSIM_C2)) / ((muX * muX + muY * muY + SSIM_C1) * (varX + varY + SSIM_C2));
+                }
+                result.Ssim += util::simd::Sum(ssimMap, count);
+
+                const float* lightness[2][3];
+                for(int32_t k = -1; k <= 1; k++)
+                {
+                    lightness[0][k + 1] = lightRow(0, clampRow(y + k));
+                    lightness[1][k + 1] = lightRow(1, clampRow(y + k));
+                }
+                double flipSum = 0.0;
+                for(int32_t x = x0; x < x1; x++)
+                {
+                    // FLIP color error
+                    const int32_t i               = x - x0;
+                    float         imageLab[3]     = {output(SSIM_SIGNALS)[i], output(SSIM_SIGNALS + 1)[i], output(SSIM_SIGNALS + 2)[i]};
+                    float         referenceLab[3] = {output(SSIM_SIGNALS + 3)[i], output(SSIM_SIGNALS + 4)[i], output(SSIM_SIGNALS + 5)[i]};
+                    float         hyab            = lHyAB(imageLab, referenceLab);
+                    if(hyab <= 0.f)
+                    {
+                        continue;
+                    }
+                    float colorError = std::pow(hyab, FLIP_QC);
+                    colorError       = colorError < FLIP_PC * flipMax ? colorError * FLIP_PT / (FLIP_PC * flipMax)
+                                                                      : FLIP_PT + (colorError - FLIP_PC * flipMax) / (flipMax - FLIP_PC * flipMax) * (1.f - FLIP_PT);
+
+                    // FLIP feature error: differences in edge (sobel) and point (laplacian) strength of the normalized lightness
+                    const size_t l = static_cast<size_t>(std::max(x - 1, 0) - cx0);
+                    const size_t c = static_cast<size_t>(x - cx0);
+                    const size_t r = static_cast<size_t>(std::min(x + 1, width - 1) - cx0);
+                    float        edge[2], point[2];
+                    for(uint32_t j = 0; j < 2; j++)
+                    {
+                        const float* const* rows = lightness[j];
+                        float gx = ((rows[0][r] + 2.f * rows[1][r] + rows[2][r]) - (rows[0][l] + 2.f * rows[1][l] + rows[2][l])) * (0.25f / 100.f);
+                        float gy = ((rows[2][l] + 2.f * rows[2][c] + rows[2][r]) - (rows[0][l] + 2.f * rows[0][c] + rows[0][r])) * (0.25f / 100.f);
+                        edge[j]  = std::sqrt(gx * gx + gy * gy);
+                        point[j] = std::abs(rows[0][c] + rows[2][c] + rows[1][l] + rows[1][r] - 4.f * rows[1][c]) * (0.25f / 100.f);
+                    }
+                    // Feature exponent of FLIP is 0.5
+                    float featureError = std::min(1.f, std::sqrt(std::max(std::abs(edge[0] - edge[1]), std::abs(point[0] - point[1])) * (1.f / std::sqrt(2.f))));
+                    flipSum += featureError > 0.f ? std::pow(colorError, 1.f - featureError) : colorError;
+                }
+                result.Flip += flipSum;
+            }
+        }, 1);
+
+        TileSums total;
+        for(const TileSums& tile : sums)
+        {
+            total.SquaredError += tile.SquaredError;
+            total.Ssim += tile.Ssim;
+            total.Flip += tile.Flip;
+            total.TemporalError += tile.TemporalError;
+        }
+
+        ImageMetrics metrics;
+        metrics.Mse           = total.SquaredError / (3.0 * pixelCount);
+        metrics.Psnr          = metrics.Mse > 0.0 ? -10.0 * std::log10(metrics.Mse) : std::numeric_limits<double>::infinity();
+        metrics.Ssim          = total.Ssim / pixelCount;
+        metrics.Flip          = total.Flip / pixelCount;
+        metrics.TemporalError = mHasPrevious ? total.TemporalError / pixelCount : std::numeric_limits<double>::quiet_NaN();
+
+        std::swap(mImageLuminance, mPrevImageLuminance);
+        std::swap(mReferenceLuminance, mPrevReferenceLuminance);
+        mHasPrevious = true;
+        return metrics;
+    }
+
+    std::string GetReferenceFramePath(const std::string& directory, uint64_t sequenceIndex)
+    {
+        return (std::filesystem::u8path(directory) / fmt::format("{:06}.exr", sequenceIndex)).string();
+    }
+
+}  // namespace denoise::metrics
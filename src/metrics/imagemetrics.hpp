@@ -0,0 +1,59 @@
+#pragma once
+
+#include "../cpu/cpuimage.hpp"
+#include "../util/threadpool.hpp"
+#include <string>
+
+namespace denoise::metrics {
+
+    /// @brief Image quality of a denoised frame compared against a reference
+    /// @details All metrics are computed on tonemapped values (x / (1 + x)), so single HDR outliers (fireflies) do not dominate the averages.
+    struct ImageMetrics
+    {
+        double Mse  = 0.0;
+        /// @brief Peak signal to noise ratio in dB (peak 1)
+        double Psnr = 0.0;
+        /// @brief Mean structural similarity of luminance (11x11 gaussian window)
+        double Ssim = 0.0;
+        /// @brief Mean FLIP-style perceptual error in [0, 1] (Andersson et al. 2020): HyAB color difference after a CSF approximating prefilter, amplified by edge and point feature differences
+        double Flip = 0.0;
+        /// @brief Mean squared luminance change between consecutive frames not explained by the change of the reference (flicker). NaN for the first frame.
+        double TemporalError = 0.0;
+
+        /// @brief All values NaN, e.g. for frames without reference
+        static ImageMetrics Unavailable();
+
+        /// @brief Column names, formatted like foray::bench::BenchmarkLog::PrintCsvHeader() for appending (starts with a separator)
+        static std::string PrintCsvHeader();
+        /// @brief Values in column order (starts with a separator)
+        std::string PrintCsvLine() const;
+    };
+
+    /// @brief Computes ImageMetrics for a sequence of frames
+    /// @details The image is split into tiles processed in parallel. Per tile, rows are tonemapped and filtered horizontally as they stream through
+    /// small ring buffers, and all metrics of a row are evaluated in the same traversal, so the working set stays in cache. The separable filters are
+    /// vectorized row kernels (util/simd.hpp). Tile results are reduced in tile order, so results are deterministic.
+    class MetricsEngine
+    {
+      public:
+        explicit MetricsEngine(util::ThreadPool* threadPool = &util::ThreadPool::Shared()) : mThreadPool(threadPool) {}
+
+        /// @brief Compares image against reference (same size, RGBA). Temporal error is computed against the previous call's image and reference.
+        ImageMetrics Evaluate(const cpu::CpuImage& image, const cpu::CpuImage& reference);
+        /// @brief Discards the previous frame, e.g. at a camera cut
+        inline void ResetTemporal() { mHasPrevious = false; }
+
+      protected:
+        util::ThreadPool* mThreadPool  = nullptr;
+        bool              mHasPrevious = false;
+        /// @brief Tonemapped luminance of the previous and current image and reference
+        std::vector<float> mPrevImageLuminance;
+        std::vector<float> mPrevReferenceLuminance;
+        std::vector<float> mImageLuminance;
+        std::vector<float> mReferenceLuminance;
+    };
+
+    /// @brief Path of the reference frame <directory>/<sequenceIndex:06>.exr
+    std::string GetReferenceFramePath(const std::string& directory, uint64_t sequenceIndex);
+
+}  // namespace denoise::metrics
@@ -0,0 +1,171 @@
+#include "metricsrecorder.hpp"
+#include "../cpu/exrio.hpp"
+#include "../util/formatinfo.hpp"
+#include "../util/half.hpp"
+#include <cstring>
+#include <filesystem>
+
+namespace denoise::metrics {
+
+    void MetricsRecorder::Init(foray::core::Context* context, foray::core::ManagedImage* image, util::ThreadPool* threadPool)
+    {
+        mContext    = context;
+        mImage      = image;
+        mThreadPool = threadPool;
+        mEngine     = MetricsEngine(threadPool);
+
+        VkFormat format = mImage->GetFormat();
+        foray::Assert(format == VK_FORMAT_R16G16B16A16_SFLOAT || format == VK_FORMAT_R32G32B32A32_SFLOAT, "Metrics: Unsupported image format");
+
+        for(uint32_t i = 0; i < foray::INFLIGHT_FRAME_COUNT; i++)
+        {
+            mSlots.push_back(std::make_unique<Slot>());
+        }
+    }
+
+    void MetricsRecorder::SetReferenceDirectory(const std::string& utf8path)
+    {
+        mReferenceDirectory     = utf8path;
+        mMissingReferenceWarned = false;
+        mLastMetrics            = ImageMetrics::Unavailable();
+        mEngine.ResetTemporal();
+    }
+
+    void MetricsRecorder::RecordFrame(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo, uint64_t sequenceIndex)
+    {
+        if(!Exists() || mReferenceDirectory.empty())
+        {
+            return;
+        }
+
+        Slot* slot = mSlots[renderInfo.GetFrameNumber() % mSlots.size()].get();
+        if(slot->ReferenceLoaded.valid())
+        {
+            slot->ReferenceLoaded.wait();  // Frame was never reported finished (e.g. skipped), its reference load may still be running
+        }
+
+        // The slot's previous frame finished executing, so its buffer can be recreated when the image was resized
+        VkExtent3D   extent = mImage->GetExtent3D();
+        VkDeviceSize size   = (VkDeviceSize)extent.width * extent.height * util::GetTexelSize(mImage->GetFormat());
+        if(slot->Size != size)
+        {
+            if(slot->Mapped)
+            {
+                slot->Buffer.Unmap();
+                slot->Buffer.Destroy();
+                slot->Mapped = nullptr;
+            }
+            foray::core::ManagedBuffer::CreateInfo ci(VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                                                      VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, "Metrics Readback");
+            slot->Buffer.Create(mContext, ci);
+            void* mapped = nullptr;
+            slot->Buffer.Map(mapped);
+            slot->Mapped = reinterpret_cast<uint8_t*>(mapped);
+            slot->Size   = size;
+        }
+        slot->Extent      = VkExtent2D{.width = extent.width, .height = extent.height};
+        slot->FrameNumber = renderInfo.GetFrameNumber();
+        slot->Recorded    = true;
+
+        foray::core::ImageLayoutCache::Barrier2 barrier{.SrcStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                                        .SrcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+                                                        .DstStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                                        .DstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+                                                        .NewLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        renderInfo.GetImageLayoutCache().CmdBarrier(cmdBuffer, mImage, barrier);
+
+        VkBufferImageCopy region{.bufferOffset      = 0,
+                                 .bufferRowLength   = 0,
+                                 .bufferImageHeight = 0,
+                                 .imageSubresource  = VkImageSubresourceLayers{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+                                 .imageOffset       = VkOffset3D{},
+                                 .imageExtent       = VkExtent3D{.width = extent.width, .height = extent.height, .depth = 1}};
+        vkCmdCopyImageToBuffer(cmdBuffer, mImage->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->Buffer.GetBuffer(), 1, &region);
+
+        VkMemoryBarrier2 hostBarrier{.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+                                     .srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                     .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                                     .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+                                     .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT};
+        VkDependencyInfo dependency{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &hostBarrier};
+        vkCmdPipelineBarrier2(cmdBuffer, &dependency);
+
+        // Decode the reference while the GPU renders the frame
+        std::shared_ptr<std::promise<bool>> promise = std::make_shared<std::promise<bool>>();
+        slot->ReferenceLoaded                       = promise->get_future();
+        std::string path                            = GetReferenceFramePath(mReferenceDirectory, sequenceIndex);
+        mThreadPool->Submit([promise, slot, path]() { promise->set_value(std::filesystem::exists(std::filesystem::u8path(path)) && cpu::LoadImageFile(path, slot->Reference)); });
+    }
+
+    bool MetricsRecorder::OnFrameFinished(uint64_t frameIndex, ImageMetrics& out)
+    {
+        if(!Exists())
+        {
+            return false;
+        }
+        Slot* slot = mSlots[frameIndex % mSlots.size()].get();
+        if(!slot->Recorded || slot->FrameNumber != frameIndex)
+        {
+            return false;
+        }
+        slot->Recorded = false;
+
+        bool referenceLoaded = slot->ReferenceLoaded.get();
+        if(!referenceLoaded)
+        {
+            if(!mMissingReferenceWarned)
+            {
+                foray::logger()->warn("Metrics: Reference frame missing or unreadable in \"{}\", affected frames are not scored", mReferenceDirectory);
+                mMissingReferenceWarned = true;
+            }
+            mEngine.ResetTemporal();
+            mLastMetrics = ImageMetrics::Unavailable();
+            return false;
+        }
+
+        // The readback memory may not be host coherent
+        vmaInvalidateAllocation(mContext->Allocator, slot->Buffer.GetAllocation(), 0, VK_WHOLE_SIZE);
+        mImageData.Resize(slot->Extent.width, slot->Extent.height);
+        size_t valueCount = mImageData.Texels.size();
+        if(mImage->GetFormat() == VK_FORMAT_R16G16B16A16_SFLOAT)
+        {
+            const uint16_t* halfs = reinterpret_cast<const uint16_t*>(slot->Mapped);
+            mThreadPool->ParallelFor(mImageData.Height, [&](uint32_t y) {
+                size_t begin = (size_t)y * mImageData.Width * 4;
+                for(size_t i = begin; i < begin + (size_t)mImageData.Width * 4; i++)
+                {
+                    mImageData.Texels[i] = util::HalfToFloat(halfs[i]);
+                }
+            });
+        }
+        else
+        {
+            std::memcpy(mImageData.Texels.data(), slot->Mapped, valueCount * sizeof(float));
+        }
+
+        mLastMetrics = mEngine.Evaluate(mImageData, slot->Reference);
+        out          = mLastMetrics;
+        return true;
+    }
+
+    void MetricsRecorder::Destroy()
+    {
+        for(std::unique_ptr<Slot>& slot : mSlots)
+        {
+            if(slot->ReferenceLoaded.valid())
+            {
+                slot->ReferenceLoaded.wait();
+            }
+            if(slot->Mapped)
+            {
+                slot->Buffer.Unmap();
+                slot->Buffer.Destroy();
+            }
+        }
+        mSlots.clear();
+        mImageData = cpu::CpuImage{};
+        mReferenceDirectory.clear();
+        mLastMetrics = ImageMetrics::Unavailable();
+    }
+
+}  // namespace denoise::metrics
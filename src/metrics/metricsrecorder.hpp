@@ -0,0 +1,56 @@
+#pragma once
+
+#include "imagemetrics.hpp"
+#include <foray_api.hpp>
+#include <future>
+#include <memory>
+
+namespace denoise::metrics {
+
+    /// @brief Scores the denoised image of every frame against a reference frame sequence
+    /// @details The image is copied into a persistently mapped readback buffer per in flight frame, while the matching reference EXR is loaded on the
+    /// thread pool. Once the frame finished executing, both are compared by a MetricsEngine. Reference frames are named <index:06>.exr, with the index
+    /// counted from the start of the sequence (application start, or bench case start).
+    class MetricsRecorder
+    {
+      public:
+        void Init(foray::core::Context* context, foray::core::ManagedImage* image, util::ThreadPool* threadPool = &util::ThreadPool::Shared());
+
+        /// @brief Sets the directory reference frames are loaded from, and restarts the temporal metrics
+        void SetReferenceDirectory(const std::string& utf8path);
+        /// @brief Records the readback of the image and starts loading the reference frame. Call after the image has been written for the frame.
+        void RecordFrame(VkCommandBuffer cmdBuffer, foray::base::FrameRenderInfo& renderInfo, uint64_t sequenceIndex);
+        /// @brief Evaluates the metrics of a finished frame
+        /// @return False if the frame was not recorded or the reference frame is missing
+        bool OnFrameFinished(uint64_t frameIndex, ImageMetrics& out);
+
+        void Destroy();
+
+        inline bool                Exists() const { return !mSlots.empty(); }
+        inline const ImageMetrics& GetLastMetrics() const { return mLastMetrics; }
+
+      protected:
+        struct Slot
+        {
+            foray::core::ManagedBuffer Buffer;
+            uint8_t*                   Mapped = nullptr;
+            VkExtent2D                 Extent{};
+            VkDeviceSize               Size        = 0;
+            uint64_t                   FrameNumber = 0;
+            bool                       Recorded    = false;
+            cpu::CpuImage              Reference;
+            std::future<bool>          ReferenceLoaded;
+        };
+
+        foray::core::Context*              mContext    = nullptr;
+        foray::core::ManagedImage*         mImage      = nullptr;
+        util::ThreadPool*                  mThreadPool = nullptr;
+        std::string                        mReferenceDirectory;
+        std::vector<std::unique_ptr<Slot>> mSlots;
+        MetricsEngine                      mEngine;
+        cpu::CpuImage                      mImageData;
+        ImageMetrics                       mLastMetrics = ImageMetrics::Unavailable();
+        bool                               mMissingReferenceWarned = false;
+    };
+
+}  // namespace denoise::metrics
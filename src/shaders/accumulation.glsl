@@ -0,0 +1,87 @@
+#ifndef ACCUMULATION_GLSL
+#define ACCUMULATION_GLSL
+
+// Progressive reference accumulation of the ComplexRaytracingStage (see RTSTAGEFLAG_ACCUMULATE)
+// Requires rtstageconfig.glsl
+
+#ifndef BIND_ACCUMULATION_MEAN
+#define BIND_ACCUMULATION_MEAN 13
+#endif
+#ifndef BIND_ACCUMULATION_M2
+#define BIND_ACCUMULATION_M2 14
+#endif
+#ifndef BIND_ACCUMULATION_STATUS
+#define BIND_ACCUMULATION_STATUS 15
+#endif
+
+// Running mean (rgb) and sample count (a)
+layout(set = 0, binding = BIND_ACCUMULATION_MEAN, rgba32f) uniform image2D AccumulationMean;
+// Sum of squared deviations from the mean (rgb) and converged flag (a)
+layout(set = 0, binding = BIND_ACCUMULATION_M2, rgba32f) uniform image2D AccumulationM2;
+
+layout(set = 0, binding = BIND_ACCUMULATION_STATUS) buffer AccumulationStatusBuffer
+{
+    uint ConvergedPixels;
+} AccumulationStatus;
+
+bool AccumulationEnabled()
+{
+    return (RtConfig.Flags & RTSTAGEFLAG_ACCUMULATE) > 0;
+}
+
+// Returns true if the pixel converged in a previous frame, mean is set to the accumulated result then
+bool AccumulationConverged(ivec2 texel, out vec3 mean)
+{
+    mean = vec3(0);
+    if((RtConfig.Flags & RTSTAGEFLAG_ACCUMULATE_RESET) > 0)
+    {
+        return false;
+    }
+    if(imageLoad(AccumulationM2, texel).a > 0.0)
+    {
+        mean = imageLoad(AccumulationMean, texel).rgb;
+        return true;
+    }
+    return false;
+}
+
+// Adds a sample (Welford's online mean and variance) and returns the updated mean
+vec3 AccumulateSample(ivec2 texel, vec3 radiance)
+{
+    vec4 mean = vec4(0);
+    vec4 m2   = vec4(0);
+    if((RtConfig.Flags & RTSTAGEFLAG_ACCUMULATE_RESET) == 0)
+    {
+        mean = imageLoad(AccumulationMean, texel);
+        m2   = imageLoad(AccumulationM2, texel);
+    }
+    // Samples with NaN / Inf would poison the whole accumulation
+    if(any(isnan(radiance)) || any(isinf(radiance)))
+    {
+        radiance = mean.rgb;
+    }
+
+    float count = mean.a + 1.0;
+    vec3  delta = radiance - mean.rgb;
+    mean.rgb += delta / count;
+    m2.rgb += delta * (radiance - mean.rgb);
+    mean.a = count;
+
+    // Early stop: standard error of the mean small relative to the mean (absolute floor for dark pixels)
+    if(RtConfig.AccumulateErrorThreshold > 0.0 && count >= float(max(RtConfig.AccumulateMinSamples, 2u)))
+    {
+        vec3 standardError = sqrt(m2.rgb / (count * (count - 1.0)));
+        vec3 tolerance     = RtConfig.AccumulateErrorThreshold * max(mean.rgb, vec3(0.01));
+        if(all(lessThanEqual(standardError, tolerance)))
+        {
+            m2.a = 1.0;
+            atomicAdd(AccumulationStatus.ConvergedPixels, 1u);
+        }
+    }
+
+    imageStore(AccumulationMean, texel, mean);
+    imageStore(AccumulationM2, texel, m2);
+    return mean.rgb;
+}
+
+#endif // ACCUMULATION_GLSL
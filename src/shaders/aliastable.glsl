@@ -0,0 +1,28 @@
+#ifndef ALIASTABLE_GLSL
+#define ALIASTABLE_GLSL
+
+// Alias table slot, written by util::BuildAliasTable() on the host (see src/util/aliastable.hpp)
+
+struct AliasEntry
+{
+    float Threshold; // Probability of keeping the slot, otherwise Alias is taken
+    uint Alias;
+    float Pdf; // Probability of drawing this slot's own element
+    uint Padding;
+};
+
+// Splits a uniform random number in [0, 1) into a slot and the fraction used for the keep / alias decision
+uint AliasSlot(float rnd, uint count, out float fraction)
+{
+    float scaled = rnd * float(count);
+    uint slot = min(uint(scaled), count - 1);
+    fraction = scaled - float(slot);
+    return slot;
+}
+
+uint AliasResolve(AliasEntry entry, uint slot, float fraction)
+{
+    return fraction < entry.Threshold ? slot : entry.Alias;
+}
+
+#endif // ALIASTABLE_GLSL
@@ -0,0 +1,98 @@
+#ifndef ENVSAMPLER_GLSL
+#define ENVSAMPLER_GLSL
+
+// Equirectangular environment map and its importance sampling tables (see EnvironmentSampler in environmentsampler.hpp)
+// Requires lcrng.glsl and constants.glsl
+
+#include "aliastable.glsl"
+
+#ifndef BIND_ENVSAMPLER
+#define BIND_ENVSAMPLER 17
+#endif
+#ifndef BIND_ENVMAP
+#define BIND_ENVMAP 18
+#endif
+
+layout(set = 0, binding = BIND_ENVMAP) uniform sampler2D EnvironmentMap;
+
+layout(set = 0, binding = BIND_ENVSAMPLER) readonly buffer EnvSamplerBuffer
+{
+    uint Width; // 0 if no environment map is set (black environment)
+    uint Height;
+    float Integral;
+    uint Padding;
+    AliasEntry Entries[]; // Height marginal entries (rows), followed by Width entries per row (columns)
+} EnvSampler;
+
+bool HasEnvironment()
+{
+    return EnvSampler.Width > 0;
+}
+
+// Row 0 of the map is at +Y, u = 0.5 faces +X
+vec2 EnvDirToUv(vec3 dir)
+{
+    return vec2(atan(dir.z, dir.x) / (2 * PI) + 0.5, acos(clamp(dir.y, -1, 1)) / PI);
+}
+
+vec3 EnvUvToDir(vec2 uv, out float sinTheta)
+{
+    const float phi = (uv.x - 0.5) * 2 * PI;
+    const float theta = uv.y * PI;
+    sinTheta = sin(theta);
+    return vec3(sinTheta * cos(phi), cos(theta), sinTheta * sin(phi));
+}
+
+vec3 EnvironmentRadiance(vec3 dir)
+{
+    return textureLod(EnvironmentMap, EnvDirToUv(dir), 0).rgb;
+}
+
+// Draws a direction proportional to luminance times solid angle. pdf is with respect to solid angle, 0 if the sample must be discarded
+vec3 SampleEnvironment(inout uint seed, out float pdf)
+{
+    const uint width = EnvSampler.Width;
+    const uint height = EnvSampler.Height;
+
+    float fraction;
+    uint slot = AliasSlot(lcgFloat(seed), height, fraction);
+    const uint row = AliasResolve(EnvSampler.Entries[slot], slot, fraction);
+    const uint rowOffset = height + row * width;
+    slot = AliasSlot(lcgFloat(seed), width, fraction);
+    const uint column = AliasResolve(EnvSampler.Entries[rowOffset + slot], slot, fraction);
+
+    const vec2 uv = vec2((float(column) + lcgFloat(seed)) / float(width), (float(row) + lcgFloat(seed)) / float(height));
+    float sinTheta;
+    const vec3 dir = EnvUvToDir(uv, sinTheta);
+
+    // Texel pdf over the unit (u, v) square, mapped onto the sphere (dOmega = 2 PI^2 sin(theta) du dv)
+    const float uvPdf = EnvSampler.Entries[row].Pdf * EnvSampler.Entries[rowOffset + column].Pdf * float(width * height);
+    pdf = sinTheta > 0 ? uvPdf / (2 * PI * PI * sinTheta) : 0;
+    return dir;
+}
+
+// Solid angle pdf of SampleEnvironment() drawing dir
+float EnvironmentPdf(vec3 dir)
+{
+    const uint width = EnvSampler.Width;
+    const uint height = EnvSampler.Height;
+    const vec2 uv = EnvDirToUv(dir);
+    const uint row = min(uint(uv.y * float(height)), height - 1);
+    const uint column = min(uint(uv.x * float(width)), width - 1);
+    const float sinTheta = sqrt(max(0, 1 - dir.y * dir.y));
+    const float uvPdf = EnvSampler.Entries[row].Pdf * EnvSampler.Entries[height + row * width + column].Pdf * float(width * height);
+    return sinTheta > 0 ? uvPdf / (2 * PI * PI * sinTheta) : 0;
+}
+
+// Pdf passed for directions drawn from a delta lobe (perfect mirrors), which no other strategy can draw
+#define DELTA_LOBE_PDF -1.0
+
+// Multiple importance sampling weight of a sample drawn with pdf, against one sample of the strategy with otherPdf (power heuristic)
+float PowerHeuristic(float pdf, float otherPdf)
+{
+    const float pdf2 = pdf * pdf;
+    const float sum = pdf2 + otherPdf * otherPdf;
+    return sum > 0 ? pdf2 / sum : 0;
+}
+
+#endif // ENVSAMPLER_GLSL
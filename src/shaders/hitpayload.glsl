@@ -0,0 +1,34 @@
+#ifndef HITPAYLOAD_GLSL
+#define HITPAYLOAD_GLSL
+
+// foray's HitPayload (rt_common/payload.glsl), extended by the pdf the parent hit drew the ray direction with
+struct HitPayload
+{
+    vec3 Radiance;
+    vec3 Attenuation;
+    uint Seed;
+    uint Depth;
+    // Solid angle pdf of the ray direction including the probability of the ray being traced at all (DELTA_LOBE_PDF for perfect mirrors).
+    // Read by the miss shader to weight environment hits against next event estimation
+    float BsdfPdf;
+};
+
+HitPayload ConstructHitPayload()
+{
+    HitPayload payload;
+    payload.Radiance = vec3(0);
+    payload.Attenuation = vec3(1);
+    payload.Seed = 0;
+    payload.Depth = 0;
+    payload.BsdfPdf = 0;
+    return payload;
+}
+
+#ifdef HITPAYLOAD_OUT
+layout(location = 0) rayPayloadEXT HitPayload ChildPayload;
+#endif // HITPAYLOAD_OUT
+#ifdef HITPAYLOAD_IN
+layout(location = 1) rayPayloadInEXT HitPayload ReturnPayload;
+#endif // HITPAYLOAD_IN
+
+#endif // HITPAYLOAD_GLSL
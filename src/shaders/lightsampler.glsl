@@ -0,0 +1,39 @@
+#ifndef LIGHTSAMPLER_GLSL
+#define LIGHTSAMPLER_GLSL
+
+// Power weighted light selection of the ComplexRaytracingStage (see LightSampler in lightsampler.hpp)
+// Requires simplifiedlights.glsl and lcrng.glsl
+
+#include "aliastable.glsl"
+
+#ifndef BIND_LIGHTSAMPLER
+#define BIND_LIGHTSAMPLER 16
+#endif
+
+layout(set = 0, binding = BIND_LIGHTSAMPLER) readonly buffer LightSamplerBuffer
+{
+    uint Count; // Matches SimplifiedLights.Count once the table is built, 0 before
+    float TotalWeight;
+    uint Padding0;
+    uint Padding1;
+    AliasEntry Entries[];
+} LightSampler;
+
+// Selects a light index proportional to its power. pdf is the selection probability (uniform if no table matches the light array)
+uint SampleLight(inout uint seed, out float pdf)
+{
+    const uint count = SimplifiedLights.Count;
+    const float rnd = lcgFloat(seed);
+    if (LightSampler.Count != count)
+    {
+        pdf = 1.0 / float(count);
+        return min(uint(rnd * float(count)), count - 1);
+    }
+    float fraction;
+    const uint slot = AliasSlot(rnd, count, fraction);
+    const uint index = AliasResolve(LightSampler.Entries[slot], slot, fraction);
+    pdf = LightSampler.Entries[index].Pdf;
+    return index;
+}
+
+#endif // LIGHTSAMPLER_GLSL
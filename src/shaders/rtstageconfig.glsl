@@ -0,0 +1,23 @@
+#ifndef RTSTAGECONFIG_GLSL
+#define RTSTAGECONFIG_GLSL
+
+// Per frame configuration of the ComplexRaytracingStage (see RtStageConfig in foray_rtstage.hpp)
+
+#ifndef BIND_RTSTAGECONFIG
+#define BIND_RTSTAGECONFIG 12
+#endif
+
+#define RTSTAGEFLAG_ACCUMULATE 1u
+#define RTSTAGEFLAG_ACCUMULATE_RESET 2u
+
+layout(set = 0, binding = BIND_RTSTAGECONFIG) readonly buffer RtStageConfigBuffer
+{
+    uint RngSeed;
+    uint Flags;
+    uint AccumulateMinSamples;
+    float AccumulateErrorThreshold;
+    // Top left region of the output that is traced, the stage scales it up to the full output afterwards
+    uvec2 ActiveExtent;
+} RtConfig;
+
+#endif // RTSTAGECONFIG_GLSL
@@ -0,0 +1,93 @@
+#include "aliastable.hpp"
+#include <vector>
+
+namespace denoise::util {
+
+    double BuildAliasTable(const float* weights, uint32_t count, AliasEntry* out)
+    {
+        double total = 0.0;
+        for(uint32_t i = 0; i < count; i++)
+        {
+            total += weights[i] > 0.f ? weights[i] : 0.f;
+        }
+        if(count == 0)
+        {
+            return total;
+        }
+        if(!(total > 0.0))
+        {
+            for(uint32_t i = 0; i < count; i++)
+            {
+                out[i] = AliasEntry{.Threshold = 1.f, .Alias = i, .Pdf = 1.f / count};
+            }
+            return total;
+        }
+
+        // Sweeping construction (Huebschle-Schneider and Sanders): light slots (scaled weight <= 1) are filled from the current heavy slot, which
+        // turns light itself once its remainder drops to 1 or below and is then filled from the next heavy slot. The slots are partitioned
+        // branch free into lights (from the front) and heavies (from the back) of a reused per thread index buffer first.
+        thread_local std::vector<uint32_t> sPartition;
+        sPartition.resize(count);
+        uint32_t* partition = sPartition.data();
+        uint32_t  lights    = 0;
+        uint32_t  heavies   = count;
+        float     scale     = static_cast<float>(count / total);
+        float     invSum    = static_cast<float>(1.0 / total);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            float weight     = weights[i] > 0.f ? weights[i] : 0.f;
+            float scaled     = weight * scale;
+            out[i].Threshold = scaled;
+            out[i].Alias     = i;
+            out[i].Pdf       = weight * invSum;
+            bool heavy       = scaled > 1.f;
+            heavies -= heavy ? 1 : 0;
+            partition[heavy ? heavies : lights] = i;
+            lights += heavy ? 0 : 1;
+        }
+
+        // Heavies were written back to front, they are consumed from the back as well
+        uint32_t light = 0;
+        uint32_t heavy = count;
+        if(heavies < count)
+        {
+            double w = out[partition[heavy - 1]].Threshold;
+            while(true)
+            {
+                if(w > 1.0)
+                {
+                    if(light == lights)
+                    {
+                        break;
+                    }
+                    out[partition[light]].Alias = partition[heavy - 1];
+                    w                           = (w + out[partition[light]].Threshold) - 1.0;
+                    light++;
+                }
+                else
+                {
+                    if(heavy - 1 == heavies)
+                    {
+                        break;
+                    }
+                    uint32_t current       = partition[heavy - 1];
+                    uint32_t next          = partition[heavy - 2];
+                    out[current].Threshold = static_cast<float>(w);
+                    out[current].Alias     = next;
+                    w                      = (w + out[next].Threshold) - 1.0;
+                    heavy--;
+                }
+            }
+        }
+        // Slots left unfilled are 1 up to rounding
+        for(uint32_t i = 0; i < count; i++)
+        {
+            if(out[i].Alias == i)
+            {
+                out[i].Threshold = 1.f;
+            }
+        }
+        return total;
+    }
+
+}  // namespace denoise::util
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+namespace denoise::util {
+
+    /// @brief Slot of an alias table, laid out for std430 storage buffers (see shaders/aliastable.glsl)
+    /// @details Sampling picks a slot uniformly, then keeps it with probability Threshold or takes Alias otherwise. Pdf is the probability of
+    /// drawing the slot's own element, so the shader can weight a sample without a second lookup into the weights.
+    struct AliasEntry
+    {
+        float    Threshold = 1.f;
+        uint32_t Alias     = 0;
+        float    Pdf       = 0.f;
+        uint32_t Padding   = 0;
+    };
+
+    /// @brief Builds an alias table over count non-negative weights in O(count)
+    /// @details Sweeping construction (Huebschle-Schneider and Sanders): the slots are partitioned into light and heavy ones, then a single sweep
+    /// fills the light slots from the current heavy slot, which joins the light ones once its remainder drops to 1 or below. No work lists
+    /// are kept, the only scratch is the partition of slot indices.
+    /// @param out Receives count entries
+    /// @return Sum of the weights. If it is not positive, the table samples uniformly
+    double BuildAliasTable(const float* weights, uint32_t count, AliasEntry* out);
+
+    /// @brief Draws an index from a table built by BuildAliasTable() with a uniform random number in [0, 1)
+    inline uint32_t SampleAliasTable(const AliasEntry* table, uint32_t count, float random)
+    {
+        float    scaled = random * static_cast<float>(count);
+        uint32_t slot   = static_cast<uint32_t>(scaled);
+        slot            = slot < count ? slot : count - 1;
+        return (scaled - static_cast<float>(slot)) < table[slot].Threshold ? slot : table[slot].Alias;
+    }
+
+}  // namespace denoise::util
@@ -0,0 +1,73 @@
+#include "envmapdistribution.hpp"
+#include <chrono>
+#include <cmath>
+#include <foray_logger.hpp>
+#include <numbers>
+
+namespace denoise::util {
+
+    float EnvMapDistribution::GetTexelWeight(const float* texel, float sinTheta)
+    {
+        float luminance = 0.2126f * texel[0] + 0.7152f * texel[1] + 0.0722f * texel[2];
+        return std::isfinite(luminance) && luminance > 0.f ? luminance * sinTheta : 0.f;
+    }
+
+    void EnvMapDistribution::Build(const float* texels, uint32_t width, uint32_t height, ThreadPool& threadPool)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        Clear();
+        if(width == 0 || height == 0)
+        {
+            return;
+        }
+        mEntries.resize(static_cast<size_t>(height) + static_cast<size_t>(width) * height);
+        AliasEntry* marginal    = mEntries.data();
+        AliasEntry* conditional = mEntries.data() + height;
+
+        // Rows are independent: weight, build the conditional table and remember the row sum for the marginal table
+        std::vector<float> rowWeights(height);
+        threadPool.ParallelFor(height, [&](uint32_t row) {
+            thread_local std::vector<float> sWeights;
+            sWeights.resize(width);
+            float*       weights  = sWeights.data();
+            float        sinTheta = std::sin((row + 0.5f) / height * std::numbers::pi_v<float>);
+            const float* source   = texels + static_cast<size_t>(row) * width * 4;
+            for(uint32_t column = 0; column < width; column++)
+            {
+                weights[column] = GetTexelWeight(source + column * 4, sinTheta);
+            }
+            rowWeights[row] = static_cast<float>(BuildAliasTable(weights, width, conditional + static_cast<size_t>(row) * width));
+        });
+        double integral = BuildAliasTable(rowWeights.data(), height, marginal);
+
+        mHeader = Header{.Width = width, .Height = height, .Integral = static_cast<float>(integral)};
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        foray::logger()->info("EnvMapDistribution: {}x{} built in {:.2f} ms on {} threads", width, height, milliseconds, threadPool.GetConcurrency());
+    }
+
+    void EnvMapDistribution::Clear()
+    {
+        mHeader = Header();
+        mEntries.clear();
+    }
+
+    float EnvMapDistribution::Sample(float random0, float random1, float random2, float random3, float uv[2]) const
+    {
+        if(!Exists() || !(mHeader.Integral > 0.f))
+        {
+            uv[0] = random2;
+            uv[1] = random3;
+            return 0.f;
+        }
+        const AliasEntry* conditional = mEntries.data() + mHeader.Height;
+        uint32_t          row         = SampleAliasTable(mEntries.data(), mHeader.Height, random0);
+        const AliasEntry* rowTable    = conditional + static_cast<size_t>(row) * mHeader.Width;
+        uint32_t          column      = SampleAliasTable(rowTable, mHeader.Width, random1);
+        uv[0]                         = (column + random2) / mHeader.Width;
+        uv[1]                         = (row + random3) / mHeader.Height;
+        return mEntries[row].Pdf * rowTable[column].Pdf * mHeader.Width * mHeader.Height;
+    }
+
+}  // namespace denoise::util
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "aliastable.hpp"
+#include "threadpool.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace denoise::util {
+
+    /// @brief Importance sampling distribution of an equirectangular environment map (see shaders/envsampler.glsl)
+    /// @details Texels are weighted by luminance times sin(theta), the solid angle they cover. A marginal alias table selects the row, one
+    /// conditional alias table per row selects the column, so a direction is drawn in O(1). Rows are built in parallel on the thread pool.
+    class EnvMapDistribution
+    {
+      public:
+        /// @brief Layout of the buffer header, followed by Height marginal and Width * Height conditional entries
+        struct Header
+        {
+            uint32_t Width  = 0;
+            uint32_t Height = 0;
+            /// @brief Sum of all texel weights
+            float    Integral = 0.f;
+            uint32_t Padding  = 0;
+        };
+
+        /// @brief Builds the tables from tightly packed RGBA32F texels, row 0 at the top (+Y)
+        void Build(const float* texels, uint32_t width, uint32_t height, ThreadPool& threadPool);
+        void Clear();
+
+        inline bool          Exists() const { return mHeader.Width > 0; }
+        inline uint32_t      GetWidth() const { return mHeader.Width; }
+        inline uint32_t      GetHeight() const { return mHeader.Height; }
+        inline float         GetIntegral() const { return mHeader.Integral; }
+        inline const Header& GetHeader() const { return mHeader; }
+        /// @brief Marginal entries followed by the conditional entries of every row
+        inline const std::vector<AliasEntry>& GetEntries() const { return mEntries; }
+
+        /// @brief Draws a texel (random0: row, random1: column) and jitters within it (random2, random3), all uniform in [0, 1)
+        /// @param uv Receives the continuous texture coordinate
+        /// @return Probability density with respect to the (u, v) domain, 0 if the map is black
+        float Sample(float random0, float random1, float random2, float random3, float uv[2]) const;
+
+        /// @brief Luminance times sin(theta) of the row's center (the weights the tables are built from)
+        static float GetTexelWeight(const float* texel, float sinTheta);
+
+      protected:
+        Header                  mHeader;
+        std::vector<AliasEntry> mEntries;
+    };
+
+}  // namespace denoise::util
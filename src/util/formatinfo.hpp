@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan.h>
+
+namespace denoise::util {
+
+    /// @brief Size of a single texel in bytes for the uncompressed color formats used by render targets. Returns 0 for unsupported formats.
+    inline uint32_t GetTexelSize(VkFormat format)
+    {
+        switch(format)
+        {
+            case VK_FORMAT_R8_UINT:
+                return 1;
+            case VK_FORMAT_R16_SFLOAT:
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R16G16_SFLOAT:
+            case VK_FORMAT_R32_UINT:
+            case VK_FORMAT_R32_SINT:
+            case VK_FORMAT_R32_SFLOAT:
+                return (format == VK_FORMAT_R16_SFLOAT) ? 2 : 4;
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+            case VK_FORMAT_R16G16B16A16_UINT:
+            case VK_FORMAT_R32G32_SFLOAT:
+            case VK_FORMAT_R32G32_UINT:
+                return 8;
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+            case VK_FORMAT_R32G32B32A32_UINT:
+                return 16;
+            default:
+                return 0;
+        }
+    }
+
+}  // namespace denoise::util
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "half.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace denoise::util {
+
+    /// @brief Encodes a unit vector as octahedral coordinates with 16 bit signed normalized components (x in the low half)
+    /// @details The angle between a normal and its decoded value is below 0.005 degrees. A zero vector encodes as (0, 0, 1).
+    inline uint32_t PackOctNormal(const float normal[3])
+    {
+        float length = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+        if(length <= 0.f)
+        {
+            return 0;
+        }
+        float u = normal[0] / length;
+        float v = normal[1] / length;
+        if(normal[2] < 0.f)
+        {
+            // Fold the lower hemisphere over the diagonals
+            float foldedU = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+            float foldedV = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+            u             = foldedU;
+            v             = foldedV;
+        }
+        int32_t x = static_cast<int32_t>(std::lround(std::clamp(u, -1.f, 1.f) * 32767.f));
+        int32_t y = static_cast<int32_t>(std::lround(std::clamp(v, -1.f, 1.f) * 32767.f));
+        return (static_cast<uint32_t>(x) & 0xFFFFu) | (static_cast<uint32_t>(y) << 16);
+    }
+
+    /// @brief Decodes PackOctNormal() into a unit vector
+    inline void UnpackOctNormal(uint32_t packed, float normal[3])
+    {
+        float u = std::max(static_cast<float>(static_cast<int16_t>(packed & 0xFFFFu)) / 32767.f, -1.f);
+        float v = std::max(static_cast<float>(static_cast<int16_t>(packed >> 16)) / 32767.f, -1.f);
+        float z = 1.f - std::abs(u) - std::abs(v);
+        if(z < 0.f)
+        {
+            float unfoldedU = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+            float unfoldedV = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+            u               = unfoldedU;
+            v               = unfoldedV;
+        }
+        float inverseLength = 1.f / std::sqrt(u * u + v * v + z * z);
+        normal[0]           = u * inverseLength;
+        normal[1]           = v * inverseLength;
+        normal[2]           = z * inverseLength;
+    }
+
+    /// @brief Packs two floats as binary16 (x in the low half), like packHalf2x16()
+    inline uint32_t PackHalf2(float x, float y) { return static_cast<uint32_t>(FloatToHalf(x)) | (static_cast<uint32_t>(FloatToHalf(y)) << 16); }
+
+    /// @brief Inverse of PackHalf2(), like unpackHalf2x16()
+    inline void UnpackHalf2(uint32_t packed, float out[2])
+    {
+        out[0] = HalfToFloat(static_cast<uint16_t>(packed & 0xFFFFu));
+        out[1] = HalfToFloat(static_cast<uint16_t>(packed >> 16));
+    }
+
+}  // namespace denoise::util
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace denoise::util {
+
+    /// @brief Converts an IEEE 754 binary16 value to float (handles denormals, infinities and NaN)
+    inline float HalfToFloat(uint16_t half)
+    {
+        uint32_t sign     = (uint32_t)(half & 0x8000u) << 16;
+        uint32_t exponent = (half >> 10) & 0x1Fu;
+        uint32_t mantissa = half & 0x3FFu;
+        uint32_t bits     = 0;
+        if(exponent == 0)
+        {
+            if(mantissa == 0)
+            {
+                bits = sign;
+            }
+            else
+            {
+                // Denormal: normalize the mantissa
+                exponent = 127 - 15 + 1;
+                while((mantissa & 0x400u) == 0)
+                {
+                    mantissa <<= 1;
+                    exponent--;
+                }
+                mantissa &= 0x3FFu;
+                bits = sign | (exponent << 23) | (mantissa << 13);
+            }
+        }
+        else if(exponent == 0x1F)
+        {
+            bits = sign | 0x7F800000u | (mantissa << 13);
+        }
+        else
+        {
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+        float result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    /// @brief Converts a float to IEEE 754 binary16 with round to nearest even
+    inline uint16_t FloatToHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint32_t sign     = (bits >> 16) & 0x8000u;
+        uint32_t exponent = (bits >> 23) & 0xFFu;
+        uint32_t mantissa = bits & 0x7FFFFFu;
+
+        if(exponent == 0xFF)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00u | (mantissa != 0 ? 0x200u : 0u));
+        }
+        int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+        if(halfExponent >= 0x1F)
+        {
+            return static_cast<uint16_t>(sign | 0x7C00u);  // Overflow to infinity
+        }
+        if(halfExponent <= 0)
+        {
+            if(halfExponent < -10)
+            {
+                return static_cast<uint16_t>(sign);  // Underflow to zero
+            }
+            // Denormal result
+            mantissa |= 0x800000u;
+            uint32_t shift   = static_cast<uint32_t>(14 - halfExponent);
+            uint32_t half    = mantissa >> shift;
+            uint32_t rest    = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if(rest > halfway || (rest == halfway && (half & 1u)))
+            {
+                half++;
+            }
+            return static_cast<uint16_t>(sign | half);
+        }
+        uint32_t half = sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+        uint32_t rest = mantissa & 0x1FFFu;
+        if(rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+        {
+            half++;  // May carry into the exponent, which correctly rounds up to the next power of two / infinity
+        }
+        return static_cast<uint16_t>(half);
+    }
+
+}  // namespace denoise::util
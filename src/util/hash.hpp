@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace denoise::util {
+
+    inline constexpr uint64_t FNV1A_SEED = 0xcbf29ce484222325ull;
+
+    /// @brief Continues a 64 bit FNV-1a hash over the bytes
+    inline void HashBytes(uint64_t& hash, const void* data, size_t size)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+        for(size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+    }
+
+    /// @brief Hashes the length before the characters, so concatenations of different strings do not collide
+    inline void HashString(uint64_t& hash, std::string_view text)
+    {
+        uint64_t size = text.size();
+        HashBytes(hash, &size, sizeof(size));
+        HashBytes(hash, text.data(), text.size());
+    }
+
+}  // namespace denoise::util
@@ -0,0 +1,136 @@
+#include "mappedfile.hpp"
+#include <algorithm>
+#include <foray_logger.hpp>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace denoise::util {
+
+#if defined(_WIN32)
+    bool MappedFile::Open(const std::string& utf8path)
+    {
+        Close();
+        int          wideLength = MultiByteToWideChar(CP_UTF8, 0, utf8path.c_str(), -1, nullptr, 0);
+        std::wstring widePath(wideLength, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, utf8path.c_str(), -1, widePath.data(), wideLength);
+
+        HANDLE file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            foray::logger()->warn("MappedFile: Unable to open \"{}\"", utf8path);
+            return false;
+        }
+        LARGE_INTEGER size{};
+        GetFileSizeEx(file, &size);
+        if(size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            foray::logger()->warn("MappedFile: \"{}\" is empty", utf8path);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void*  view    = !!mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if(!view)
+        {
+            if(!!mapping)
+            {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            foray::logger()->warn("MappedFile: Unable to map \"{}\"", utf8path);
+            return false;
+        }
+        mFileHandle    = file;
+        mMappingHandle = mapping;
+        mData          = reinterpret_cast<const uint8_t*>(view);
+        mSize          = static_cast<size_t>(size.QuadPart);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if(!!mData)
+        {
+            UnmapViewOfFile(mData);
+            CloseHandle(mMappingHandle);
+            CloseHandle(mFileHandle);
+        }
+        mData          = nullptr;
+        mSize          = 0;
+        mFileHandle    = nullptr;
+        mMappingHandle = nullptr;
+    }
+
+    void MappedFile::Prefetch(size_t offset, size_t size) const
+    {
+        if(!mData || offset >= mSize)
+        {
+            return;
+        }
+        WIN32_MEMORY_RANGE_ENTRY range{.VirtualAddress = const_cast<uint8_t*>(mData + offset), .NumberOfBytes = std::min(size, mSize - offset)};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    bool MappedFile::Open(const std::string& utf8path)
+    {
+        Close();
+        int fd = open(utf8path.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            foray::logger()->warn("MappedFile: Unable to open \"{}\"", utf8path);
+            return false;
+        }
+        struct stat info
+        {
+        };
+        if(fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            foray::logger()->warn("MappedFile: \"{}\" is empty or can not be queried", utf8path);
+            return false;
+        }
+        void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);  // The mapping keeps its own reference to the file
+        if(data == MAP_FAILED)
+        {
+            foray::logger()->warn("MappedFile: Unable to map \"{}\"", utf8path);
+            return false;
+        }
+        mData = reinterpret_cast<const uint8_t*>(data);
+        mSize = static_cast<size_t>(info.st_size);
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if(!!mData)
+        {
+            munmap(const_cast<uint8_t*>(mData), mSize);
+        }
+        mData = nullptr;
+        mSize = 0;
+    }
+
+    void MappedFile::Prefetch(size_t offset, size_t size) const
+    {
+        if(!mData || offset >= mSize)
+        {
+            return;
+        }
+        // madvise requires page aligned addresses
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t       begin    = offset - (offset % pageSize);
+        size_t       end      = std::min(offset + size, mSize);
+        madvise(const_cast<uint8_t*>(mData + begin), end - begin, MADV_WILLNEED);
+    }
+#endif
+
+}  // namespace denoise::util
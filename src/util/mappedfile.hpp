@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace denoise::util {
+
+    /// @brief Read-only memory mapping of a whole file
+    class MappedFile
+    {
+      public:
+        MappedFile() = default;
+        ~MappedFile() { Close(); }
+
+        MappedFile(const MappedFile&)            = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /// @brief Maps the file. Returns false (and logs a warning) if the file can not be opened or mapped.
+        bool Open(const std::string& utf8path);
+        void Close();
+
+        /// @brief Hints the OS to read the range ahead of access
+        void Prefetch(size_t offset, size_t size) const;
+
+        inline bool           IsOpen() const { return !!mData; }
+        inline const uint8_t* GetData() const { return mData; }
+        inline size_t         GetSize() const { return mSize; }
+
+      protected:
+        const uint8_t* mData = nullptr;
+        size_t         mSize = 0;
+#if defined(_WIN32)
+        void* mFileHandle    = nullptr;
+        void* mMappingHandle = nullptr;
+#endif
+    };
+
+}  // namespace denoise::util
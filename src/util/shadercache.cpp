@@ -0,0 +1,176 @@
+#include "shadercache.hpp"
+#include "hash.hpp"
+#include "mappedfile.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace denoise::util {
+
+    /// @brief Bump to invalidate all entries (e.g. when the compiler arguments change)
+    const uint32_t SHADER_CACHE_VERSION = 1;
+    const char*    SHADER_COMPILER_ARGS = "--target-env=vulkan1.3";
+
+    /// @brief Returns the path of a quoted #include directive, empty if the line is none
+    std::string_view lParseInclude(std::string_view line)
+    {
+        size_t pos = line.find_first_not_of(" \t");
+        if(pos == std::string_view::npos || line[pos] != '#')
+        {
+            return {};
+        }
+        pos = line.find_first_not_of(" \t", pos + 1);
+        if(pos == std::string_view::npos || line.substr(pos, 7) != "include")
+        {
+            return {};
+        }
+        size_t begin = line.find('"', pos + 7);
+        size_t end   = begin == std::string_view::npos ? begin : line.find('"', begin + 1);
+        if(end == std::string_view::npos)
+        {
+            return {};
+        }
+        return line.substr(begin + 1, end - begin - 1);
+    }
+
+    bool lHashFileRecursive(uint64_t& hash, const std::filesystem::path& path, std::set<std::filesystem::path>& visited)
+    {
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path);
+        if(!visited.insert(canonical).second)
+        {
+            return true;  // Include guarded files are hashed once
+        }
+        std::ifstream file(canonical, std::ios_base::in | std::ios_base::binary);
+        if(!file.is_open())
+        {
+            foray::logger()->warn("ShaderCache: Unable to read \"{}\"", canonical.string());
+            return false;
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        std::string source = stream.str();
+        HashString(hash, source);
+
+        std::string_view remaining(source);
+        while(remaining.size() > 0)
+        {
+            size_t           lineEnd = remaining.find('\n');
+            std::string_view line    = remaining.substr(0, lineEnd);
+            remaining                = lineEnd == std::string_view::npos ? std::string_view() : remaining.substr(lineEnd + 1);
+
+            std::string_view include = lParseInclude(line);
+            if(include.size() > 0 && !lHashFileRecursive(hash, canonical.parent_path() / std::filesystem::u8path(include), visited))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ShaderCache::ComputeKey(const std::string& sourcePath, const std::vector<std::string>& defines, uint64_t& key)
+    {
+        uint64_t hash = FNV1A_SEED;
+        HashBytes(hash, &SHADER_CACHE_VERSION, sizeof(SHADER_CACHE_VERSION));
+        HashString(hash, SHADER_COMPILER_ARGS);
+        // The extension selects the shader stage
+        HashString(hash, std::filesystem::u8path(sourcePath).extension().string());
+        for(const std::string& define : defines)
+        {
+            HashString(hash, define);
+        }
+        std::set<std::filesystem::path> visited;
+        if(!lHashFileRecursive(hash, std::filesystem::u8path(sourcePath), visited))
+        {
+            return false;
+        }
+        key = hash;
+        return true;
+    }
+
+    bool ShaderCache::Init(const std::string& utf8dir)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::u8path(utf8dir), error);
+        if(error)
+        {
+            foray::logger()->warn("ShaderCache: Unable to create \"{}\": {}", utf8dir, error.message());
+            return false;
+        }
+        mDirectory = utf8dir;
+        mHits      = 0;
+        mMisses    = 0;
+
+        const char* sdk = std::getenv("VULKAN_SDK");
+#if defined(_WIN32)
+        mCompiler = !!sdk ? (std::filesystem::u8path(sdk) / "Bin" / "glslc.exe").string() : "glslc.exe";
+#else
+        mCompiler = !!sdk ? (std::filesystem::u8path(sdk) / "bin" / "glslc").string() : "glslc";
+#endif
+        return true;
+    }
+
+    bool ShaderCache::Compile(const std::string& sourcePath, const std::vector<std::string>& defines, const std::string& outPath) const
+    {
+        std::string command = fmt::format("\"{}\" {}", mCompiler, SHADER_COMPILER_ARGS);
+        for(const std::string& define : defines)
+        {
+            command += fmt::format(" \"-D{}\"", define);
+        }
+        command += fmt::format(" -o \"{}\" \"{}\"", outPath, sourcePath);
+#if defined(_WIN32)
+        command = "\"" + command + "\"";  // cmd.exe strips the outer quotes
+#endif
+        int result = std::system(command.c_str());
+        if(result != 0)
+        {
+            foray::logger()->warn("ShaderCache: Compiling \"{}\" failed ({})", sourcePath, result);
+            return false;
+        }
+        return true;
+    }
+
+    bool ShaderCache::Load(foray::core::Context* context, const std::string& sourcePath, foray::core::ShaderModule& module, const std::vector<std::string>& defines)
+    {
+        uint64_t key = 0;
+        if(!Exists() || !ComputeKey(sourcePath, defines, key))
+        {
+            return false;
+        }
+        std::filesystem::path entry = std::filesystem::u8path(mDirectory) / fmt::format("{:016x}.spv", key);
+
+        if(std::filesystem::exists(entry))
+        {
+            mHits++;
+        }
+        else
+        {
+            mMisses++;
+            // Unique per process and call, the rename below is atomic within the directory
+            std::filesystem::path temp = entry;
+            temp += fmt::format(".{}.tmp", std::chrono::steady_clock::now().time_since_epoch().count());
+            bool compiled = Compile(sourcePath, defines, temp.string());
+            std::error_code error;
+            if(compiled)
+            {
+                std::filesystem::rename(temp, entry, error);
+            }
+            std::filesystem::remove(temp, error);
+            if(!compiled || !std::filesystem::exists(entry))
+            {
+                return false;
+            }
+        }
+
+        MappedFile file;
+        if(!file.Open(entry.string()) || file.GetSize() % sizeof(uint32_t) != 0)
+        {
+            return false;
+        }
+        module.LoadFromBinary(context, file.GetData(), file.GetSize());
+        return true;
+    }
+
+}  // namespace denoise::util
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <foray_api.hpp>
+#include <string>
+#include <vector>
+
+namespace denoise::util {
+
+    /// @brief Content addressed on-disk cache of compiled SPIR-V
+    /// @details Entries are stored as <directory>/<key:016x>.spv, where the key hashes the shader source, all recursively included files (relative
+    /// #include "..." directives, resolved like glslc does), the defines and the compiler settings. Any edit therefore yields a new entry instead of
+    /// invalidating an old one. Hits are memory mapped and handed to the shader module without a copy. Misses are compiled with glslc
+    /// ($VULKAN_SDK/bin or PATH) into a temporary file which is renamed into place, so concurrently launched instances never read partial entries.
+    class ShaderCache
+    {
+      public:
+        /// @param utf8dir Cache directory, created if missing
+        bool Init(const std::string& utf8dir);
+
+        /// @brief Loads the compiled source into module, compiling it into the cache on a miss
+        /// @return False if the shader could neither be found in nor compiled into the cache (module is untouched, the caller should compile it directly)
+        bool Load(foray::core::Context* context, const std::string& sourcePath, foray::core::ShaderModule& module, const std::vector<std::string>& defines = {});
+
+        /// @brief Hashes the source, its includes and the defines. Returns false if a file could not be read
+        static bool ComputeKey(const std::string& sourcePath, const std::vector<std::string>& defines, uint64_t& key);
+
+        inline bool     Exists() const { return !mDirectory.empty(); }
+        inline uint32_t GetHits() const { return mHits; }
+        inline uint32_t GetMisses() const { return mMisses; }
+
+      protected:
+        bool Compile(const std::string& sourcePath, const std::vector<std::string>& defines, const std::string& outPath) const;
+
+        std::string mDirectory;
+        std::string mCompiler;
+        uint32_t    mHits   = 0;
+        uint32_t    mMisses = 0;
+    };
+
+}  // namespace denoise::util
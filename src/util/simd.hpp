@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cstddef>
+
+// MSVC never defines __FMA__, /arch:AVX2 implies it
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define DENOISE_SIMD_AVX2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DENOISE_SIMD_NEON 1
+#endif
+
+namespace denoise::util::simd {
+
+    /// @brief Name of the instruction set the kernels were compiled for
+    inline constexpr const char* GetInstructionSet()
+    {
+#if defined(DENOISE_SIMD_AVX2)
+        return "AVX2";
+#elif defined(DENOISE_SIMD_NEON)
+        return "NEON";
+#else
+        return "Scalar";
+#endif
+    }
+
+#if defined(DENOISE_SIMD_AVX2)
+    inline float lHorizontalSum(__m256 v)
+    {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        sum        = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum        = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+        return _mm_cvtss_f32(sum);
+    }
+#endif
+
+    /// @brief Returns sum(a[i] * b[i])
+    inline float Dot(const float* a, const float* b, size_t count)
+    {
+        size_t i   = 0;
+        float  sum = 0.f;
+#if defined(DENOISE_SIMD_AVX2)
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for(; i + 16 <= count; i += 16)
+        {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        }
+        sum = lHorizontalSum(_mm256_add_ps(acc0, acc1));
+#elif defined(DENOISE_SIMD_NEON)
+        float32x4_t acc0 = vdupq_n_f32(0.f);
+        float32x4_t acc1 = vdupq_n_f32(0.f);
+        for(; i + 8 <= count; i += 8)
+        {
+            acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+            acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        }
+        sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+        for(; i < count; i++)
+        {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    /// @brief Returns sum(x[i]), accumulated in double precision per vector lane group
+    inline double Sum(const float* x, size_t count)
+    {
+        size_t i   = 0;
+        double sum = 0.0;
+#if defined(DENOISE_SIMD_AVX2)
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 v = _mm256_loadu_ps(x + i);
+            acc0     = _mm256_add_pd(acc0, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+            acc1     = _mm256_add_pd(acc1, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+        }
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, _mm256_add_pd(acc0, acc1));
+        sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(DENOISE_SIMD_NEON)
+        float64x2_t acc0 = vdupq_n_f64(0.0);
+        float64x2_t acc1 = vdupq_n_f64(0.0);
+        for(; i + 4 <= count; i += 4)
+        {
+            float32x4_t v = vld1q_f32(x + i);
+            acc0          = vaddq_f64(acc0, vcvt_f64_f32(vget_low_f32(v)));
+            acc1          = vaddq_f64(acc1, vcvt_high_f64_f32(v));
+        }
+        sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+#endif
+        for(; i < count; i++)
+        {
+            sum += x[i];
+        }
+        return sum;
+    }
+
+    /// @brief y[i] += alpha * x[i]
+    inline void Axpy(float alpha, const float* x, float* y, size_t count)
+    {
+        size_t i = 0;
+#if defined(DENOISE_SIMD_AVX2)
+        __m256 a = _mm256_set1_ps(alpha);
+        for(; i + 8 <= count; i += 8)
+        {
+            _mm256_storeu_ps(y + i, _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+        }
+#elif defined(DENOISE_SIMD_NEON)
+        float32x4_t a = vdupq_n_f32(alpha);
+        for(; i + 4 <= count; i += 4)
+        {
+            vst1q_f32(y + i, vfmaq_f32(vld1q_f32(y + i), a, vld1q_f32(x + i)));
+        }
+#endif
+        for(; i < count; i++)
+        {
+            y[i] += alpha * x[i];
+        }
+    }
+
+    /// @brief dst[i] = sum_k(weights[k] * src[i + k]) for k in [0, taps). src must hold count + taps - 1 values.
+    inline void Convolve(const float* src, const float* weights, size_t taps, float* dst, size_t count)
+    {
+        size_t i = 0;
+#if defined(DENOISE_SIMD_AVX2)
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 acc = _mm256_setzero_ps();
+            for(size_t k = 0; k < taps; k++)
+            {
+                acc = _mm256_fmadd_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(src + i + k), acc);
+            }
+            _mm256_storeu_ps(dst + i, acc);
+        }
+#elif defined(DENOISE_SIMD_NEON)
+        for(; i + 4 <= count; i += 4)
+        {
+            float32x4_t acc = vdupq_n_f32(0.f);
+            for(size_t k = 0; k < taps; k++)
+            {
+                acc = vfmaq_n_f32(acc, vld1q_f32(src + i + k), weights[k]);
+            }
+            vst1q_f32(dst + i, acc);
+        }
+#endif
+        for(; i < count; i++)
+        {
+            float sum = 0.f;
+            for(size_t k = 0; k < taps; k++)
+            {
+                sum += weights[k] * src[i + k];
+            }
+            dst[i] = sum;
+        }
+    }
+
+    /// @brief dst[i] = sum_k(weights[k] * rows[k][i]) for k in [0, taps), e.g. the vertical pass of a separable filter
+    inline void ConvolveRows(const float* const* rows, const float* weights, size_t taps, float* dst, size_t count)
+    {
+        size_t i = 0;
+#if defined(DENOISE_SIMD_AVX2)
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 acc = _mm256_setzero_ps();
+            for(size_t k = 0; k < taps; k++)
+            {
+                acc = _mm256_fmadd_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i), acc);
+            }
+            _mm256_storeu_ps(dst + i, acc);
+        }
+#elif defined(DENOISE_SIMD_NEON)
+        for(; i + 4 <= count; i += 4)
+        {
+            float32x4_t acc = vdupq_n_f32(0.f);
+            for(size_t k = 0; k < taps; k++)
+            {
+                acc = vfmaq_n_f32(acc, vld1q_f32(rows[k] + i), weights[k]);
+            }
+            vst1q_f32(dst + i, acc);
+        }
+#endif
+        for(; i < count; i++)
+        {
+            float sum = 0.f;
+            for(size_t k = 0; k < taps; k++)
+            {
+                sum += weights[k] * rows[k][i];
+            }
+            dst[i] = sum;
+        }
+    }
+
+    /// @brief x[i] *= alpha
+    inline void Scale(float alpha, float* x, size_t count)
+    {
+        size_t i = 0;
+#if defined(DENOISE_SIMD_AVX2)
+        __m256 a = _mm256_set1_ps(alpha);
+        for(; i + 8 <= count; i += 8)
+        {
+            _mm256_storeu_ps(x + i, _mm256_mul_ps(a, _mm256_loadu_ps(x + i)));
+        }
+#elif defined(DENOISE_SIMD_NEON)
+        float32x4_t a = vdupq_n_f32(alpha);
+        for(; i + 4 <= count; i += 4)
+        {
+            vst1q_f32(x + i, vmulq_f32(a, vld1q_f32(x + i)));
+        }
+#endif
+        for(; i < count; i++)
+        {
+            x[i] *= alpha;
+        }
+    }
+
+    /// @brief Returns sum((a[i] - b[i])^2)
+    inline float SquaredDistance(const float* a, const float* b, size_t count)
+    {
+        size_t i   = 0;
+        float  sum = 0.f;
+#if defined(DENOISE_SIMD_AVX2)
+        __m256 acc = _mm256_setzero_ps();
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 diff = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            acc         = _mm256_fmadd_ps(diff, diff, acc);
+        }
+        sum = lHorizontalSum(acc);
+#elif defined(DENOISE_SIMD_NEON)
+        float32x4_t acc = vdupq_n_f32(0.f);
+        for(; i + 4 <= count; i += 4)
+        {
+            float32x4_t diff = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+            acc              = vfmaq_f32(acc, diff, diff);
+        }
+        sum = vaddvq_f32(acc);
+#endif
+        for(; i < count; i++)
+        {
+            float diff = a[i] - b[i];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+}  // namespace denoise::util::simd
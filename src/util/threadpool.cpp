@@ -0,0 +1,182 @@
+#include "threadpool.hpp"
+#include "timeline.hpp"
+#include <algorithm>
+#include <string>
+
+namespace denoise::util {
+
+    void ThreadPool::Init(uint32_t threadCount)
+    {
+        Destroy();
+        if(threadCount == 0)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        // The calling thread participates in ParallelFor
+        threadCount--;
+        mStop = false;
+        // One additional queue for tasks pushed by non-worker threads
+        for(uint32_t i = 0; i <= threadCount; i++)
+        {
+            mQueues.push_back(std::make_unique<Queue>());
+        }
+        for(uint32_t i = 0; i < threadCount; i++)
+        {
+            mWorkers.emplace_back([this, i]() { this->WorkerMain(i); });
+        }
+    }
+
+    void ThreadPool::Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mStop = true;
+        }
+        mSleepCondition.notify_all();
+        for(std::thread& worker : mWorkers)
+        {
+            worker.join();
+        }
+        mWorkers.clear();
+        mQueues.clear();
+        mPendingTasks = 0;
+    }
+
+    ThreadPool& ThreadPool::Shared()
+    {
+        static ThreadPool sPool;
+        static std::once_flag sInitFlag;
+        std::call_once(sInitFlag, []() { sPool.Init(); });
+        return sPool;
+    }
+
+    void ThreadPool::Push(uint32_t queueIndex, Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mQueues[queueIndex]->Mutex);
+            mQueues[queueIndex]->Tasks.push_back(std::move(task));
+        }
+        {
+            // Taking the sleep mutex orders the increment with a worker checking the predicate
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mPendingTasks++;
+        }
+        mSleepCondition.notify_one();
+    }
+
+    bool ThreadPool::TryPop(uint32_t queueIndex, Task& out)
+    {
+        Queue&                      queue = *mQueues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if(queue.Tasks.empty())
+        {
+            return false;
+        }
+        out = std::move(queue.Tasks.back());
+        queue.Tasks.pop_back();
+        mPendingTasks--;
+        return true;
+    }
+
+    bool ThreadPool::TrySteal(uint32_t thiefIndex, Task& out)
+    {
+        const uint32_t queueCount = static_cast<uint32_t>(mQueues.size());
+        for(uint32_t offset = 1; offset <= queueCount; offset++)
+        {
+            Queue&                       queue = *mQueues[(thiefIndex + offset) % queueCount];
+            std::unique_lock<std::mutex> lock(queue.Mutex, std::try_to_lock);
+            if(!lock.owns_lock() || queue.Tasks.empty())
+            {
+                continue;
+            }
+            out = std::move(queue.Tasks.front());
+            queue.Tasks.pop_front();
+            mPendingTasks--;
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::WorkerMain(uint32_t index)
+    {
+        Timeline::Shared().SetThreadName(Timeline::Shared().InternName("Worker " + std::to_string(index)));
+        Task task;
+        while(true)
+        {
+            if(TryPop(index, task) || TrySteal(index, task))
+            {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            mSleepCondition.wait(lock, [this]() { return mStop || mPendingTasks.load() > 0; });
+            if(mStop)
+            {
+                return;
+            }
+        }
+    }
+
+    void ThreadPool::Submit(Task task)
+    {
+        if(mWorkers.empty())
+        {
+            task();
+            return;
+        }
+        Push(static_cast<uint32_t>(mWorkers.size()), std::move(task));
+    }
+
+    void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t index)>& func, uint32_t grain)
+    {
+        if(count == 0)
+        {
+            return;
+        }
+        if(mWorkers.empty() || count == 1)
+        {
+            for(uint32_t i = 0; i < count; i++)
+            {
+                func(i);
+            }
+            return;
+        }
+        if(grain == 0)
+        {
+            grain = std::max(1u, count / (GetConcurrency() * 4));
+        }
+
+        const uint32_t        taskCount = (count + grain - 1) / grain;
+        std::atomic<uint32_t> remaining = taskCount;
+        for(uint32_t task = 0; task < taskCount; task++)
+        {
+            uint32_t begin = task * grain;
+            uint32_t end   = std::min(count, begin + grain);
+            Push(mNextQueue++ % static_cast<uint32_t>(mWorkers.size()), [&func, &remaining, begin, end]() {
+                for(uint32_t i = begin; i < end; i++)
+                {
+                    func(i);
+                }
+                remaining--;
+            });
+        }
+
+        // The calling thread steals work until all chunks of this call have finished
+        const uint32_t callerQueue = static_cast<uint32_t>(mWorkers.size());
+        Task           task;
+        while(remaining.load() > 0)
+        {
+            if(TrySteal(callerQueue, task))
+            {
+                task();
+                task = nullptr;
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+}  // namespace denoise::util
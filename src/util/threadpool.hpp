@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace denoise::util {
+
+    /// @brief Work stealing thread pool
+    /// @details Every worker owns a task deque. Workers pop from the back of their own deque (LIFO, cache warm) and steal from the front
+    /// of other deques when idle. ParallelFor() distributes chunks across all deques and lets the calling thread participate.
+    class ThreadPool
+    {
+      public:
+        using Task = std::function<void()>;
+
+        ThreadPool() = default;
+        ~ThreadPool() { Destroy(); }
+
+        ThreadPool(const ThreadPool&)            = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /// @param threadCount Threads executing a ParallelFor, including the calling thread. 0 uses one per hardware thread
+        void Init(uint32_t threadCount = 0);
+        void Destroy();
+
+        /// @brief Number of threads executing a ParallelFor (workers + calling thread)
+        inline uint32_t GetConcurrency() const { return static_cast<uint32_t>(mWorkers.size()) + 1; }
+
+        /// @brief Runs func(index) for every index in [0, count) and returns once all invocations finished
+        /// @param grain Indices per task. 0 chooses a grain yielding a few tasks per thread
+        void ParallelFor(uint32_t count, const std::function<void(uint32_t index)>& func, uint32_t grain = 0);
+
+        /// @brief Queues a task for asynchronous execution
+        void Submit(Task task);
+
+        /// @brief Process wide pool, initialized on first use
+        static ThreadPool& Shared();
+
+      protected:
+        struct Queue
+        {
+            std::mutex       Mutex;
+            std::deque<Task> Tasks;
+        };
+
+        void WorkerMain(uint32_t index);
+        bool TryPop(uint32_t queueIndex, Task& out);
+        bool TrySteal(uint32_t thiefIndex, Task& out);
+        void Push(uint32_t queueIndex, Task task);
+
+        std::vector<std::unique_ptr<Queue>> mQueues;
+        std::vector<std::thread>            mWorkers;
+        std::atomic<uint32_t>               mPendingTasks = 0;
+        std::atomic<uint32_t>               mNextQueue    = 0;
+        std::mutex                          mSleepMutex;
+        std::condition_variable             mSleepCondition;
+        bool                                mStop = false;
+    };
+
+}  // namespace denoise::util
@@ -0,0 +1,241 @@
+#include "timeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <foray_logger.hpp>
+#include <fstream>
+
+namespace denoise::util {
+
+    thread_local Timeline::ThreadBuffer* Timeline::sThreadBuffer = nullptr;
+    thread_local const char*             Timeline::sThreadName   = nullptr;
+
+    /// @brief Appends s as JSON string literal
+    void lAppendJsonString(std::string& out, const char* s)
+    {
+        out += '"';
+        for(; *s != '\0'; s++)
+        {
+            char c = *s;
+            if(c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if(static_cast<unsigned char>(c) < 0x20)
+            {
+                out += fmt::format("\\u{:04x}", static_cast<unsigned>(c));
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+
+    Timeline::Timeline()
+    {
+        mOriginNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    Timeline::~Timeline()
+    {
+        ThreadBuffer* buffer = mBuffers.exchange(nullptr);
+        while(!!buffer)
+        {
+            Chunk* chunk = buffer->First;
+            while(!!chunk)
+            {
+                Chunk* next = chunk->Next.load();
+                delete chunk;
+                chunk = next;
+            }
+            ThreadBuffer* next = buffer->Next;
+            delete buffer;
+            buffer = next;
+        }
+    }
+
+    Timeline& Timeline::Shared()
+    {
+        static Timeline sTimeline;
+        return sTimeline;
+    }
+
+    void Timeline::Enable(uint32_t maxEventsPerThread)
+    {
+        mMaxChunksPerThread.store(std::max(1u, (maxEventsPerThread + Chunk::CAPACITY - 1) / Chunk::CAPACITY));
+        mEnabled.store(true);
+    }
+
+    void Timeline::Disable()
+    {
+        mEnabled.store(false);
+    }
+
+    int64_t Timeline::Now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - mOriginNs;
+    }
+
+    Timeline::ThreadBuffer* Timeline::GetThreadBuffer()
+    {
+        if(!!sThreadBuffer)
+        {
+            return sThreadBuffer;
+        }
+        ThreadBuffer* buffer = new ThreadBuffer();
+        buffer->First        = new Chunk();
+        buffer->Last         = buffer->First;
+        buffer->ChunkCount   = 1;
+        buffer->Index        = mThreadCount.fetch_add(1);
+        buffer->Name.store(sThreadName);
+
+        // Lock-free push, the exporter only ever walks the list from its head
+        buffer->Next = mBuffers.load(std::memory_order_relaxed);
+        while(!mBuffers.compare_exchange_weak(buffer->Next, buffer, std::memory_order_release, std::memory_order_relaxed))
+        {
+        }
+        sThreadBuffer = buffer;
+        return buffer;
+    }
+
+    void Timeline::AddEvent(const char* name, int64_t beginNs, int64_t endNs, uint32_t track)
+    {
+        if(!IsEnabled())
+        {
+            return;
+        }
+        ThreadBuffer* buffer = GetThreadBuffer();
+        Chunk*        chunk  = buffer->Last;
+        uint32_t      count  = chunk->Count.load(std::memory_order_relaxed);
+        if(count == Chunk::CAPACITY)
+        {
+            if(buffer->ChunkCount >= mMaxChunksPerThread.load(std::memory_order_relaxed))
+            {
+                buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            Chunk* next = new Chunk();
+            chunk->Next.store(next, std::memory_order_release);
+            buffer->Last = next;
+            buffer->ChunkCount++;
+            chunk = next;
+            count = 0;
+        }
+        chunk->Events[count] = TimelineEvent{.Name = name, .BeginNs = beginNs, .EndNs = endNs, .Track = track};
+        chunk->Count.store(count + 1, std::memory_order_release);
+    }
+
+    void Timeline::SetThreadName(const char* name)
+    {
+        sThreadName = name;
+        if(!!sThreadBuffer)
+        {
+            sThreadBuffer->Name.store(name);
+        }
+    }
+
+    uint32_t Timeline::AddTrack(std::string_view name)
+    {
+        const char*                 interned = InternName(name);
+        std::lock_guard<std::mutex> lock(mNamesMutex);
+        mTracks.push_back(interned);
+        return static_cast<uint32_t>(mTracks.size() - 1);
+    }
+
+    const char* Timeline::InternName(std::string_view name)
+    {
+        std::lock_guard<std::mutex> lock(mNamesMutex);
+        return mNames.emplace(name).first->c_str();
+    }
+
+    uint64_t Timeline::GetDroppedEvents() const
+    {
+        uint64_t dropped = 0;
+        for(ThreadBuffer* buffer = mBuffers.load(std::memory_order_acquire); !!buffer; buffer = buffer->Next)
+        {
+            dropped += buffer->Dropped.load(std::memory_order_relaxed);
+        }
+        return dropped;
+    }
+
+    bool Timeline::WriteChromeTrace(const std::string& utf8path)
+    {
+        constexpr uint32_t HOST_PID   = 1;
+        constexpr uint32_t DEVICE_PID = 2;
+
+        std::ofstream file(std::filesystem::u8path(utf8path), std::ios::binary | std::ios::trunc);
+        if(!file)
+        {
+            foray::logger()->error("Timeline: Failed to open \"{}\"", utf8path);
+            return false;
+        }
+
+        std::vector<const char*> tracks;
+        {
+            std::lock_guard<std::mutex> lock(mNamesMutex);
+            tracks = mTracks;
+        }
+
+        std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out += fmt::format("{{\"ph\":\"M\",\"pid\":{},\"name\":\"process_name\",\"args\":{{\"name\":\"Host\"}}}},\n", HOST_PID);
+        out += fmt::format("{{\"ph\":\"M\",\"pid\":{},\"name\":\"process_name\",\"args\":{{\"name\":\"Device\"}}}}", DEVICE_PID);
+        for(uint32_t track = 0; track < tracks.size(); track++)
+        {
+            out += fmt::format(",\n{{\"ph\":\"M\",\"pid\":{},\"tid\":{},\"name\":\"thread_name\",\"args\":{{\"name\":", DEVICE_PID, track);
+            lAppendJsonString(out, tracks[track]);
+            out += "}}";
+        }
+
+        size_t eventCount = 0;
+        for(ThreadBuffer* buffer = mBuffers.load(std::memory_order_acquire); !!buffer; buffer = buffer->Next)
+        {
+            const char* threadName = buffer->Name.load();
+            out += fmt::format(",\n{{\"ph\":\"M\",\"pid\":{},\"tid\":{},\"name\":\"thread_name\",\"args\":{{\"name\":", HOST_PID, buffer->Index);
+            if(!!threadName)
+            {
+                lAppendJsonString(out, threadName);
+            }
+            else
+            {
+                out += fmt::format("\"Thread {}\"", buffer->Index);
+            }
+            out += "}}";
+
+            for(Chunk* chunk = buffer->First; !!chunk; chunk = chunk->Next.load(std::memory_order_acquire))
+            {
+                uint32_t count = chunk->Count.load(std::memory_order_acquire);
+                for(uint32_t i = 0; i < count; i++)
+                {
+                    const TimelineEvent& event  = chunk->Events[i];
+                    bool                 device = event.Track != THREAD_TRACK;
+                    // Complete events, timestamps in microseconds
+                    out += fmt::format(",\n{{\"ph\":\"X\",\"pid\":{},\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},\"name\":", device ? DEVICE_PID : HOST_PID,
+                                       device ? event.Track : buffer->Index, event.BeginNs / 1000.0, std::max<int64_t>(event.EndNs - event.BeginNs, 0) / 1000.0);
+                    lAppendJsonString(out, event.Name);
+                    out += '}';
+                }
+                eventCount += count;
+                if(out.size() > (1u << 20))
+                {
+                    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+                    out.clear();
+                }
+            }
+        }
+        out += "\n]}\n";
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        if(!file)
+        {
+            foray::logger()->error("Timeline: Failed to write \"{}\"", utf8path);
+            return false;
+        }
+
+        uint64_t dropped = GetDroppedEvents();
+        foray::logger()->info("Timeline: Wrote {} events to \"{}\"{}", eventCount, utf8path, dropped > 0 ? fmt::format(" ({} dropped)", dropped) : std::string());
+        return true;
+    }
+
+}  // namespace denoise::util
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace denoise::util {
+
+    /// @brief Timed span on a timeline track. Times are nanoseconds since the timeline was created
+    struct TimelineEvent
+    {
+        /// @brief Static or interned (Timeline::InternName()) string
+        const char* Name    = nullptr;
+        int64_t     BeginNs = 0;
+        int64_t     EndNs   = 0;
+        /// @brief Timeline::THREAD_TRACK for the recording thread, index of a track added with Timeline::AddTrack() otherwise
+        uint32_t Track = 0;
+    };
+
+    /// @brief Process wide recorder of timed spans (host scopes, device timestamps), exported as Chrome trace JSON (chrome://tracing, Perfetto)
+    /// @details Recording is lock-free: every thread appends to its own chunked buffer and publishes the event count with a release store, buffers
+    /// are registered in an atomic list on the first event of a thread. Chunks are kept until the process exits, so the exporter may read while
+    /// threads keep recording. While disabled, a TimelineScope costs one relaxed atomic load.
+    class Timeline
+    {
+      public:
+        static constexpr uint32_t THREAD_TRACK = UINT32_MAX;
+
+        ~Timeline();
+
+        /// @brief Process wide timeline
+        static Timeline& Shared();
+
+        /// @param maxEventsPerThread Events a thread records at most, further events are dropped and counted
+        void        Enable(uint32_t maxEventsPerThread = 1u << 20);
+        void        Disable();
+        inline bool IsEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+        /// @brief Nanoseconds since the timeline was created (steady clock)
+        int64_t Now() const;
+
+        /// @brief Appends an event to the buffer of the calling thread. Does nothing while disabled
+        void AddEvent(const char* name, int64_t beginNs, int64_t endNs, uint32_t track = THREAD_TRACK);
+
+        /// @brief Names the calling thread in the export. name must outlive the timeline (static or interned)
+        void SetThreadName(const char* name);
+        /// @brief Adds a track not bound to a thread (e.g. a device queue). Locks, call during initialization
+        /// @return Track index for AddEvent()
+        uint32_t AddTrack(std::string_view name);
+        /// @brief Returns a copy of name living as long as the timeline. Locks, call during initialization
+        const char* InternName(std::string_view name);
+
+        /// @brief Writes all events recorded so far as Chrome trace JSON. Host threads are grouped as process "Host", tracks as process "Device"
+        bool WriteChromeTrace(const std::string& utf8path);
+
+        uint64_t GetDroppedEvents() const;
+
+      protected:
+        Timeline();
+
+        struct Chunk
+        {
+            static constexpr uint32_t CAPACITY = 4096;
+
+            TimelineEvent         Events[CAPACITY];
+            std::atomic<uint32_t> Count = 0;
+            std::atomic<Chunk*>   Next  = nullptr;
+        };
+
+        struct ThreadBuffer
+        {
+            Chunk* First = nullptr;
+            /// @brief Chunk currently written (owning thread only)
+            Chunk*                   Last       = nullptr;
+            uint32_t                 ChunkCount = 0;
+            uint32_t                 Index      = 0;
+            std::atomic<const char*> Name       = nullptr;
+            std::atomic<uint64_t>    Dropped    = 0;
+            ThreadBuffer*            Next       = nullptr;
+        };
+
+        /// @brief Buffer of the calling thread, registered on first use
+        ThreadBuffer* GetThreadBuffer();
+
+        /// @brief Buffer of the calling thread (there only is the shared timeline)
+        static thread_local ThreadBuffer* sThreadBuffer;
+        /// @brief Name set with SetThreadName(), possibly before the thread recorded its first event
+        static thread_local const char* sThreadName;
+
+        std::atomic<bool>          mEnabled            = false;
+        std::atomic<uint32_t>      mMaxChunksPerThread = 0;
+        std::atomic<ThreadBuffer*> mBuffers            = nullptr;
+        std::atomic<uint32_t>      mThreadCount        = 0;
+        int64_t                    mOriginNs           = 0;
+        std::mutex                 mNamesMutex;
+        std::set<std::string>      mNames;
+        std::vector<const char*>   mTracks;
+    };
+
+    /// @brief Records the lifetime of the scope as event on the calling thread's track
+    class TimelineScope
+    {
+      public:
+        /// @param name Static or interned string
+        explicit TimelineScope(const char* name)
+        {
+            Timeline& timeline = Timeline::Shared();
+            if(timeline.IsEnabled())
+            {
+                mName    = name;
+                mBeginNs = timeline.Now();
+            }
+        }
+        ~TimelineScope()
+        {
+            if(!!mName)
+            {
+                Timeline& timeline = Timeline::Shared();
+                timeline.AddEvent(mName, mBeginNs, timeline.Now());
+            }
+        }
+
+        TimelineScope(const TimelineScope&)            = delete;
+        TimelineScope& operator=(const TimelineScope&) = delete;
+
+      protected:
+        const char* mName    = nullptr;
+        int64_t     mBeginNs = 0;
+    };
+
+}  // namespace denoise::util
@@ -0,0 +1,131 @@
+#include "testing.hpp"
+#include "util/aliastable.hpp"
+#include <random>
+
+using namespace denoise;
+
+namespace {
+    /// @brief Probability of SampleAliasTable() drawing each index, computed exactly from the slots
+    std::vector<double> lTableProbabilities(const std::vector<util::AliasEntry>& table)
+    {
+        std::vector<double> probabilities(table.size(), 0.0);
+        for(uint32_t slot = 0; slot < table.size(); slot++)
+        {
+            double threshold = table[slot].Threshold < 1.f ? table[slot].Threshold : 1.0;
+            probabilities[slot] += threshold / table.size();
+            probabilities[table[slot].Alias] += (1.0 - threshold) / table.size();
+        }
+        return probabilities;
+    }
+
+    /// @brief Builds the table and checks both the exact probabilities of its slots and the frequencies of stratified samples against the weights
+    void lCheckTable(const std::vector<float>& weights)
+    {
+        const uint32_t count = static_cast<uint32_t>(weights.size());
+        double         total = 0.0;
+        for(float weight : weights)
+        {
+            total += weight > 0.f ? weight : 0.f;
+        }
+        std::vector<double> expected(count);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            expected[i] = total > 0.0 ? (weights[i] > 0.f ? weights[i] : 0.f) / total : 1.0 / count;
+        }
+
+        std::vector<util::AliasEntry> table(count);
+        TEST_CHECK_NEAR(util::BuildAliasTable(weights.data(), count, table.data()), total, total * 1e-12);
+
+        std::vector<double> probabilities = lTableProbabilities(table);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            TEST_CHECK(table[i].Alias < count);
+            TEST_CHECK(table[i].Threshold >= 0.f);
+            TEST_CHECK_NEAR(table[i].Pdf, expected[i], 1e-6 * expected[i]);
+            TEST_CHECK_NEAR(probabilities[i], expected[i], 1e-5 * expected[i] + 1e-9);  // Thresholds are floats
+            if(expected[i] == 0.0)
+            {
+                TEST_CHECK(probabilities[i] == 0.0);
+            }
+        }
+
+        // Stratified over [0, 1): every slot gets the same number of samples. Each slot contributes at most one sample of error to a bin, plus
+        // the rounding of the float random number scaled by count
+        const uint32_t        samplesPerSlot = 4096;
+        const uint64_t        sampleCount    = static_cast<uint64_t>(count) * samplesPerSlot;
+        const double          slotError      = (1.0 / samplesPerSlot + count * std::ldexp(1.0, -23)) / count;
+        std::vector<uint64_t> histogram(count, 0);
+        std::vector<uint32_t> contributingSlots(count, 1);
+        for(uint32_t slot = 0; slot < count; slot++)
+        {
+            contributingSlots[table[slot].Alias] += table[slot].Alias != slot ? 1 : 0;
+        }
+        for(uint64_t i = 0; i < sampleCount; i++)
+        {
+            float random = static_cast<float>((static_cast<double>(i) + 0.5) / sampleCount);
+            histogram[util::SampleAliasTable(table.data(), count, random)]++;
+        }
+        for(uint32_t i = 0; i < count; i++)
+        {
+            TEST_CHECK_NEAR(static_cast<double>(histogram[i]) / sampleCount, expected[i], (contributingSlots[i] + 1.0) * slotError);
+            if(expected[i] == 0.0)
+            {
+                TEST_CHECK(histogram[i] == 0);
+            }
+        }
+    }
+
+    void SingleBin()
+    {
+        lCheckTable({3.5f});
+        lCheckTable({0.f});
+    }
+
+    void AllEqualWeights()
+    {
+        for(uint32_t count : {2u, 3u, 7u, 64u, 1000u})
+        {
+            lCheckTable(std::vector<float>(count, 0.25f));
+        }
+    }
+
+    void ZeroWeights()
+    {
+        lCheckTable({0.f, 1.f, 0.f, 0.f, 2.f, 0.f});
+        lCheckTable({0.f, 0.f, 0.f, 5.f});
+        lCheckTable({1.f, 0.f, -2.f, 1.f});  // Negative weights count as zero
+        lCheckTable(std::vector<float>(16, 0.f));  // Nothing to sample by weight, the table is uniform
+
+        std::vector<float> sparse(997, 0.f);
+        for(size_t i = 0; i < sparse.size(); i += 31)
+        {
+            sparse[i] = static_cast<float>(i % 7 + 1);
+        }
+        lCheckTable(sparse);
+    }
+
+    void SkewedWeights()
+    {
+        lCheckTable({1000.f, 1.f, 1.f, 1.f});
+        lCheckTable({1.f, 1.f, 1.f, 1e6f, 1.f});
+        lCheckTable({1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f});
+
+        // Log-normal weights spanning several orders of magnitude, like the texels of an HDR environment map
+        std::mt19937                       random(7);
+        std::lognormal_distribution<float> distribution(0.f, 2.f);
+        for(uint32_t count : {5u, 100u, 4096u})
+        {
+            std::vector<float> weights(count);
+            for(float& weight : weights)
+            {
+                weight = distribution(random);
+            }
+            lCheckTable(weights);
+        }
+    }
+}  // namespace
+
+int main()
+{
+    return test::RunTests({{"SingleBin", SingleBin}, {"AllEqualWeights", AllEqualWeights}, {"ZeroWeights", ZeroWeights}, {"SkewedWeights", SkewedWeights}});
+}
@@ -0,0 +1,136 @@
+#include "bench/benchstatistics.hpp"
+#include "testing.hpp"
+#include <algorithm>
+#include <random>
+
+using namespace denoise;
+
+namespace {
+    void MedianOfOddAndEvenSizes()
+    {
+        std::vector<double> empty;
+        TEST_CHECK(bench::Median(empty) == 0.0);
+        std::vector<double> single{4.5};
+        TEST_CHECK(bench::Median(single) == 4.5);
+        std::vector<double> odd{3.0, 1.0, 2.0};
+        TEST_CHECK(bench::Median(odd) == 2.0);
+        std::vector<double> even{4.0, 1.0, 3.0, 2.0};
+        TEST_CHECK(bench::Median(even) == 2.5);
+        std::vector<double> pair{7.0, -1.0};
+        TEST_CHECK(bench::Median(pair) == 3.0);
+        std::vector<double> tiedEven{5.0, 1.0, 5.0, 1.0};
+        TEST_CHECK(bench::Median(tiedEven) == 3.0);
+        std::vector<double> tiedOdd{2.0, 2.0, 9.0, 2.0, -4.0};
+        TEST_CHECK(bench::Median(tiedOdd) == 2.0);
+
+        // Against sorting, for every size up to 64
+        std::mt19937                           random(5);
+        std::uniform_real_distribution<double> distribution(-10.0, 10.0);
+        for(size_t size = 1; size <= 64; size++)
+        {
+            std::vector<double> values(size);
+            for(double& value : values)
+            {
+                value = distribution(random);
+            }
+            std::vector<double> sorted(values);
+            std::sort(sorted.begin(), sorted.end());
+            double expected = size % 2 == 1 ? sorted[size / 2] : (sorted[size / 2 - 1] + sorted[size / 2]) * 0.5;
+            TEST_CHECK(bench::Median(values) == expected);
+        }
+    }
+
+    void RemovesOnlyOutliers()
+    {
+        std::vector<double> values{10.0, 10.2, 9.9, 10.1, 9.8, 10.0, 10.3, 9.7, 10.1, 25.0, -3.0};
+        TEST_CHECK(bench::RemoveOutliers(values, 5.0) == 2);
+        TEST_CHECK(values.size() == 9);
+        TEST_CHECK(std::none_of(values.begin(), values.end(), [](double value) { return value == 25.0 || value == -3.0; }));
+        // The first removal leaves nothing that far out
+        TEST_CHECK(bench::RemoveOutliers(values, 5.0) == 0);
+
+        // More than half of the values tied: the MAD is 0 and nothing is removed
+        std::vector<double> tied{1.0, 1.0, 1.0, 1.0, 2.0, 100.0};
+        TEST_CHECK(bench::RemoveOutliers(tied, 5.0) == 0);
+        TEST_CHECK(tied.size() == 6);
+
+        std::vector<double> empty;
+        TEST_CHECK(bench::RemoveOutliers(empty, 5.0) == 0);
+    }
+
+    void MannWhitneyKnownPValues()
+    {
+        // Complete separation, U = 0 (R: wilcox.test(1:5, 6:10, exact = FALSE) gives 0.01219)
+        TEST_CHECK_NEAR(bench::MannWhitneyPValue({1, 2, 3, 4, 5}, {6, 7, 8, 9, 10}), 0.0121857804, 1e-9);
+        TEST_CHECK_NEAR(bench::MannWhitneyPValue({6, 7, 8, 9, 10}, {1, 2, 3, 4, 5}), 0.0121857804, 1e-9);
+        // Interleaved, no ties: U = 6 of 16
+        TEST_CHECK_NEAR(bench::MannWhitneyPValue({1.1, 2.2, 3.3, 4.4}, {1.5, 2.5, 3.5, 4.5}), 0.6650055421, 1e-9);
+        // Tied samples: average ranks, U = 3, tie corrected variance 10.857
+        TEST_CHECK_NEAR(bench::MannWhitneyPValue({1, 2, 2, 3}, {2, 3, 3, 4}), 0.1720337089, 1e-9);
+        TEST_CHECK_NEAR(bench::MannWhitneyPValue({1, 2, 2, 3, 3, 3}, {2, 3, 3, 4, 4, 5, 5}), 0.0453521914, 1e-9);
+
+        // Identical samples, all values tied, and empty samples never reject
+        TEST_CHECK_NEAR(bench::MannWhitneyPValue({1, 2, 3}, {1, 2, 3}), 1.0, 1e-12);
+        TEST_CHECK(bench::MannWhitneyPValue({4, 4, 4}, {4, 4}) == 1.0);
+        TEST_CHECK(bench::MannWhitneyPValue({}, {1, 2}) == 1.0);
+
+        // Benchmark sized samples: a 1% shift on 2% noise is detected, noise alone is not
+        std::mt19937                     random(11);
+        std::normal_distribution<double> noise(10.0, 0.2);
+        std::vector<double>              baseline(2000), same(2000), shifted(2000);
+        for(size_t i = 0; i < baseline.size(); i++)
+        {
+            baseline[i] = noise(random);
+            same[i]     = noise(random);
+            shifted[i]  = noise(random) + 0.1;
+        }
+        TEST_CHECK(bench::MannWhitneyPValue(baseline, shifted) < 1e-6);
+        TEST_CHECK(bench::MannWhitneyPValue(baseline, same) > 0.01);
+    }
+
+    void BootstrapIntervalCoversDelta()
+    {
+        std::mt19937                     random(3);
+        std::normal_distribution<double> noise(20.0, 0.5);
+        std::vector<double>              baseline(501), candidate(501);
+        for(size_t i = 0; i < baseline.size(); i++)
+        {
+            baseline[i]  = noise(random);
+            candidate[i] = noise(random) * 1.1;
+        }
+        double low  = 0.0;
+        double high = 0.0;
+        bench::BootstrapMedianDelta(baseline, candidate, 1000, 0.95, 1, low, high);
+        TEST_CHECK(low > 0.05 && low <= 0.1);
+        TEST_CHECK(high >= 0.1 && high < 0.15);
+
+        // Deterministic per seed, and a lower confidence gives a nested interval
+        double lowAgain  = 0.0;
+        double highAgain = 0.0;
+        bench::BootstrapMedianDelta(baseline, candidate, 1000, 0.95, 1, lowAgain, highAgain);
+        TEST_CHECK(lowAgain == low && highAgain == high);
+        double lowNarrow  = 0.0;
+        double highNarrow = 0.0;
+        bench::BootstrapMedianDelta(baseline, candidate, 1000, 0.5, 1, lowNarrow, highNarrow);
+        TEST_CHECK(low <= lowNarrow && lowNarrow <= highNarrow && highNarrow <= high);
+
+        // Constant samples leave no uncertainty, odd and even sizes
+        bench::BootstrapMedianDelta({2, 2, 2}, {3, 3, 3, 3}, 200, 0.95, 1, low, high);
+        TEST_CHECK_NEAR(low, 0.5, 1e-12);
+        TEST_CHECK_NEAR(high, 0.5, 1e-12);
+
+        // Nothing to compare: empty samples or a zero baseline median
+        bench::BootstrapMedianDelta({}, {1, 2}, 200, 0.95, 1, low, high);
+        TEST_CHECK(low == 0.0 && high == 0.0);
+        bench::BootstrapMedianDelta({0, 0, 0}, {1, 2}, 200, 0.95, 1, low, high);
+        TEST_CHECK(low == 0.0 && high == 0.0);
+    }
+}  // namespace
+
+int main()
+{
+    return test::RunTests({{"MedianOfOddAndEvenSizes", MedianOfOddAndEvenSizes},
+                           {"RemovesOnlyOutliers", RemovesOnlyOutliers},
+                           {"MannWhitneyKnownPValues", MannWhitneyKnownPValues},
+                           {"BootstrapIntervalCoversDelta", BootstrapIntervalCoversDelta}});
+}
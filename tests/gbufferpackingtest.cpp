@@ -0,0 +1,392 @@
+#include "cpu/cpuimage.hpp"
+#include "cpu/cpuscene.hpp"
+#include "cpu/packedgbuffer.hpp"
+#include "testing.hpp"
+#include "util/gbufferpacking.hpp"
+#include "util/half.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <random>
+#include <thread>
+
+using namespace denoise;
+
+namespace {
+    constexpr double DEGREES = 180.0 / 3.14159265358979323846;
+
+    /// @brief Runs body(begin, end) over [0, count) split across all hardware threads. Exhaustive sweeps would take minutes on one
+    template <typename Body>
+    void lParallelRange(uint64_t count, Body&& body)
+    {
+        uint32_t                 threadCount = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> threads;
+        for(uint32_t i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back([&, i]() { body(count * i / threadCount, count * (i + 1) / threadCount); });
+        }
+        for(std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    /// @brief Lock free maximum of doubles (non-negative values compare like their bit patterns)
+    void lAtomicMax(std::atomic<uint64_t>& maximum, double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        uint64_t current = maximum.load();
+        while(bits > current && !maximum.compare_exchange_weak(current, bits))
+        {
+        }
+    }
+
+    double lLoad(const std::atomic<uint64_t>& maximum)
+    {
+        uint64_t bits = maximum.load();
+        double   value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    /// @brief Squared sine of the angle between two unit vectors, negated if they point apart (cheap enough for 2^32 evaluations)
+    double lSinAngleSquared(const float a[3], const float b[3])
+    {
+        double dot    = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+        double crossX = (double)a[1] * b[2] - (double)a[2] * b[1];
+        double crossY = (double)a[2] * b[0] - (double)a[0] * b[2];
+        double crossZ = (double)a[0] * b[1] - (double)a[1] * b[0];
+        double sine2  = crossX * crossX + crossY * crossY + crossZ * crossZ;
+        return dot > 0.0 ? sine2 : -1.0;
+    }
+
+    double lAngleDegrees(const float a[3], const float b[3])
+    {
+        double dot = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+        return std::atan2(std::sqrt(std::max(lSinAngleSquared(a, b), 0.0)), dot) * DEGREES;
+    }
+
+    /// @brief Angle of the largest lSinAngleSquared(), 180 degrees if any pair pointed apart
+    double lToDegrees(double maxSine2, bool apart) { return apart ? 180.0 : std::asin(std::sqrt(maxSine2)) * DEGREES; }
+
+    void OctNormalDecodesEveryCode()
+    {
+        // Every 2x16 bit code decodes to a unit vector, which encodes to a code decoding within the error bound again
+        std::atomic<uint64_t> maxLengthError{0};
+        std::atomic<uint64_t> maxSine2{0};
+        std::atomic<bool>     apart{false};
+        lParallelRange(uint64_t(1) << 32, [&](uint64_t begin, uint64_t end) {
+            double lengthError = 0.0;
+            double sine2       = 0.0;
+            for(uint64_t code = begin; code < end; code++)
+            {
+                float normal[3];
+                util::UnpackOctNormal(static_cast<uint32_t>(code), normal);
+                double length = std::sqrt((double)normal[0] * normal[0] + (double)normal[1] * normal[1] + (double)normal[2] * normal[2]);
+                lengthError   = std::max(lengthError, std::abs(length - 1.0));
+                float decoded[3];
+                util::UnpackOctNormal(util::PackOctNormal(normal), decoded);
+                double pairSine2 = lSinAngleSquared(normal, decoded);
+                if(pairSine2 < 0.0)
+                {
+                    apart = true;
+                }
+                sine2 = std::max(sine2, pairSine2);
+            }
+            lAtomicMax(maxLengthError, lengthError);
+            lAtomicMax(maxSine2, sine2);
+        });
+        double maxAngle = lToDegrees(lLoad(maxSine2), apart.load());
+        std::printf("  octahedral codes: max |length - 1| %.3g, max re-encode angle %.5f degrees\n", lLoad(maxLengthError), maxAngle);
+        TEST_CHECK(lLoad(maxLengthError) < 1e-6);
+        TEST_CHECK(maxAngle < 0.005);
+    }
+
+    void OctNormalEncodeError()
+    {
+        // Dense spiral over the sphere plus the directions where the octahedral map folds
+        std::vector<std::array<float, 3>> normals;
+        const uint32_t                    spiralCount = 1u << 22;
+        for(uint32_t i = 0; i < spiralCount; i++)
+        {
+            double z   = 1.0 - 2.0 * (i + 0.5) / spiralCount;
+            double r   = std::sqrt(std::max(0.0, 1.0 - z * z));
+            double phi = i * 2.39996322972865332;
+            normals.push_back({(float)(r * std::cos(phi)), (float)(r * std::sin(phi)), (float)z});
+        }
+        for(int x = -1; x <= 1; x++)
+        {
+            for(int y = -1; y <= 1; y++)
+            {
+                for(int z = -1; z <= 1; z++)
+                {
+                    if(x != 0 || y != 0 || z != 0)
+                    {
+                        float length = std::sqrt((float)(x * x + y * y + z * z));
+                        normals.push_back({x / length, y / length, z / length});
+                    }
+                }
+            }
+        }
+
+        double maxAngle = 0.0;
+        for(const auto& normal : normals)
+        {
+            float decoded[3];
+            util::UnpackOctNormal(util::PackOctNormal(normal.data()), decoded);
+            maxAngle = std::max(maxAngle, lAngleDegrees(normal.data(), decoded));
+        }
+        std::printf("  %zu normals: max encode angle %.5f degrees\n", normals.size(), maxAngle);
+        TEST_CHECK(maxAngle < 0.005);
+
+        // Zero vectors (no surface) encode as +z
+        const float zero[3] = {0.f, 0.f, 0.f};
+        float       decoded[3];
+        util::UnpackOctNormal(util::PackOctNormal(zero), decoded);
+        TEST_CHECK(decoded[0] == 0.f && decoded[1] == 0.f && decoded[2] == 1.f);
+    }
+
+    void HalfRoundTripsEveryCode()
+    {
+        uint32_t mismatches = 0;
+        for(uint32_t code = 0; code < 0x10000; code++)
+        {
+            uint16_t half  = static_cast<uint16_t>(code);
+            float    value = util::HalfToFloat(half);
+            bool     nan   = (half & 0x7C00u) == 0x7C00u && (half & 0x3FFu) != 0;
+            if(nan)
+            {
+                // NaN payloads are not kept, NaN stays NaN
+                uint16_t back = util::FloatToHalf(value);
+                mismatches += std::isnan(value) && (back & 0x7C00u) == 0x7C00u && (back & 0x3FFu) != 0 ? 0 : 1;
+                continue;
+            }
+            mismatches += util::FloatToHalf(value) == half ? 0 : 1;
+        }
+        TEST_CHECK(mismatches == 0);
+        TEST_CHECK(util::HalfToFloat(0x3C00u) == 1.f);
+        TEST_CHECK(util::HalfToFloat(0x7BFFu) == 65504.f);
+        TEST_CHECK(util::HalfToFloat(0x0001u) == std::ldexp(1.f, -24));
+        TEST_CHECK(std::isinf(util::HalfToFloat(0xFC00u)) && util::HalfToFloat(0xFC00u) < 0.f);
+    }
+
+    void FloatToHalfRoundsEveryFloat()
+    {
+        // Every float converts to the nearest binary16 value (ties to even), overflowing to infinity past 65520 like IEEE 754 rounding
+        std::atomic<uint64_t> failures{0};
+        lParallelRange(uint64_t(1) << 32, [&](uint64_t begin, uint64_t end) {
+            uint64_t localFailures = 0;
+            for(uint64_t bits = begin; bits < end; bits++)
+            {
+                uint32_t floatBits = static_cast<uint32_t>(bits);
+                float    value;
+                std::memcpy(&value, &floatBits, sizeof(value));
+                uint16_t half      = util::FloatToHalf(value);
+                uint16_t magnitude = half & 0x7FFFu;
+                if(std::isnan(value))
+                {
+                    localFailures += (magnitude & 0x7C00u) == 0x7C00u && (magnitude & 0x3FFu) != 0 ? 0 : 1;
+                    continue;
+                }
+                if((half & 0x8000u) != ((floatBits >> 16) & 0x8000u))
+                {
+                    localFailures++;
+                    continue;
+                }
+                double absolute = std::abs((double)value);
+                if(absolute >= 65520.0)
+                {
+                    localFailures += magnitude == 0x7C00u ? 0 : 1;
+                    continue;
+                }
+                if(magnitude > 0x7BFFu)
+                {
+                    localFailures++;
+                    continue;
+                }
+                double error = std::abs(absolute - util::HalfToFloat(magnitude));
+                for(int step : {-1, 1})
+                {
+                    int neighbour = magnitude + step;
+                    if(neighbour < 0 || neighbour > 0x7BFF)
+                    {
+                        continue;
+                    }
+                    double neighbourError = std::abs(absolute - util::HalfToFloat(static_cast<uint16_t>(neighbour)));
+                    if(neighbourError < error || (neighbourError == error && (magnitude & 1u) != 0))
+                    {
+                        localFailures++;
+                    }
+                }
+            }
+            failures += localFailures;
+        });
+        TEST_CHECK(failures.load() == 0);
+    }
+
+    /// @brief Fills a frame with surfaces at random depths along the camera rays of rayDirection(u, v) (view depth 1), every 7th pixel background
+    template <typename RayFunction>
+    void lFillFrame(cpu::CpuFrame& frame, const cpu::Vec3& origin, RayFunction&& rayDirection, std::vector<cpu::Vec3>& positions)
+    {
+        const uint32_t width  = frame.Primary.Width;
+        const uint32_t height = frame.Primary.Height;
+        for(cpu::CpuImage* image : {&frame.Normal, &frame.Position, &frame.Motion})
+        {
+            image->Resize(width, height);
+        }
+        frame.MeshInstanceId.Resize(width, height);
+        positions.assign((size_t)width * height, cpu::Vec3{});
+
+        std::mt19937                          random(7);
+        std::uniform_real_distribution<float> depths(0.05f, 2000.f);
+        std::uniform_real_distribution<float> motions(-0.5f, 0.5f);
+        const uint32_t                        ids[] = {0u, 1u, (1u << 24) + 1u, 0x7FFFFFFFu, 0xFFFFFFFEu};
+        for(uint32_t y = 0; y < height; y++)
+        {
+            for(uint32_t x = 0; x < width; x++)
+            {
+                size_t index      = (size_t)y * width + x;
+                bool   background = index % 7 == 3;
+                float* normal     = frame.Normal.At(x, y);
+                float* position   = frame.Position.At(x, y);
+                float* motion     = frame.Motion.At(x, y);
+                if(!background)
+                {
+                    cpu::Vec3 hit    = origin + rayDirection((x + 0.5f) / width, (y + 0.5f) / height) * depths(random);
+                    positions[index] = hit;
+                    cpu::Vec3 facing = cpu::Normalize(origin - hit);
+                    std::copy_n(&hit.x, 3, position);
+                    std::copy_n(&facing.x, 3, normal);
+                }
+                motion[0]                     = motions(random);
+                motion[1]                     = motions(random);
+                frame.MeshInstanceId.At(x, y) = background ? cpu::CpuIdImage::NO_ID : ids[index % 5];
+            }
+        }
+    }
+
+    void lCheckPackedFrame(cpu::CpuFrame frame, const cpu::GBufferCamera& camera, const std::vector<cpu::Vec3>& positions)
+    {
+        const cpu::CpuFrame original = frame;
+        cpu::PackGBuffer(frame, camera);
+        TEST_CHECK(frame.IsGBufferPacked());
+        TEST_CHECK(frame.Normal.IsEmpty() && frame.Position.IsEmpty() && frame.MeshInstanceId.IsEmpty());
+
+        double   maxRelativeError   = 0.0;
+        double   maxNormalAngle     = 0.0;
+        uint32_t motionFailures     = 0;
+        uint32_t idFailures         = 0;
+        uint32_t backgroundFailures = 0;
+        for(uint32_t y = 0; y < frame.GBuffer.Height; y++)
+        {
+            for(uint32_t x = 0; x < frame.GBuffer.Width; x++)
+            {
+                float position[3];
+                float normal[3];
+                float motion[2];
+                frame.GetPosition(x, y, position);
+                frame.GetNormal(x, y, normal);
+                frame.GetMotion(x, y, motion);
+                idFailures += frame.GetMeshInstanceId(x, y) == original.GetMeshInstanceId(x, y) ? 0 : 1;
+                for(int c = 0; c < 2; c++)
+                {
+                    float expected = original.Motion.At(x, y)[c];
+                    motionFailures += std::abs(motion[c] - expected) <= std::abs(expected) * std::ldexp(1.f, -11) + std::ldexp(1.f, -25) ? 0 : 1;
+                }
+
+                const cpu::Vec3& expected       = positions[(size_t)y * frame.GBuffer.Width + x];
+                const float*     expectedNormal = original.Normal.At(x, y);
+                if(expectedNormal[0] == 0.f && expectedNormal[1] == 0.f && expectedNormal[2] == 0.f)
+                {
+                    backgroundFailures += position[0] == 0.f && position[1] == 0.f && position[2] == 0.f && normal[0] == 0.f && normal[1] == 0.f && normal[2] == 0.f ? 0 : 1;
+                    continue;
+                }
+                double distance  = cpu::Length(expected - camera.Origin);
+                double error     = cpu::Length(cpu::Vec3{position[0], position[1], position[2]} - expected);
+                maxRelativeError = std::max(maxRelativeError, error / distance);
+                maxNormalAngle   = std::max(maxNormalAngle, lAngleDegrees(expectedNormal, normal));
+            }
+        }
+        std::printf("  max relative position error %.3g, max normal angle %.5f degrees\n", maxRelativeError, maxNormalAngle);
+        // Float rounding of the stored position, the depth and the rays (positions lie up to 2 km from a camera 40 m off the origin)
+        TEST_CHECK(maxRelativeError < 1e-5);
+        TEST_CHECK(maxNormalAngle < 0.005);
+        TEST_CHECK(motionFailures == 0);
+        TEST_CHECK(idFailures == 0);
+        TEST_CHECK(backgroundFailures == 0);
+    }
+
+    cpu::Mat4 lCameraToWorld()
+    {
+        // Rotated about an oblique axis and moved away from the origin, so every matrix element matters
+        const float rotation[4] = {0.2f, -0.4f, 0.1f, 0.888819f};  // Unit quaternion (x, y, z, w)
+        return cpu::Mat4::FromTrs(cpu::Vec3{12.f, -3.5f, 40.f}, rotation, cpu::Vec3{1.f, 1.f, 1.f});
+    }
+
+    void DepthReconstructsCpuCameraPositions()
+    {
+        cpu::CpuCamera camera{.CameraToWorld = lCameraToWorld(), .YFov = 0.9f};
+        cpu::CpuFrame  frame;
+        frame.Primary.Resize(96, 54);
+        const float aspect     = 96.f / 54.f;
+        const float tanHalfFov = std::tan(camera.YFov * 0.5f);
+        const auto  origin     = camera.CameraToWorld.TransformPoint(cpu::Vec3{});
+
+        // Rays as the path tracer casts them
+        std::vector<cpu::Vec3> positions;
+        lFillFrame(
+            frame, origin,
+            [&](float u, float v) { return camera.CameraToWorld.TransformDirection(cpu::Vec3{(u * 2.f - 1.f) * tanHalfFov * aspect, -(v * 2.f - 1.f) * tanHalfFov, -1.f}); },
+            positions);
+        lCheckPackedFrame(frame, cpu::GBufferCamera::FromCpuCamera(camera, aspect), positions);
+    }
+
+    void DepthReconstructsCapturedPositions()
+    {
+        // glm style matrices as captured: column major view and a Vulkan perspective projection (y flipped, depth 0 to 1, off center by a jitter)
+        cpu::Mat4   cameraToWorld = lCameraToWorld();
+        cpu::Mat4   view          = cameraToWorld.InverseAffine();
+        const float aspect        = 64.f / 48.f;
+        const float tanHalfFov    = std::tan(0.6f);
+        const float nearPlane     = 0.1f;
+        const float farPlane      = 5000.f;
+        cpu::Mat4   projection;
+        projection.At(0, 0) = 1.f / (aspect * tanHalfFov);
+        projection.At(1, 1) = -1.f / tanHalfFov;
+        projection.At(0, 2) = 0.003f;
+        projection.At(1, 2) = -0.002f;
+        projection.At(2, 2) = farPlane / (nearPlane - farPlane);
+        projection.At(3, 2) = -1.f;
+        projection.At(2, 3) = -(farPlane * nearPlane) / (farPlane - nearPlane);
+        projection.At(3, 3) = 0.f;
+
+        cpu::CpuFrame frame;
+        frame.Primary.Resize(64, 48);
+        const auto origin = cameraToWorld.TransformPoint(cpu::Vec3{});
+
+        // Inverse projection of the NDC of the pixel center, like the ray generation shader
+        std::vector<cpu::Vec3> positions;
+        lFillFrame(
+            frame, origin,
+            [&](float u, float v) {
+                float ndcX = u * 2.f - 1.f;
+                float ndcY = v * 2.f - 1.f;
+                return cameraToWorld.TransformDirection(
+                    cpu::Vec3{(ndcX + projection.At(0, 2)) / projection.At(0, 0), (ndcY + projection.At(1, 2)) / projection.At(1, 1), -1.f});
+            },
+            positions);
+        lCheckPackedFrame(frame, cpu::GBufferCamera::FromMatrices(view.m, projection.m), positions);
+    }
+}  // namespace
+
+int main()
+{
+    return test::RunTests({{"OctNormalDecodesEveryCode", OctNormalDecodesEveryCode},
+                           {"OctNormalEncodeError", OctNormalEncodeError},
+                           {"HalfRoundTripsEveryCode", HalfRoundTripsEveryCode},
+                           {"FloatToHalfRoundsEveryFloat", FloatToHalfRoundsEveryFloat},
+                           {"DepthReconstructsCpuCameraPositions", DepthReconstructsCpuCameraPositions},
+                           {"DepthReconstructsCapturedPositions", DepthReconstructsCapturedPositions}});
+}
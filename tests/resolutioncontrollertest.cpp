@@ -0,0 +1,204 @@
+#include "bench/csvcells.hpp"
+#include "bench/resolutioncontroller.hpp"
+#include "testing.hpp"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <string>
+
+using namespace denoise;
+
+namespace {
+    constexpr float TARGET_MS = 16.667f;
+
+    /// @brief Frame times of a trace (--frame-time-trace CSV: scale, device_ms per frame), converted to full resolution
+    std::vector<float> lLoadTrace(const char* name)
+    {
+        std::vector<float> fullScaleMs;
+        std::ifstream      file(std::string(TEST_DATA_DIR "/frametimes/") + name);
+        std::string        line;
+        while(std::getline(file, line))
+        {
+            float values[2] = {0.f, 0.f};
+            bench::ForEachCsvCell(bench::TrimCsvLine(line), [&values](size_t index, std::string_view cell) {
+                if(index < 2)
+                {
+                    std::from_chars(cell.data(), cell.data() + cell.size(), values[index]);
+                }
+            });
+            // Comments and the header parse as 0
+            if(values[0] > 0.f && values[1] > 0.f)
+            {
+                fullScaleMs.push_back(values[1] / (values[0] * values[0]));
+            }
+        }
+        TEST_CHECK(!fullScaleMs.empty());
+        return fullScaleMs;
+    }
+
+    /// @brief Levels per frame of a closed loop replay
+    struct Replay
+    {
+        std::vector<uint32_t> Levels;
+        std::vector<float>    FrameMs;
+        uint64_t              LevelChanges = 0;
+
+        /// @brief Fraction of the frames in [begin, end) rendered at level
+        double Share(uint32_t level, size_t begin, size_t end) const
+        {
+            return static_cast<double>(std::count(Levels.begin() + begin, Levels.begin() + end, level)) / (end - begin);
+        }
+        /// @brief Level changes between the frames in [begin, end)
+        uint32_t Changes(size_t begin, size_t end) const
+        {
+            uint32_t changes = 0;
+            for(size_t i = std::max<size_t>(begin, 1); i < end; i++)
+            {
+                changes += Levels[i] != Levels[i - 1] ? 1 : 0;
+            }
+            return changes;
+        }
+    };
+
+    /// @brief Feeds the trace through the controller. Frame time scales with the pixel count of the level a frame was recorded at, frames finish
+    /// (and are fed to the controller) framesInFlight frames after they were recorded
+    Replay lReplay(const std::vector<float>& fullScaleMs, const bench::ResolutionControllerConfig& config, uint32_t framesInFlight = 2)
+    {
+        bench::ResolutionController controller;
+        controller.Init(config);
+        Replay                replay;
+        std::vector<uint32_t> recordedLevels(framesInFlight + 1);
+        for(size_t frame = 0; frame < fullScaleMs.size() + framesInFlight; frame++)
+        {
+            recordedLevels[frame % recordedLevels.size()] = controller.GetLevel();
+            if(frame < framesInFlight)
+            {
+                continue;
+            }
+            size_t   finished = frame - framesInFlight;
+            uint32_t level    = recordedLevels[finished % recordedLevels.size()];
+            float    scale    = config.MinScale + (config.MaxScale - config.MinScale) * level / (config.LevelCount - 1);
+            float    frameMs  = fullScaleMs[finished] * scale * scale;
+            replay.Levels.push_back(level);
+            replay.FrameMs.push_back(frameMs);
+            controller.Update(frameMs);
+        }
+        replay.LevelChanges = controller.GetLevelChanges();
+        return replay;
+    }
+
+    /// @brief Highest level whose frame time at the average load of [begin, end) meets the target
+    uint32_t lIdealLevel(const std::vector<float>& fullScaleMs, size_t begin, size_t end, const bench::ResolutionControllerConfig& config)
+    {
+        double mean = 0.0;
+        for(size_t i = begin; i < end; i++)
+        {
+            mean += fullScaleMs[i] / (end - begin);
+        }
+        uint32_t level = 0;
+        for(uint32_t candidate = 0; candidate < config.LevelCount; candidate++)
+        {
+            float scale = config.MinScale + (config.MaxScale - config.MinScale) * candidate / (config.LevelCount - 1);
+            level       = mean * scale * scale <= config.TargetFrameMs ? candidate : level;
+        }
+        return level;
+    }
+
+    void SettlesAtTargetLevel()
+    {
+        // 24 ms at full resolution: 80% scale (15.4 ms) is the highest level within 16.67 ms. Hitches of up to 3.5x do not cause a step down
+        bench::ResolutionControllerConfig config{.TargetFrameMs = TARGET_MS};
+        std::vector<float>                trace  = lLoadTrace("steady.csv");
+        Replay                            replay = lReplay(trace, config);
+        uint32_t                          ideal  = lIdealLevel(trace, 0, trace.size(), config);
+        TEST_CHECK(ideal == 3);
+        TEST_CHECK(replay.Share(ideal, 300, trace.size()) >= 0.97);
+        TEST_CHECK(*std::min_element(replay.Levels.begin() + 100, replay.Levels.end()) == ideal);
+        // Every visit of the level above is a probe: it is left within a few frames
+        TEST_CHECK(replay.Share(ideal + 1, 300, trace.size()) <= 0.02);
+    }
+
+    void BoundsOscillation()
+    {
+        // 21.5 ms at full resolution: the 90% level just misses the target (17.4 ms), the 80% level undershoots it (13.8 ms). The controller
+        // output sits between them, only the backoff keeps it from switching every few frames
+        bench::ResolutionControllerConfig config{.TargetFrameMs = TARGET_MS};
+        std::vector<float>                trace  = lLoadTrace("betweenlevels.csv");
+        Replay                            replay = lReplay(trace, config);
+        uint32_t                          ideal  = lIdealLevel(trace, 0, trace.size(), config);
+        TEST_CHECK(ideal == 3);
+        TEST_CHECK(replay.LevelChanges <= 20);
+        TEST_CHECK(replay.Changes(500, trace.size()) <= 10);
+        TEST_CHECK(replay.Share(ideal, 500, trace.size()) >= 0.97);
+        TEST_CHECK(*std::min_element(replay.Levels.begin() + 100, replay.Levels.end()) == ideal);
+
+        bench::ResolutionControllerConfig noBackoff = config;
+        noBackoff.UpBackoffFrames                   = 0;
+        Replay oscillating                          = lReplay(trace, noBackoff);
+        TEST_CHECK(oscillating.LevelChanges > 10 * replay.LevelChanges);
+    }
+
+    void BacksOffExponentially()
+    {
+        // Every failed step up blocks the level above twice as long as the previous one, up to 16 times UpBackoffFrames
+        bench::ResolutionControllerConfig config{.TargetFrameMs = TARGET_MS};
+        std::vector<float>                trace  = lLoadTrace("betweenlevels.csv");
+        Replay                            replay = lReplay(trace, config);
+        uint32_t                          ideal  = lIdealLevel(trace, 0, trace.size(), config);
+        std::vector<size_t>               stepUps;
+        for(size_t i = 100; i < replay.Levels.size(); i++)
+        {
+            if(replay.Levels[i] == ideal + 1 && replay.Levels[i - 1] == ideal)
+            {
+                stepUps.push_back(i);
+            }
+        }
+        TEST_CHECK(stepUps.size() >= 5);
+        const size_t maxBlock = config.UpBackoffFrames * 16;
+        for(size_t i = 1; i < stepUps.size(); i++)
+        {
+            size_t gap = stepUps[i] - stepUps[i - 1];
+            TEST_CHECK(gap >= config.UpBackoffFrames);
+            TEST_CHECK(gap <= maxBlock + 100);
+            if(i >= 2)
+            {
+                size_t previous = stepUps[i - 1] - stepUps[i - 2];
+                TEST_CHECK(gap >= std::min<size_t>(previous * 3 / 2, maxBlock));
+            }
+        }
+        if(stepUps.size() >= 2)
+        {
+            TEST_CHECK(stepUps.back() - stepUps[stepUps.size() - 2] >= maxBlock);
+        }
+    }
+
+    void FollowsLoadChanges()
+    {
+        // 12 ms views fit at full resolution, the 30 ms view between frames 1090 and 2000 at 70% (14.7 ms). A block of the level above from the
+        // heavy view must not hold the controller back once the load drops
+        bench::ResolutionControllerConfig config{.TargetFrameMs = TARGET_MS};
+        std::vector<float>                trace  = lLoadTrace("camerapan.csv");
+        Replay                            replay = lReplay(trace, config);
+        const uint32_t                    top    = config.LevelCount - 1;
+        uint32_t                          heavy  = lIdealLevel(trace, 1090, 2000, config);
+        TEST_CHECK(lIdealLevel(trace, 0, 1000, config) == top);
+        TEST_CHECK(lIdealLevel(trace, 2090, trace.size(), config) == top);
+        TEST_CHECK(heavy == 2);
+
+        TEST_CHECK(replay.Share(top, 0, 1000) == 1.0);
+        TEST_CHECK(replay.Changes(0, 1000) == 0);
+        TEST_CHECK(replay.Levels[1090 + 120] == heavy);
+        TEST_CHECK(replay.Share(heavy, 1210, 2000) >= 0.95);
+        TEST_CHECK(*std::min_element(replay.Levels.begin() + 1000, replay.Levels.begin() + 2000) == heavy);
+        TEST_CHECK(replay.Levels[2090 + 120] == top);
+        TEST_CHECK(replay.Share(top, 2210, trace.size()) == 1.0);
+    }
+}  // namespace
+
+int main()
+{
+    return test::RunTests({{"SettlesAtTargetLevel", SettlesAtTargetLevel},
+                           {"BoundsOscillation", BoundsOscillation},
+                           {"BacksOffExponentially", BacksOffExponentially},
+                           {"FollowsLoadChanges", FollowsLoadChanges}});
+}
@@ -0,0 +1,209 @@
+#include "cpu/samplebudget.hpp"
+#include "testing.hpp"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+using namespace denoise;
+
+namespace {
+    struct Scenario
+    {
+        std::vector<float>    TileError;
+        std::vector<uint32_t> TilePixels;
+    };
+
+    /// @brief Tiles of a width x height image (partial tiles at the right and bottom edges) with log-normal errors, a few of them 0
+    Scenario lMakeScenario(uint32_t width, uint32_t height, uint32_t tileSize, uint32_t seed)
+    {
+        Scenario scenario;
+        cpu::GetTilePixels(width, height, tileSize, scenario.TilePixels);
+        std::mt19937                       random(seed);
+        std::lognormal_distribution<float> errors(0.f, 1.5f);
+        for(size_t i = 0; i < scenario.TilePixels.size(); i++)
+        {
+            scenario.TileError.push_back(i % 11 == 5 ? 0.f : errors(random));
+        }
+        return scenario;
+    }
+
+    uint64_t lSpent(const std::vector<uint32_t>& tileSamples, const std::vector<uint32_t>& tilePixels)
+    {
+        uint64_t spent = 0;
+        for(size_t i = 0; i < tileSamples.size(); i++)
+        {
+            spent += static_cast<uint64_t>(tileSamples[i]) * tilePixels[i];
+        }
+        return spent;
+    }
+
+    void NeverExceedsBudget()
+    {
+        uint32_t checked = 0;
+        for(uint32_t seed = 0; seed < 8; seed++)
+        {
+            Scenario       scenario    = lMakeScenario(333 + seed * 97, 191 + seed * 53, 32, seed);
+            const uint64_t totalPixels = std::accumulate(scenario.TilePixels.begin(), scenario.TilePixels.end(), uint64_t(0));
+            const uint64_t slack       = static_cast<uint64_t>(*std::max_element(scenario.TilePixels.begin(), scenario.TilePixels.end())) * scenario.TilePixels.size();
+            for(uint32_t maxSamples : {1u, 2u, 4u, 8u, 16u})
+            {
+                for(float samplesPerPixel : {1.f, 1.01f, 1.5f, 2.f, 3.3f, 4.f, 7.99f, 8.f, 12.f, 40.f})
+                {
+                    cpu::SampleBudgetConfig config{.SamplesPerPixel = samplesPerPixel, .MinSamples = 1, .MaxSamples = maxSamples};
+                    std::vector<uint32_t>   tileSamples;
+                    cpu::AllocateSamples(scenario.TileError, scenario.TilePixels, config, tileSamples);
+                    const uint64_t budget = static_cast<uint64_t>(samplesPerPixel * static_cast<double>(totalPixels));
+                    const uint64_t spent  = lSpent(tileSamples, scenario.TilePixels);
+                    TEST_CHECK(tileSamples.size() == scenario.TilePixels.size());
+                    TEST_CHECK(spent <= budget);
+                    // Rounding leaves less than one sample per tile unused, unless every tile is saturated
+                    bool saturated = std::all_of(tileSamples.begin(), tileSamples.end(), [maxSamples](uint32_t samples) { return samples == maxSamples; });
+                    TEST_CHECK(saturated || budget - spent < slack);
+                    checked++;
+                }
+            }
+        }
+        TEST_CHECK(checked == 400);
+    }
+
+    void RespectsSampleRange()
+    {
+        Scenario scenario = lMakeScenario(640, 360, 16, 3);
+        for(uint32_t minSamples : {1u, 2u, 3u})
+        {
+            for(uint32_t maxSamples : {3u, 5u, 8u, 64u})
+            {
+                for(float samplesPerPixel : {3.f, 4.5f, 6.f, 100.f})
+                {
+                    cpu::SampleBudgetConfig config{.SamplesPerPixel = samplesPerPixel, .MinSamples = minSamples, .MaxSamples = maxSamples};
+                    std::vector<uint32_t>   tileSamples;
+                    cpu::AllocateSamples(scenario.TileError, scenario.TilePixels, config, tileSamples);
+                    for(uint32_t samples : tileSamples)
+                    {
+                        TEST_CHECK(samples >= minSamples && samples <= maxSamples);
+                    }
+                }
+            }
+        }
+
+        // A budget below the minimum gives every tile the minimum, above the maximum every tile the maximum
+        std::vector<uint32_t> tileSamples;
+        cpu::AllocateSamples(scenario.TileError, scenario.TilePixels, cpu::SampleBudgetConfig{.SamplesPerPixel = 0.5f, .MinSamples = 1, .MaxSamples = 8}, tileSamples);
+        TEST_CHECK(std::all_of(tileSamples.begin(), tileSamples.end(), [](uint32_t samples) { return samples == 1; }));
+        cpu::AllocateSamples(scenario.TileError, scenario.TilePixels, cpu::SampleBudgetConfig{.SamplesPerPixel = 9.f, .MinSamples = 1, .MaxSamples = 8}, tileSamples);
+        TEST_CHECK(std::all_of(tileSamples.begin(), tileSamples.end(), [](uint32_t samples) { return samples == 8; }));
+    }
+
+    void MonotonicInTileError()
+    {
+        // Equally sized tiles: ordering the tiles by error orders their samples the same way
+        for(uint32_t seed = 0; seed < 16; seed++)
+        {
+            Scenario scenario = lMakeScenario(512, 512, 32, 100 + seed);
+            for(float samplesPerPixel : {1.2f, 2.f, 3.7f, 6.f})
+            {
+                std::vector<uint32_t> tileSamples;
+                cpu::AllocateSamples(scenario.TileError, scenario.TilePixels, cpu::SampleBudgetConfig{.SamplesPerPixel = samplesPerPixel, .MinSamples = 1, .MaxSamples = 8},
+                                     tileSamples);
+                std::vector<uint32_t> order(tileSamples.size());
+                std::iota(order.begin(), order.end(), 0u);
+                std::sort(order.begin(), order.end(), [&scenario](uint32_t a, uint32_t b) { return scenario.TileError[a] < scenario.TileError[b]; });
+                uint32_t violations = 0;
+                for(size_t i = 1; i < order.size(); i++)
+                {
+                    violations += tileSamples[order[i]] >= tileSamples[order[i - 1]] ? 0 : 1;
+                }
+                TEST_CHECK(violations == 0);
+                TEST_CHECK(tileSamples[order.front()] < tileSamples[order.back()]);
+            }
+        }
+
+        // Without any error estimate all tiles are treated the same
+        Scenario scenario = lMakeScenario(256, 256, 32, 1);
+        std::fill(scenario.TileError.begin(), scenario.TileError.end(), 0.f);
+        std::vector<uint32_t> tileSamples;
+        cpu::AllocateSamples(scenario.TileError, scenario.TilePixels, cpu::SampleBudgetConfig{.SamplesPerPixel = 3.f, .MinSamples = 1, .MaxSamples = 8}, tileSamples);
+        TEST_CHECK(std::all_of(tileSamples.begin(), tileSamples.end(), [](uint32_t samples) { return samples == 3; }));
+    }
+
+    /// @brief Renders a flat grey image whose per sample noise varies per tile (standard deviation tileSigma), averaging tileSamples samples
+    void lRenderNoise(uint32_t size, uint32_t tileSize, const std::vector<float>& tileSigma, const std::vector<uint32_t>& tileSamples, std::mt19937& random, cpu::CpuImage& out)
+    {
+        const uint32_t                  tilesX = size / tileSize;
+        std::normal_distribution<float> normal(0.f, 1.f);
+        out.Resize(size, size);
+        for(uint32_t y = 0; y < size; y++)
+        {
+            for(uint32_t x = 0; x < size; x++)
+            {
+                size_t tile    = (size_t)(y / tileSize) * tilesX + x / tileSize;
+                float  samples = static_cast<float>(tileSamples[tile]);
+                float  value   = 0.5f + tileSigma[tile] * normal(random) / std::sqrt(samples);
+                float* texel   = out.At(x, y);
+                texel[0] = texel[1] = texel[2] = value;
+                texel[3]                       = 1.f;
+            }
+        }
+    }
+
+    /// @brief Mean squared error of the Reinhard tonemapped luminance against the noise free value
+    double lTonemappedMse(const cpu::CpuImage& image)
+    {
+        const double reference = 0.5 / 1.5;
+        double       sum       = 0.0;
+        for(size_t i = 0; i < image.GetPixelCount(); i++)
+        {
+            double value  = image.Texels[i * 4];
+            double mapped = value / (1.0 + value);
+            sum += (mapped - reference) * (mapped - reference);
+        }
+        return sum / image.GetPixelCount();
+    }
+
+    void AdaptiveBeatsUniformAtEqualBudget()
+    {
+        // The render loop of --adaptive-spp on a synthetic image: tiles differ in noise by up to 30x. Frame 0 uses the uniform budget, the error
+        // estimated from it drives frame 1. Both frames spend the same budget, the adaptive one has to end up with a lower error.
+        const uint32_t                     size     = 256;
+        const uint32_t                     tileSize = 16;
+        std::mt19937                       random(42);
+        std::vector<float>                 tileSigma;
+        std::lognormal_distribution<float> sigmas(std::log(0.03f), 1.f);
+        for(uint32_t i = 0; i < (size / tileSize) * (size / tileSize); i++)
+        {
+            tileSigma.push_back(std::clamp(sigmas(random), 0.005f, 0.15f));
+        }
+        std::vector<uint32_t> tilePixels;
+        cpu::GetTilePixels(size, size, tileSize, tilePixels);
+
+        for(float samplesPerPixel : {2.f, 4.f})
+        {
+            cpu::SampleBudgetConfig config{.SamplesPerPixel = samplesPerPixel, .MinSamples = 1, .MaxSamples = 16};
+            std::vector<uint32_t>   uniformSamples(tilePixels.size(), static_cast<uint32_t>(samplesPerPixel));
+            cpu::CpuImage           uniform;
+            lRenderNoise(size, tileSize, tileSigma, uniformSamples, random, uniform);
+
+            std::vector<float>    tileError;
+            std::vector<uint32_t> adaptiveSamples;
+            cpu::EstimateTileError(uniform, tileSize, uniformSamples, tileError);
+            cpu::AllocateSamples(tileError, tilePixels, config, adaptiveSamples);
+            cpu::CpuImage adaptive;
+            lRenderNoise(size, tileSize, tileSigma, adaptiveSamples, random, adaptive);
+
+            double uniformMse  = lTonemappedMse(uniform);
+            double adaptiveMse = lTonemappedMse(adaptive);
+            std::printf("  %.0f spp: tonemapped MSE uniform %.4g, adaptive %.4g (%.1f%% lower)\n", samplesPerPixel, uniformMse, adaptiveMse,
+                        (1.0 - adaptiveMse / uniformMse) * 100.0);
+            TEST_CHECK(lSpent(adaptiveSamples, tilePixels) <= lSpent(uniformSamples, tilePixels));
+            TEST_CHECK(adaptiveMse < uniformMse * 0.9);
+        }
+    }
+}  // namespace
+
+int main()
+{
+    return test::RunTests({{"NeverExceedsBudget", NeverExceedsBudget},
+                           {"RespectsSampleRange", RespectsSampleRange},
+                           {"MonotonicInTileError", MonotonicInTileError},
+                           {"AdaptiveBeatsUniformAtEqualBudget", AdaptiveBeatsUniformAtEqualBudget}});
+}
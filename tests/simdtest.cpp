@@ -0,0 +1,132 @@
+#include "testing.hpp"
+#include "util/simd.hpp"
+#include <random>
+
+using namespace denoise;
+
+namespace {
+    /// @brief Covers empty input, pure tails, exact multiples of the AVX2 (8, 16) and NEON (4, 8) blocks and blocks with tails
+    const size_t COUNTS[] = {0, 1, 3, 4, 7, 8, 9, 15, 16, 17, 31, 33, 100, 1023};
+
+    /// @brief Values in [-2, 2], offset by one float so the kernels see unaligned pointers
+    std::vector<float> lRandomValues(size_t count, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> distribution(-2.f, 2.f);
+        std::vector<float>                    values(count + 1);
+        for(float& value : values)
+        {
+            value = distribution(random);
+        }
+        return values;
+    }
+
+    /// @brief The vector paths reassociate the sums and fuse multiply adds: allow a few float roundings per accumulated term
+    double lTolerance(double absoluteSum, size_t terms)
+    {
+        return absoluteSum * (terms + 4) * std::ldexp(1.0, -23) + 1e-30;
+    }
+
+    void Reductions()
+    {
+        std::mt19937 random(1);
+        for(size_t count : COUNTS)
+        {
+            std::vector<float> aValues = lRandomValues(count, random);
+            std::vector<float> bValues = lRandomValues(count, random);
+            const float*       a       = aValues.data() + 1;
+            const float*       b       = bValues.data() + 1;
+
+            double dot = 0.0, dotAbs = 0.0, sum = 0.0, sumAbs = 0.0, distance = 0.0;
+            for(size_t i = 0; i < count; i++)
+            {
+                dot += static_cast<double>(a[i]) * b[i];
+                dotAbs += std::abs(static_cast<double>(a[i]) * b[i]);
+                sum += a[i];
+                sumAbs += std::abs(a[i]);
+                distance += (static_cast<double>(a[i]) - b[i]) * (static_cast<double>(a[i]) - b[i]);
+            }
+            TEST_CHECK_NEAR(util::simd::Dot(a, b, count), dot, lTolerance(dotAbs, count));
+            TEST_CHECK_NEAR(util::simd::Sum(a, count), sum, sumAbs * 1e-12);
+            TEST_CHECK_NEAR(util::simd::SquaredDistance(a, b, count), distance, lTolerance(distance, count));
+        }
+    }
+
+    void ElementWise()
+    {
+        std::mt19937 random(2);
+        for(size_t count : COUNTS)
+        {
+            std::vector<float> xValues = lRandomValues(count, random);
+            std::vector<float> yValues = lRandomValues(count, random);
+            const float*       x       = xValues.data() + 1;
+            float*             y       = yValues.data() + 1;
+            const float        alpha   = -0.7f;
+
+            std::vector<float> axpy(y, y + count);
+            util::simd::Axpy(alpha, x, axpy.data(), count);
+            std::vector<float> scaled(x, x + count);
+            util::simd::Scale(alpha, scaled.data(), count);
+            for(size_t i = 0; i < count; i++)
+            {
+                const double expectedAxpy = y[i] + static_cast<double>(alpha) * x[i];
+                TEST_CHECK_NEAR(axpy[i], expectedAxpy, lTolerance(std::abs(y[i]) + std::abs(alpha * x[i]), 1));
+                TEST_CHECK(scaled[i] == alpha * x[i]);  // A single rounding either way
+            }
+        }
+    }
+
+    void Convolutions()
+    {
+        std::mt19937 random(3);
+        for(size_t taps : {1, 3, 7, 11})
+        {
+            std::vector<float> weights = lRandomValues(taps, random);
+            for(size_t count : COUNTS)
+            {
+                std::vector<float>              srcValues = lRandomValues(count + taps - 1, random);
+                const float*                    src       = srcValues.data() + 1;
+                std::vector<std::vector<float>> rowValues;
+                std::vector<const float*>       rows;
+                for(size_t k = 0; k < taps; k++)
+                {
+                    rowValues.push_back(lRandomValues(count, random));
+                }
+                for(size_t k = 0; k < taps; k++)
+                {
+                    rows.push_back(rowValues[k].data() + 1);
+                }
+
+                std::vector<float> convolved(count), convolvedRows(count);
+                util::simd::Convolve(src, weights.data() + 1, taps, convolved.data(), count);
+                util::simd::ConvolveRows(rows.data(), weights.data() + 1, taps, convolvedRows.data(), count);
+                for(size_t i = 0; i < count; i++)
+                {
+                    double sum = 0.0, sumAbs = 0.0, rowSum = 0.0, rowSumAbs = 0.0;
+                    for(size_t k = 0; k < taps; k++)
+                    {
+                        const double weight = weights[k + 1];
+                        sum += weight * src[i + k];
+                        sumAbs += std::abs(weight * src[i + k]);
+                        rowSum += weight * rows[k][i];
+                        rowSumAbs += std::abs(weight * rows[k][i]);
+                    }
+                    TEST_CHECK_NEAR(convolved[i], sum, lTolerance(sumAbs, taps));
+                    TEST_CHECK_NEAR(convolvedRows[i], rowSum, lTolerance(rowSumAbs, taps));
+                }
+            }
+        }
+    }
+}  // namespace
+
+int main()
+{
+    std::printf("Kernels: %s\n", util::simd::GetInstructionSet());
+#if defined(DENOISE_SIMD_AVX2) && defined(__GNUC__)
+    if(!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("fma"))
+    {
+        std::printf("CPU lacks AVX2 or FMA, skipped\n");
+        return 0;
+    }
+#endif
+    return test::RunTests({{"Reductions", Reductions}, {"ElementWise", ElementWise}, {"Convolutions", Convolutions}});
+}
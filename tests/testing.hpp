@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace denoise::test {
+
+    /// @brief Failed checks of the running test case
+    inline int& FailureCount()
+    {
+        static int sCount = 0;
+        return sCount;
+    }
+
+    inline bool Check(bool condition, const char* expression, const char* file, int line)
+    {
+        if(!condition)
+        {
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+            FailureCount()++;
+        }
+        return condition;
+    }
+
+    inline bool CheckNear(double value, double expected, double tolerance, const char* expression, const char* file, int line)
+    {
+        bool near = std::abs(value - expected) <= tolerance;
+        if(!near)
+        {
+            std::fprintf(stderr, "%s:%d: check failed: %s = %.9g, expected %.9g +- %.3g\n", file, line, expression, value, expected, tolerance);
+            FailureCount()++;
+        }
+        return near;
+    }
+
+    struct TestCase
+    {
+        const char*           Name;
+        std::function<void()> Run;
+    };
+
+    /// @brief Runs all cases, printing the failed checks of each. Returns the process exit code (0 if every check passed)
+    inline int RunTests(const std::vector<TestCase>& cases)
+    {
+        int failedCases = 0;
+        for(const TestCase& testCase : cases)
+        {
+            FailureCount() = 0;
+            testCase.Run();
+            std::printf("[%s] %s\n", FailureCount() == 0 ? "PASS" : "FAIL", testCase.Name);
+            failedCases += FailureCount() == 0 ? 0 : 1;
+        }
+        std::printf("%d of %zu test cases failed\n", failedCases, cases.size());
+        return failedCases == 0 ? 0 : 1;
+    }
+
+}  // namespace denoise::test
+
+/// @brief Records a failure (and continues) if condition is false. Evaluates to condition
+#define TEST_CHECK(condition) denoise::test::Check(!!(condition), #condition, __FILE__, __LINE__)
+/// @brief Records a failure (and continues) if value differs from expected by more than tolerance
+#define TEST_CHECK_NEAR(value, expected, tolerance) denoise::test::CheckNear((value), (expected), (tolerance), #value, __FILE__, __LINE__)
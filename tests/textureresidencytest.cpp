@@ -0,0 +1,282 @@
+#include "assets/textureresidency.hpp"
+#include "testing.hpp"
+#include <numeric>
+#include <random>
+
+using namespace denoise;
+
+namespace {
+    /// @brief Mip byte sizes of a size x size RGBA8 texture with a full mip chain, finest first
+    std::vector<uint64_t> lMipChain(uint32_t size)
+    {
+        std::vector<uint64_t> mipBytes;
+        for(uint32_t extent = size; extent > 0; extent /= 2)
+        {
+            mipBytes.push_back(static_cast<uint64_t>(extent) * extent * 4);
+        }
+        return mipBytes;
+    }
+
+    uint64_t lBytes(const std::vector<uint64_t>& mipBytes, uint32_t firstMip, uint32_t endMip)
+    {
+        return std::accumulate(mipBytes.begin() + firstMip, mipBytes.begin() + endMip, uint64_t(0));
+    }
+
+    /// @brief Mirror of the residency built only from the reported changes, checks that they are consistent with the getters
+    struct Mirror
+    {
+        std::vector<std::vector<uint64_t>> MipBytes;
+        std::vector<uint32_t>              ResidentMip;
+
+        uint32_t Add(assets::TextureResidency& residency, const std::vector<uint64_t>& mipBytes, uint32_t tailMip)
+        {
+            MipBytes.push_back(mipBytes);
+            ResidentMip.push_back(tailMip);
+            return residency.AddTexture(mipBytes, tailMip);
+        }
+
+        /// @return Bytes streamed in by the changes
+        uint64_t Apply(const assets::TextureResidency& residency, const std::vector<assets::ResidencyChange>& changes)
+        {
+            uint64_t streamed = 0;
+            for(const assets::ResidencyChange& change : changes)
+            {
+                TEST_CHECK(change.FromMip == ResidentMip[change.Texture]);
+                TEST_CHECK(change.FromMip != change.ToMip);
+                if(change.ToMip < change.FromMip)
+                {
+                    streamed += lBytes(MipBytes[change.Texture], change.ToMip, change.FromMip);
+                }
+                ResidentMip[change.Texture] = change.ToMip;
+            }
+            uint64_t resident = 0;
+            for(uint32_t i = 0; i < MipBytes.size(); i++)
+            {
+                TEST_CHECK(residency.GetResidentMip(i) == ResidentMip[i]);
+                resident += lBytes(MipBytes[i], ResidentMip[i], static_cast<uint32_t>(MipBytes[i].size()));
+            }
+            TEST_CHECK(residency.GetResidentBytes() == resident);
+            return streamed;
+        }
+    };
+
+    void StaysWithinBudget()
+    {
+        // Random textures and requests with a budget far below the total, streaming unlimited
+        std::mt19937             random(7);
+        assets::TextureResidency residency;
+        Mirror                   mirror;
+        residency.Init(4u << 20, UINT64_MAX);
+        uint64_t tailBytes = 0;
+        for(uint32_t i = 0; i < 64; i++)
+        {
+            std::vector<uint64_t> mipBytes = lMipChain(1u << (6 + random() % 6));
+            uint32_t              tailMip  = static_cast<uint32_t>(mipBytes.size()) - 4;
+            tailBytes += lBytes(mipBytes, tailMip, static_cast<uint32_t>(mipBytes.size()));
+            mirror.Add(residency, mipBytes, tailMip);
+        }
+        TEST_CHECK(residency.GetTotalBytes() > 4 * residency.GetBudget());
+        TEST_CHECK(residency.GetResidentBytes() == tailBytes);
+
+        std::vector<assets::ResidencyChange> changes;
+        uint64_t                             streamed = 0;
+        for(uint32_t frame = 0; frame < 500; frame++)
+        {
+            for(uint32_t lookup = 0; lookup < 12; lookup++)
+            {
+                residency.RequestMip(random() % 64, random() % 4);
+            }
+            changes.clear();
+            residency.Update(changes);
+            streamed += mirror.Apply(residency, changes);
+            TEST_CHECK(residency.GetResidentBytes() <= residency.GetBudget());
+        }
+        TEST_CHECK(residency.GetStreamedBytes() == streamed);
+        TEST_CHECK(residency.GetResidentBytes() == tailBytes + residency.GetStreamedBytes() - residency.GetEvictedBytes());
+        TEST_CHECK(residency.GetEvictedBytes() > 0);
+    }
+
+    void EvictsLeastRecentlyUsed()
+    {
+        // Room for the tails and the full chains of two textures
+        const std::vector<uint64_t> mipBytes  = lMipChain(64);
+        const uint32_t              tailMip   = 4;
+        const uint64_t              tailBytes = lBytes(mipBytes, tailMip, static_cast<uint32_t>(mipBytes.size()));
+        const uint64_t              fullBytes = lBytes(mipBytes, 0, tailMip);
+        assets::TextureResidency    residency;
+        Mirror                      mirror;
+        residency.Init(5 * tailBytes + 2 * fullBytes, UINT64_MAX);
+        for(uint32_t i = 0; i < 5; i++)
+        {
+            mirror.Add(residency, mipBytes, tailMip);
+        }
+
+        std::vector<assets::ResidencyChange> changes;
+
+        auto frame = [&](std::initializer_list<std::pair<uint32_t, uint32_t>> requests) {
+            for(auto [texture, mip] : requests)
+            {
+                residency.RequestMip(texture, mip);
+            }
+            changes.clear();
+            residency.Update(changes);
+            mirror.Apply(residency, changes);
+        };
+
+        frame({{0, 0}});
+        frame({{1, 0}});
+        TEST_CHECK(residency.GetResidentMip(0) == 0 && residency.GetResidentMip(1) == 0);
+
+        // Texture 0 is the least recently used one
+        frame({{2, 0}});
+        TEST_CHECK(residency.GetResidentMip(0) == tailMip);
+        TEST_CHECK(residency.GetResidentMip(1) == 0);
+        TEST_CHECK(residency.GetResidentMip(2) == 0);
+
+        // Using texture 1 again makes texture 2 the least recently used one
+        frame({{1, 0}});
+        frame({{3, 0}});
+        TEST_CHECK(residency.GetResidentMip(1) == 0);
+        TEST_CHECK(residency.GetResidentMip(2) == tailMip);
+        TEST_CHECK(residency.GetResidentMip(3) == 0);
+
+        // Only the finest mip is needed: the least recently used texture gives up its finest mip, not more
+        frame({{1, 1}, {3, 1}});
+        frame({{4, 1}});
+        TEST_CHECK(residency.GetResidentMip(1) == 0 || residency.GetResidentMip(3) == 0);
+        TEST_CHECK(residency.GetResidentMip(1) <= 1 && residency.GetResidentMip(3) <= 1);
+        TEST_CHECK(residency.GetResidentMip(4) == 1);
+
+        // Room for the tails and mips [1, tail) of two textures. Ties in the last use evict the lower index first
+        residency.Init(3 * tailBytes + 2 * (fullBytes - mipBytes[0]), UINT64_MAX);
+        mirror = Mirror();
+        for(uint32_t i = 0; i < 3; i++)
+        {
+            mirror.Add(residency, mipBytes, tailMip);
+        }
+        frame({{0, 1}, {1, 1}});
+        TEST_CHECK(residency.GetResidentMip(0) == 1 && residency.GetResidentMip(1) == 1);
+        frame({{2, 1}});
+        TEST_CHECK(residency.GetResidentMip(0) > 1);
+        TEST_CHECK(residency.GetResidentMip(1) == 1);
+        TEST_CHECK(residency.GetResidentMip(2) == 1);
+
+        // Textures of the current frame only give up detail finer than requested, wanted mips are never evicted for others
+        frame({{0, 1}, {1, 3}, {2, 1}});
+        TEST_CHECK(residency.GetResidentMip(0) < tailMip);
+        TEST_CHECK(residency.GetResidentMip(1) > 1 && residency.GetResidentMip(1) <= 3);
+        TEST_CHECK(residency.GetResidentMip(2) == 1);
+        TEST_CHECK(residency.GetResidentBytes() <= residency.GetBudget());
+    }
+
+    void KeepsMipTailResident()
+    {
+        const std::vector<uint64_t> mipBytes = lMipChain(256);
+        const uint32_t              tailMip  = 5;
+        std::mt19937                random(3);
+
+        // A budget below the tails: nothing streams in, the tails stay resident regardless
+        assets::TextureResidency residency;
+        Mirror                   mirror;
+        residency.Init(0, UINT64_MAX);
+        for(uint32_t i = 0; i < 8; i++)
+        {
+            mirror.Add(residency, mipBytes, tailMip);
+        }
+        std::vector<assets::ResidencyChange> changes;
+        for(uint32_t frame = 0; frame < 10; frame++)
+        {
+            for(uint32_t i = 0; i < 8; i++)
+            {
+                residency.RequestMip(i, 0);
+            }
+            changes.clear();
+            residency.Update(changes);
+            TEST_CHECK(changes.empty());
+            mirror.Apply(residency, changes);
+        }
+        TEST_CHECK(residency.GetResidentBytes() == 8 * lBytes(mipBytes, tailMip, static_cast<uint32_t>(mipBytes.size())));
+
+        // Heavy churn in a tight budget never evicts into the tail
+        residency.Init(2 * mipBytes[0], UINT64_MAX);
+        mirror = Mirror();
+        for(uint32_t i = 0; i < 8; i++)
+        {
+            mirror.Add(residency, mipBytes, tailMip);
+        }
+        for(uint32_t frame = 0; frame < 300; frame++)
+        {
+            residency.RequestMip(random() % 8, random() % (tailMip + 3));
+            residency.RequestMip(random() % 8, 0);
+            changes.clear();
+            residency.Update(changes);
+            mirror.Apply(residency, changes);
+            for(uint32_t i = 0; i < 8; i++)
+            {
+                TEST_CHECK(residency.GetResidentMip(i) <= tailMip);
+            }
+        }
+    }
+
+    void BoundsStreamingRate()
+    {
+        const std::vector<uint64_t> mipBytes = lMipChain(256);
+        const uint32_t              tailMip  = 4;
+        const uint32_t              count    = 6;
+        const uint64_t              rate     = 20000;
+        assets::TextureResidency    residency;
+        Mirror                      mirror;
+        residency.Init(UINT64_MAX, rate);
+        for(uint32_t i = 0; i < count; i++)
+        {
+            mirror.Add(residency, mipBytes, tailMip);
+        }
+
+        std::vector<assets::ResidencyChange> changes;
+        uint32_t                             updates = 0;
+        bool                                 done    = false;
+        while(!done && updates < 100)
+        {
+            for(uint32_t i = 0; i < count; i++)
+            {
+                residency.RequestMip(i, 0);
+            }
+            changes.clear();
+            residency.Update(changes);
+            uint64_t streamed = mirror.Apply(residency, changes);
+            updates++;
+
+            // Within the rate, unless the update streamed a single mip larger than it (otherwise that mip could never stream in)
+            uint32_t streamedMips = 0;
+            for(const assets::ResidencyChange& change : changes)
+            {
+                streamedMips += change.FromMip - change.ToMip;
+            }
+            TEST_CHECK(streamed <= rate || streamedMips == 1);
+            TEST_CHECK(streamed > 0);
+
+            // Coarse before fine: no texture is more than one mip ahead of another
+            uint32_t finest   = tailMip;
+            uint32_t coarsest = 0;
+            for(uint32_t i = 0; i < count; i++)
+            {
+                finest   = std::min(finest, residency.GetResidentMip(i));
+                coarsest = std::max(coarsest, residency.GetResidentMip(i));
+            }
+            TEST_CHECK(coarsest - finest <= 1);
+            done = coarsest == 0;
+        }
+        TEST_CHECK(done);
+        // Mip 3 of all textures takes two updates, the 16 KiB mip 2 and larger mips one update per texture
+        TEST_CHECK(updates == 2 + 3 * count);
+        TEST_CHECK(residency.GetStreamedBytes() == count * lBytes(mipBytes, 0, tailMip));
+    }
+}  // namespace
+
+int main()
+{
+    return test::RunTests({{"StaysWithinBudget", StaysWithinBudget},
+                           {"EvictsLeastRecentlyUsed", EvictsLeastRecentlyUsed},
+                           {"KeepsMipTailResident", KeepsMipTailResident},
+                           {"BoundsStreamingRate", BoundsStreamingRate}});
+}